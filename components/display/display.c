@@ -0,0 +1,519 @@
+#include "display.h"
+#include "display_backend.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h" // For mutex
+#include <string.h>
+
+static const char *TAG = "DISPLAY";
+
+// State
+static uint16_t *framebuffer = NULL;            // PSRAM, native-endian RGB565
+static SemaphoreHandle_t fb_mutex = NULL;       // Guards framebuffer pixels
+static portMUX_TYPE dirty_lock = portMUX_INITIALIZER_UNLOCKED; // Guards dirty_set (held only for copies)
+static display_dirty_set_t dirty_set;
+static TaskHandle_t flush_task_handle = NULL;
+static SemaphoreHandle_t task_exit_sem = NULL;
+static volatile bool flush_in_progress = false;
+static volatile bool stop_requested = false;
+static uint32_t min_frame_us = 0;
+
+static display_stats_t stats;
+static uint32_t fps_window_frames = 0;
+static int64_t fps_window_start_us = 0;
+
+// --- Helpers ---
+
+// Clip to the screen; returns false if nothing is left
+static bool clip_rect(display_rect_t *r)
+{
+    int32_t x0 = r->x < 0 ? 0 : r->x;
+    int32_t y0 = r->y < 0 ? 0 : r->y;
+    int32_t x1 = (int32_t)r->x + r->w;
+    int32_t y1 = (int32_t)r->y + r->h;
+    if (x1 > DISPLAY_WIDTH)
+    {
+        x1 = DISPLAY_WIDTH;
+    }
+    if (y1 > DISPLAY_HEIGHT)
+    {
+        y1 = DISPLAY_HEIGHT;
+    }
+    if (x1 <= x0 || y1 <= y0)
+    {
+        return false;
+    }
+    r->x = (int16_t)x0;
+    r->y = (int16_t)y0;
+    r->w = (int16_t)(x1 - x0);
+    r->h = (int16_t)(y1 - y0);
+    return true;
+}
+
+// Send one dirty rect: set the window, then stream rows through the bounce
+// buffers. Rows are copied (and byte-swapped for the panel) under the
+// framebuffer lock; the SPI/DMA transfer itself runs unlocked.
+static esp_err_t flush_rect(const display_rect_t *r, uint32_t *bytes)
+{
+    esp_err_t ret = display_backend.set_window(r->x, r->y, r->x + r->w - 1, r->y + r->h - 1);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    *bytes += DISPLAY_WINDOW_CMD_BYTES;
+
+    const int rows_per_chunk = DISPLAY_BOUNCE_PIXELS / r->w;
+    for (int row = 0; row < r->h; row += rows_per_chunk)
+    {
+        int rows = (r->h - row < rows_per_chunk) ? r->h - row : rows_per_chunk;
+        uint16_t *buf = display_backend.acquire_buffer();
+        if (buf == NULL)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+
+        uint16_t *dst = buf;
+        xSemaphoreTake(fb_mutex, portMAX_DELAY);
+        for (int y = 0; y < rows; ++y)
+        {
+            const uint16_t *src = &framebuffer[(r->y + row + y) * DISPLAY_WIDTH + r->x];
+            for (int x = 0; x < r->w; ++x)
+            {
+                *dst++ = __builtin_bswap16(src[x]); // Panel expects big-endian RGB565
+            }
+        }
+        xSemaphoreGive(fb_mutex);
+
+        size_t pixel_count = (size_t)rows * r->w;
+        ret = display_backend.write_pixels(buf, pixel_count);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+        *bytes += pixel_count * sizeof(uint16_t);
+    }
+    return ESP_OK;
+}
+
+static void display_flush_task(void *arg)
+{
+    int64_t last_frame_start_us = 0;
+
+    while (!stop_requested)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (stop_requested)
+        {
+            break;
+        }
+
+        // Frame rate cap: coalesce presents that arrive faster than max_fps
+        int64_t since_last_us = esp_timer_get_time() - last_frame_start_us;
+        if (min_frame_us != 0 && since_last_us < min_frame_us)
+        {
+            vTaskDelay(pdMS_TO_TICKS((min_frame_us - since_last_us + 999) / 1000));
+        }
+
+        display_dirty_set_t frame;
+        portENTER_CRITICAL(&dirty_lock);
+        frame = dirty_set;
+        dirty_set.count = 0;
+        flush_in_progress = (frame.count != 0);
+        portEXIT_CRITICAL(&dirty_lock);
+
+        if (frame.count == 0)
+        {
+            continue;
+        }
+
+        int64_t start_us = esp_timer_get_time();
+        last_frame_start_us = start_us;
+        uint32_t frame_bytes = 0;
+        esp_err_t ret = ESP_OK;
+        size_t sent = 0;
+        while (sent < frame.count && ret == ESP_OK)
+        {
+            ret = flush_rect(&frame.rects[sent], &frame_bytes);
+            if (ret == ESP_OK)
+            {
+                sent++;
+            }
+        }
+        if (ret == ESP_OK)
+        {
+            ret = display_backend.wait_done();
+            if (ret != ESP_OK)
+            {
+                sent = 0; // No telling which of the queued transfers landed
+            }
+        }
+        if (ret != ESP_OK)
+        {
+            // Put the unsent regions back so the next frame retries them;
+            // until then the panel and the framebuffer disagree there
+            ESP_LOGE(TAG, "Frame flush failed: %s", esp_err_to_name(ret));
+            portENTER_CRITICAL(&dirty_lock);
+            for (size_t i = sent; i < frame.count; ++i)
+            {
+                display_dirty_add(&dirty_set, frame.rects[i]);
+            }
+            portEXIT_CRITICAL(&dirty_lock);
+        }
+
+        int64_t end_us = esp_timer_get_time();
+        stats.frames++;
+        stats.rects_sent += frame.count;
+        stats.bytes_sent += frame_bytes;
+        stats.last_frame_bytes = frame_bytes;
+        stats.last_frame_us = (uint32_t)(end_us - start_us);
+
+        fps_window_frames++;
+        if (end_us - fps_window_start_us >= 1000000)
+        {
+            stats.fps = (float)fps_window_frames * 1000000.0f / (float)(end_us - fps_window_start_us);
+            fps_window_frames = 0;
+            fps_window_start_us = end_us;
+        }
+
+        flush_in_progress = false;
+    }
+
+    xSemaphoreGive(task_exit_sem);
+    vTaskDelete(NULL);
+}
+
+// --- Initialization ---
+
+esp_err_t display_init(const display_config_t *config)
+{
+    esp_err_t ret;
+
+    if (config == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (framebuffer != NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Framebuffer lives in PSRAM; only the small DMA bounce buffers need internal RAM
+    size_t fb_size = DISPLAY_WIDTH * DISPLAY_HEIGHT * sizeof(uint16_t);
+    framebuffer = heap_caps_calloc(1, fb_size, MALLOC_CAP_SPIRAM);
+    if (framebuffer == NULL)
+    {
+        ESP_LOGW(TAG, "PSRAM framebuffer allocation failed, falling back to internal RAM");
+        framebuffer = heap_caps_calloc(1, fb_size, MALLOC_CAP_DEFAULT);
+    }
+    if (framebuffer == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate %d byte framebuffer", fb_size);
+        return ESP_ERR_NO_MEM;
+    }
+
+    fb_mutex = xSemaphoreCreateMutex();
+    task_exit_sem = xSemaphoreCreateBinary();
+    if (fb_mutex == NULL || task_exit_sem == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create display semaphores");
+        ret = ESP_ERR_NO_MEM;
+        goto init_fail;
+    }
+
+    ret = display_backend.init();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Display backend init failed: %s", esp_err_to_name(ret));
+        goto init_fail;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    stats.full_frame_bytes = fb_size + DISPLAY_WINDOW_CMD_BYTES;
+    fps_window_start_us = esp_timer_get_time();
+    min_frame_us = (config->max_fps != 0) ? 1000000 / config->max_fps : 0;
+    stop_requested = false;
+
+    // First present pushes the whole (blank) screen so panel and framebuffer agree
+    dirty_set.count = 0;
+    display_rect_t full = {.x = 0, .y = 0, .w = DISPLAY_WIDTH, .h = DISPLAY_HEIGHT};
+    display_dirty_add(&dirty_set, full);
+
+    if (xTaskCreatePinnedToCore(display_flush_task, "display", config->task_stack_size, NULL,
+                                config->task_priority, &flush_task_handle, config->task_core_id) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create display task");
+        display_backend.deinit();
+        ret = ESP_ERR_NO_MEM;
+        goto init_fail;
+    }
+
+    ESP_LOGI(TAG, "Display initialized (%dx%d, %d byte framebuffer)", DISPLAY_WIDTH, DISPLAY_HEIGHT, fb_size);
+    return ESP_OK;
+
+init_fail:
+    if (task_exit_sem)
+    {
+        vSemaphoreDelete(task_exit_sem);
+        task_exit_sem = NULL;
+    }
+    if (fb_mutex)
+    {
+        vSemaphoreDelete(fb_mutex);
+        fb_mutex = NULL;
+    }
+    heap_caps_free(framebuffer);
+    framebuffer = NULL;
+    return ret;
+}
+
+esp_err_t display_deinit(void)
+{
+    if (framebuffer == NULL)
+    {
+        return ESP_OK;
+    }
+
+    stop_requested = true;
+    xTaskNotifyGive(flush_task_handle);
+    xSemaphoreTake(task_exit_sem, portMAX_DELAY);
+    flush_task_handle = NULL;
+
+    display_backend.deinit();
+
+    vSemaphoreDelete(task_exit_sem);
+    task_exit_sem = NULL;
+    vSemaphoreDelete(fb_mutex);
+    fb_mutex = NULL;
+    heap_caps_free(framebuffer);
+    framebuffer = NULL;
+
+    ESP_LOGI(TAG, "Display deinitialized.");
+    return ESP_OK;
+}
+
+// --- Drawing ---
+
+esp_err_t display_lock(TickType_t timeout_ticks)
+{
+    if (fb_mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return (xSemaphoreTake(fb_mutex, timeout_ticks) == pdTRUE) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void display_unlock(void)
+{
+    xSemaphoreGive(fb_mutex);
+}
+
+uint16_t *display_framebuffer(void)
+{
+    return framebuffer;
+}
+
+void display_invalidate(const display_rect_t *rect)
+{
+    if (rect == NULL)
+    {
+        return;
+    }
+
+    display_rect_t r = *rect;
+    if (!clip_rect(&r))
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&dirty_lock);
+    display_dirty_add(&dirty_set, r);
+    portEXIT_CRITICAL(&dirty_lock);
+}
+
+esp_err_t display_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+    if (framebuffer == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    display_rect_t r = {.x = x, .y = y, .w = w, .h = h};
+    if (!clip_rect(&r))
+    {
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(fb_mutex, portMAX_DELAY);
+    for (int row = 0; row < r.h; ++row)
+    {
+        uint16_t *dst = &framebuffer[(r.y + row) * DISPLAY_WIDTH + r.x];
+        for (int col = 0; col < r.w; ++col)
+        {
+            dst[col] = color;
+        }
+    }
+    xSemaphoreGive(fb_mutex);
+
+    display_invalidate(&r);
+    return ESP_OK;
+}
+
+esp_err_t display_blit(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *pixels)
+{
+    if (pixels == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (framebuffer == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    display_rect_t r = {.x = x, .y = y, .w = w, .h = h};
+    if (!clip_rect(&r))
+    {
+        return ESP_OK;
+    }
+
+    // Offsets into the source when the block was clipped on the top/left
+    int src_x = r.x - x;
+    int src_y = r.y - y;
+
+    xSemaphoreTake(fb_mutex, portMAX_DELAY);
+    for (int row = 0; row < r.h; ++row)
+    {
+        memcpy(&framebuffer[(r.y + row) * DISPLAY_WIDTH + r.x],
+               &pixels[(src_y + row) * w + src_x],
+               r.w * sizeof(uint16_t));
+    }
+    xSemaphoreGive(fb_mutex);
+
+    display_invalidate(&r);
+    return ESP_OK;
+}
+
+esp_err_t display_draw_pixel(int16_t x, int16_t y, uint16_t color)
+{
+    return display_fill_rect(x, y, 1, 1, color);
+}
+
+// --- Presentation ---
+
+esp_err_t display_present(void)
+{
+    if (flush_task_handle == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xTaskNotifyGive(flush_task_handle);
+    return ESP_OK;
+}
+
+esp_err_t display_wait_idle(TickType_t timeout_ticks)
+{
+    TickType_t start = xTaskGetTickCount();
+    while (1)
+    {
+        portENTER_CRITICAL(&dirty_lock);
+        bool idle = (dirty_set.count == 0) && !flush_in_progress;
+        portEXIT_CRITICAL(&dirty_lock);
+
+        if (idle)
+        {
+            return ESP_OK;
+        }
+        if (xTaskGetTickCount() - start >= timeout_ticks)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(1);
+    }
+}
+
+// --- Diagnostics ---
+
+esp_err_t display_get_stats(display_stats_t *out_stats)
+{
+    if (out_stats == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_stats = stats;
+    return ESP_OK;
+}
+
+void display_reset_stats(void)
+{
+    uint32_t full_frame_bytes = stats.full_frame_bytes;
+    memset(&stats, 0, sizeof(stats));
+    stats.full_frame_bytes = full_frame_bytes;
+    fps_window_frames = 0;
+    fps_window_start_us = esp_timer_get_time();
+}
+
+esp_err_t display_benchmark(uint32_t num_frames, display_stats_t *out_stats)
+{
+    if (out_stats == NULL || num_frames == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (flush_task_handle == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Start from a settled screen so only the workload is measured
+    esp_err_t ret = display_present();
+    if (ret == ESP_OK)
+    {
+        ret = display_wait_idle(pdMS_TO_TICKS(1000));
+    }
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    display_reset_stats();
+
+    const int16_t bar_x = 8, bar_y = DISPLAY_HEIGHT / 2, bar_w = DISPLAY_WIDTH - 16, bar_h = 8;
+    const uint16_t fg = DISPLAY_RGB565(0x40, 0xC0, 0xFF);
+    const uint16_t bg = DISPLAY_RGB565(0, 0, 0);
+    int16_t prev_fill = 0;
+
+    for (uint32_t f = 0; f < num_frames; ++f)
+    {
+        // Parameter bar: only the span between the old and new level changes
+        int16_t fill = (int16_t)((f * 7) % bar_w);
+        if (fill > prev_fill)
+        {
+            display_fill_rect(bar_x + prev_fill, bar_y, fill - prev_fill, bar_h, fg);
+        }
+        else
+        {
+            display_fill_rect(bar_x + fill, bar_y, prev_fill - fill, bar_h, bg);
+        }
+        prev_fill = fill;
+
+        // Selection cursor hopping between menu rows
+        int16_t row = (int16_t)(f % 4) * 12 + 4;
+        int16_t prev_row = (int16_t)((f + 3) % 4) * 12 + 4;
+        display_fill_rect(2, prev_row, 4, 8, bg);
+        display_fill_rect(2, row, 4, 8, fg);
+
+        display_present();
+        ret = display_wait_idle(pdMS_TO_TICKS(1000));
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+    }
+
+    *out_stats = stats;
+    uint32_t bytes_per_update = (uint32_t)(stats.bytes_sent / (stats.frames ? stats.frames : 1));
+    ESP_LOGI(TAG, "Benchmark: %lu updates, %lu bytes/update (full frame %lu), %.1f fps",
+             (unsigned long)stats.frames, (unsigned long)bytes_per_update,
+             (unsigned long)stats.full_frame_bytes, stats.fps);
+    return ESP_OK;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// Internal interface between the display core (framebuffer, dirty tracking,
+// flush task) and the component that actually moves pixels to a panel.
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// Size of each DMA bounce buffer in pixels (one or more full panel rows)
+#define DISPLAY_BOUNCE_PIXELS (DISPLAY_WIDTH * 8)
+
+// Fixed command overhead of one window update in bytes (column + row address + RAM write)
+#define DISPLAY_WINDOW_CMD_BYTES 7
+
+typedef struct
+{
+    esp_err_t (*init)(void);
+    void (*deinit)(void);
+
+    // Set the panel write window (inclusive coordinates) and start a RAM write.
+    // Waits for any pixel data still in flight first.
+    esp_err_t (*set_window)(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
+
+    // Get a free bounce buffer of DISPLAY_BOUNCE_PIXELS, waiting for an in-flight
+    // transfer to complete if all buffers are busy.
+    uint16_t *(*acquire_buffer)(void);
+
+    // Queue `pixel_count` big-endian RGB565 pixels from a buffer returned by
+    // acquire_buffer(). Returns once queued; the transfer runs in the background.
+    esp_err_t (*write_pixels)(uint16_t *buffer, size_t pixel_count);
+
+    // Wait until every queued transfer has completed.
+    esp_err_t (*wait_done)(void);
+} display_backend_t;
+
+// Provided by exactly one of display_backend_ssd1336.c / display_backend_host.c
+extern const display_backend_t display_backend;
+
+// --- Dirty Region Tracking (display_dirty.c) ---
+
+#define DISPLAY_MAX_DIRTY_RECTS CONFIG_CENTRAL_DISPLAY_MAX_DIRTY_RECTS
+
+typedef struct
+{
+    display_rect_t rects[DISPLAY_MAX_DIRTY_RECTS];
+    size_t count;
+} display_dirty_set_t;
+
+// Add an already clipped, non-empty rect, merging where one window is cheaper than two
+void display_dirty_add(display_dirty_set_t *set, display_rect_t rect);
+
+// Bytes needed to send the whole set, including per-window command overhead
+uint32_t display_dirty_cost(const display_dirty_set_t *set);
@@ -0,0 +1,92 @@
+#include "display.h"
+#include "display_backend.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Host framebuffer backend: emulates the panel's windowed RAM writes into an
+// in-memory "panel" so the dirty-rect pipeline can be exercised and benchmarked
+// without hardware (ESP-IDF linux target, or on-device with no panel fitted).
+
+static const char *TAG = "DISPLAY_HOST";
+
+// State
+static uint16_t *panel = NULL; // What the panel would show, native-endian
+static uint16_t bounce_buffer[DISPLAY_BOUNCE_PIXELS];
+static uint16_t win_x0, win_y0, win_x1, win_y1;
+static uint16_t cursor_x, cursor_y;
+
+static esp_err_t host_init(void)
+{
+    panel = calloc(DISPLAY_WIDTH * DISPLAY_HEIGHT, sizeof(uint16_t));
+    if (panel == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Host display backend initialized (%dx%d)", DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    return ESP_OK;
+}
+
+static void host_deinit(void)
+{
+    free(panel);
+    panel = NULL;
+}
+
+static esp_err_t host_set_window(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    if (x1 >= DISPLAY_WIDTH || y1 >= DISPLAY_HEIGHT || x0 > x1 || y0 > y1)
+    {
+        ESP_LOGE(TAG, "Bad window %d,%d-%d,%d", x0, y0, x1, y1);
+        return ESP_ERR_INVALID_ARG;
+    }
+    win_x0 = x0;
+    win_y0 = y0;
+    win_x1 = x1;
+    win_y1 = y1;
+    cursor_x = x0;
+    cursor_y = y0;
+    return ESP_OK;
+}
+
+static uint16_t *host_acquire_buffer(void)
+{
+    return bounce_buffer; // Writes complete synchronously, so one buffer is always free
+}
+
+static esp_err_t host_write_pixels(uint16_t *buffer, size_t pixel_count)
+{
+    // Same auto-increment behaviour as the controller: column first, wrapping inside the window
+    for (size_t i = 0; i < pixel_count; ++i)
+    {
+        panel[cursor_y * DISPLAY_WIDTH + cursor_x] = __builtin_bswap16(buffer[i]);
+        if (++cursor_x > win_x1)
+        {
+            cursor_x = win_x0;
+            if (++cursor_y > win_y1)
+            {
+                cursor_y = win_y0;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t host_wait_done(void)
+{
+    return ESP_OK;
+}
+
+const uint16_t *display_host_panel(void)
+{
+    return panel;
+}
+
+const display_backend_t display_backend = {
+    .init = host_init,
+    .deinit = host_deinit,
+    .set_window = host_set_window,
+    .acquire_buffer = host_acquire_buffer,
+    .write_pixels = host_write_pixels,
+    .wait_done = host_wait_done,
+};
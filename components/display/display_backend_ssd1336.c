@@ -0,0 +1,278 @@
+#include "display.h"
+#include "display_backend.h"
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "SSD1336";
+
+// Configuration values (read from sdkconfig)
+#define DISPLAY_SPI_HOST CONFIG_CENTRAL_DISPLAY_SPI_HOST
+#define DISPLAY_PIN_MOSI CONFIG_CENTRAL_DISPLAY_MOSI_IO
+#define DISPLAY_PIN_SCLK CONFIG_CENTRAL_DISPLAY_SCLK_IO
+#define DISPLAY_PIN_CS CONFIG_CENTRAL_DISPLAY_CS_IO
+#define DISPLAY_PIN_DC CONFIG_CENTRAL_DISPLAY_DC_IO
+#define DISPLAY_PIN_RST CONFIG_CENTRAL_DISPLAY_RST_IO
+#define DISPLAY_SPI_CLOCK_HZ (CONFIG_CENTRAL_DISPLAY_SPI_CLOCK_MHZ * 1000 * 1000)
+
+#define NUM_BOUNCE_BUFFERS 2 // Fill one while the other is on the wire
+
+// Controller commands
+#define SSD_CMD_SET_COLUMN 0x15
+#define SSD_CMD_SET_ROW 0x75
+#define SSD_CMD_WRITE_RAM 0x5C
+#define SSD_CMD_DISPLAY_OFF 0xAE
+#define SSD_CMD_DISPLAY_ON 0xAF
+
+// Power-up sequence: command byte, data length, data bytes
+static const uint8_t init_sequence[] = {
+    0xFD, 1, 0x12,             // Unlock command interface
+    0xFD, 1, 0xB1,             // Unlock privileged commands
+    SSD_CMD_DISPLAY_OFF, 0,    //
+    0xB3, 1, 0xF1,             // Clock divider / oscillator frequency
+    0xCA, 1, DISPLAY_HEIGHT - 1, // Mux ratio
+    0xA0, 1, 0x74,             // Remap: 65k colour (RGB565), COM split, scan direction
+    0xA1, 1, 0x00,             // Display start line
+    0xA2, 1, 0x00,             // Display offset
+    0xAB, 1, 0x01,             // Internal VDD regulator
+    0xB1, 1, 0x32,             // Phase 1/2 period
+    0xBE, 1, 0x05,             // VCOMH
+    0xA6, 0,                   // Normal display mode
+    0xC1, 3, 0xC8, 0x80, 0xC8, // Contrast A/B/C
+    0xC7, 1, 0x0F,             // Master contrast
+    0xB6, 1, 0x01,             // Second precharge period
+    SSD_CMD_DISPLAY_ON, 0,
+};
+
+// State
+static spi_device_handle_t spi_dev = NULL;
+static uint16_t *bounce_buffers[NUM_BOUNCE_BUFFERS] = {NULL};
+static spi_transaction_t pixel_trans[NUM_BOUNCE_BUFFERS];
+static int next_buffer = 0;
+static int in_flight = 0;
+
+// D/C line is driven from the transaction's user field just before each transfer
+static void IRAM_ATTR spi_pre_transfer_callback(spi_transaction_t *t)
+{
+    gpio_set_level(DISPLAY_PIN_DC, (int)(intptr_t)t->user);
+}
+
+static esp_err_t collect_one(void)
+{
+    spi_transaction_t *done = NULL;
+    esp_err_t ret = spi_device_get_trans_result(spi_dev, &done, pdMS_TO_TICKS(100));
+    if (ret == ESP_OK)
+    {
+        in_flight--;
+    }
+    return ret;
+}
+
+static esp_err_t ssd_wait_done(void)
+{
+    while (in_flight > 0)
+    {
+        esp_err_t ret = collect_one();
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Pixel transfer did not complete: %s", esp_err_to_name(ret));
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+// Small command/data writes are polled; they are a few bytes and must follow queued pixels in order
+static esp_err_t ssd_write(uint8_t cmd, const uint8_t *data, size_t len)
+{
+    spi_transaction_t t = {
+        .length = 8,
+        .tx_buffer = &cmd,
+        .user = (void *)0, // D/C low: command
+    };
+    esp_err_t ret = spi_device_polling_transmit(spi_dev, &t);
+    if (ret == ESP_OK && len > 0)
+    {
+        spi_transaction_t d = {
+            .length = len * 8,
+            .tx_buffer = data,
+            .user = (void *)1, // D/C high: data
+        };
+        ret = spi_device_polling_transmit(spi_dev, &d);
+    }
+    return ret;
+}
+
+static esp_err_t ssd_init(void)
+{
+    esp_err_t ret;
+
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << DISPLAY_PIN_DC) | (DISPLAY_PIN_RST >= 0 ? (1ULL << DISPLAY_PIN_RST) : 0),
+        .mode = GPIO_MODE_OUTPUT,
+    };
+    ret = gpio_config(&io_conf);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    spi_bus_config_t bus_cfg = {
+        .mosi_io_num = DISPLAY_PIN_MOSI,
+        .miso_io_num = -1,
+        .sclk_io_num = DISPLAY_PIN_SCLK,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = DISPLAY_BOUNCE_PIXELS * sizeof(uint16_t),
+    };
+    ret = spi_bus_initialize(DISPLAY_SPI_HOST, &bus_cfg, SPI_DMA_CH_AUTO);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to initialize SPI bus: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    spi_device_interface_config_t dev_cfg = {
+        .clock_speed_hz = DISPLAY_SPI_CLOCK_HZ,
+        .mode = 0,
+        .spics_io_num = DISPLAY_PIN_CS,
+        .queue_size = NUM_BOUNCE_BUFFERS,
+        .pre_cb = spi_pre_transfer_callback,
+    };
+    ret = spi_bus_add_device(DISPLAY_SPI_HOST, &dev_cfg, &spi_dev);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to add SPI device: %s", esp_err_to_name(ret));
+        spi_bus_free(DISPLAY_SPI_HOST);
+        return ret;
+    }
+
+    for (int i = 0; i < NUM_BOUNCE_BUFFERS; ++i)
+    {
+        bounce_buffers[i] = heap_caps_malloc(DISPLAY_BOUNCE_PIXELS * sizeof(uint16_t), MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if (bounce_buffers[i] == NULL)
+        {
+            ESP_LOGE(TAG, "Failed to allocate DMA bounce buffer");
+            ret = ESP_ERR_NO_MEM;
+            goto init_fail;
+        }
+    }
+    next_buffer = 0;
+    in_flight = 0;
+
+    if (DISPLAY_PIN_RST >= 0)
+    {
+        gpio_set_level(DISPLAY_PIN_RST, 0);
+        vTaskDelay(pdMS_TO_TICKS(10));
+        gpio_set_level(DISPLAY_PIN_RST, 1);
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    for (size_t i = 0; i < sizeof(init_sequence);)
+    {
+        uint8_t cmd = init_sequence[i];
+        uint8_t len = init_sequence[i + 1];
+        ret = ssd_write(cmd, &init_sequence[i + 2], len);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Init command 0x%02X failed: %s", cmd, esp_err_to_name(ret));
+            goto init_fail;
+        }
+        i += 2 + len;
+    }
+
+    ESP_LOGI(TAG, "SSD1336 initialized on SPI%d @ %d MHz", DISPLAY_SPI_HOST + 1, CONFIG_CENTRAL_DISPLAY_SPI_CLOCK_MHZ);
+    return ESP_OK;
+
+init_fail:
+    for (int i = 0; i < NUM_BOUNCE_BUFFERS; ++i)
+    {
+        heap_caps_free(bounce_buffers[i]);
+        bounce_buffers[i] = NULL;
+    }
+    spi_bus_remove_device(spi_dev);
+    spi_dev = NULL;
+    spi_bus_free(DISPLAY_SPI_HOST);
+    return ret;
+}
+
+static void ssd_deinit(void)
+{
+    if (spi_dev == NULL)
+    {
+        return;
+    }
+    ssd_wait_done();
+    ssd_write(SSD_CMD_DISPLAY_OFF, NULL, 0);
+    spi_bus_remove_device(spi_dev);
+    spi_dev = NULL;
+    spi_bus_free(DISPLAY_SPI_HOST);
+    for (int i = 0; i < NUM_BOUNCE_BUFFERS; ++i)
+    {
+        heap_caps_free(bounce_buffers[i]);
+        bounce_buffers[i] = NULL;
+    }
+}
+
+static esp_err_t ssd_set_window(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    // Polled transactions may not overlap queued ones
+    esp_err_t ret = ssd_wait_done();
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    uint8_t cols[2] = {(uint8_t)x0, (uint8_t)x1};
+    uint8_t rows[2] = {(uint8_t)y0, (uint8_t)y1};
+    ret = ssd_write(SSD_CMD_SET_COLUMN, cols, sizeof(cols));
+    if (ret == ESP_OK)
+    {
+        ret = ssd_write(SSD_CMD_SET_ROW, rows, sizeof(rows));
+    }
+    if (ret == ESP_OK)
+    {
+        ret = ssd_write(SSD_CMD_WRITE_RAM, NULL, 0);
+    }
+    return ret;
+}
+
+static uint16_t *ssd_acquire_buffer(void)
+{
+    // Buffers are used round-robin; with all of them queued, the oldest must finish first
+    if (in_flight >= NUM_BOUNCE_BUFFERS && collect_one() != ESP_OK)
+    {
+        return NULL;
+    }
+    return bounce_buffers[next_buffer];
+}
+
+static esp_err_t ssd_write_pixels(uint16_t *buffer, size_t pixel_count)
+{
+    spi_transaction_t *t = &pixel_trans[next_buffer];
+    *t = (spi_transaction_t){
+        .length = pixel_count * 16,
+        .tx_buffer = buffer,
+        .user = (void *)1, // D/C high: pixel data
+    };
+
+    esp_err_t ret = spi_device_queue_trans(spi_dev, t, pdMS_TO_TICKS(100));
+    if (ret == ESP_OK)
+    {
+        in_flight++;
+        next_buffer = (next_buffer + 1) % NUM_BOUNCE_BUFFERS;
+    }
+    return ret;
+}
+
+const display_backend_t display_backend = {
+    .init = ssd_init,
+    .deinit = ssd_deinit,
+    .set_window = ssd_set_window,
+    .acquire_buffer = ssd_acquire_buffer,
+    .write_pixels = ssd_write_pixels,
+    .wait_done = ssd_wait_done,
+};
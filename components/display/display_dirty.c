@@ -0,0 +1,80 @@
+#include "display.h"
+#include "display_backend.h"
+
+// A window update costs its pixel bytes plus a fixed command/transaction setup.
+// Merging two rects is worth it when the union's extra pixels cost less than
+// the setup of the second window. The setup figure includes the SPI transaction
+// turnaround, expressed in equivalent pixels.
+#define WINDOW_OVERHEAD_PIXELS 64
+
+static inline int32_t rect_area(display_rect_t r)
+{
+    return (int32_t)r.w * r.h;
+}
+
+static display_rect_t rect_union(display_rect_t a, display_rect_t b)
+{
+    int16_t x0 = (a.x < b.x) ? a.x : b.x;
+    int16_t y0 = (a.y < b.y) ? a.y : b.y;
+    int16_t x1 = (a.x + a.w > b.x + b.w) ? a.x + a.w : b.x + b.w;
+    int16_t y1 = (a.y + a.h > b.y + b.h) ? a.y + a.h : b.y + b.h;
+    display_rect_t u = {.x = x0, .y = y0, .w = (int16_t)(x1 - x0), .h = (int16_t)(y1 - y0)};
+    return u;
+}
+
+// Extra pixels sent if a and b are replaced by their union (negative when merging saves)
+static int32_t merge_cost(display_rect_t a, display_rect_t b)
+{
+    return rect_area(rect_union(a, b)) - rect_area(a) - rect_area(b) - WINDOW_OVERHEAD_PIXELS;
+}
+
+void display_dirty_add(display_dirty_set_t *set, display_rect_t rect)
+{
+    // Fold the new rect into existing ones for as long as that is cheaper.
+    // A merge can make the grown rect worth merging with another, so rescan.
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (size_t i = 0; i < set->count; ++i)
+        {
+            if (merge_cost(set->rects[i], rect) <= 0)
+            {
+                rect = rect_union(set->rects[i], rect);
+                set->rects[i] = set->rects[--set->count];
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    if (set->count < DISPLAY_MAX_DIRTY_RECTS)
+    {
+        set->rects[set->count++] = rect;
+        return;
+    }
+
+    // Set is full: merge the new rect into whichever existing rect grows least
+    size_t best = 0;
+    int32_t best_cost = INT32_MAX;
+    for (size_t i = 0; i < set->count; ++i)
+    {
+        int32_t cost = merge_cost(set->rects[i], rect);
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            best = i;
+        }
+    }
+    set->rects[best] = rect_union(set->rects[best], rect);
+}
+
+uint32_t display_dirty_cost(const display_dirty_set_t *set)
+{
+    uint32_t bytes = 0;
+    for (size_t i = 0; i < set->count; ++i)
+    {
+        bytes += (uint32_t)rect_area(set->rects[i]) * sizeof(uint16_t) + DISPLAY_WINDOW_CMD_BYTES;
+    }
+    return bytes;
+}
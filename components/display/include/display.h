@@ -0,0 +1,182 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h" // For TickType_t, UBaseType_t
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // --- Geometry ---
+
+#define DISPLAY_WIDTH CONFIG_CENTRAL_DISPLAY_WIDTH
+#define DISPLAY_HEIGHT CONFIG_CENTRAL_DISPLAY_HEIGHT
+
+// Pack 8-bit components into native-endian RGB565
+#define DISPLAY_RGB565(r, g, b) ((uint16_t)((((r) & 0xF8) << 8) | (((g) & 0xFC) << 3) | ((b) >> 3)))
+
+    typedef struct
+    {
+        int16_t x;
+        int16_t y;
+        int16_t w;
+        int16_t h;
+    } display_rect_t;
+
+    // --- Configuration ---
+
+    typedef struct
+    {
+        size_t task_stack_size;    // Stack size for the display flush task
+        UBaseType_t task_priority; // Keep below the I2C engine so the bus is never starved
+        int task_core_id;          // Core to pin the task to (0, 1, or tskNO_AFFINITY)
+        uint32_t max_fps;          // Upper bound on presented frames per second (0 = unlimited)
+    } display_config_t;
+
+    // --- Statistics ---
+
+    typedef struct
+    {
+        uint32_t frames;           // Frames presented (flushes that sent at least one rect)
+        uint32_t rects_sent;       // Window updates sent to the panel
+        uint64_t bytes_sent;       // Pixel and command bytes sent to the panel
+        uint32_t last_frame_bytes; // Bytes sent by the most recent frame
+        uint32_t last_frame_us;    // Time to push the most recent frame
+        uint32_t full_frame_bytes; // Bytes a full-screen redraw would cost, for comparison
+        float fps;                 // Presented frames per second over the last measurement period
+    } display_stats_t;
+
+    // --- Initialization / Deinitialization ---
+
+    /**
+     * @brief Initialize the display: allocate the PSRAM framebuffer, bring up the backend
+     * (SSD1336 over SPI, or the host framebuffer) and start the flush task.
+     *
+     * @param config Pointer to configuration struct.
+     * @return ESP_OK on success, or an error code.
+     */
+    esp_err_t display_init(const display_config_t *config);
+
+    /**
+     * @brief Stop the flush task, shut down the backend and free the framebuffer.
+     *
+     * @return ESP_OK on success.
+     */
+    esp_err_t display_deinit(void);
+
+    // --- Drawing ---
+    // All drawing goes to the framebuffer and only marks regions dirty. Nothing is
+    // sent to the panel until display_present() is called.
+
+    /**
+     * @brief Lock the framebuffer for direct access via display_framebuffer().
+     * The flush task cannot copy out pixels while the lock is held.
+     *
+     * @param timeout_ticks Max time to wait for the lock.
+     * @return ESP_OK on success, ESP_ERR_TIMEOUT otherwise.
+     */
+    esp_err_t display_lock(TickType_t timeout_ticks);
+
+    /**
+     * @brief Release the framebuffer lock.
+     */
+    void display_unlock(void);
+
+    /**
+     * @brief Raw framebuffer (DISPLAY_WIDTH x DISPLAY_HEIGHT, native-endian RGB565).
+     * Only valid between display_lock() and display_unlock(); call display_invalidate()
+     * for every region modified.
+     *
+     * @return Pointer to the framebuffer, or NULL if not initialized.
+     */
+    uint16_t *display_framebuffer(void);
+
+    /**
+     * @brief Mark a region as changed so it is sent with the next present.
+     * The region is clipped to the screen.
+     *
+     * @param rect Region in pixels.
+     */
+    void display_invalidate(const display_rect_t *rect);
+
+    /**
+     * @brief Fill a rectangle with a solid colour.
+     *
+     * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized.
+     */
+    esp_err_t display_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+
+    /**
+     * @brief Copy a block of RGB565 pixels (row-major, w pixels per row) into the framebuffer.
+     *
+     * @return ESP_OK on success, ESP_ERR_INVALID_ARG on NULL pixels, ESP_ERR_INVALID_STATE if not initialized.
+     */
+    esp_err_t display_blit(int16_t x, int16_t y, int16_t w, int16_t h, const uint16_t *pixels);
+
+    /**
+     * @brief Set a single pixel.
+     *
+     * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized.
+     */
+    esp_err_t display_draw_pixel(int16_t x, int16_t y, uint16_t color);
+
+    // --- Presentation ---
+
+    /**
+     * @brief Ask the flush task to send all dirty regions to the panel. Returns immediately.
+     *
+     * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized.
+     */
+    esp_err_t display_present(void);
+
+    /**
+     * @brief Block until no dirty regions are pending and the last present has completed.
+     *
+     * @param timeout_ticks Max time to wait.
+     * @return ESP_OK once idle, ESP_ERR_TIMEOUT otherwise.
+     */
+    esp_err_t display_wait_idle(TickType_t timeout_ticks);
+
+    // --- Diagnostics ---
+
+    /**
+     * @brief Copy the flush statistics.
+     *
+     * @param[out] stats Destination.
+     * @return ESP_OK on success.
+     */
+    esp_err_t display_get_stats(display_stats_t *stats);
+
+    /**
+     * @brief Reset the flush statistics (e.g. at the start of a benchmark run).
+     */
+    void display_reset_stats(void);
+
+    /**
+     * @brief Drive a synthetic UI workload (a moving parameter bar and cursor, one small
+     * change per frame) through the full pipeline and report the resulting statistics.
+     * Intended for the host backend or for on-device profiling before the UI starts.
+     *
+     * @param num_frames Number of UI updates to present.
+     * @param[out] stats Statistics for the run (fps, bytes per update vs. full frame).
+     * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized, ESP_ERR_TIMEOUT if a frame stalls.
+     */
+    esp_err_t display_benchmark(uint32_t num_frames, display_stats_t *stats);
+
+#if CONFIG_CENTRAL_DISPLAY_BACKEND_HOST
+    /**
+     * @brief Host backend only: the simulated panel RAM, as the panel would show it
+     * (DISPLAY_WIDTH x DISPLAY_HEIGHT, native-endian RGB565).
+     *
+     * @return Pointer to the panel contents, or NULL if not initialized.
+     */
+    const uint16_t *display_host_panel(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
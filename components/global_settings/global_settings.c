@@ -0,0 +1,381 @@
+#include "global_settings.h"
+#include "esp_log.h"
+#include "esp_system.h" // For esp_register_shutdown_handler
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h" // For mutex
+#include <string.h>
+
+static const char *TAG = "GLOBAL_SETTINGS";
+
+#define SETTINGS_NVS_NAMESPACE "global"
+
+// --- Setting Metadata ---
+
+typedef struct
+{
+    const char *nvs_key;
+    global_setting_type_t type;
+    int32_t default_value;
+} setting_meta_t;
+
+#define GLOBAL_SETTINGS_META_ENTRY(id, key, type, def) [id] = {key, type, (int32_t)(def)},
+static const setting_meta_t setting_meta[SETTING_COUNT] = {
+    GLOBAL_SETTINGS_TABLE(GLOBAL_SETTINGS_META_ENTRY)};
+#undef GLOBAL_SETTINGS_META_ENTRY
+
+// --- State ---
+// All values are 32-bit and stored as raw words; the type only selects the
+// NVS accessor and which getter/setter is allowed.
+
+static uint32_t values[SETTING_COUNT];
+static uint32_t dirty_mask = 0; // Bit per setting with changes not yet in flash
+static portMUX_TYPE values_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t flush_mutex = NULL; // Serializes NVS writes between the task and flush()
+static TaskHandle_t commit_task_handle = NULL;
+static uint32_t commit_count = 0;
+static TickType_t quiet_period_ticks = 0;
+static TickType_t max_delay_ticks = 0;
+
+_Static_assert(SETTING_COUNT <= 32, "dirty_mask holds one bit per setting");
+
+// --- Helpers ---
+
+static esp_err_t load_setting(nvs_handle_t nvs, global_setting_id_t id)
+{
+    esp_err_t ret;
+    switch (setting_meta[id].type)
+    {
+    case SETTING_TYPE_I32:
+    {
+        int32_t v;
+        ret = nvs_get_i32(nvs, setting_meta[id].nvs_key, &v);
+        if (ret == ESP_OK)
+        {
+            values[id] = (uint32_t)v;
+        }
+        break;
+    }
+    case SETTING_TYPE_BOOL:
+    {
+        uint8_t v;
+        ret = nvs_get_u8(nvs, setting_meta[id].nvs_key, &v);
+        if (ret == ESP_OK)
+        {
+            values[id] = (v != 0);
+        }
+        break;
+    }
+    default: // SETTING_TYPE_U32
+        ret = nvs_get_u32(nvs, setting_meta[id].nvs_key, &values[id]);
+        break;
+    }
+    return ret;
+}
+
+static esp_err_t store_setting(nvs_handle_t nvs, global_setting_id_t id, uint32_t value)
+{
+    switch (setting_meta[id].type)
+    {
+    case SETTING_TYPE_I32:
+        return nvs_set_i32(nvs, setting_meta[id].nvs_key, (int32_t)value);
+    case SETTING_TYPE_BOOL:
+        return nvs_set_u8(nvs, setting_meta[id].nvs_key, (uint8_t)(value != 0));
+    default: // SETTING_TYPE_U32
+        return nvs_set_u32(nvs, setting_meta[id].nvs_key, value);
+    }
+}
+
+static esp_err_t get_raw(global_setting_id_t id, global_setting_type_t type, uint32_t *value)
+{
+    if (id >= SETTING_COUNT || setting_meta[id].type != type || value == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Aligned 32-bit reads are atomic on Xtensa; no lock needed
+    *value = values[id];
+    return ESP_OK;
+}
+
+static esp_err_t set_raw(global_setting_id_t id, global_setting_type_t type, uint32_t value)
+{
+    if (id >= SETTING_COUNT || setting_meta[id].type != type)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool changed = false;
+    portENTER_CRITICAL(&values_lock);
+    if (values[id] != value)
+    {
+        values[id] = value;
+        dirty_mask |= 1u << id;
+        changed = true;
+    }
+    portEXIT_CRITICAL(&values_lock);
+
+    if (changed && commit_task_handle != NULL)
+    {
+        xTaskNotifyGive(commit_task_handle); // Restarts the quiet period
+    }
+    return ESP_OK;
+}
+
+// --- Background Commit ---
+
+static void global_settings_task(void *arg)
+{
+    while (1)
+    {
+        // Sleep until the first change
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        TickType_t first_change = xTaskGetTickCount();
+
+        // Debounce: every further change restarts the quiet period, but never
+        // wait longer than max_delay after the first one
+        while (1)
+        {
+            TickType_t elapsed = xTaskGetTickCount() - first_change;
+            if (elapsed >= max_delay_ticks)
+            {
+                break;
+            }
+            TickType_t remaining = max_delay_ticks - elapsed;
+            TickType_t wait = (quiet_period_ticks < remaining) ? quiet_period_ticks : remaining;
+            if (ulTaskNotifyTake(pdTRUE, wait) == 0)
+            {
+                break; // Quiet period passed without changes
+            }
+        }
+
+        esp_err_t ret = global_settings_flush();
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Background commit failed: %s", esp_err_to_name(ret));
+            // Settings stay dirty; retry after another quiet period
+            xTaskNotifyGive(commit_task_handle);
+            vTaskDelay(quiet_period_ticks);
+        }
+    }
+}
+
+static void global_settings_shutdown_handler(void)
+{
+    if (global_settings_is_dirty())
+    {
+        global_settings_flush();
+    }
+}
+
+// --- Initialization ---
+
+esp_err_t global_settings_init(const global_settings_config_t *config)
+{
+    esp_err_t ret;
+
+    if (config == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (flush_mutex != NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (int id = 0; id < SETTING_COUNT; ++id)
+    {
+        values[id] = (uint32_t)setting_meta[id].default_value;
+    }
+    dirty_mask = 0;
+
+    // Read everything once; after this, reads never touch flash
+    nvs_handle_t nvs;
+    ret = nvs_open(SETTINGS_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (ret == ESP_OK)
+    {
+        for (int id = 0; id < SETTING_COUNT; ++id)
+        {
+            esp_err_t load_ret = load_setting(nvs, (global_setting_id_t)id);
+            if (load_ret != ESP_OK && load_ret != ESP_ERR_NVS_NOT_FOUND)
+            {
+                ESP_LOGW(TAG, "Failed to load '%s', using default: %s", setting_meta[id].nvs_key, esp_err_to_name(load_ret));
+            }
+        }
+        nvs_close(nvs);
+    }
+    else if (ret == ESP_ERR_NVS_NOT_FOUND)
+    {
+        ESP_LOGI(TAG, "No stored settings, using defaults");
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Failed to open NVS namespace '%s': %s", SETTINGS_NVS_NAMESPACE, esp_err_to_name(ret));
+        return ret;
+    }
+
+    flush_mutex = xSemaphoreCreateMutex();
+    if (flush_mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create settings mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    quiet_period_ticks = pdMS_TO_TICKS(config->quiet_period_ms);
+    max_delay_ticks = pdMS_TO_TICKS(config->max_delay_ms);
+    if (max_delay_ticks < quiet_period_ticks)
+    {
+        max_delay_ticks = quiet_period_ticks;
+    }
+
+    if (xTaskCreatePinnedToCore(global_settings_task, "settings", config->task_stack_size, NULL,
+                                config->task_priority, &commit_task_handle, config->task_core_id) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create settings task");
+        vSemaphoreDelete(flush_mutex);
+        flush_mutex = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ret = esp_register_shutdown_handler(global_settings_shutdown_handler);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Failed to register shutdown flush: %s", esp_err_to_name(ret));
+    }
+
+    ESP_LOGI(TAG, "Global settings loaded (%d settings, commit after %lu ms quiet)",
+             SETTING_COUNT, (unsigned long)config->quiet_period_ms);
+    return ESP_OK;
+}
+
+// --- Typed Accessors ---
+
+esp_err_t global_settings_get_u32(global_setting_id_t id, uint32_t *value)
+{
+    return get_raw(id, SETTING_TYPE_U32, value);
+}
+
+esp_err_t global_settings_set_u32(global_setting_id_t id, uint32_t value)
+{
+    return set_raw(id, SETTING_TYPE_U32, value);
+}
+
+esp_err_t global_settings_get_i32(global_setting_id_t id, int32_t *value)
+{
+    return get_raw(id, SETTING_TYPE_I32, (uint32_t *)value);
+}
+
+esp_err_t global_settings_set_i32(global_setting_id_t id, int32_t value)
+{
+    return set_raw(id, SETTING_TYPE_I32, (uint32_t)value);
+}
+
+esp_err_t global_settings_get_bool(global_setting_id_t id, bool *value)
+{
+    if (value == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t raw = 0;
+    esp_err_t ret = get_raw(id, SETTING_TYPE_BOOL, &raw);
+    *value = (raw != 0);
+    return ret;
+}
+
+esp_err_t global_settings_set_bool(global_setting_id_t id, bool value)
+{
+    return set_raw(id, SETTING_TYPE_BOOL, value ? 1 : 0);
+}
+
+esp_err_t global_settings_reset(global_setting_id_t id)
+{
+    if (id >= SETTING_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return set_raw(id, setting_meta[id].type, (uint32_t)setting_meta[id].default_value);
+}
+
+// --- Persistence ---
+
+bool global_settings_is_dirty(void)
+{
+    return dirty_mask != 0;
+}
+
+esp_err_t global_settings_flush(void)
+{
+    if (flush_mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(flush_mutex, portMAX_DELAY);
+
+    // Snapshot and clear under the lock; setters running during the NVS write
+    // simply re-mark their setting for the next commit
+    uint32_t pending;
+    uint32_t snapshot[SETTING_COUNT];
+    portENTER_CRITICAL(&values_lock);
+    pending = dirty_mask;
+    dirty_mask = 0;
+    memcpy(snapshot, values, sizeof(snapshot));
+    portEXIT_CRITICAL(&values_lock);
+
+    if (pending == 0)
+    {
+        xSemaphoreGive(flush_mutex);
+        return ESP_OK;
+    }
+
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(SETTINGS_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    uint32_t failed = pending;
+    if (ret == ESP_OK)
+    {
+        failed = 0;
+        for (int id = 0; id < SETTING_COUNT; ++id)
+        {
+            if ((pending & (1u << id)) == 0)
+            {
+                continue;
+            }
+            esp_err_t set_ret = store_setting(nvs, (global_setting_id_t)id, snapshot[id]);
+            if (set_ret != ESP_OK)
+            {
+                ESP_LOGE(TAG, "Failed to write '%s': %s", setting_meta[id].nvs_key, esp_err_to_name(set_ret));
+                failed |= 1u << id;
+                ret = set_ret;
+            }
+        }
+
+        // One commit for the whole batch
+        esp_err_t commit_ret = nvs_commit(nvs);
+        nvs_close(nvs);
+        if (commit_ret != ESP_OK)
+        {
+            failed = pending;
+            ret = commit_ret;
+        }
+        else
+        {
+            commit_count++;
+            ESP_LOGD(TAG, "Committed settings mask 0x%08lx", (unsigned long)(pending & ~failed));
+        }
+    }
+
+    if (failed)
+    {
+        portENTER_CRITICAL(&values_lock);
+        dirty_mask |= failed;
+        portEXIT_CRITICAL(&values_lock);
+    }
+
+    xSemaphoreGive(flush_mutex);
+    return ret;
+}
+
+uint32_t global_settings_get_commit_count(void)
+{
+    return commit_count;
+}
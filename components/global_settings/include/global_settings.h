@@ -0,0 +1,103 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h" // For TickType_t, UBaseType_t
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // --- Setting Definitions ---
+    // X(id, nvs_key, type, default). NVS keys are at most 15 characters.
+    // Append new settings at the end; keys, not positions, identify stored values.
+
+#define GLOBAL_SETTINGS_TABLE(X)                                        \
+    X(SETTING_SAMPLE_RATE, "sample_rate", SETTING_TYPE_U32, 48000)      \
+    X(SETTING_MIDI_CHANNEL, "midi_channel", SETTING_TYPE_U32, 1)        \
+    X(SETTING_MASTER_TUNE_CENTS, "tune_cents", SETTING_TYPE_I32, 0)     \
+    X(SETTING_CLOCK_SYNC_ENABLED, "clock_sync", SETTING_TYPE_BOOL, 0)   \
+    X(SETTING_DISPLAY_BRIGHTNESS, "disp_bright", SETTING_TYPE_U32, 200)
+
+    typedef enum
+    {
+        SETTING_TYPE_U32 = 0,
+        SETTING_TYPE_I32,
+        SETTING_TYPE_BOOL,
+    } global_setting_type_t;
+
+#define GLOBAL_SETTINGS_ENUM_ENTRY(id, key, type, def) id,
+    typedef enum
+    {
+        GLOBAL_SETTINGS_TABLE(GLOBAL_SETTINGS_ENUM_ENTRY)
+            SETTING_COUNT
+    } global_setting_id_t;
+#undef GLOBAL_SETTINGS_ENUM_ENTRY
+
+    // --- Configuration ---
+
+    typedef struct
+    {
+        uint32_t quiet_period_ms;  // Commit once no setting has changed for this long
+        uint32_t max_delay_ms;     // Commit at the latest this long after the first unsaved change
+        size_t task_stack_size;    // Stack size for the background commit task
+        UBaseType_t task_priority; // Priority for the commit task (low; flash writes are slow)
+        int task_core_id;          // Core to pin the task to (0, 1, or tskNO_AFFINITY)
+    } global_settings_config_t;
+
+    // --- Initialization ---
+
+    /**
+     * @brief Load all settings from NVS into RAM and start the background commit task.
+     * NVS must already be initialized (nvs_flash_init). Missing keys take their defaults.
+     * Also registers a shutdown handler that flushes unsaved changes on esp_restart().
+     *
+     * @param config Pointer to configuration struct.
+     * @return ESP_OK on success, or an error code.
+     */
+    esp_err_t global_settings_init(const global_settings_config_t *config);
+
+    // --- Typed Accessors ---
+    // Getters only read RAM. Setters update RAM, mark the setting dirty and return
+    // immediately; the commit task writes it to flash later. Setting a value equal to
+    // the current one is a no-op. Accessing a setting with the wrong type returns
+    // ESP_ERR_INVALID_ARG.
+
+    esp_err_t global_settings_get_u32(global_setting_id_t id, uint32_t *value);
+    esp_err_t global_settings_set_u32(global_setting_id_t id, uint32_t value);
+    esp_err_t global_settings_get_i32(global_setting_id_t id, int32_t *value);
+    esp_err_t global_settings_set_i32(global_setting_id_t id, int32_t value);
+    esp_err_t global_settings_get_bool(global_setting_id_t id, bool *value);
+    esp_err_t global_settings_set_bool(global_setting_id_t id, bool value);
+
+    /**
+     * @brief Restore one setting to its default (marks it dirty).
+     *
+     * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown id.
+     */
+    esp_err_t global_settings_reset(global_setting_id_t id);
+
+    // --- Persistence ---
+
+    /**
+     * @brief Whether any setting has changes not yet committed to flash.
+     */
+    bool global_settings_is_dirty(void);
+
+    /**
+     * @brief Commit all dirty settings now, in the caller's context, with a single nvs_commit.
+     *
+     * @return ESP_OK on success (or nothing to do), or the NVS error. Failed settings stay dirty.
+     */
+    esp_err_t global_settings_flush(void);
+
+    /**
+     * @brief Number of nvs_commit calls issued since boot (for measuring write coalescing).
+     */
+    uint32_t global_settings_get_commit_count(void);
+
+#ifdef __cplusplus
+}
+#endif
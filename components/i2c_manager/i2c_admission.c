@@ -0,0 +1,254 @@
+#include "i2c_admission.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+static const char *TAG = "I2C_ADMISSION";
+
+#define WINDOW_BUCKETS 8 // The window slides in steps of 1/8
+#define WINDOW_US ((uint32_t)CONFIG_CENTRAL_I2C_BUDGET_WINDOW_MS * 1000)
+#define BUCKET_US (WINDOW_US / WINDOW_BUCKETS)
+#define SOURCE_BUDGET_US (WINDOW_US / 100 * CONFIG_CENTRAL_I2C_SOURCE_BUDGET_PCT)
+#define MODULE_BUDGET_US (WINDOW_US / 100 * CONFIG_CENTRAL_I2C_MODULE_BUDGET_PCT)
+#define OVERSUBSCRIBED_US (WINDOW_US / 100 * CONFIG_CENTRAL_I2C_OVERSUBSCRIBED_PCT)
+#define SHED_AGE_US ((uint32_t)CONFIG_CENTRAL_I2C_SHED_AGE_MS * 1000)
+#define MODULE_ACCOUNTS CONFIG_CENTRAL_I2C_MODULE_CACHE_ENTRIES // Modules tracked at once, as in the module cache
+
+_Static_assert(CONFIG_CENTRAL_I2C_BUDGET_WINDOW_MS * 1000 / WINDOW_BUCKETS > 0, "Window too short");
+
+// Bus time per bucket; buckets older than the window are zeroed as time moves on
+typedef struct
+{
+    uint32_t bucket_us[WINDOW_BUCKETS];
+    uint32_t last_bucket; // Bucket number (time / BUCKET_US) of the last update
+} window_account_t;
+
+typedef struct
+{
+    window_account_t account;
+    uint8_t mux_channel;
+    uint8_t module_addr;
+    bool valid;
+} module_account_t;
+
+// --- State ---
+
+static uint32_t scl_hz = 100000;
+static window_account_t bus_account;
+static window_account_t source_accounts[CONFIG_CENTRAL_I2C_MAX_PRODUCERS];
+static module_account_t module_accounts[MODULE_ACCOUNTS];
+static portMUX_TYPE admission_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// --- Sliding Window (admission_lock held) ---
+
+static inline uint32_t current_bucket(void)
+{
+    return (uint32_t)(esp_timer_get_time() / BUCKET_US);
+}
+
+static void advance(window_account_t *a, uint32_t now)
+{
+    uint32_t elapsed = now - a->last_bucket;
+    if (elapsed >= WINDOW_BUCKETS)
+    {
+        memset(a->bucket_us, 0, sizeof(a->bucket_us));
+    }
+    else
+    {
+        for (uint32_t k = 1; k <= elapsed; ++k)
+        {
+            a->bucket_us[(a->last_bucket + k) % WINDOW_BUCKETS] = 0;
+        }
+    }
+    a->last_bucket = now;
+}
+
+static void add(window_account_t *a, uint32_t now, uint32_t cost_us)
+{
+    advance(a, now);
+    a->bucket_us[now % WINDOW_BUCKETS] += cost_us;
+}
+
+static uint32_t total(window_account_t *a, uint32_t now)
+{
+    advance(a, now);
+    uint32_t sum = 0;
+    for (int i = 0; i < WINDOW_BUCKETS; ++i)
+    {
+        sum += a->bucket_us[i];
+    }
+    return sum;
+}
+
+static module_account_t *find_module(uint8_t mux_channel, uint8_t module_addr)
+{
+    for (int i = 0; i < MODULE_ACCOUNTS; ++i)
+    {
+        module_account_t *m = &module_accounts[i];
+        if (m->valid && m->mux_channel == mux_channel && m->module_addr == module_addr)
+        {
+            return m;
+        }
+    }
+    return NULL;
+}
+
+// Free slot, or the module charged longest ago
+static module_account_t *alloc_module(void)
+{
+    module_account_t *oldest = &module_accounts[0];
+    for (int i = 0; i < MODULE_ACCOUNTS; ++i)
+    {
+        module_account_t *m = &module_accounts[i];
+        if (!m->valid)
+        {
+            return m;
+        }
+        if ((int32_t)(m->account.last_bucket - oldest->account.last_bucket) < 0)
+        {
+            oldest = m;
+        }
+    }
+    return oldest;
+}
+
+static inline uint16_t permille(uint32_t used_us)
+{
+    uint32_t p = (uint32_t)((uint64_t)used_us * 1000 / WINDOW_US);
+    return p > UINT16_MAX ? UINT16_MAX : (uint16_t)p;
+}
+
+// --- Accounting ---
+
+void i2c_admission_init(uint32_t clk_speed)
+{
+    scl_hz = clk_speed > 0 ? clk_speed : 100000;
+    portENTER_CRITICAL(&admission_lock);
+    memset(&bus_account, 0, sizeof(bus_account));
+    memset(source_accounts, 0, sizeof(source_accounts));
+    memset(module_accounts, 0, sizeof(module_accounts));
+    portEXIT_CRITICAL(&admission_lock);
+    ESP_LOGI(TAG, "Bus budgets over %d ms: %d%% per source, %d%% per module, oversubscribed above %d%% (%s)",
+             CONFIG_CENTRAL_I2C_BUDGET_WINDOW_MS, CONFIG_CENTRAL_I2C_SOURCE_BUDGET_PCT,
+             CONFIG_CENTRAL_I2C_MODULE_BUDGET_PCT, CONFIG_CENTRAL_I2C_OVERSUBSCRIBED_PCT,
+             CONFIG_CENTRAL_I2C_ADMISSION_ENABLE ? "enforced" : "measured only");
+}
+
+uint32_t i2c_admission_cost_us(size_t bytes, bool restart)
+{
+    // Start + address byte + data bytes (8 bits and ACK each) + stop
+    uint32_t bits = 1 + 9 + 9 * (uint32_t)bytes + 1;
+    if (restart)
+    {
+        bits += 1 + 9;
+    }
+    return (uint32_t)(((uint64_t)bits * 1000000 + scl_hz - 1) / scl_hz);
+}
+
+void i2c_admission_charge(uint8_t mux_channel, uint8_t module_addr, uint32_t cost_us)
+{
+    uint32_t now = current_bucket();
+    portENTER_CRITICAL(&admission_lock);
+    add(&bus_account, now, cost_us);
+    if (module_addr != I2C_ADMISSION_NO_MODULE)
+    {
+        module_account_t *m = find_module(mux_channel, module_addr);
+        if (m == NULL)
+        {
+            m = alloc_module();
+            memset(m, 0, sizeof(*m));
+            m->mux_channel = mux_channel;
+            m->module_addr = module_addr;
+            m->valid = true;
+            m->account.last_bucket = now;
+        }
+        add(&m->account, now, cost_us);
+    }
+    portEXIT_CRITICAL(&admission_lock);
+}
+
+void i2c_admission_charge_source(int source, uint32_t cost_us)
+{
+    uint32_t now = current_bucket();
+    portENTER_CRITICAL(&admission_lock);
+    add(&source_accounts[source], now, cost_us);
+    portEXIT_CRITICAL(&admission_lock);
+}
+
+// --- Admission ---
+
+i2c_admission_verdict_t i2c_admission_check(int source, uint8_t mux_channel, uint8_t module_addr, uint32_t cost_us,
+                                            i2c_producer_priority_t priority, bool sheddable, uint32_t age_us)
+{
+#if CONFIG_CENTRAL_I2C_ADMISSION_ENABLE
+    uint32_t now = current_bucket();
+    portENTER_CRITICAL(&admission_lock);
+    bool oversubscribed = total(&bus_account, now) > OVERSUBSCRIBED_US;
+    // An idle account always admits, so a request costlier than the whole budget still runs
+    uint32_t used = total(&source_accounts[source], now);
+    bool over_budget = used > 0 && used + cost_us > SOURCE_BUDGET_US;
+    if (!over_budget && module_addr != I2C_ADMISSION_NO_MODULE)
+    {
+        module_account_t *m = find_module(mux_channel, module_addr);
+        used = m ? total(&m->account, now) : 0;
+        over_budget = used > 0 && used + cost_us > MODULE_BUDGET_US;
+    }
+    portEXIT_CRITICAL(&admission_lock);
+
+    bool low = priority == I2C_PRIORITY_LOW;
+    if (!over_budget && !(oversubscribed && low))
+    {
+        return I2C_ADMISSION_ADMIT;
+    }
+    if (sheddable && low && oversubscribed && age_us >= SHED_AGE_US)
+    {
+        return I2C_ADMISSION_SHED;
+    }
+    return I2C_ADMISSION_DEFER;
+#else
+    return I2C_ADMISSION_ADMIT;
+#endif
+}
+
+TickType_t i2c_admission_retry_ticks(void)
+{
+    TickType_t ticks = pdMS_TO_TICKS(BUCKET_US / 1000);
+    return ticks > 0 ? ticks : 1;
+}
+
+// --- Reporting ---
+
+uint16_t i2c_admission_source_load(int source)
+{
+    uint32_t now = current_bucket();
+    portENTER_CRITICAL(&admission_lock);
+    uint32_t used = total(&source_accounts[source], now);
+    portEXIT_CRITICAL(&admission_lock);
+    return permille(used);
+}
+
+void i2c_admission_get_load(i2c_bus_load_t *out)
+{
+    uint32_t now = current_bucket();
+    uint32_t busiest = 0;
+    portENTER_CRITICAL(&admission_lock);
+    uint32_t bus = total(&bus_account, now);
+    for (int i = 0; i < MODULE_ACCOUNTS; ++i)
+    {
+        module_account_t *m = &module_accounts[i];
+        uint32_t used = m->valid ? total(&m->account, now) : 0;
+        if (used > busiest)
+        {
+            busiest = used;
+            out->busiest_mux_channel = m->mux_channel;
+            out->busiest_module_addr = m->module_addr;
+        }
+    }
+    portEXIT_CRITICAL(&admission_lock);
+
+    out->bus_permille = permille(bus);
+    out->busiest_permille = permille(busiest);
+    out->oversubscribed = bus > OVERSUBSCRIBED_US;
+    out->window_ms = CONFIG_CENTRAL_I2C_BUDGET_WINDOW_MS;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// Internal: bus time accounting and admission control. Every transaction is charged
+// to the bus and (when it reached a module) to that module, with its cost estimated
+// from the bytes on the wire and the SCL frequency, over a sliding window. The bus
+// task asks i2c_admission_check() before it runs a queued request and charges the
+// request to its producer once sent. Safe to call from any task.
+
+#include "i2c_manager.h"
+
+#define I2C_ADMISSION_NO_MODULE 0xFF // module_addr for bus-only traffic (mux writes, broadcasts, failed probes)
+
+typedef enum
+{
+    I2C_ADMISSION_ADMIT,
+    I2C_ADMISSION_DEFER, // Leave it queued and ask again once the window has moved on
+    I2C_ADMISSION_SHED,  // May be dropped: low priority, stale, and the bus is oversubscribed
+} i2c_admission_verdict_t;
+
+void i2c_admission_init(uint32_t scl_hz);
+
+// Estimated bus time of one transaction: start, address, `bytes` data bytes (each
+// with its ACK bit) and stop; `restart` adds a repeated start and second address
+uint32_t i2c_admission_cost_us(size_t bytes, bool restart);
+
+// Bus time actually spent (called for every transaction, under i2c_mutex)
+void i2c_admission_charge(uint8_t mux_channel, uint8_t module_addr, uint32_t cost_us);
+
+// Bus time a producer's admitted request actually used (nothing when the shadow dropped it)
+void i2c_admission_charge_source(int source, uint32_t cost_us);
+
+// `sheddable` requests may be dropped outright once they are older than
+// CONFIG_CENTRAL_I2C_SHED_AGE_MS; everything else is only ever deferred. The caller
+// drops a request only if a newer queued one makes it redundant, and defers it otherwise.
+i2c_admission_verdict_t i2c_admission_check(int source, uint8_t mux_channel, uint8_t module_addr, uint32_t cost_us,
+                                            i2c_producer_priority_t priority, bool sheddable, uint32_t age_us);
+
+// Share of the window the producer used, in permille
+uint16_t i2c_admission_source_load(int source);
+
+// Fills the utilisation fields of `out` (not the deferred/shed counters)
+void i2c_admission_get_load(i2c_bus_load_t *out);
+
+// Ticks after which a deferred request may be admitted (one window bucket)
+TickType_t i2c_admission_retry_ticks(void);
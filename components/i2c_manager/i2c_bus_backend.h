@@ -0,0 +1,29 @@
+#pragma once
+
+// Internal interface between the I2C manager (locking, mux tracking, framing,
+// tracing) and the component that actually drives the wire. Each mux is just
+// another 7-bit address to the backend.
+
+#include "i2c_manager.h" // For i2c_manager_config_t
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct
+{
+    // Create the bus (port, pins, clock and mux addresses from the config)
+    esp_err_t (*init)(const i2c_manager_config_t *config);
+    void (*deinit)(void);
+
+    // Write `len` bytes (0 for an address-only probe)
+    esp_err_t (*transmit)(uint8_t address, const uint8_t *data, size_t len, int timeout_ms);
+
+    // Write then read with a repeated start
+    esp_err_t (*transmit_receive)(uint8_t address, const uint8_t *tx, size_t tx_len,
+                                  uint8_t *rx, size_t rx_len, int timeout_ms);
+
+    esp_err_t (*receive)(uint8_t address, uint8_t *rx, size_t rx_len, int timeout_ms);
+} i2c_bus_backend_t;
+
+// Provided by exactly one of i2c_bus_backend_idf.c / i2c_bus_backend_mock.c
+extern const i2c_bus_backend_t i2c_bus_backend;
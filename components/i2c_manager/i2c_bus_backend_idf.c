@@ -0,0 +1,179 @@
+#include "i2c_bus_backend.h"
+#include "driver/i2c_master.h" // New I2C Master Driver header
+#include "esp_log.h"
+
+static const char *TAG = "I2C_BUS";
+
+// State
+static i2c_master_bus_handle_t bus_handle = NULL;
+static i2c_master_dev_handle_t mux_dev_handles[I2C_MUX_COUNT]; // Device handles for the MUXes themselves
+static uint8_t mux_addresses[I2C_MUX_COUNT];
+static uint32_t bus_freq_hz = 0;
+
+// --- Device Handles ---
+
+// Modules get a temporary device handle per transaction. This avoids needing
+// to add/remove every module to the bus constantly. Each mux keeps its own.
+static esp_err_t acquire_device(uint8_t address, i2c_master_dev_handle_t *dev)
+{
+    for (int m = 0; m < I2C_MUX_COUNT; ++m)
+    {
+        if (address == mux_addresses[m] && mux_dev_handles[m] != NULL)
+        {
+            *dev = mux_dev_handles[m];
+            return ESP_OK;
+        }
+    }
+
+    i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = address,
+        .scl_speed_hz = bus_freq_hz, // Use bus default speed
+    };
+    esp_err_t ret = i2c_master_bus_add_device(bus_handle, &dev_cfg, dev);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to create temporary device handle: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static void release_device(i2c_master_dev_handle_t dev)
+{
+    for (int m = 0; m < I2C_MUX_COUNT; ++m)
+    {
+        if (dev == mux_dev_handles[m])
+        {
+            return;
+        }
+    }
+    i2c_master_bus_rm_device(dev);
+}
+
+static void remove_mux_devices(void)
+{
+    for (int m = 0; m < I2C_MUX_COUNT; ++m)
+    {
+        if (mux_dev_handles[m])
+        {
+            i2c_master_bus_rm_device(mux_dev_handles[m]);
+            mux_dev_handles[m] = NULL;
+        }
+    }
+}
+
+// --- Backend ---
+
+static esp_err_t idf_init(const i2c_manager_config_t *config)
+{
+    esp_err_t ret;
+
+    bus_freq_hz = config->clk_speed;
+
+    ESP_LOGI(TAG, "Initializing I2C Master Port: %d", config->i2c_port);
+    ESP_LOGI(TAG, "SCL Pin: %d, SDA Pin: %d, Freq: %lu Hz", config->scl_io_num, config->sda_io_num, (unsigned long)bus_freq_hz);
+
+    // Configure the I2C master bus
+    i2c_master_bus_config_t i2c_mst_config = {
+        .clk_source = I2C_CLK_SRC_DEFAULT, // Use default clock source
+        .i2c_port = config->i2c_port,
+        .scl_io_num = config->scl_io_num,
+        .sda_io_num = config->sda_io_num,
+        .glitch_ignore_cnt = 7,               // Default glitch filter setting
+        .flags.enable_internal_pullup = true, // Enable internal pullups
+    };
+    ret = i2c_new_master_bus(&i2c_mst_config, &bus_handle);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to create I2C master bus: %s", esp_err_to_name(ret));
+        goto init_fail;
+    }
+
+    // Add the MUXes as devices on the bus (nested ones are only reachable once selected)
+    for (int m = 0; m < I2C_MUX_COUNT; ++m)
+    {
+        mux_addresses[m] = config->muxes[m].address;
+        i2c_device_config_t mux_dev_cfg = {
+            .scl_speed_hz = bus_freq_hz,
+            .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+            .device_address = mux_addresses[m],
+        };
+        ret = i2c_master_bus_add_device(bus_handle, &mux_dev_cfg, &mux_dev_handles[m]);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to add MUX device (0x%02X) to bus: %s", mux_addresses[m], esp_err_to_name(ret));
+            goto init_fail;
+        }
+    }
+
+    ESP_LOGI(TAG, "I2C Master bus and %d MUX device(s) initialized successfully.", I2C_MUX_COUNT);
+    return ESP_OK;
+
+init_fail:
+    // Cleanup on failure
+    remove_mux_devices();
+    if (bus_handle)
+    {
+        i2c_del_master_bus(bus_handle);
+        bus_handle = NULL;
+    }
+    return ret;
+}
+
+static void idf_deinit(void)
+{
+    remove_mux_devices();
+    if (bus_handle)
+    {
+        i2c_del_master_bus(bus_handle);
+        bus_handle = NULL;
+    }
+}
+
+static esp_err_t idf_transmit(uint8_t address, const uint8_t *data, size_t len, int timeout_ms)
+{
+    i2c_master_dev_handle_t dev;
+    esp_err_t ret = acquire_device(address, &dev);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    ret = i2c_master_transmit(dev, data, len, timeout_ms);
+    release_device(dev);
+    return ret;
+}
+
+static esp_err_t idf_transmit_receive(uint8_t address, const uint8_t *tx, size_t tx_len,
+                                      uint8_t *rx, size_t rx_len, int timeout_ms)
+{
+    i2c_master_dev_handle_t dev;
+    esp_err_t ret = acquire_device(address, &dev);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    ret = i2c_master_transmit_receive(dev, tx, tx_len, rx, rx_len, timeout_ms);
+    release_device(dev);
+    return ret;
+}
+
+static esp_err_t idf_receive(uint8_t address, uint8_t *rx, size_t rx_len, int timeout_ms)
+{
+    i2c_master_dev_handle_t dev;
+    esp_err_t ret = acquire_device(address, &dev);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    ret = i2c_master_receive(dev, rx, rx_len, timeout_ms);
+    release_device(dev);
+    return ret;
+}
+
+const i2c_bus_backend_t i2c_bus_backend = {
+    .init = idf_init,
+    .deinit = idf_deinit,
+    .transmit = idf_transmit,
+    .transmit_receive = idf_transmit_receive,
+    .receive = idf_receive,
+};
@@ -0,0 +1,507 @@
+#include "i2c_bus_engine.h"
+#include "i2c_admission.h"
+#include "spsc_ring.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "I2C_BUS_ENGINE";
+
+#define MAX_PRODUCERS CONFIG_CENTRAL_I2C_MAX_PRODUCERS
+
+_Static_assert(sizeof(I2sConfig_t) <= I2C_MANAGER_MAX_QUEUED_PAYLOAD, "I2S config must fit a queued request");
+
+// One queued bus write. Fixed size so the rings need no allocator.
+typedef struct
+{
+    union
+    {
+        i2c_channel_mask_t channel_mask; // Broadcasts
+        uint8_t mux_channel;             // Everything else
+    };
+    uint32_t enqueue_us; // Low 32 bits of esp_timer_get_time() when queued
+    uint8_t module_addr;
+    uint8_t command;
+    uint8_t len; // Payload bytes after the command byte
+    bool broadcast;
+    bool deferred; // Held back by admission control at least once (bus task only)
+    uint8_t payload[I2C_MANAGER_MAX_QUEUED_PAYLOAD];
+} bus_request_t;
+
+// A producer slot is claimed once by a task (owner, via compare-and-swap) and
+// then belongs to it for good. `ready` publishes the ring to the bus task.
+typedef struct
+{
+    TaskHandle_t owner;
+    bool ready;
+    spsc_ring_t ring;
+    // Written by the producer
+    uint32_t dropped;
+    i2c_producer_priority_t priority;
+    bool unreported; // Parameter writes are kept from the observer (i2c_manager_set_producer_reported)
+    // Written by the bus task
+    uint32_t sent;
+    uint32_t failed;
+    uint32_t max_latency_us;
+    uint32_t deferred;
+    uint32_t shed;
+} producer_t;
+
+// --- State ---
+
+static producer_t producers[MAX_PRODUCERS];
+static TaskHandle_t bus_task_handle = NULL;
+static uint32_t ring_capacity = 0;
+
+// --- Producer Side ---
+
+static producer_t *claim_producer(TaskHandle_t self)
+{
+    for (int i = 0; i < MAX_PRODUCERS; ++i)
+    {
+        TaskHandle_t expected = NULL;
+        if (__atomic_compare_exchange_n(&producers[i].owner, &expected, self, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        {
+            producer_t *p = &producers[i];
+            void *storage = heap_caps_malloc(ring_capacity * sizeof(bus_request_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            if (storage == NULL)
+            {
+                ESP_LOGE(TAG, "No memory for producer ring of task '%s'", pcTaskGetName(self));
+                return NULL; // The slot stays claimed but never ready; this task keeps failing
+            }
+            spsc_ring_init(&p->ring, storage, sizeof(bus_request_t), ring_capacity);
+            __atomic_store_n(&p->ready, true, __ATOMIC_RELEASE);
+            ESP_LOGI(TAG, "Task '%s' registered as bus producer %d", pcTaskGetName(self), i);
+            return p;
+        }
+    }
+    ESP_LOGE(TAG, "More than %d tasks queue I2C requests; raise CONFIG_CENTRAL_I2C_MAX_PRODUCERS", MAX_PRODUCERS);
+    return NULL;
+}
+
+static producer_t *current_producer(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < MAX_PRODUCERS; ++i)
+    {
+        if (__atomic_load_n(&producers[i].owner, __ATOMIC_ACQUIRE) == self)
+        {
+            return __atomic_load_n(&producers[i].ready, __ATOMIC_ACQUIRE) ? &producers[i] : NULL;
+        }
+    }
+    return claim_producer(self);
+}
+
+static esp_err_t enqueue(i2c_channel_mask_t channel, uint8_t module_addr, uint8_t command, const void *payload,
+                         size_t len, bool broadcast)
+{
+    if (bus_task_handle == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    producer_t *p = current_producer();
+    if (p == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    bus_request_t *req = spsc_ring_acquire(&p->ring);
+    if (req == NULL)
+    {
+        p->dropped++;
+        return ESP_ERR_TIMEOUT;
+    }
+    req->enqueue_us = (uint32_t)esp_timer_get_time();
+    if (broadcast)
+    {
+        req->channel_mask = channel;
+    }
+    else
+    {
+        req->mux_channel = (uint8_t)channel;
+    }
+    req->module_addr = module_addr;
+    req->command = command;
+    req->len = (uint8_t)len;
+    req->broadcast = broadcast;
+    req->deferred = false;
+    if (len > 0)
+    {
+        memcpy(req->payload, payload, len);
+    }
+    spsc_ring_commit(&p->ring);
+
+    xTaskNotifyGive(bus_task_handle);
+    return ESP_OK;
+}
+
+// --- Bus Task ---
+
+// Parameter IDs written by a CMD_SET_PARAM / CMD_SET_PARAM_BULK request; 0 for anything else
+static size_t request_params(const bus_request_t *req, ParamId_t ids[I2C_MANAGER_MAX_BULK_PARAMS])
+{
+    const size_t pair = sizeof(ParamId_t) + sizeof(ParamValue_t);
+    size_t offset = 0;
+    size_t count = 0;
+    if (req->command == CMD_SET_PARAM && req->len == pair)
+    {
+        count = 1;
+    }
+    else if (req->command == CMD_SET_PARAM_BULK && req->len >= 1 && req->payload[0] <= I2C_MANAGER_MAX_BULK_PARAMS &&
+             req->len == 1 + req->payload[0] * pair)
+    {
+        count = req->payload[0];
+        offset = 1;
+    }
+    for (size_t k = 0; k < count; ++k)
+    {
+        memcpy(&ids[k], &req->payload[offset + k * pair], sizeof(ParamId_t));
+    }
+    return count;
+}
+
+static bool same_target(const bus_request_t *a, const bus_request_t *b)
+{
+    if (a->broadcast != b->broadcast)
+    {
+        return false;
+    }
+    return a->broadcast ? a->channel_mask == b->channel_mask
+                        : a->mux_channel == b->mux_channel && a->module_addr == b->module_addr;
+}
+
+// True if later requests in the producer's ring write every parameter the oldest one
+// does, to the same target, before any other kind of request (which might depend on
+// the old value). Only then can it be dropped without leaving a module on a value its
+// producer believes was sent: producers send changes, not periodic refreshes.
+static bool superseded(producer_t *p, const bus_request_t *req)
+{
+    ParamId_t ids[I2C_MANAGER_MAX_BULK_PARAMS];
+    size_t remaining = request_params(req, ids);
+    if (remaining == 0)
+    {
+        return false;
+    }
+
+    const bus_request_t *later;
+    for (uint32_t idx = 1; remaining > 0 && (later = spsc_ring_peek_at(&p->ring, idx)) != NULL; ++idx)
+    {
+        ParamId_t later_ids[I2C_MANAGER_MAX_BULK_PARAMS];
+        size_t later_count = request_params(later, later_ids);
+        if (later_count == 0)
+        {
+            break;
+        }
+        if (!same_target(req, later))
+        {
+            continue;
+        }
+        for (size_t k = 0; k < remaining;)
+        {
+            bool covered = false;
+            for (size_t j = 0; j < later_count && !covered; ++j)
+            {
+                covered = later_ids[j] == ids[k];
+            }
+            if (covered)
+            {
+                ids[k] = ids[--remaining];
+            }
+            else
+            {
+                k++;
+            }
+        }
+    }
+    return remaining == 0;
+}
+
+// Ask admission control about the producer's oldest request
+static i2c_admission_verdict_t admit(int source, producer_t *p, const bus_request_t *req, uint32_t cost_us,
+                                     uint32_t age_us)
+{
+    bool param_write = req->command == CMD_SET_PARAM || req->command == CMD_SET_PARAM_BULK;
+    i2c_admission_verdict_t verdict =
+        i2c_admission_check(source, req->broadcast ? 0 : req->mux_channel,
+                            req->broadcast ? I2C_ADMISSION_NO_MODULE : req->module_addr, cost_us,
+                            __atomic_load_n(&p->priority, __ATOMIC_RELAXED), param_write, age_us);
+    // The ring scan only runs for the rare request that is old enough to shed
+    if (verdict == I2C_ADMISSION_SHED && !superseded(p, req))
+    {
+        verdict = I2C_ADMISSION_DEFER;
+    }
+    return verdict;
+}
+
+static void i2c_bus_engine_task(void *arg)
+{
+    ESP_LOGI(TAG, "Bus engine task started (%d producer slots, %lu requests each)",
+             MAX_PRODUCERS, (unsigned long)ring_capacity);
+
+    TickType_t wait = portMAX_DELAY;
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        // Round-robin one request per producer per pass, so a busy producer
+        // (e.g. the modulation engine) cannot starve a UI command. A deferred
+        // producer sits out until the next wakeup, which comes no later than
+        // one budget window bucket from now.
+        bool more = true;
+        bool deferred = false;
+        while (more)
+        {
+            more = false;
+            for (int i = 0; i < MAX_PRODUCERS; ++i)
+            {
+                producer_t *p = &producers[i];
+                if (!__atomic_load_n(&p->ready, __ATOMIC_ACQUIRE))
+                {
+                    continue;
+                }
+                bus_request_t *req = spsc_ring_peek(&p->ring);
+                if (req == NULL)
+                {
+                    continue;
+                }
+
+                uint32_t latency = (uint32_t)esp_timer_get_time() - req->enqueue_us;
+                uint32_t cost_us = i2c_admission_cost_us(1 + req->len, false);
+                i2c_admission_verdict_t verdict = admit(i, p, req, cost_us, latency);
+                if (verdict == I2C_ADMISSION_DEFER)
+                {
+                    if (!req->deferred)
+                    {
+                        req->deferred = true;
+                        p->deferred++;
+                    }
+                    deferred = true;
+                    continue;
+                }
+                if (verdict == I2C_ADMISSION_SHED)
+                {
+                    spsc_ring_release(&p->ring);
+                    p->shed++;
+                    more = true;
+                    continue;
+                }
+
+                if (latency > p->max_latency_us)
+                {
+                    p->max_latency_us = latency;
+                }
+
+                size_t sent_len = 0;
+                esp_err_t ret = req->broadcast
+                                    ? i2c_manager_broadcast_counted(req->channel_mask, req->command, req->payload,
+                                                                    req->len, &sent_len)
+                                    : i2c_manager_send_command_counted(
+                                          req->mux_channel, req->module_addr, req->command, req->payload, req->len,
+                                          !__atomic_load_n(&p->unreported, __ATOMIC_RELAXED), &sent_len);
+                spsc_ring_release(&p->ring);
+                // Admission used the queued size; the source pays for what the shadow let through
+                if (sent_len > 0)
+                {
+                    i2c_admission_charge_source(i, i2c_admission_cost_us(sent_len, false));
+                }
+
+                p->sent++;
+                if (ret != ESP_OK)
+                {
+                    p->failed++;
+                }
+                more = true;
+            }
+        }
+        wait = deferred ? i2c_admission_retry_ticks() : portMAX_DELAY;
+    }
+}
+
+esp_err_t i2c_bus_engine_start(const i2c_manager_config_t *config)
+{
+    if (bus_task_handle != NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ring_capacity = 2;
+    while (ring_capacity < config->command_queue_size)
+    {
+        ring_capacity <<= 1;
+    }
+
+    if (xTaskCreatePinnedToCore(i2c_bus_engine_task, "i2c_bus", config->task_stack_size, NULL,
+                                config->task_priority, &bus_task_handle, config->task_core_id) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create bus engine task");
+        bus_task_handle = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void i2c_bus_engine_stop(void)
+{
+    if (bus_task_handle != NULL)
+    {
+        vTaskDelete(bus_task_handle);
+        bus_task_handle = NULL;
+    }
+    // Producer rings stay allocated; their owners may still hold pointers to them
+}
+
+// --- Public API ---
+
+esp_err_t i2c_manager_queue_set_param(uint8_t mux_channel, uint8_t module_addr, ParamId_t param_id, ParamValue_t value)
+{
+    uint8_t payload[sizeof(ParamId_t) + sizeof(ParamValue_t)];
+    memcpy(payload, &param_id, sizeof(ParamId_t));
+    memcpy(payload + sizeof(ParamId_t), &value, sizeof(ParamValue_t));
+    return enqueue(mux_channel, module_addr, CMD_SET_PARAM, payload, sizeof(payload), false);
+}
+
+esp_err_t i2c_manager_queue_set_i2s_config(uint8_t mux_channel, uint8_t module_addr, const I2sConfig_t config)
+{
+    return enqueue(mux_channel, module_addr, CMD_SET_I2S_CONFIG, &config, sizeof(config), false);
+}
+
+esp_err_t i2c_manager_queue_send_command(uint8_t mux_channel, uint8_t module_addr, uint8_t command)
+{
+    return enqueue(mux_channel, module_addr, command, NULL, 0, false);
+}
+
+esp_err_t i2c_manager_queue_param_block(uint8_t mux_channel, uint8_t module_addr,
+                                        const ParamId_t *param_ids, const ParamValue_t *values, size_t count)
+{
+    if (param_ids == NULL || values == NULL || count == 0 || count > I2C_MANAGER_MAX_BULK_PARAMS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Same frame as i2c_manager_send_param_block()
+    uint8_t payload[I2C_MANAGER_MAX_QUEUED_PAYLOAD];
+    size_t len = 0;
+    payload[len++] = (uint8_t)count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        memcpy(&payload[len], &param_ids[i], sizeof(ParamId_t));
+        len += sizeof(ParamId_t);
+        memcpy(&payload[len], &values[i], sizeof(ParamValue_t));
+        len += sizeof(ParamValue_t);
+    }
+    return enqueue(mux_channel, module_addr, CMD_SET_PARAM_BULK, payload, len, false);
+}
+
+esp_err_t i2c_manager_queue_broadcast(i2c_channel_mask_t channel_mask, uint8_t command_id, const void *data, size_t data_len)
+{
+    if (channel_mask == 0 || (channel_mask & ~I2C_MUX_ALL_CHANNELS) || data_len > I2C_MANAGER_MAX_QUEUED_PAYLOAD ||
+        (data == NULL && data_len > 0))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return enqueue(channel_mask, CONFIG_CENTRAL_I2C_BROADCAST_ADDRESS, command_id, data, data_len, true);
+}
+
+esp_err_t i2c_manager_set_producer_priority(i2c_producer_priority_t priority)
+{
+    if (priority != I2C_PRIORITY_NORMAL && priority != I2C_PRIORITY_LOW)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (bus_task_handle == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    producer_t *p = current_producer();
+    if (p == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    __atomic_store_n(&p->priority, priority, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+esp_err_t i2c_manager_set_producer_reported(bool reported)
+{
+    if (bus_task_handle == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    producer_t *p = current_producer();
+    if (p == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    __atomic_store_n(&p->unreported, !reported, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+esp_err_t i2c_manager_get_producer_stats(i2c_producer_stats_t *stats, size_t capacity, size_t *count)
+{
+    if (stats == NULL || count == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t n = 0;
+    for (int i = 0; i < MAX_PRODUCERS && n < capacity; ++i)
+    {
+        producer_t *p = &producers[i];
+        if (!__atomic_load_n(&p->ready, __ATOMIC_ACQUIRE))
+        {
+            continue;
+        }
+        stats[n].task_name = pcTaskGetName(p->owner);
+        stats[n].sent = p->sent;
+        stats[n].dropped = p->dropped;
+        stats[n].failed = p->failed;
+        stats[n].queued = spsc_ring_count(&p->ring);
+        stats[n].max_latency_us = p->max_latency_us;
+        stats[n].deferred = p->deferred;
+        stats[n].shed = p->shed;
+        stats[n].load_permille = i2c_admission_source_load(i);
+        stats[n].priority = p->priority;
+        n++;
+    }
+    *count = n;
+    return ESP_OK;
+}
+
+void i2c_manager_reset_producer_stats(void)
+{
+    for (int i = 0; i < MAX_PRODUCERS; ++i)
+    {
+        producers[i].sent = 0;
+        producers[i].dropped = 0;
+        producers[i].failed = 0;
+        producers[i].max_latency_us = 0;
+        producers[i].deferred = 0;
+        producers[i].shed = 0;
+    }
+}
+
+esp_err_t i2c_manager_get_bus_load(i2c_bus_load_t *load)
+{
+    if (load == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(load, 0, sizeof(*load));
+    i2c_admission_get_load(load);
+    for (int i = 0; i < MAX_PRODUCERS; ++i)
+    {
+        if (__atomic_load_n(&producers[i].ready, __ATOMIC_ACQUIRE))
+        {
+            load->deferred += producers[i].deferred;
+            load->shed += producers[i].shed;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// Internal: the bus task that owns the I2C bus and drains the producer rings.
+// Started and stopped by i2c_manager_init() / i2c_manager_deinit().
+
+#include "i2c_manager.h"
+
+esp_err_t i2c_bus_engine_start(const i2c_manager_config_t *config);
+void i2c_bus_engine_stop(void);
+
+// Implemented in i2c_master_control.c. As i2c_manager_send_command() / i2c_manager_broadcast(),
+// plus the bytes that went to the module(s) in *sent_len: command byte included, mux selects
+// not, and 0 when nothing was transmitted (e.g. the param shadow dropped every parameter).
+// The bus task charges producers for these rather than for what they queued. Parameter
+// writes sent without `report` are kept from the parameter observer.
+esp_err_t i2c_manager_send_command_counted(uint8_t mux_channel, uint8_t module_address, uint8_t command_id,
+                                           const void *data, size_t data_len, bool report, size_t *sent_len);
+esp_err_t i2c_manager_broadcast_counted(i2c_channel_mask_t channel_mask, uint8_t command_id, const void *data,
+                                        size_t data_len, size_t *sent_len);
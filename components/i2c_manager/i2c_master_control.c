@@ -1,33 +1,50 @@
 #include "i2c_manager.h"
-#include "driver/i2c_master.h" // New I2C Master Driver header
+#include "i2c_trace.h"
+#include "i2c_admission.h"
+#include "i2c_bus_backend.h"
+#include "i2c_bus_engine.h"
+#include "i2c_module_cache.h"
+#include "i2c_mux_topology.h"
+#include "i2c_param_shadow.h"
 #include "esp_log.h"
+#include "esp_timer.h" // For trace timestamps
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h" // For mutex
 #include "synth_constants.h" // From common_definitions
 // Include the shared protocol definitions (even if just for types initially)
 #include "module_i2c_proto.h" // Assumed to exist in shared_components
 #include <string.h>
+#include <stdlib.h> // For malloc/free
 static const char *TAG = "I2C_MANAGER";
 
-// Configuration values (read from sdkconfig)
-#define I2C_MASTER_PORT_NUM CONFIG_CENTRAL_I2C_MASTER_PORT_NUM
-#define I2C_MASTER_SCL_IO CONFIG_CENTRAL_I2C_MASTER_SCL_IO
-#define I2C_MASTER_SDA_IO CONFIG_CENTRAL_I2C_MASTER_SDA_IO
-#define I2C_MASTER_FREQ_HZ CONFIG_CENTRAL_I2C_MASTER_FREQ_HZ
-#define I2C_MUX_ADDR CONFIG_CENTRAL_I2C_MUX_ADDRESS
-
 // State
-static i2c_master_bus_handle_t bus_handle = NULL;
-static i2c_master_dev_handle_t mux_dev_handle = NULL; // Device handle for the MUX itself
+static bool bus_ready = false; // Backend bus (and MUX devices) are up
 static SemaphoreHandle_t i2c_mutex = NULL;
-static uint8_t current_mux_channel = 0xFF; // Invalid channel initially
+static i2c_channel_mask_t current_channels = 0; // Channels the last selection connected
+static bool current_channels_known = false;     // False until a selection succeeds, and after any failure
 
 // --- Initialization ---
 
-esp_err_t i2c_manager_init(void)
+esp_err_t i2c_manager_init(const i2c_manager_config_t *config)
 {
     esp_err_t ret = ESP_OK;
 
+    if (config == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ret = i2c_mux_topology_init(config->muxes);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    current_channels_known = false;
+
+    // Transaction tracing is diagnostic only; run without it if PSRAM is short
+    i2c_trace_init();
+    i2c_param_shadow_init(); // Likewise: without it every write is sent
+    i2c_admission_init(config->clk_speed);
+
     // Create Mutex for thread safety
     i2c_mutex = xSemaphoreCreateMutex();
     if (i2c_mutex == NULL)
@@ -36,42 +53,16 @@ esp_err_t i2c_manager_init(void)
         return ESP_ERR_NO_MEM;
     }
 
-    ESP_LOGI(TAG, "Initializing I2C Master Port: %d", I2C_MASTER_PORT_NUM);
-    ESP_LOGI(TAG, "SCL Pin: %d, SDA Pin: %d, Freq: %d Hz", I2C_MASTER_SCL_IO, I2C_MASTER_SDA_IO, I2C_MASTER_FREQ_HZ);
-
-    // Configure the I2C master bus
-    i2c_master_bus_config_t i2c_mst_config = {
-        .clk_source = I2C_CLK_SRC_DEFAULT, // Use default clock source
-        .i2c_port = I2C_MASTER_PORT_NUM,
-        .scl_io_num = I2C_MASTER_SCL_IO,
-        .sda_io_num = I2C_MASTER_SDA_IO,
-        .glitch_ignore_cnt = 7,               // Default glitch filter setting
-        .flags.enable_internal_pullup = true, // Enable internal pullups
-    };
-    ret = i2c_new_master_bus(&i2c_mst_config, &bus_handle);
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Failed to create I2C master bus: %s", esp_err_to_name(ret));
-        goto init_fail;
-    }
-
-    // Add the MUX as a device on the bus
-    i2c_device_config_t mux_dev_cfg = {
-        .scl_speed_hz = I2C_MASTER_FREQ_HZ,
-        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
-        .device_address = I2C_MUX_ADDR, // Changed from dev_addr to device_address
-    };
-    ret = i2c_master_bus_add_device(bus_handle, &mux_dev_cfg, &mux_dev_handle);
+    // Bring up the bus and the MUX devices (hardware or mock backend)
+    ret = i2c_bus_backend.init(config);
     if (ret != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to add MUX device (0x%02X) to bus: %s", I2C_MUX_ADDR, esp_err_to_name(ret));
         goto init_fail;
     }
+    bus_ready = true;
 
-    ESP_LOGI(TAG, "I2C Master bus and MUX device initialized successfully.");
-
-    // Initial MUX state: Select channel 0 (or deselect all if preferred)
-    ret = i2c_manager_select_mux_channel(0); // Select channel 0 initially
+    // Initial MUX state: Select channel 0, which also clears every other mux on the main bus
+    ret = i2c_manager_select_mux_channel(0);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "Initial MUX channel selection failed: %s", esp_err_to_name(ret));
@@ -83,20 +74,19 @@ esp_err_t i2c_manager_init(void)
         ESP_LOGI(TAG, "I2C MUX Initialized, channel 0 selected.");
     }
 
+    // Start the bus task that drains the producer rings
+    ret = i2c_bus_engine_start(config);
+    if (ret != ESP_OK)
+    {
+        i2c_bus_backend.deinit();
+        bus_ready = false;
+        goto init_fail;
+    }
+
     return ESP_OK;
 
 init_fail:
-    // Cleanup on failure
-    if (mux_dev_handle)
-    {
-        i2c_master_bus_rm_device(mux_dev_handle);
-        mux_dev_handle = NULL;
-    }
-    if (bus_handle)
-    {
-        i2c_del_master_bus(bus_handle);
-        bus_handle = NULL;
-    }
+    // Cleanup on failure (the backend releases its own handles)
     if (i2c_mutex)
     {
         vSemaphoreDelete(i2c_mutex);
@@ -113,15 +103,13 @@ esp_err_t i2c_manager_deinit(void)
         // Proceed with deinit anyway, might be stuck
     }
 
-    if (mux_dev_handle)
-    {
-        i2c_master_bus_rm_device(mux_dev_handle);
-        mux_dev_handle = NULL;
-    }
-    if (bus_handle)
+    // With the mutex held the bus task is between transactions (or waiting for us)
+    i2c_bus_engine_stop();
+
+    if (bus_ready)
     {
-        i2c_del_master_bus(bus_handle);
-        bus_handle = NULL;
+        i2c_bus_backend.deinit();
+        bus_ready = false;
     }
 
     if (i2c_mutex)
@@ -136,51 +124,111 @@ esp_err_t i2c_manager_deinit(void)
 
 // --- TCA9548A MUX Control ---
 
+// Caller must hold i2c_mutex. Split out so the transaction functions below can
+// switch channels without re-taking the (non-recursive) mutex they already hold.
+// Any combination of flat channels can be enabled at once, across muxes.
+static esp_err_t select_mux_mask_locked(i2c_channel_mask_t channels)
+{
+    // Only touch the muxes if the enabled set is actually changing
+    if (current_channels_known && channels == current_channels)
+    {
+        return ESP_OK; // Already on the correct channel(s)
+    }
+
+    i2c_mux_write_t writes[I2C_MUX_COUNT];
+    size_t n = i2c_mux_topology_plan(channels, writes);
+    esp_err_t ret = ESP_OK;
+    for (size_t i = 0; i < n && ret == ESP_OK; ++i)
+    {
+        uint8_t address = i2c_mux_topology_address(writes[i].mux);
+        uint8_t write_buf = writes[i].value; // TCA9548A control register value
+        // Trace single channels by flat number, combinations as I2C_TRACE_MUX_MULTI (the mask is in the command field)
+        uint8_t trace_channel = (write_buf != 0 && (write_buf & (write_buf - 1)) == 0)
+                                    ? (uint8_t)(writes[i].mux * MAX_I2C_MUX_CHANNELS + __builtin_ctz(write_buf))
+                                    : I2C_TRACE_MUX_MULTI;
+
+        int64_t start_us = esp_timer_get_time();
+        ret = i2c_bus_backend.transmit(address, &write_buf, 1, I2C_TIMEOUT_MS);
+        i2c_trace_record(I2C_TRACE_OP_MUX_SELECT, trace_channel, address, write_buf, 1, ret, start_us);
+        i2c_admission_charge(0, I2C_ADMISSION_NO_MODULE, i2c_admission_cost_us(1, false));
+        i2c_mux_topology_record(&writes[i], ret == ESP_OK);
+
+        if (ret != ESP_OK)
+        {
+            // Muxes behind this one were not written and keep their cached state
+            ESP_LOGE(TAG, "Failed to write 0x%02X to MUX 0x%02X: %s", write_buf, address, esp_err_to_name(ret));
+        }
+    }
+
+    if (ret == ESP_OK)
+    {
+        ESP_LOGD(TAG, "Selected MUX channels 0x%016llX (%d mux writes)", (unsigned long long)channels, n);
+        current_channels = channels;
+        current_channels_known = true;
+    }
+    else
+    {
+        current_channels_known = false; // Mark state as unknown on error
+    }
+    return ret;
+}
+
+static esp_err_t select_mux_channel_locked(uint8_t channel)
+{
+    if (channel >= I2C_MUX_CHANNEL_COUNT)
+    {
+        ESP_LOGE(TAG, "Invalid MUX channel: %d (Max is %d)", channel, I2C_MUX_CHANNEL_COUNT - 1);
+        return ESP_ERR_INVALID_ARG;
+    }
+    return select_mux_mask_locked(I2C_CHANNEL_BIT(channel));
+}
+
 esp_err_t i2c_manager_select_mux_channel(uint8_t channel)
 {
-    if (channel >= MAX_I2C_MUX_CHANNELS)
+    if (channel >= I2C_MUX_CHANNEL_COUNT)
     {
-        ESP_LOGE(TAG, "Invalid MUX channel: %d (Max is %d)", channel, MAX_I2C_MUX_CHANNELS - 1);
+        ESP_LOGE(TAG, "Invalid MUX channel: %d (Max is %d)", channel, I2C_MUX_CHANNEL_COUNT - 1);
         return ESP_ERR_INVALID_ARG;
     }
-    if (!bus_handle || !mux_dev_handle)
+    if (!bus_ready)
     {
         ESP_LOGE(TAG, "I2C Manager not initialized for MUX select");
         return ESP_ERR_INVALID_STATE;
     }
 
-    esp_err_t ret = ESP_FAIL;
-
     if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(I2C_TIMEOUT_MS * 2)) != pdTRUE)
     {
         ESP_LOGE(TAG, "Failed to acquire I2C mutex for MUX select");
         return ESP_ERR_TIMEOUT;
     }
 
-    // Only write to MUX if the channel is actually changing
-    if (channel == current_mux_channel)
+    esp_err_t ret = select_mux_channel_locked(channel);
+
+    xSemaphoreGive(i2c_mutex);
+    return ret;
+}
+
+esp_err_t i2c_manager_select_mux_mask(i2c_channel_mask_t channel_mask)
+{
+    if (channel_mask & ~I2C_MUX_ALL_CHANNELS)
     {
-        ret = ESP_OK; // Already on the correct channel
+        ESP_LOGE(TAG, "Invalid MUX mask: 0x%016llX", (unsigned long long)channel_mask);
+        return ESP_ERR_INVALID_ARG;
     }
-    else
+    if (!bus_ready)
     {
-        uint8_t write_buf = 1 << channel; // TCA9548A control register value
-
-        // Use the new transmit function with the MUX device handle
-        ret = i2c_master_transmit(mux_dev_handle, &write_buf, 1, I2C_TIMEOUT_MS);
+        ESP_LOGE(TAG, "I2C Manager not initialized for MUX select");
+        return ESP_ERR_INVALID_STATE;
+    }
 
-        if (ret == ESP_OK)
-        {
-            ESP_LOGD(TAG, "Successfully selected MUX channel %d", channel);
-            current_mux_channel = channel;
-        }
-        else
-        {
-            ESP_LOGE(TAG, "Failed to select MUX channel %d: %s", channel, esp_err_to_name(ret));
-            current_mux_channel = 0xFF; // Mark channel as unknown/invalid on error
-        }
+    if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(I2C_TIMEOUT_MS * 2)) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Failed to acquire I2C mutex for MUX select");
+        return ESP_ERR_TIMEOUT;
     }
 
+    esp_err_t ret = select_mux_mask_locked(channel_mask);
+
     xSemaphoreGive(i2c_mutex);
     return ret;
 }
@@ -188,10 +236,19 @@ esp_err_t i2c_manager_select_mux_channel(uint8_t channel)
 // --- Module Communication ---
 
 esp_err_t i2c_manager_send_command(uint8_t mux_channel, uint8_t module_address, uint8_t command_id, const void *data, size_t data_len)
+{
+    size_t sent_len;
+    return i2c_manager_send_command_counted(mux_channel, module_address, command_id, data, data_len, true,
+                                            &sent_len);
+}
+
+esp_err_t i2c_manager_send_command_counted(uint8_t mux_channel, uint8_t module_address, uint8_t command_id,
+                                           const void *data, size_t data_len, bool report, size_t *sent_len)
 {
     esp_err_t ret;
 
-    if (!bus_handle)
+    *sent_len = 0;
+    if (!bus_ready)
     {
         ESP_LOGE(TAG, "I2C Manager not initialized for send command");
         return ESP_ERR_INVALID_STATE;
@@ -203,8 +260,17 @@ esp_err_t i2c_manager_send_command(uint8_t mux_channel, uint8_t module_address,
         return ESP_ERR_TIMEOUT;
     }
 
+    // 0. Drop parameters the module already holds; if none are left, neither mux nor module is touched
+    uint8_t filtered[I2C_MANAGER_MAX_QUEUED_PAYLOAD];
+    if ((command_id == CMD_SET_PARAM || command_id == CMD_SET_PARAM_BULK) &&
+        !i2c_param_shadow_filter(mux_channel, module_address, command_id, &data, &data_len, filtered))
+    {
+        xSemaphoreGive(i2c_mutex);
+        return ESP_OK;
+    }
+
     // 1. Select the correct MUX channel
-    ret = i2c_manager_select_mux_channel(mux_channel); // This function handles mutex internally but we hold it across the whole operation
+    ret = select_mux_channel_locked(mux_channel); // We hold the mutex across the whole operation
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to select MUX channel %d before sending command", mux_channel);
@@ -239,32 +305,15 @@ esp_err_t i2c_manager_send_command(uint8_t mux_channel, uint8_t module_address,
         return ESP_ERR_INVALID_ARG;
     }
 
-    // Use i2c_master_transmit - creates a temporary device handle
-    // This avoids needing to add/remove every module to the bus constantly.
-    i2c_device_config_t module_dev_cfg = {
-        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
-        .device_address = module_address,   // Changed from dev_addr to device_address
-        .scl_speed_hz = I2C_MASTER_FREQ_HZ, // Use bus default speed
-    };
-
     ESP_LOGD(TAG, "Sending %d bytes (Cmd: 0x%02X) to MUX %d Addr 0x%02X", total_len, command_id, mux_channel, module_address);
 
-    // Create a temporary device handle for this operation
-    i2c_master_dev_handle_t temp_dev_handle = NULL;
-    ret = i2c_master_bus_add_device(bus_handle, &module_dev_cfg, &temp_dev_handle);
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Failed to create temporary device handle: %s", esp_err_to_name(ret));
-        free(tx_buffer);
-        xSemaphoreGive(i2c_mutex);
-        return ret;
-    }
-
     // Transmit to the device
-    ret = i2c_master_transmit(temp_dev_handle, tx_buffer, total_len, I2C_TIMEOUT_MS);
-
-    // Remove the temporary device
-    i2c_master_bus_rm_device(temp_dev_handle);
+    int64_t start_us = esp_timer_get_time();
+    ret = i2c_bus_backend.transmit(module_address, tx_buffer, total_len, I2C_TIMEOUT_MS);
+    *sent_len = total_len;
+    i2c_trace_record(I2C_TRACE_OP_WRITE, mux_channel, module_address, command_id, total_len, ret, start_us);
+    i2c_admission_charge(mux_channel, module_address, i2c_admission_cost_us(total_len, false));
+    i2c_param_shadow_record_write(mux_channel, module_address, command_id, data, data_len, ret, report);
 
     free(tx_buffer); // Free the temporary buffer
 
@@ -282,6 +331,109 @@ esp_err_t i2c_manager_send_command(uint8_t mux_channel, uint8_t module_address,
     return ret;
 }
 
+esp_err_t i2c_manager_send_param_block(uint8_t mux_channel, uint8_t module_addr,
+                                       const ParamId_t *param_ids, const ParamValue_t *values, size_t count)
+{
+    if (param_ids == NULL || values == NULL || count == 0 || count > I2C_MANAGER_MAX_BULK_PARAMS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // count byte + packed (id, value) pairs; sized for the worst case so no heap is needed
+    uint8_t payload[1 + I2C_MANAGER_MAX_BULK_PARAMS * (sizeof(ParamId_t) + sizeof(ParamValue_t))];
+    size_t len = 0;
+
+    payload[len++] = (uint8_t)count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        memcpy(&payload[len], &param_ids[i], sizeof(ParamId_t));
+        len += sizeof(ParamId_t);
+        memcpy(&payload[len], &values[i], sizeof(ParamValue_t));
+        len += sizeof(ParamValue_t);
+    }
+
+    ESP_LOGD(TAG, "Bulk write of %d params to MUX %d Addr 0x%02X", count, mux_channel, module_addr);
+    return i2c_manager_send_command(mux_channel, module_addr, CMD_SET_PARAM_BULK, payload, len);
+}
+
+// --- Broadcast ---
+
+esp_err_t i2c_manager_broadcast(i2c_channel_mask_t channel_mask, uint8_t command_id, const void *data, size_t data_len)
+{
+    size_t sent_len;
+    return i2c_manager_broadcast_counted(channel_mask, command_id, data, data_len, &sent_len);
+}
+
+esp_err_t i2c_manager_broadcast_counted(i2c_channel_mask_t channel_mask, uint8_t command_id, const void *data,
+                                        size_t data_len, size_t *sent_len)
+{
+    uint8_t tx_buffer[1 + I2C_MANAGER_MAX_QUEUED_PAYLOAD];
+
+    *sent_len = 0;
+    if (channel_mask == 0 || (channel_mask & ~I2C_MUX_ALL_CHANNELS) || data_len > I2C_MANAGER_MAX_QUEUED_PAYLOAD ||
+        (data == NULL && data_len > 0))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!bus_ready)
+    {
+        ESP_LOGE(TAG, "I2C Manager not initialized for broadcast");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    tx_buffer[0] = command_id;
+    if (data_len > 0)
+    {
+        memcpy(tx_buffer + 1, data, data_len);
+    }
+
+    if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(I2C_TIMEOUT_MS * 2)) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Failed to acquire I2C mutex for broadcast");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    // Enable every requested channel, then one frame reaches all modules behind them
+    esp_err_t ret = select_mux_mask_locked(channel_mask);
+    if (ret == ESP_OK)
+    {
+        int64_t start_us = esp_timer_get_time();
+        ret = i2c_bus_backend.transmit(CONFIG_CENTRAL_I2C_BROADCAST_ADDRESS, tx_buffer, 1 + data_len, I2C_TIMEOUT_MS);
+        *sent_len = 1 + data_len;
+        // Masks beyond the first mux are traced as I2C_TRACE_MUX_MULTI; the MUX_SELECT records show them
+        uint8_t trace_mask = channel_mask <= 0xFF ? (uint8_t)channel_mask : I2C_TRACE_MUX_MULTI;
+        i2c_trace_record(I2C_TRACE_OP_BROADCAST, trace_mask, CONFIG_CENTRAL_I2C_BROADCAST_ADDRESS, command_id,
+                         1 + data_len, ret, start_us);
+        i2c_admission_charge(0, I2C_ADMISSION_NO_MODULE, i2c_admission_cost_us(1 + data_len, false));
+        i2c_param_shadow_record_broadcast(channel_mask, command_id, data, data_len, ret);
+    }
+
+    xSemaphoreGive(i2c_mutex);
+
+    if (ret == ESP_OK)
+    {
+        // Module state changed behind the cache's back; identity is unaffected
+        i2c_module_cache_expire_status(channel_mask);
+        ESP_LOGD(TAG, "Broadcast 0x%02X (%d bytes) to MUX mask 0x%016llX", command_id, 1 + data_len,
+                 (unsigned long long)channel_mask);
+    }
+    else
+    {
+        // ACK is wired-AND: a NACK means no module on these channels took the frame
+        ESP_LOGE(TAG, "Broadcast 0x%02X to MUX mask 0x%016llX failed: %s", command_id,
+                 (unsigned long long)channel_mask, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+esp_err_t i2c_manager_broadcast_param(i2c_channel_mask_t channel_mask, ParamId_t param_id, ParamValue_t value)
+{
+    uint8_t payload[sizeof(ParamId_t) + sizeof(ParamValue_t)];
+    memcpy(payload, &param_id, sizeof(ParamId_t));
+    memcpy(payload + sizeof(ParamId_t), &value, sizeof(ParamValue_t));
+    return i2c_manager_broadcast(channel_mask, CMD_SET_PARAM, payload, sizeof(payload));
+}
+
 esp_err_t i2c_manager_read_data(uint8_t mux_channel, uint8_t module_address, uint8_t request_id,
                                 bool write_request_id, void *buffer, size_t buffer_len, size_t *bytes_read)
 {
@@ -294,7 +446,7 @@ esp_err_t i2c_manager_read_data(uint8_t mux_channel, uint8_t module_address, uin
 
     *bytes_read = 0; // Initialize output
 
-    if (!bus_handle)
+    if (!bus_ready)
     {
         ESP_LOGE(TAG, "I2C Manager not initialized for read data");
         return ESP_ERR_INVALID_STATE;
@@ -307,7 +459,7 @@ esp_err_t i2c_manager_read_data(uint8_t mux_channel, uint8_t module_address, uin
     }
 
     // 1. Select the correct MUX channel
-    ret = i2c_manager_select_mux_channel(mux_channel);
+    ret = select_mux_channel_locked(mux_channel);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to select MUX channel %d before reading data", mux_channel);
@@ -316,45 +468,32 @@ esp_err_t i2c_manager_read_data(uint8_t mux_channel, uint8_t module_address, uin
     }
 
     // 2. Perform the I2C Read Transaction
-    i2c_device_config_t module_dev_cfg = {
-        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
-        .device_address = module_address, // Changed from dev_addr to device_address
-        .scl_speed_hz = I2C_MASTER_FREQ_HZ,
-    };
-
-    // Create a temporary device handle for this operation
-    i2c_master_dev_handle_t temp_dev_handle = NULL;
-    ret = i2c_master_bus_add_device(bus_handle, &module_dev_cfg, &temp_dev_handle);
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Failed to create temporary device handle: %s", esp_err_to_name(ret));
-        xSemaphoreGive(i2c_mutex);
-        return ret;
-    }
-
     if (write_request_id)
     {
         // Use transmit_receive: Write request_id first, then read
         ESP_LOGD(TAG, "Reading %d bytes from MUX %d Addr 0x%02X after writing Req 0x%02X",
                  buffer_len, mux_channel, module_address, request_id);
-        ret = i2c_master_transmit_receive(temp_dev_handle,
-                                          &request_id, 1,     // Write request ID
-                                          buffer, buffer_len, // Read into buffer
-                                          I2C_TIMEOUT_MS);
+        int64_t start_us = esp_timer_get_time();
+        ret = i2c_bus_backend.transmit_receive(module_address,
+                                               &request_id, 1,     // Write request ID
+                                               buffer, buffer_len, // Read into buffer
+                                               I2C_TIMEOUT_MS);
+        i2c_trace_record(I2C_TRACE_OP_WRITE_READ, mux_channel, module_address, request_id, 1 + buffer_len, ret, start_us);
+        i2c_admission_charge(mux_channel, module_address, i2c_admission_cost_us(1 + buffer_len, true));
     }
     else
     {
         // Use receive only: Directly read from the device
         ESP_LOGD(TAG, "Reading %d bytes from MUX %d Addr 0x%02X (no write phase)",
                  buffer_len, mux_channel, module_address);
-        ret = i2c_master_receive(temp_dev_handle,
-                                 buffer, buffer_len,
-                                 I2C_TIMEOUT_MS);
+        int64_t start_us = esp_timer_get_time();
+        ret = i2c_bus_backend.receive(module_address,
+                                      buffer, buffer_len,
+                                      I2C_TIMEOUT_MS);
+        i2c_trace_record(I2C_TRACE_OP_READ, mux_channel, module_address, 0, buffer_len, ret, start_us);
+        i2c_admission_charge(mux_channel, module_address, i2c_admission_cost_us(buffer_len, false));
     }
 
-    // Remove the temporary device
-    i2c_master_bus_rm_device(temp_dev_handle);
-
     if (ret == ESP_OK)
     {
         // The new driver functions perform the full read operation as requested.
@@ -383,7 +522,7 @@ esp_err_t i2c_manager_probe_device(uint8_t device_address)
     uint8_t mux_channel = 0;
     esp_err_t ret;
 
-    if (!bus_handle)
+    if (!bus_ready)
     {
         ESP_LOGE(TAG, "I2C Manager not initialized for probe");
         return ESP_ERR_INVALID_STATE;
@@ -397,7 +536,7 @@ esp_err_t i2c_manager_probe_device(uint8_t device_address)
     }
 
     // Select the MUX channel
-    ret = i2c_manager_select_mux_channel(mux_channel);
+    ret = select_mux_channel_locked(mux_channel);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to select MUX channel %d before probing", mux_channel);
@@ -406,29 +545,14 @@ esp_err_t i2c_manager_probe_device(uint8_t device_address)
     }
 
     // NOTE: MUX channel must be selected *before* calling probe.
-    i2c_device_config_t probe_dev_cfg = {
-        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
-        .device_address = device_address, // Using device_address instead of dev_addr
-        .scl_speed_hz = I2C_MASTER_FREQ_HZ,
-    };
-
-    // Create a temporary device handle for this operation
-    i2c_master_dev_handle_t temp_dev_handle = NULL;
-    ret = i2c_master_bus_add_device(bus_handle, &probe_dev_cfg, &temp_dev_handle);
-
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Failed to create temporary device handle for probe: %s", esp_err_to_name(ret));
-        xSemaphoreGive(i2c_mutex);
-        return ret;
-    }
-
     // Perform a zero-byte write transaction. Success (ESP_OK) indicates an ACK.
     // Timeout (ESP_ERR_TIMEOUT) indicates no ACK (NACK or bus busy/stuck).
-    ret = i2c_master_transmit(temp_dev_handle, NULL, 0, pdMS_TO_TICKS(50)); // Short timeout for probe
-
-    // Remove the temporary device
-    i2c_master_bus_rm_device(temp_dev_handle);
+    int64_t start_us = esp_timer_get_time();
+    ret = i2c_bus_backend.transmit(device_address, NULL, 0, 50); // Short timeout for probe
+    i2c_trace_record(I2C_TRACE_OP_PROBE, mux_channel, device_address, 0, 0, ret, start_us);
+    // Empty addresses get no module account, so a scan cannot evict the live ones
+    i2c_admission_charge(mux_channel, ret == ESP_OK ? device_address : I2C_ADMISSION_NO_MODULE,
+                         i2c_admission_cost_us(0, false));
 
     if (ret == ESP_OK)
     {
@@ -454,7 +578,7 @@ esp_err_t i2c_manager_probe_device_on_channel(uint8_t mux_channel, uint8_t devic
 {
     esp_err_t ret;
 
-    if (!bus_handle)
+    if (!bus_ready)
     {
         ESP_LOGE(TAG, "I2C Manager not initialized for probe");
         return ESP_ERR_INVALID_STATE;
@@ -468,7 +592,7 @@ esp_err_t i2c_manager_probe_device_on_channel(uint8_t mux_channel, uint8_t devic
     }
 
     // Select the MUX channel
-    ret = i2c_manager_select_mux_channel(mux_channel);
+    ret = select_mux_channel_locked(mux_channel);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to select MUX channel %d before probing", mux_channel);
@@ -477,29 +601,13 @@ esp_err_t i2c_manager_probe_device_on_channel(uint8_t mux_channel, uint8_t devic
     }
 
     // NOTE: MUX channel must be selected *before* calling probe.
-    i2c_device_config_t probe_dev_cfg = {
-        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
-        .device_address = device_address, // Using device_address instead of dev_addr
-        .scl_speed_hz = I2C_MASTER_FREQ_HZ,
-    };
-
-    // Create a temporary device handle for this operation
-    i2c_master_dev_handle_t temp_dev_handle = NULL;
-    ret = i2c_master_bus_add_device(bus_handle, &probe_dev_cfg, &temp_dev_handle);
-
-    if (ret != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Failed to create temporary device handle for probe: %s", esp_err_to_name(ret));
-        xSemaphoreGive(i2c_mutex);
-        return ret;
-    }
-
     // Perform a zero-byte write transaction. Success (ESP_OK) indicates an ACK.
     // Timeout (ESP_ERR_TIMEOUT) indicates no ACK (NACK or bus busy/stuck).
-    ret = i2c_master_transmit(temp_dev_handle, NULL, 0, pdMS_TO_TICKS(50)); // Short timeout for probe
-
-    // Remove the temporary device
-    i2c_master_bus_rm_device(temp_dev_handle);
+    int64_t start_us = esp_timer_get_time();
+    ret = i2c_bus_backend.transmit(device_address, NULL, 0, 50); // Short timeout for probe
+    i2c_trace_record(I2C_TRACE_OP_PROBE, mux_channel, device_address, 0, 0, ret, start_us);
+    i2c_admission_charge(mux_channel, ret == ESP_OK ? device_address : I2C_ADMISSION_NO_MODULE,
+                         i2c_admission_cost_us(0, false));
 
     if (ret == ESP_OK)
     {
@@ -519,4 +627,230 @@ esp_err_t i2c_manager_probe_device_on_channel(uint8_t mux_channel, uint8_t devic
 
     xSemaphoreGive(i2c_mutex);
     return (ret == ESP_OK) ? ESP_OK : ESP_ERR_NOT_FOUND; // Return ESP_OK only if ACK was received
-}
\ No newline at end of file
+}
+
+// --- Common Registers ---
+
+esp_err_t i2c_manager_read_common_reg(uint8_t mux_channel, uint8_t module_addr, uint8_t reg_addr, uint8_t *buffer, size_t read_size, TickType_t timeout_ticks)
+{
+    if (buffer == NULL || read_size == 0 || mux_channel >= I2C_MUX_CHANNEL_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!bus_ready)
+    {
+        ESP_LOGE(TAG, "I2C Manager not initialized for register read");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xSemaphoreTake(i2c_mutex, timeout_ticks) != pdTRUE)
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    esp_err_t ret = select_mux_channel_locked(mux_channel);
+    if (ret == ESP_OK)
+    {
+        int64_t start_us = esp_timer_get_time();
+        ret = i2c_bus_backend.transmit_receive(module_addr, &reg_addr, 1, buffer, read_size, I2C_TIMEOUT_MS);
+        i2c_trace_record(I2C_TRACE_OP_WRITE_READ, mux_channel, module_addr, reg_addr, 1 + read_size, ret, start_us);
+        i2c_admission_charge(mux_channel, module_addr, i2c_admission_cost_us(1 + read_size, true));
+    }
+
+    xSemaphoreGive(i2c_mutex);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGD(TAG, "Register 0x%02X read from 0x%02X on MUX %d failed: %s",
+                 reg_addr, module_addr, mux_channel, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+// Caller must hold i2c_mutex. One write-read from COMMON_REG_BLOCK_START; the module
+// auto-increments its register pointer across the block.
+static esp_err_t read_common_block_locked(uint8_t mux_channel, uint8_t module_addr, i2c_common_block_t *block, int xfer_timeout_ms)
+{
+    uint8_t reg = COMMON_REG_BLOCK_START;
+    uint8_t raw[I2C_COMMON_BLOCK_SIZE];
+
+    esp_err_t ret = select_mux_channel_locked(mux_channel);
+    if (ret != ESP_OK)
+    {
+        return ret; // Says nothing about the module itself
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    ret = i2c_bus_backend.transmit_receive(module_addr, &reg, 1, raw, sizeof(raw), xfer_timeout_ms);
+    i2c_trace_record(I2C_TRACE_OP_WRITE_READ, mux_channel, module_addr, reg, 1 + sizeof(raw), ret, start_us);
+    i2c_admission_charge(mux_channel, module_addr, i2c_admission_cost_us(1 + sizeof(raw), true));
+    if (ret != ESP_OK)
+    {
+        i2c_module_cache_update(mux_channel, module_addr, NULL);
+        i2c_param_shadow_forget_module(mux_channel, module_addr); // Gone, or about to come back reset
+        return ret;
+    }
+
+    memcpy(&block->module_type, &raw[I2C_COMMON_BLOCK_OFFSET_TYPE], sizeof(ModuleType_t));
+    block->fw_version = (uint16_t)(raw[I2C_COMMON_BLOCK_OFFSET_FW_VERSION] |
+                                   (raw[I2C_COMMON_BLOCK_OFFSET_FW_VERSION + 1] << 8));
+    block->status = raw[I2C_COMMON_BLOCK_OFFSET_STATUS];
+    i2c_module_cache_update(mux_channel, module_addr, block);
+    return ESP_OK;
+}
+
+esp_err_t i2c_manager_read_common_blocks(const i2c_module_ref_t *modules, size_t count,
+                                         i2c_common_block_t *blocks, esp_err_t *results, TickType_t timeout_ticks)
+{
+    if ((modules == NULL || blocks == NULL) && count > 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t first_error = ESP_OK;
+    if (!bus_ready)
+    {
+        ESP_LOGE(TAG, "I2C Manager not initialized for block read");
+        first_error = ESP_ERR_INVALID_STATE;
+    }
+    else if (count > 0 && xSemaphoreTake(i2c_mutex, timeout_ticks) != pdTRUE)
+    {
+        first_error = ESP_ERR_TIMEOUT;
+    }
+    if (first_error != ESP_OK || count == 0)
+    {
+        for (size_t i = 0; results && i < count; ++i)
+        {
+            results[i] = first_error;
+        }
+        return first_error;
+    }
+
+    i2c_channel_mask_t wanted = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (modules[i].mux_channel >= I2C_MUX_CHANNEL_COUNT)
+        {
+            first_error = first_error == ESP_OK ? ESP_ERR_INVALID_ARG : first_error;
+            if (results)
+            {
+                results[i] = ESP_ERR_INVALID_ARG;
+            }
+            continue;
+        }
+        wanted |= I2C_CHANNEL_BIT(modules[i].mux_channel);
+    }
+
+    // Visit channels in tree order starting with the selected one, so each channel is
+    // selected at most once and each mux switched as rarely as possible
+    i2c_channel_mask_t mask = current_channels_known ? current_channels : 0;
+    uint8_t start = (mask != 0 && (mask & (mask - 1)) == 0) ? i2c_mux_topology_rank((uint8_t)__builtin_ctzll(mask)) : 0;
+    for (int k = 0; k < I2C_MUX_CHANNEL_COUNT && wanted != 0; ++k)
+    {
+        uint8_t channel = i2c_mux_topology_channel_at((start + k) % I2C_MUX_CHANNEL_COUNT);
+        if (!(wanted & I2C_CHANNEL_BIT(channel)))
+        {
+            continue;
+        }
+        wanted &= ~I2C_CHANNEL_BIT(channel);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (modules[i].mux_channel != channel)
+            {
+                continue;
+            }
+            esp_err_t ret = read_common_block_locked(channel, modules[i].module_addr, &blocks[i], I2C_TIMEOUT_MS);
+            if (results)
+            {
+                results[i] = ret;
+            }
+            if (ret != ESP_OK && first_error == ESP_OK)
+            {
+                first_error = ret;
+            }
+        }
+    }
+
+    xSemaphoreGive(i2c_mutex);
+    return first_error;
+}
+
+esp_err_t i2c_manager_read_common_block(uint8_t mux_channel, uint8_t module_addr, i2c_common_block_t *block, TickType_t timeout_ticks)
+{
+    i2c_module_ref_t ref = {.mux_channel = mux_channel, .module_addr = module_addr};
+    return i2c_manager_read_common_blocks(&ref, 1, block, NULL, timeout_ticks);
+}
+
+// --- Discovery ---
+
+esp_err_t i2c_manager_discover_modules(discovered_module_t *found_modules_buffer,
+                                       size_t buffer_capacity,
+                                       size_t *count,
+                                       const uint8_t *addresses_to_scan,
+                                       size_t num_addresses,
+                                       uint32_t timeout_ms_per_device)
+{
+    if (count == NULL || (found_modules_buffer == NULL && buffer_capacity > 0))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!bus_ready)
+    {
+        ESP_LOGE(TAG, "I2C Manager not initialized for discovery");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const uint8_t first_default = 0x08;
+    const uint8_t last_default = 0x77;
+    size_t candidates = addresses_to_scan ? num_addresses : (size_t)(last_default - first_default + 1);
+    size_t found = 0;
+
+    *count = 0;
+    i2c_param_shadow_forget_all(); // Modules may have been swapped or power-cycled since the last scan
+    for (uint8_t rank = 0; rank < I2C_MUX_CHANNEL_COUNT; ++rank)
+    {
+        uint8_t channel = i2c_mux_topology_channel_at(rank);
+
+        // Released between channels so queued writes are not held up for the whole scan
+        if (xSemaphoreTake(i2c_mutex, pdMS_TO_TICKS(I2C_TIMEOUT_MS * 2)) != pdTRUE)
+        {
+            ESP_LOGE(TAG, "Failed to acquire I2C mutex for discovery");
+            return ESP_ERR_TIMEOUT;
+        }
+
+        for (size_t a = 0; a < candidates; ++a)
+        {
+            uint8_t addr = addresses_to_scan ? addresses_to_scan[a] : (uint8_t)(first_default + a);
+            if (i2c_mux_topology_is_mux(addr))
+            {
+                continue; // A mux answers on every channel it is reachable from
+            }
+
+            // The block read doubles as the probe: absent modules NACK the register write
+            i2c_common_block_t block;
+            if (read_common_block_locked(channel, addr, &block, (int)timeout_ms_per_device) != ESP_OK)
+            {
+                continue;
+            }
+            if (found < buffer_capacity)
+            {
+                found_modules_buffer[found] = (discovered_module_t){
+                    .mux_channel = channel,
+                    .i2c_address = addr,
+                    .module_type = block.module_type,
+                    .fw_version = block.fw_version,
+                    .status = block.status,
+                    .present = true,
+                };
+            }
+            found++;
+        }
+
+        xSemaphoreGive(i2c_mutex);
+    }
+
+    if (found > buffer_capacity)
+    {
+        ESP_LOGW(TAG, "Discovery found %d modules, buffer holds %d", found, buffer_capacity);
+    }
+    *count = found < buffer_capacity ? found : buffer_capacity;
+    ESP_LOGI(TAG, "Discovery complete: %d modules", found);
+    return ESP_OK;
+}
@@ -0,0 +1,359 @@
+#include "i2c_module_cache.h"
+#include "i2c_param_shadow.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+
+static const char *TAG = "I2C_MODULE_CACHE";
+
+#define CACHE_ENTRIES CONFIG_CENTRAL_I2C_MODULE_CACHE_ENTRIES
+#define REFRESH_CHUNK 16 // Stale modules read per mutex hold in i2c_manager_refresh_modules()
+
+// --- Fields and TTLs ---
+// A block read refreshes every field at once, so one timestamp per entry is enough;
+// the fields differ only in how long that timestamp keeps them valid.
+
+typedef enum
+{
+    FIELD_TYPE = 1 << 0,
+    FIELD_FW_VERSION = 1 << 1,
+    FIELD_STATUS = 1 << 2,
+    FIELD_ALL = FIELD_TYPE | FIELD_FW_VERSION | FIELD_STATUS,
+} cache_field_t;
+
+// 0 = valid until the module stops answering
+#define IDENTITY_TTL_US ((int64_t)CONFIG_CENTRAL_I2C_IDENTITY_TTL_MS * 1000)
+#define STATUS_TTL_US ((int64_t)CONFIG_CENTRAL_I2C_STATUS_TTL_MS * 1000)
+
+typedef struct
+{
+    i2c_common_block_t block;
+    int64_t read_us;   // esp_timer_get_time() of the block read
+    uint32_t last_use; // use_clock value at the last hit or store, for LRU eviction
+    uint8_t mux_channel;
+    uint8_t module_addr;
+    bool valid;
+    bool status_expired; // Set by a broadcast that may have changed the status
+} cache_entry_t;
+
+// --- State ---
+
+static cache_entry_t entries[CACHE_ENTRIES];
+static uint32_t use_clock = 0;
+static i2c_module_cache_stats_t stats = {0};
+static portMUX_TYPE cache_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// --- Helpers (cache_lock held) ---
+
+static cache_entry_t *find_entry(uint8_t mux_channel, uint8_t module_addr)
+{
+    for (int i = 0; i < CACHE_ENTRIES; ++i)
+    {
+        if (entries[i].valid && entries[i].mux_channel == mux_channel && entries[i].module_addr == module_addr)
+        {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static cache_entry_t *alloc_entry(void)
+{
+    cache_entry_t *lru = &entries[0];
+    for (int i = 0; i < CACHE_ENTRIES; ++i)
+    {
+        if (!entries[i].valid)
+        {
+            stats.entries++;
+            return &entries[i];
+        }
+        if ((int32_t)(entries[i].last_use - lru->last_use) < 0)
+        {
+            lru = &entries[i];
+        }
+    }
+    stats.evictions++;
+    return lru;
+}
+
+static bool entry_fresh(const cache_entry_t *e, uint32_t fields, int64_t now)
+{
+    int64_t age = now - e->read_us;
+    if ((fields & (FIELD_TYPE | FIELD_FW_VERSION)) && IDENTITY_TTL_US > 0 && age >= IDENTITY_TTL_US)
+    {
+        return false;
+    }
+    if ((fields & FIELD_STATUS) && (e->status_expired || age >= STATUS_TTL_US))
+    {
+        return false;
+    }
+    return true;
+}
+
+static void drop_entry(cache_entry_t *e)
+{
+    e->valid = false;
+    stats.entries--;
+}
+
+// Copy out a cached block if all requested fields are fresh; counts a hit or a miss
+static bool cache_lookup(uint8_t mux_channel, uint8_t module_addr, uint32_t fields, i2c_common_block_t *out)
+{
+    int64_t now = esp_timer_get_time();
+    bool hit = false;
+
+    portENTER_CRITICAL(&cache_lock);
+    cache_entry_t *e = find_entry(mux_channel, module_addr);
+    if (e != NULL && entry_fresh(e, fields, now))
+    {
+        *out = e->block;
+        e->last_use = ++use_clock;
+        stats.hits++;
+        hit = true;
+    }
+    else
+    {
+        stats.misses++;
+    }
+    portEXIT_CRITICAL(&cache_lock);
+    return hit;
+}
+
+// --- Internal Interface ---
+
+void i2c_module_cache_update(uint8_t mux_channel, uint8_t module_addr, const i2c_common_block_t *block)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&cache_lock);
+    stats.bus_reads++;
+    cache_entry_t *e = find_entry(mux_channel, module_addr);
+    if (block == NULL)
+    {
+        if (e != NULL)
+        {
+            drop_entry(e);
+        }
+    }
+    else
+    {
+        if (e == NULL)
+        {
+            e = alloc_entry();
+            e->mux_channel = mux_channel;
+            e->module_addr = module_addr;
+            e->valid = true;
+        }
+        e->block = *block;
+        e->read_us = now;
+        e->status_expired = false;
+        e->last_use = ++use_clock;
+    }
+    portEXIT_CRITICAL(&cache_lock);
+}
+
+void i2c_module_cache_expire_status(i2c_channel_mask_t channel_mask)
+{
+    portENTER_CRITICAL(&cache_lock);
+    for (int i = 0; i < CACHE_ENTRIES; ++i)
+    {
+        if (entries[i].valid && (channel_mask & I2C_CHANNEL_BIT(entries[i].mux_channel)))
+        {
+            entries[i].status_expired = true;
+        }
+    }
+    portEXIT_CRITICAL(&cache_lock);
+}
+
+// --- Cached Getters ---
+
+static esp_err_t get_fields(uint8_t mux_channel, uint8_t module_addr, uint32_t fields,
+                            i2c_common_block_t *out, TickType_t timeout_ticks)
+{
+    if (cache_lookup(mux_channel, module_addr, fields, out))
+    {
+        return ESP_OK;
+    }
+    return i2c_manager_read_common_block(mux_channel, module_addr, out, timeout_ticks);
+}
+
+esp_err_t i2c_manager_get_module_type(uint8_t mux_channel, uint8_t module_addr, ModuleType_t *module_type, TickType_t timeout_ticks)
+{
+    if (module_type == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_common_block_t block;
+    esp_err_t ret = get_fields(mux_channel, module_addr, FIELD_TYPE, &block, timeout_ticks);
+    if (ret == ESP_OK)
+    {
+        *module_type = block.module_type;
+    }
+    return ret;
+}
+
+esp_err_t i2c_manager_get_status(uint8_t mux_channel, uint8_t module_addr, uint8_t *status, TickType_t timeout_ticks)
+{
+    if (status == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_common_block_t block;
+    esp_err_t ret = get_fields(mux_channel, module_addr, FIELD_STATUS, &block, timeout_ticks);
+    if (ret == ESP_OK)
+    {
+        *status = block.status;
+    }
+    return ret;
+}
+
+esp_err_t i2c_manager_get_fw_version(uint8_t mux_channel, uint8_t module_addr, uint16_t *version, TickType_t timeout_ticks)
+{
+    if (version == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    i2c_common_block_t block;
+    esp_err_t ret = get_fields(mux_channel, module_addr, FIELD_FW_VERSION, &block, timeout_ticks);
+    if (ret == ESP_OK)
+    {
+        *version = block.fw_version;
+    }
+    return ret;
+}
+
+esp_err_t i2c_manager_get_module_info(uint8_t mux_channel, uint8_t module_addr, i2c_common_block_t *info, TickType_t timeout_ticks)
+{
+    if (info == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return get_fields(mux_channel, module_addr, FIELD_ALL, info, timeout_ticks);
+}
+
+esp_err_t i2c_manager_refresh_modules(const i2c_module_ref_t *modules, size_t count,
+                                      i2c_common_block_t *infos, esp_err_t *results, TickType_t timeout_ticks)
+{
+    if (modules == NULL && count > 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    i2c_module_ref_t stale[REFRESH_CHUNK];
+    size_t stale_index[REFRESH_CHUNK];
+    i2c_common_block_t blocks[REFRESH_CHUNK];
+    esp_err_t stale_results[REFRESH_CHUNK];
+    size_t n_stale = 0;
+    esp_err_t first_error = ESP_OK;
+
+    for (size_t i = 0; i <= count; ++i)
+    {
+        // Flush the pending stale modules when the chunk is full or the input is done
+        if (n_stale == REFRESH_CHUNK || (i == count && n_stale > 0))
+        {
+            i2c_manager_read_common_blocks(stale, n_stale, blocks, stale_results, timeout_ticks);
+            for (size_t s = 0; s < n_stale; ++s)
+            {
+                esp_err_t r = stale_results[s];
+                if (infos && r == ESP_OK)
+                {
+                    infos[stale_index[s]] = blocks[s];
+                }
+                if (results)
+                {
+                    results[stale_index[s]] = r;
+                }
+                if (r != ESP_OK && first_error == ESP_OK)
+                {
+                    first_error = r;
+                }
+            }
+            n_stale = 0;
+        }
+        if (i == count)
+        {
+            break;
+        }
+
+        i2c_common_block_t cached;
+        if (cache_lookup(modules[i].mux_channel, modules[i].module_addr, FIELD_ALL, &cached))
+        {
+            if (infos)
+            {
+                infos[i] = cached;
+            }
+            if (results)
+            {
+                results[i] = ESP_OK;
+            }
+            continue;
+        }
+        stale[n_stale] = modules[i];
+        stale_index[n_stale] = i;
+        n_stale++;
+    }
+
+    return first_error;
+}
+
+// --- Invalidation and Statistics ---
+
+esp_err_t i2c_manager_get_cached_modules(i2c_channel_mask_t channel_mask, i2c_module_ref_t *modules, size_t capacity, size_t *count)
+{
+    if (count == NULL || (modules == NULL && capacity > 0))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t n = 0;
+    portENTER_CRITICAL(&cache_lock);
+    for (int i = 0; i < CACHE_ENTRIES && n < capacity; ++i)
+    {
+        if (entries[i].valid && (channel_mask & I2C_CHANNEL_BIT(entries[i].mux_channel)))
+        {
+            modules[n].mux_channel = entries[i].mux_channel;
+            modules[n].module_addr = entries[i].module_addr;
+            n++;
+        }
+    }
+    portEXIT_CRITICAL(&cache_lock);
+    *count = n;
+    return ESP_OK;
+}
+
+void i2c_manager_invalidate_module(uint8_t mux_channel, uint8_t module_addr)
+{
+    portENTER_CRITICAL(&cache_lock);
+    cache_entry_t *e = find_entry(mux_channel, module_addr);
+    if (e != NULL)
+    {
+        drop_entry(e);
+    }
+    portEXIT_CRITICAL(&cache_lock);
+    i2c_param_shadow_forget_module(mux_channel, module_addr);
+}
+
+void i2c_manager_invalidate_all_modules(void)
+{
+    portENTER_CRITICAL(&cache_lock);
+    for (int i = 0; i < CACHE_ENTRIES; ++i)
+    {
+        entries[i].valid = false;
+    }
+    stats.entries = 0;
+    portEXIT_CRITICAL(&cache_lock);
+    i2c_param_shadow_forget_all();
+    ESP_LOGD(TAG, "Module cache cleared");
+}
+
+void i2c_manager_get_module_cache_stats(i2c_module_cache_stats_t *out)
+{
+    if (out == NULL)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&cache_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&cache_lock);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// Internal: per-module cache of common register blocks. Fed by every block read
+// in i2c_master_control.c; the cached getters live in i2c_module_cache.c.
+
+#include "i2c_manager.h"
+
+// Record the outcome of one block read. block == NULL means the read failed: the
+// module may be gone or replaced, so its entry is dropped and identity re-read later.
+void i2c_module_cache_update(uint8_t mux_channel, uint8_t module_addr, const i2c_common_block_t *block);
+
+// Mark the status byte of every module on the given mux channels stale (after a broadcast)
+void i2c_module_cache_expire_status(i2c_channel_mask_t channel_mask);
@@ -0,0 +1,171 @@
+#include "i2c_mux_topology.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "I2C_MUX_TOPOLOGY";
+
+_Static_assert(MAX_I2C_MUX_CHANNELS <= 8, "A TCA9548A control register has one bit per channel");
+_Static_assert(I2C_MUX_COUNT >= 1 && I2C_MUX_COUNT <= I2C_MUX_MAX_COUNT, "Unsupported number of muxes");
+
+#define MUX_ADDRESS_FIRST 0x70
+#define MUX_ADDRESS_LAST 0x77
+#define MUX_STATE_UNKNOWN 0xFFFF // Outside the 8-bit register range, so the next plan always writes
+
+// --- State ---
+
+static i2c_mux_config_t topology[I2C_MUX_COUNT];
+static uint16_t mux_state[I2C_MUX_COUNT];                // Control register as last written
+static i2c_channel_mask_t path_mask[I2C_MUX_CHANNEL_COUNT]; // Channel plus every trunk channel above it
+static uint8_t rank_of[I2C_MUX_CHANNEL_COUNT];
+static uint8_t channel_at[I2C_MUX_CHANNEL_COUNT];
+
+// --- Setup ---
+
+static void visit(uint8_t mux, uint8_t *rank)
+{
+    for (uint8_t c = 0; c < MAX_I2C_MUX_CHANNELS; ++c)
+    {
+        uint8_t channel = mux * MAX_I2C_MUX_CHANNELS + c;
+        rank_of[channel] = *rank;
+        channel_at[(*rank)++] = channel;
+        for (uint8_t child = mux + 1; child < I2C_MUX_COUNT; ++child)
+        {
+            if (topology[child].parent_channel == channel)
+            {
+                visit(child, rank);
+            }
+        }
+    }
+}
+
+esp_err_t i2c_mux_topology_init(const i2c_mux_config_t *muxes)
+{
+    for (uint8_t m = 0; m < I2C_MUX_COUNT; ++m)
+    {
+        int parent = muxes[m].parent_channel;
+        if (muxes[m].address < MUX_ADDRESS_FIRST || muxes[m].address > MUX_ADDRESS_LAST)
+        {
+            ESP_LOGE(TAG, "Mux %d: address 0x%02X is not a TCA9548A address", m, muxes[m].address);
+            return ESP_ERR_INVALID_ARG;
+        }
+        // An upstream channel on an earlier mux keeps the tree acyclic and the index order topological
+        if (parent != I2C_MUX_ROOT && (parent < 0 || parent >= m * MAX_I2C_MUX_CHANNELS))
+        {
+            ESP_LOGE(TAG, "Mux %d: upstream channel %d is not on an earlier mux", m, parent);
+            return ESP_ERR_INVALID_ARG;
+        }
+        for (uint8_t k = 0; k < m; ++k)
+        {
+            if (muxes[k].address == muxes[m].address)
+            {
+                ESP_LOGE(TAG, "Muxes %d and %d both at 0x%02X", k, m, muxes[m].address);
+                return ESP_ERR_INVALID_ARG;
+            }
+        }
+    }
+
+    memcpy(topology, muxes, sizeof(topology));
+    for (uint8_t m = 0; m < I2C_MUX_COUNT; ++m)
+    {
+        int parent = topology[m].parent_channel;
+        for (uint8_t c = 0; c < MAX_I2C_MUX_CHANNELS; ++c)
+        {
+            uint8_t channel = m * MAX_I2C_MUX_CHANNELS + c;
+            path_mask[channel] = I2C_CHANNEL_BIT(channel) | (parent == I2C_MUX_ROOT ? 0 : path_mask[parent]);
+        }
+    }
+
+    uint8_t rank = 0;
+    for (uint8_t m = 0; m < I2C_MUX_COUNT; ++m)
+    {
+        if (topology[m].parent_channel == I2C_MUX_ROOT)
+        {
+            visit(m, &rank);
+        }
+    }
+
+    i2c_mux_topology_invalidate();
+    for (uint8_t m = 0; m < I2C_MUX_COUNT; ++m)
+    {
+        if (topology[m].parent_channel == I2C_MUX_ROOT)
+        {
+            ESP_LOGI(TAG, "Mux %d at 0x%02X: channels %d-%d on the main bus", m, topology[m].address,
+                     m * MAX_I2C_MUX_CHANNELS, (m + 1) * MAX_I2C_MUX_CHANNELS - 1);
+        }
+        else
+        {
+            ESP_LOGI(TAG, "Mux %d at 0x%02X: channels %d-%d behind channel %d", m, topology[m].address,
+                     m * MAX_I2C_MUX_CHANNELS, (m + 1) * MAX_I2C_MUX_CHANNELS - 1, topology[m].parent_channel);
+        }
+    }
+    return ESP_OK;
+}
+
+// --- Planning ---
+
+size_t i2c_mux_topology_plan(i2c_channel_mask_t channels, i2c_mux_write_t writes[I2C_MUX_COUNT])
+{
+    i2c_channel_mask_t needed = 0;
+    for (i2c_channel_mask_t rest = channels; rest; rest &= rest - 1)
+    {
+        needed |= path_mask[__builtin_ctzll(rest)];
+    }
+
+    size_t n = 0;
+    for (uint8_t m = 0; m < I2C_MUX_COUNT; ++m)
+    {
+        int parent = topology[m].parent_channel;
+        if (parent != I2C_MUX_ROOT && !(needed & I2C_CHANNEL_BIT(parent)))
+        {
+            continue; // Cut off from the bus by its parent
+        }
+        uint8_t want = (uint8_t)(needed >> (m * MAX_I2C_MUX_CHANNELS));
+        if (mux_state[m] != want)
+        {
+            writes[n++] = (i2c_mux_write_t){.mux = m, .value = want};
+        }
+    }
+    return n;
+}
+
+void i2c_mux_topology_record(const i2c_mux_write_t *write, bool ok)
+{
+    mux_state[write->mux] = ok ? write->value : MUX_STATE_UNKNOWN;
+}
+
+void i2c_mux_topology_invalidate(void)
+{
+    for (uint8_t m = 0; m < I2C_MUX_COUNT; ++m)
+    {
+        mux_state[m] = MUX_STATE_UNKNOWN;
+    }
+}
+
+// --- Lookups ---
+
+uint8_t i2c_mux_topology_address(uint8_t mux)
+{
+    return topology[mux].address;
+}
+
+bool i2c_mux_topology_is_mux(uint8_t address)
+{
+    for (uint8_t m = 0; m < I2C_MUX_COUNT; ++m)
+    {
+        if (topology[m].address == address)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t i2c_mux_topology_rank(uint8_t channel)
+{
+    return rank_of[channel];
+}
+
+uint8_t i2c_mux_topology_channel_at(uint8_t rank)
+{
+    return channel_at[rank];
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+// Internal: the mux tree and the control register each mux was last written with.
+// Pure bookkeeping: i2c_master_control.c issues the writes and reports every outcome
+// back, always under i2c_mutex, which therefore also protects this state.
+
+#include "i2c_manager.h"
+
+typedef struct
+{
+    uint8_t mux;   // Index into the topology
+    uint8_t value; // Control register value to write
+} i2c_mux_write_t;
+
+// Validate the topology (parents before children, addresses 0x70-0x77 and unique)
+// and forget every mux state, so the next selection writes each reachable mux.
+esp_err_t i2c_mux_topology_init(const i2c_mux_config_t *muxes);
+
+// The writes that connect exactly `channels` plus the trunk channels leading to them,
+// in issue order (a parent before the muxes behind it). Muxes already in the right
+// state are skipped, and so are muxes whose upstream channel stays disconnected: what
+// they have enabled is off the bus, and keeping it means returning to that branch
+// costs only the upstream write. Returns the number of writes.
+size_t i2c_mux_topology_plan(i2c_channel_mask_t channels, i2c_mux_write_t writes[I2C_MUX_COUNT]);
+
+// Outcome of one planned write; a failed write leaves that mux in an unknown state
+void i2c_mux_topology_record(const i2c_mux_write_t *write, bool ok);
+
+void i2c_mux_topology_invalidate(void);
+
+uint8_t i2c_mux_topology_address(uint8_t mux);
+bool i2c_mux_topology_is_mux(uint8_t address);
+
+// Depth-first order of the tree: a mux's channels are consecutive and each nested mux
+// follows its upstream channel, so walking channels by rank switches every mux as
+// rarely as possible.
+uint8_t i2c_mux_topology_rank(uint8_t channel);
+uint8_t i2c_mux_topology_channel_at(uint8_t rank);
@@ -0,0 +1,528 @@
+#include "i2c_param_shadow.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+static const char *TAG = "I2C_PARAM_SHADOW";
+
+#ifndef CONFIG_CENTRAL_I2C_PARAM_SHADOW_ENTRIES
+#define CONFIG_CENTRAL_I2C_PARAM_SHADOW_ENTRIES 64 // Only used when the shadow is disabled
+#endif
+
+#define SHADOW_CAPACITY CONFIG_CENTRAL_I2C_PARAM_SHADOW_ENTRIES
+#define KEY_EMPTY 0xFFFFFFFFu // Mux channel 0xFF never exists
+#define PARAM_PAIR_SIZE (sizeof(ParamId_t) + sizeof(ParamValue_t))
+#define MODULE_SLOTS (I2C_MUX_CHANNEL_COUNT << 7) // Every (channel, 7-bit address) pair
+
+_Static_assert(sizeof(ParamId_t) <= 2, "Keys pack the parameter ID into 16 bits");
+
+// The table is touched once per parameter write, which costs far more on the wire
+#define SHADOW_CAPS_PREFERRED (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define SHADOW_CAPS_FALLBACK (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+typedef enum
+{
+    SLOT_VALUE_KNOWN = 1 << 0, // `value` was ACKed by the module
+    SLOT_PENDING = 1 << 1,     // A new value is staged under `pending_seq` and applied by its commit
+} slot_flags_t;
+
+typedef struct
+{
+    uint32_t key; // Mux channel, module address, parameter ID
+    ParamValue_t value;
+    uint8_t flags;
+    uint8_t pending_seq;
+} shadow_slot_t;
+
+// --- State ---
+
+// Open addressing with linear probing, load factor <= 1/2; deletions shift the
+// rest of the cluster back, so lookups never need tombstones
+static shadow_slot_t *slots = NULL;
+static size_t slot_count = 0;
+static SemaphoreHandle_t shadow_mutex = NULL;
+
+// Modules that may have entries. Failed reads during a discovery scan forget every
+// absent address, and this keeps those from each scanning the whole table.
+static uint32_t module_bits[MODULE_SLOTS / 32];
+static i2c_param_shadow_stats_t stats = {0};
+static i2c_param_observer_t observer = NULL;
+
+// --- Keys ---
+
+static inline uint32_t make_key(uint8_t mux_channel, uint8_t module_addr, ParamId_t param_id)
+{
+    return (uint32_t)mux_channel << 24 | (uint32_t)module_addr << 16 | (uint32_t)param_id;
+}
+
+static inline uint8_t key_channel(uint32_t key)
+{
+    return (uint8_t)(key >> 24);
+}
+
+static inline uint16_t key_module(uint32_t key)
+{
+    return (uint16_t)(key >> 16);
+}
+
+static inline size_t key_module_slot(uint32_t key)
+{
+    return ((size_t)key_channel(key) << 7) | ((key >> 16) & 0x7F);
+}
+
+static inline ParamId_t key_param(uint32_t key)
+{
+    return (ParamId_t)(key & 0xFFFF);
+}
+
+static inline size_t key_home(uint32_t key)
+{
+    uint32_t h = key * 0x9E3779B1u;
+    return (h ^ (h >> 15)) & (slot_count - 1);
+}
+
+// --- Table (shadow_mutex held) ---
+
+// Slot holding the key, or the empty slot where it would go
+static size_t find_slot(uint32_t key)
+{
+    size_t i = key_home(key);
+    while (slots[i].key != KEY_EMPTY && slots[i].key != key)
+    {
+        i = (i + 1) & (slot_count - 1);
+    }
+    return i;
+}
+
+static shadow_slot_t *lookup(uint32_t key)
+{
+    shadow_slot_t *s = &slots[find_slot(key)];
+    return s->key == key ? s : NULL;
+}
+
+// Existing or new slot for the key; NULL when the table is full
+static shadow_slot_t *insert(uint32_t key)
+{
+    shadow_slot_t *s = &slots[find_slot(key)];
+    if (s->key == key)
+    {
+        return s;
+    }
+    if (stats.entries >= SHADOW_CAPACITY)
+    {
+        stats.untracked++;
+        return NULL;
+    }
+    *s = (shadow_slot_t){.key = key};
+    stats.entries++;
+    size_t m = key_module_slot(key);
+    module_bits[m / 32] |= 1u << (m % 32);
+    return s;
+}
+
+static void remove_at(size_t hole)
+{
+    size_t mask = slot_count - 1;
+    for (size_t i = (hole + 1) & mask; slots[i].key != KEY_EMPTY; i = (i + 1) & mask)
+    {
+        // Move the entry back unless its home lies cyclically in (hole, i]
+        size_t home = key_home(slots[i].key);
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            slots[hole] = slots[i];
+            hole = i;
+        }
+    }
+    slots[hole].key = KEY_EMPTY;
+    stats.entries--;
+}
+
+typedef bool (*slot_visitor_t)(shadow_slot_t *slot, const void *arg); // Returns true to remove the slot
+
+// Full scan; only invalidations and commits take it, and those are rare next to writes
+static void visit_all(slot_visitor_t visit, const void *arg)
+{
+    for (size_t i = 0; i < slot_count;)
+    {
+        if (slots[i].key != KEY_EMPTY && visit(&slots[i], arg))
+        {
+            remove_at(i); // Re-examine slot i: the shift may have moved an unvisited entry into it
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+// --- Visitors ---
+
+typedef struct
+{
+    i2c_channel_mask_t channel_mask;
+    uint16_t module;
+    ParamId_t param_id;
+    uint8_t seq;
+} visit_arg_t;
+
+static bool visit_module(shadow_slot_t *s, const void *arg)
+{
+    return key_module(s->key) == ((const visit_arg_t *)arg)->module;
+}
+
+static bool visit_channels(shadow_slot_t *s, const void *arg)
+{
+    return (((const visit_arg_t *)arg)->channel_mask & I2C_CHANNEL_BIT(key_channel(s->key))) != 0;
+}
+
+static bool visit_channel_param(shadow_slot_t *s, const void *arg)
+{
+    const visit_arg_t *a = arg;
+    if (!visit_channels(s, arg) || key_param(s->key) != a->param_id)
+    {
+        return false;
+    }
+    // A pending value is still applied by its commit; only the current value is unknown
+    s->flags &= ~SLOT_VALUE_KNOWN;
+    return s->flags == 0;
+}
+
+static bool visit_commit(shadow_slot_t *s, const void *arg)
+{
+    const visit_arg_t *a = arg;
+    if ((s->flags & SLOT_PENDING) && visit_channels(s, arg))
+    {
+        // The ACK only proves some module applied its set, so the staged value cannot be
+        // trusted; a stale sequence number is dropped by the module and changes nothing
+        if (s->pending_seq == a->seq)
+        {
+            s->flags &= ~SLOT_VALUE_KNOWN;
+        }
+        s->flags &= ~SLOT_PENDING;
+    }
+    return s->flags == 0;
+}
+
+static bool visit_discard(shadow_slot_t *s, const void *arg)
+{
+    if ((s->flags & SLOT_PENDING) && visit_channels(s, arg))
+    {
+        s->flags &= ~SLOT_PENDING;
+    }
+    return s->flags == 0;
+}
+
+static void forget_module_locked(uint8_t mux_channel, uint8_t module_addr)
+{
+    uint32_t key = make_key(mux_channel, module_addr, 0);
+    size_t m = key_module_slot(key);
+    if (mux_channel >= I2C_MUX_CHANNEL_COUNT || !(module_bits[m / 32] & (1u << (m % 32))))
+    {
+        return;
+    }
+    module_bits[m / 32] &= ~(1u << (m % 32));
+
+    visit_arg_t arg = {.module = key_module(key)};
+    visit_all(visit_module, &arg);
+    stats.invalidations++;
+}
+
+// --- Lifecycle ---
+
+void i2c_param_shadow_init(void)
+{
+#if CONFIG_CENTRAL_I2C_PARAM_SHADOW_ENABLE
+    if (slots != NULL)
+    {
+        return;
+    }
+
+    size_t count = 2;
+    while (count < 2 * SHADOW_CAPACITY)
+    {
+        count <<= 1;
+    }
+    shadow_slot_t *table = heap_caps_malloc(count * sizeof(shadow_slot_t), SHADOW_CAPS_PREFERRED);
+    if (table == NULL)
+    {
+        table = heap_caps_malloc(count * sizeof(shadow_slot_t), SHADOW_CAPS_FALLBACK);
+    }
+    shadow_mutex = xSemaphoreCreateMutex();
+    if (table == NULL || shadow_mutex == NULL)
+    {
+        // Not fatal: every write is sent, as without the shadow
+        ESP_LOGW(TAG, "No memory for the parameter shadow; redundant writes will be sent");
+        heap_caps_free(table);
+        if (shadow_mutex)
+        {
+            vSemaphoreDelete(shadow_mutex);
+            shadow_mutex = NULL;
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        table[i].key = KEY_EMPTY;
+    }
+    slot_count = count;
+    stats.capacity = SHADOW_CAPACITY;
+    __atomic_store_n(&slots, table, __ATOMIC_RELEASE);
+    ESP_LOGI(TAG, "Parameter shadow ready: %d entries (%d bytes)", SHADOW_CAPACITY, count * sizeof(shadow_slot_t));
+#endif
+}
+
+// --- Filtering ---
+
+bool i2c_param_shadow_filter(uint8_t mux_channel, uint8_t module_addr, uint8_t command, const void **data,
+                             size_t *len, uint8_t scratch[I2C_MANAGER_MAX_QUEUED_PAYLOAD])
+{
+    if (__atomic_load_n(&slots, __ATOMIC_ACQUIRE) == NULL)
+    {
+        return true;
+    }
+
+    // Parameter pairs start after the count byte of a bulk frame
+    const uint8_t *in = *data;
+    size_t head = command == CMD_SET_PARAM_BULK ? 1 : 0;
+    size_t pairs = command == CMD_SET_PARAM_BULK ? (*len > 0 ? in[0] : 0) : 1;
+    if (*len != head + pairs * PARAM_PAIR_SIZE || *len > I2C_MANAGER_MAX_QUEUED_PAYLOAD || pairs == 0)
+    {
+        return true; // Not a frame we understand; send it as is
+    }
+
+    xSemaphoreTake(shadow_mutex, portMAX_DELAY);
+    size_t out_len = 1;
+    size_t kept = 0;
+    for (size_t i = 0; i < pairs; ++i)
+    {
+        const uint8_t *pair = in + head + i * PARAM_PAIR_SIZE;
+        ParamId_t param_id;
+        ParamValue_t value;
+        memcpy(&param_id, pair, sizeof(ParamId_t));
+        memcpy(&value, pair + sizeof(ParamId_t), sizeof(ParamValue_t));
+
+        const shadow_slot_t *s = lookup(make_key(mux_channel, module_addr, param_id));
+        if (s != NULL && (s->flags & SLOT_VALUE_KNOWN) && s->value == value)
+        {
+            continue;
+        }
+        memcpy(&scratch[out_len], pair, PARAM_PAIR_SIZE);
+        out_len += PARAM_PAIR_SIZE;
+        kept++;
+    }
+
+    stats.frames_checked++;
+    stats.params_checked += pairs;
+    stats.params_dropped += pairs - kept;
+    if (kept == 0)
+    {
+        stats.frames_dropped++;
+        stats.bytes_saved += 1 + *len;
+    }
+    else if (kept < pairs)
+    {
+        // Only bulk frames carry several pairs: still one transaction, just shorter
+        scratch[0] = (uint8_t)kept;
+        stats.bytes_saved += *len - out_len;
+        *data = scratch;
+        *len = out_len;
+    }
+    xSemaphoreGive(shadow_mutex);
+    return kept > 0;
+}
+
+// --- Outcomes ---
+
+// Parameter pairs in a frame. CMD_SET_PARAM: (id, value); CMD_SET_PARAM_BULK: count, pairs;
+// CMD_STAGE_PARAM_BULK: seq, count, pairs. False if the length does not match.
+static bool frame_pairs(uint8_t command, const uint8_t *in, size_t len, size_t *head, size_t *pairs)
+{
+    *head = command == CMD_STAGE_PARAM_BULK ? 2 : (command == CMD_SET_PARAM_BULK ? 1 : 0);
+    *pairs = *head > 0 ? (len >= *head ? in[*head - 1] : 0) : 1;
+    return len == *head + *pairs * PARAM_PAIR_SIZE;
+}
+
+static void read_pair(const uint8_t *in, size_t head, size_t i, ParamId_t *param_id, ParamValue_t *value)
+{
+    const uint8_t *pair = in + head + i * PARAM_PAIR_SIZE;
+    memcpy(param_id, pair, sizeof(ParamId_t));
+    memcpy(value, pair + sizeof(ParamId_t), sizeof(ParamValue_t));
+}
+
+void i2c_param_shadow_report(uint8_t mux_channel, uint8_t module_addr, ParamId_t param_id, ParamValue_t value)
+{
+    i2c_param_observer_t fn = __atomic_load_n(&observer, __ATOMIC_ACQUIRE);
+    if (fn)
+    {
+        fn(mux_channel, module_addr, param_id, value);
+    }
+}
+
+void i2c_param_shadow_record_write(uint8_t mux_channel, uint8_t module_addr, uint8_t command, const void *data,
+                                   size_t len, esp_err_t result, bool report)
+{
+    bool sets = command == CMD_SET_PARAM || command == CMD_SET_PARAM_BULK;
+    size_t head, pairs;
+    if (report && result == ESP_OK && sets && frame_pairs(command, data, len, &head, &pairs))
+    {
+        for (size_t i = 0; i < pairs; ++i)
+        {
+            ParamId_t param_id;
+            ParamValue_t value;
+            read_pair(data, head, i, &param_id, &value);
+            i2c_param_shadow_report(mux_channel, module_addr, param_id, value);
+        }
+    }
+
+    if (__atomic_load_n(&slots, __ATOMIC_ACQUIRE) == NULL)
+    {
+        return;
+    }
+    bool stages = command == CMD_STAGE_PARAM_BULK;
+    if (result == ESP_OK && !sets && !stages && command != CMD_COMMON_RESET)
+    {
+        return; // Other commands do not touch parameters
+    }
+
+    xSemaphoreTake(shadow_mutex, portMAX_DELAY);
+    if (result != ESP_OK || command == CMD_COMMON_RESET)
+    {
+        // A failed frame may have been half taken, or the module may have reset
+        forget_module_locked(mux_channel, module_addr);
+        xSemaphoreGive(shadow_mutex);
+        return;
+    }
+
+    const uint8_t *in = data;
+    if (!frame_pairs(command, in, len, &head, &pairs))
+    {
+        forget_module_locked(mux_channel, module_addr); // Malformed: whatever the module made of it is unknown
+        xSemaphoreGive(shadow_mutex);
+        return;
+    }
+
+    for (size_t i = 0; i < pairs; ++i)
+    {
+        ParamId_t param_id;
+        ParamValue_t value;
+        read_pair(in, head, i, &param_id, &value);
+
+        shadow_slot_t *s = insert(make_key(mux_channel, module_addr, param_id));
+        if (s == NULL)
+        {
+            continue;
+        }
+        if (stages)
+        {
+            s->pending_seq = in[0]; // The current value stays in effect until the commit
+            s->flags |= SLOT_PENDING;
+        }
+        else
+        {
+            s->value = value;
+            s->flags |= SLOT_VALUE_KNOWN;
+        }
+    }
+    xSemaphoreGive(shadow_mutex);
+}
+
+void i2c_param_shadow_record_broadcast(i2c_channel_mask_t channel_mask, uint8_t command, const void *data,
+                                       size_t len, esp_err_t result)
+{
+    if (__atomic_load_n(&slots, __ATOMIC_ACQUIRE) == NULL)
+    {
+        return;
+    }
+
+    visit_arg_t arg = {.channel_mask = channel_mask};
+    slot_visitor_t visit = NULL;
+    if (command == CMD_SET_PARAM && len == PARAM_PAIR_SIZE)
+    {
+        memcpy(&arg.param_id, data, sizeof(ParamId_t));
+        visit = visit_channel_param;
+    }
+    else if (command == CMD_SET_PARAM || command == CMD_SET_PARAM_BULK || command == CMD_COMMON_RESET)
+    {
+        visit = visit_channels;
+    }
+    else if (command == CMD_COMMIT_STAGED && result == ESP_OK && len == 1)
+    {
+        // A NACKed commit reached no module at all; a discard follows it
+        arg.seq = *(const uint8_t *)data;
+        visit = visit_commit;
+    }
+    else if (command == CMD_DISCARD_STAGED)
+    {
+        visit = visit_discard;
+    }
+    if (visit == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(shadow_mutex, portMAX_DELAY);
+    visit_all(visit, &arg);
+    if (visit == visit_channels)
+    {
+        stats.invalidations++;
+    }
+    xSemaphoreGive(shadow_mutex);
+}
+
+// --- Invalidation ---
+
+void i2c_param_shadow_forget_module(uint8_t mux_channel, uint8_t module_addr)
+{
+    if (__atomic_load_n(&slots, __ATOMIC_ACQUIRE) == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(shadow_mutex, portMAX_DELAY);
+    forget_module_locked(mux_channel, module_addr);
+    xSemaphoreGive(shadow_mutex);
+}
+
+void i2c_param_shadow_forget_all(void)
+{
+    if (__atomic_load_n(&slots, __ATOMIC_ACQUIRE) == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(shadow_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < slot_count; ++i)
+    {
+        slots[i].key = KEY_EMPTY;
+    }
+    memset(module_bits, 0, sizeof(module_bits));
+    stats.entries = 0;
+    stats.invalidations++;
+    xSemaphoreGive(shadow_mutex);
+}
+
+// --- Public API ---
+
+void i2c_manager_set_param_observer(i2c_param_observer_t fn)
+{
+    __atomic_store_n(&observer, fn, __ATOMIC_RELEASE);
+}
+
+// --- Statistics ---
+
+void i2c_manager_get_param_shadow_stats(i2c_param_shadow_stats_t *out)
+{
+    if (out == NULL)
+    {
+        return;
+    }
+    if (__atomic_load_n(&slots, __ATOMIC_ACQUIRE) == NULL)
+    {
+        *out = stats;
+        return;
+    }
+    xSemaphoreTake(shadow_mutex, portMAX_DELAY);
+    *out = stats;
+    xSemaphoreGive(shadow_mutex);
+}
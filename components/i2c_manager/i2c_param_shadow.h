@@ -0,0 +1,41 @@
+#pragma once
+
+// Internal: the last value each module acknowledged for each parameter, so that
+// parameter writes which would not change anything never reach the bus.
+// i2c_master_control.c consults it under i2c_mutex right before a transaction and
+// reports every outcome back, so a value is only trusted once the module has ACKed
+// it, and the check sees the module state in exactly the order writes hit the wire.
+// The table has its own lock for invalidations from other tasks.
+
+#include "i2c_manager.h"
+
+// Allocate the table (no-op when CONFIG_CENTRAL_I2C_PARAM_SHADOW_ENABLE is off,
+// in which case every write is sent)
+void i2c_param_shadow_init(void);
+
+// For CMD_SET_PARAM and CMD_SET_PARAM_BULK frames: drop the parameters the module
+// already holds. Returns false if nothing is left to send. If only some are dropped,
+// *data and *len are pointed at a rebuilt bulk frame in `scratch`.
+bool i2c_param_shadow_filter(uint8_t mux_channel, uint8_t module_addr, uint8_t command, const void **data,
+                             size_t *len, uint8_t scratch[I2C_MANAGER_MAX_QUEUED_PAYLOAD]);
+
+// Outcome of a unicast frame (sent after filtering). ACKed parameter writes are
+// recorded, and reported to the parameter observer if `report`; staged writes are marked pending
+// (the current value holds until their commit); a reset or any failed transaction
+// makes the module's entries unknown.
+void i2c_param_shadow_record_write(uint8_t mux_channel, uint8_t module_addr, uint8_t command, const void *data,
+                                   size_t len, esp_err_t result, bool report);
+
+// Outcome of a broadcast. The wired-AND ACK does not prove every module took the
+// frame, so broadcast parameter writes, resets and commits only ever forget entries
+// (a commit, those staged under its sequence number). The next write of each such
+// parameter is sent and recorded again.
+void i2c_param_shadow_record_broadcast(i2c_channel_mask_t channel_mask, uint8_t command, const void *data,
+                                       size_t len, esp_err_t result);
+
+// A parameter value the module has taken outside a unicast write (a committed stage):
+// passed on to the i2c_manager_set_param_observer() observer
+void i2c_param_shadow_report(uint8_t mux_channel, uint8_t module_addr, ParamId_t param_id, ParamValue_t value);
+
+void i2c_param_shadow_forget_module(uint8_t mux_channel, uint8_t module_addr);
+void i2c_param_shadow_forget_all(void);
@@ -0,0 +1,252 @@
+#include "i2c_stage.h"
+#include "i2c_mux_topology.h"
+#include "i2c_param_shadow.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h" // For the commit mutex
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "I2C_STAGE";
+
+#define STAGE_CAPS_PREFERRED (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define STAGE_CAPS_FALLBACK (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+// --- State ---
+// A module holds one pending set, so staging for two commits at once would mix them.
+// Commits are serialized by a mutex created on first use.
+
+static SemaphoreHandle_t commit_mutex = NULL;
+static uint8_t next_seq = 1;
+
+static SemaphoreHandle_t get_commit_mutex(void)
+{
+    SemaphoreHandle_t m = __atomic_load_n(&commit_mutex, __ATOMIC_ACQUIRE);
+    if (m != NULL)
+    {
+        return m;
+    }
+
+    SemaphoreHandle_t created = xSemaphoreCreateMutex();
+    if (created == NULL)
+    {
+        return NULL;
+    }
+    SemaphoreHandle_t expected = NULL;
+    if (__atomic_compare_exchange_n(&commit_mutex, &expected, created, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+        return created;
+    }
+    vSemaphoreDelete(created); // Another task won the race
+    return expected;
+}
+
+// --- Stage Building ---
+
+esp_err_t i2c_stage_init(i2c_stage_t *stage, size_t capacity)
+{
+    if (stage == NULL || capacity == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    stage->params = heap_caps_malloc(capacity * sizeof(i2c_staged_param_t), STAGE_CAPS_PREFERRED);
+    if (stage->params == NULL)
+    {
+        stage->params = heap_caps_malloc(capacity * sizeof(i2c_staged_param_t), STAGE_CAPS_FALLBACK);
+    }
+    if (stage->params == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate stage for %d parameters", capacity);
+        stage->capacity = 0;
+        stage->count = 0;
+        return ESP_ERR_NO_MEM;
+    }
+    stage->capacity = capacity;
+    stage->count = 0;
+    return ESP_OK;
+}
+
+void i2c_stage_free(i2c_stage_t *stage)
+{
+    if (stage == NULL)
+    {
+        return;
+    }
+    heap_caps_free(stage->params);
+    stage->params = NULL;
+    stage->capacity = 0;
+    stage->count = 0;
+}
+
+void i2c_stage_clear(i2c_stage_t *stage)
+{
+    if (stage != NULL)
+    {
+        stage->count = 0;
+    }
+}
+
+esp_err_t i2c_stage_set_param(i2c_stage_t *stage, uint8_t mux_channel, uint8_t module_addr,
+                              ParamId_t param_id, ParamValue_t value)
+{
+    if (stage == NULL || stage->params == NULL || mux_channel >= I2C_MUX_CHANNEL_COUNT)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (size_t i = 0; i < stage->count; ++i)
+    {
+        i2c_staged_param_t *p = &stage->params[i];
+        if (p->mux_channel == mux_channel && p->module_addr == module_addr && p->param_id == param_id)
+        {
+            p->value = value; // Last write wins, as it would on the wire
+            return ESP_OK;
+        }
+    }
+
+    if (stage->count >= stage->capacity)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    stage->params[stage->count++] = (i2c_staged_param_t){
+        .mux_channel = mux_channel,
+        .module_addr = module_addr,
+        .param_id = param_id,
+        .value = value,
+    };
+    return ESP_OK;
+}
+
+// --- Commit ---
+
+static int compare_by_module(const void *a, const void *b)
+{
+    const i2c_staged_param_t *pa = a;
+    const i2c_staged_param_t *pb = b;
+    if (pa->mux_channel != pb->mux_channel)
+    {
+        // Tree order: each mux is switched once on the way through the scene
+        return i2c_mux_topology_rank(pa->mux_channel) - i2c_mux_topology_rank(pb->mux_channel);
+    }
+    return pa->module_addr - pb->module_addr;
+}
+
+// Send params[0..count) (all for one module) as CMD_STAGE_PARAM_BULK frames
+static esp_err_t send_pending_set(const i2c_staged_param_t *params, size_t count, uint8_t seq, uint16_t *frames)
+{
+    uint8_t payload[2 + I2C_MANAGER_MAX_BULK_PARAMS * (sizeof(ParamId_t) + sizeof(ParamValue_t))];
+
+    for (size_t done = 0; done < count;)
+    {
+        size_t n = count - done < I2C_MANAGER_MAX_BULK_PARAMS ? count - done : I2C_MANAGER_MAX_BULK_PARAMS;
+        size_t len = 0;
+        payload[len++] = seq;
+        payload[len++] = (uint8_t)n;
+        for (size_t i = 0; i < n; ++i)
+        {
+            memcpy(&payload[len], &params[done + i].param_id, sizeof(ParamId_t));
+            len += sizeof(ParamId_t);
+            memcpy(&payload[len], &params[done + i].value, sizeof(ParamValue_t));
+            len += sizeof(ParamValue_t);
+        }
+
+        esp_err_t ret = i2c_manager_send_command(params[0].mux_channel, params[0].module_addr,
+                                                 CMD_STAGE_PARAM_BULK, payload, len);
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+        (*frames)++;
+        done += n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_stage_commit(i2c_stage_t *stage, i2c_stage_result_t *result)
+{
+    if (stage == NULL || stage->params == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (stage->count == 0)
+    {
+        return ESP_OK;
+    }
+
+    SemaphoreHandle_t mutex = get_commit_mutex();
+    if (mutex == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    i2c_stage_result_t r = {.seq = next_seq++};
+    esp_err_t ret = ESP_OK;
+
+    // Group by module (and modules by channel in tree order, which keeps mux switches to one per channel)
+    qsort(stage->params, stage->count, sizeof(i2c_staged_param_t), compare_by_module);
+
+    // 1. Pending sets: nothing changes audibly yet
+    int64_t t0 = esp_timer_get_time();
+    for (size_t first = 0; first < stage->count;)
+    {
+        size_t end = first + 1;
+        while (end < stage->count && compare_by_module(&stage->params[first], &stage->params[end]) == 0)
+        {
+            end++;
+        }
+
+        r.channel_mask |= I2C_CHANNEL_BIT(stage->params[first].mux_channel);
+        ret = send_pending_set(&stage->params[first], end - first, r.seq, &r.frames);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Staging to 0x%02X on MUX %d failed: %s, discarding scene",
+                     stage->params[first].module_addr, stage->params[first].mux_channel, esp_err_to_name(ret));
+            break;
+        }
+        r.modules++;
+        first = end;
+    }
+
+    // 2. One broadcast applies every pending set at the same audio frame
+    int64_t t1 = esp_timer_get_time();
+    if (ret == ESP_OK)
+    {
+        ret = i2c_manager_broadcast(r.channel_mask, CMD_COMMIT_STAGED, &r.seq, 1);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Commit broadcast for seq %d failed: %s", r.seq, esp_err_to_name(ret));
+        }
+    }
+    int64_t t2 = esp_timer_get_time();
+
+    if (ret != ESP_OK)
+    {
+        // Best effort: modules that did get a pending set must not apply it with a later commit
+        i2c_manager_broadcast(r.channel_mask, CMD_DISCARD_STAGED, NULL, 0);
+    }
+    else
+    {
+        ESP_LOGD(TAG, "Committed seq %d: %d params on %d modules (%d frames), staged in %lu us, commit %lu us",
+                 r.seq, stage->count, r.modules, r.frames, (unsigned long)(t1 - t0), (unsigned long)(t2 - t1));
+        for (size_t i = 0; i < stage->count; ++i)
+        {
+            const i2c_staged_param_t *p = &stage->params[i];
+            i2c_param_shadow_report(p->mux_channel, p->module_addr, p->param_id, p->value);
+        }
+        stage->count = 0;
+    }
+
+    xSemaphoreGive(mutex);
+
+    r.stage_us = (uint32_t)(t1 - t0);
+    r.commit_us = (uint32_t)(t2 - t1);
+    if (result)
+    {
+        *result = r;
+    }
+    return ret;
+}
@@ -0,0 +1,243 @@
+#include "i2c_trace.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h" // For esp_ptr_external_ram
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "I2C_TRACE";
+
+#ifndef CONFIG_CENTRAL_I2C_TRACE_RECORDS_LOG2
+#define CONFIG_CENTRAL_I2C_TRACE_RECORDS_LOG2 8 // Only used when tracing is disabled
+#endif
+
+#define TRACE_CAPACITY (1u << CONFIG_CENTRAL_I2C_TRACE_RECORDS_LOG2)
+#define TRACE_MASK (TRACE_CAPACITY - 1)
+#define DUMP_CHUNK_RECORDS 32 // Records copied to the stack per write_fn call
+
+_Static_assert(sizeof(i2c_trace_record_t) == 16, "trace records must stay 16 bytes");
+_Static_assert(sizeof(i2c_trace_header_t) == 24, "trace header layout is part of the dump format");
+_Static_assert(CONFIG_CENTRAL_I2C_TRACE_RECORDS_LOG2 <= 16, "seq holds the low 16 bits of the index");
+
+// --- State ---
+// Writers reserve a slot with one atomic increment of `head`, then fill it
+// seqlock-style: seq is set to ~index first and to index last, so a reader
+// that sees the same matching seq before and after copying has a whole record.
+
+static i2c_trace_record_t *ring = NULL;
+static uint32_t head = 0; // Next record index (monotonic, wraps at 2^32)
+static volatile bool trace_enabled = false;
+
+// --- Recording ---
+
+// Task context only: the ring is in PSRAM, so this cannot run with the cache disabled
+void i2c_trace_record(i2c_trace_op_t op, uint8_t mux_channel, uint8_t address, uint8_t command, size_t length,
+                      esp_err_t result, int64_t start_us)
+{
+    if (!trace_enabled)
+    {
+        return;
+    }
+
+    int64_t duration = esp_timer_get_time() - start_us;
+    uint32_t idx = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+    i2c_trace_record_t *r = &ring[idx & TRACE_MASK];
+
+    r->seq = (uint16_t)~idx;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    r->timestamp_us = (uint32_t)start_us;
+    r->duration_us = duration > UINT16_MAX ? UINT16_MAX : (uint16_t)duration;
+    r->mux_channel = mux_channel;
+    r->address = address;
+    r->command = command;
+    r->op = (uint8_t)op;
+    r->length = length > UINT16_MAX ? UINT16_MAX : (uint16_t)length;
+    r->result = (result >= INT16_MIN && result <= INT16_MAX) ? (int16_t)result : (int16_t)ESP_FAIL;
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->seq = (uint16_t)idx;
+}
+
+// --- Control ---
+
+esp_err_t i2c_trace_init(void)
+{
+#if CONFIG_CENTRAL_I2C_TRACE_ENABLE
+    if (ring != NULL)
+    {
+        return ESP_OK;
+    }
+
+    ring = heap_caps_calloc(TRACE_CAPACITY, sizeof(i2c_trace_record_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (ring == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate %u-record trace ring in PSRAM, tracing disabled", TRACE_CAPACITY);
+        return ESP_ERR_NO_MEM;
+    }
+
+    __atomic_store_n(&head, 0, __ATOMIC_RELAXED);
+    trace_enabled = true;
+    ESP_LOGI(TAG, "I2C trace ring: %u records (%u KB)", TRACE_CAPACITY,
+             (unsigned)(TRACE_CAPACITY * sizeof(i2c_trace_record_t) / 1024));
+#endif
+    return ESP_OK;
+}
+
+void i2c_trace_set_enabled(bool enabled)
+{
+    trace_enabled = enabled && ring != NULL;
+}
+
+void i2c_trace_clear(void)
+{
+    __atomic_store_n(&head, 0, __ATOMIC_RELAXED);
+}
+
+void i2c_trace_get_stats(i2c_trace_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+    stats->recorded = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    stats->capacity = ring ? TRACE_CAPACITY : 0;
+    stats->enabled = trace_enabled;
+    stats->in_psram = ring != NULL && esp_ptr_external_ram(ring);
+}
+
+// --- Export ---
+
+esp_err_t i2c_trace_dump(i2c_trace_write_fn_t write_fn, void *ctx)
+{
+    if (ring == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (write_fn == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool was_enabled = trace_enabled;
+    trace_enabled = false; // Writers already past the check can still land; seq catches them
+
+    uint32_t end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    uint32_t count = end < TRACE_CAPACITY ? end : TRACE_CAPACITY;
+    uint32_t first = end - count;
+
+    i2c_trace_header_t header = {
+        .magic = I2C_TRACE_MAGIC,
+        .version = I2C_TRACE_VERSION,
+        .record_size = sizeof(i2c_trace_record_t),
+        .reserved = 0,
+        .first_index = first,
+        .record_count = count,
+        .dump_time_us = (uint64_t)esp_timer_get_time(),
+    };
+    esp_err_t ret = write_fn(&header, sizeof(header), ctx);
+
+    i2c_trace_record_t chunk[DUMP_CHUNK_RECORDS];
+    uint32_t lost = 0;
+    for (uint32_t done = 0; ret == ESP_OK && done < count;)
+    {
+        uint32_t n = count - done < DUMP_CHUNK_RECORDS ? count - done : DUMP_CHUNK_RECORDS;
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            uint32_t idx = first + done + i;
+            const i2c_trace_record_t *src = &ring[idx & TRACE_MASK];
+            uint16_t seq_before = __atomic_load_n(&src->seq, __ATOMIC_ACQUIRE);
+            chunk[i] = *src;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            uint16_t seq_after = __atomic_load_n(&src->seq, __ATOMIC_RELAXED);
+            if (seq_before != (uint16_t)idx || seq_after != seq_before)
+            {
+                memset(&chunk[i], 0, sizeof(chunk[i])); // op = I2C_TRACE_OP_LOST
+                chunk[i].seq = (uint16_t)idx;
+                lost++;
+            }
+        }
+        ret = write_fn(chunk, n * sizeof(i2c_trace_record_t), ctx);
+        done += n;
+    }
+
+    trace_enabled = was_enabled;
+
+    if (lost > 0)
+    {
+        ESP_LOGW(TAG, "%lu records were overwritten during the dump", (unsigned long)lost);
+    }
+    return ret;
+}
+
+static esp_err_t console_hex_writer(const void *data, size_t len, void *ctx)
+{
+    static const char hex[] = "0123456789abcdef";
+    const uint8_t *p = data;
+    char line[5 + 2 * 32 + 1];
+
+    while (len > 0)
+    {
+        size_t n = len < 32 ? len : 32;
+        memcpy(line, "I2CT ", 5);
+        for (size_t i = 0; i < n; ++i)
+        {
+            line[5 + 2 * i] = hex[p[i] >> 4];
+            line[6 + 2 * i] = hex[p[i] & 0x0F];
+        }
+        line[5 + 2 * n] = '\0';
+        puts(line);
+        p += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_trace_dump_console(void)
+{
+    if (ring == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    puts("I2CT BEGIN");
+    esp_err_t ret = i2c_trace_dump(console_hex_writer, NULL);
+    puts("I2CT END");
+    fflush(stdout);
+    return ret;
+}
+
+// --- Benchmark ---
+
+esp_err_t i2c_trace_benchmark(uint32_t iterations, float *ns_per_record)
+{
+    if (ring == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (iterations == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool was_enabled = trace_enabled;
+    trace_enabled = true;
+
+    int64_t t0 = esp_timer_get_time();
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        i2c_trace_record(I2C_TRACE_OP_WRITE, i & 7, 0x40, 0x10, 9, ESP_OK, t0);
+    }
+    int64_t elapsed = esp_timer_get_time() - t0;
+
+    trace_enabled = was_enabled;
+    i2c_trace_clear();
+
+    float ns = (float)elapsed * 1000.0f / (float)iterations;
+    ESP_LOGI(TAG, "Benchmark: %lu records, %.1f ns/record", (unsigned long)iterations, ns);
+    if (ns_per_record)
+    {
+        *ns_per_record = ns;
+    }
+    return ESP_OK;
+}
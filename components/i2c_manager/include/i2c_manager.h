@@ -6,12 +6,84 @@
 #include <stdbool.h>
 #include <stddef.h>            // For size_t
 #include "freertos/FreeRTOS.h" // For TickType_t
+#include "synth_constants.h"   // For MAX_I2C_MUX_CHANNELS
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+    // --- Protocol Extensions ---
+    // Commands used by the controller that are not (yet) part of module_i2c_proto.
+    // The proto header wins if it defines them.
+
+#ifndef CMD_SET_PARAM_BULK
+#define CMD_SET_PARAM_BULK 0x1F // Payload: count, then count x (ParamId_t, ParamValue_t)
+#endif
+
+#ifndef CMD_SET_PARAM
+#define CMD_SET_PARAM 0x10 // Payload: ParamId_t, ParamValue_t
+#endif
+
+#ifndef CMD_SET_I2S_CONFIG
+#define CMD_SET_I2S_CONFIG 0x11 // Payload: I2sConfig_t
+#endif
+
+// Staged writes (see i2c_stage.h): parameters are held as pending by the module
+// until a CMD_COMMIT_STAGED broadcast with the same sequence number applies them
+// all at the next audio frame boundary.
+#ifndef CMD_STAGE_PARAM_BULK
+#define CMD_STAGE_PARAM_BULK 0x1E // Payload: seq, count, then count x (ParamId_t, ParamValue_t)
+#endif
+
+#ifndef CMD_COMMIT_STAGED
+#define CMD_COMMIT_STAGED 0x1D // Payload: seq. Applies the pending set staged under seq
+#endif
+
+#ifndef CMD_DISCARD_STAGED
+#define CMD_DISCARD_STAGED 0x1C // No payload. Drops any pending set
+#endif
+
+// Common register block: module type, firmware version (little-endian) and status
+// are consecutive registers, so one write-read with register auto-increment
+// starting at COMMON_REG_BLOCK_START returns all of them.
+#ifndef COMMON_REG_BLOCK_START
+#define COMMON_REG_BLOCK_START 0x00
+#endif
+
+#define I2C_COMMON_BLOCK_OFFSET_TYPE 0
+#define I2C_COMMON_BLOCK_OFFSET_FW_VERSION (I2C_COMMON_BLOCK_OFFSET_TYPE + sizeof(ModuleType_t))
+#define I2C_COMMON_BLOCK_OFFSET_STATUS (I2C_COMMON_BLOCK_OFFSET_FW_VERSION + sizeof(uint16_t))
+#define I2C_COMMON_BLOCK_SIZE (I2C_COMMON_BLOCK_OFFSET_STATUS + sizeof(uint8_t))
+
+// --- Mux Topology ---
+// Up to I2C_MUX_MAX_COUNT TCA9548A muxes, side by side on the main bus or cascaded
+// behind a channel of another mux. Modules are addressed by a flat channel number:
+// channel c of mux m is m * MAX_I2C_MUX_CHANNELS + c, so eight muxes give 64 channels.
+// Channel masks have bit n for flat channel n. A channel that leads to a nested mux
+// is enabled whenever a channel behind it is, so modules on it also see that traffic.
+
+#define I2C_MUX_MAX_COUNT 8 // TCA9548A address straps: 0x70-0x77
+#define I2C_MUX_COUNT CONFIG_CENTRAL_I2C_MUX_COUNT
+#define I2C_MUX_CHANNEL_COUNT (I2C_MUX_COUNT * MAX_I2C_MUX_CHANNELS) // Flat channels in this build
+#define I2C_MUX_ROOT (-1)                                            // parent_channel of a mux on the main bus
+
+#define I2C_CHANNEL_BIT(channel) ((i2c_channel_mask_t)1 << (channel))
+#define I2C_MUX_ALL_CHANNELS (~(i2c_channel_mask_t)0 >> (64 - I2C_MUX_CHANNEL_COUNT)) // Channel mask for a whole rack
+
+#define I2C_MANAGER_MAX_BULK_PARAMS 16 // Max parameters per CMD_SET_PARAM_BULK frame
+
+// Largest payload a queued request can carry (a full CMD_SET_PARAM_BULK frame)
+#define I2C_MANAGER_MAX_QUEUED_PAYLOAD (1 + I2C_MANAGER_MAX_BULK_PARAMS * (sizeof(ParamId_t) + sizeof(ParamValue_t)))
+
+    typedef uint64_t i2c_channel_mask_t;
+
+    typedef struct
+    {
+        uint8_t address;       // 7-bit address of the mux (0x70-0x77)
+        int8_t parent_channel; // Flat channel of an earlier mux this one hangs off, or I2C_MUX_ROOT
+    } i2c_mux_config_t;
+
     // --- Configuration ---
 
     typedef struct
@@ -20,18 +92,55 @@ extern "C"
         int sda_io_num;              // GPIO number for SDA
         int scl_io_num;              // GPIO number for SCL
         uint32_t clk_speed;          // I2C clock speed (e.g., 100000 for 100kHz, 400000 for 400kHz)
-        uint8_t tca9548a_addr;       // I2C address of the TCA9548A mux itself
+        i2c_mux_config_t muxes[I2C_MUX_COUNT]; // Mux topology, index order = flat channel order
         size_t task_stack_size;      // Stack size for the dedicated I2C manager task
         UBaseType_t task_priority;   // Priority for the I2C manager task
         int task_core_id;            // Core to pin the task to (0, 1, or tskNO_AFFINITY)
-        uint32_t command_queue_size; // Max number of outstanding I2C requests
+        uint32_t command_queue_size; // Outstanding requests per producer task (rounded up to a power of two)
     } i2c_manager_config_t;
 
+    // --- Hand-off Statistics ---
+
+    // Admission priority of a producer task's queued requests
+    typedef enum
+    {
+        I2C_PRIORITY_NORMAL = 0, // Deferred only when over its source or module budget
+        I2C_PRIORITY_LOW,        // Also deferred while the bus is oversubscribed; stale, overwritten parameter writes are shed
+    } i2c_producer_priority_t;
+
+    typedef struct
+    {
+        const char *task_name;   // Producer task
+        uint32_t sent;           // Requests executed by the bus task
+        uint32_t dropped;        // Requests rejected because the ring was full
+        uint32_t failed;         // Requests whose bus transaction failed
+        uint32_t queued;         // Requests currently waiting
+        uint32_t max_latency_us; // Longest time from queueing to the start of the transaction
+        uint32_t deferred;       // Requests held back at least once by admission control
+        uint32_t shed;           // Requests dropped by admission control
+        uint16_t load_permille;  // Estimated bus time used over the budget window (1000 = whole bus)
+        i2c_producer_priority_t priority;
+    } i2c_producer_stats_t;
+
+    // --- Bus Load ---
+
+    typedef struct
+    {
+        uint16_t bus_permille;       // Estimated bus time used over the window (1000 = saturated)
+        bool oversubscribed;         // bus_permille above CONFIG_CENTRAL_I2C_OVERSUBSCRIBED_PCT
+        uint32_t window_ms;          // CONFIG_CENTRAL_I2C_BUDGET_WINDOW_MS
+        uint32_t deferred;           // Requests held back at least once, all producers
+        uint32_t shed;               // Requests dropped, all producers
+        uint8_t busiest_mux_channel; // Module with the most bus time in the window
+        uint8_t busiest_module_addr;
+        uint16_t busiest_permille;   // 0 if no module was addressed in the window
+    } i2c_bus_load_t;
+
     // --- Discovered Module Info ---
 
     typedef struct
     {
-        uint8_t mux_channel;      // Mux channel (0-7) where module was found
+        uint8_t mux_channel;      // Flat mux channel where module was found
         uint8_t i2c_address;      // Slave address (0x08-0x77) of the module
         ModuleType_t module_type; // Type reported by the module
         uint16_t fw_version;      // Firmware version reported by the module
@@ -40,6 +149,44 @@ extern "C"
         bool present; // Flag indicating if module responded during last scan
     } discovered_module_t;
 
+    // --- Common Register Snapshots ---
+
+    typedef struct
+    {
+        uint8_t mux_channel; // Flat mux channel
+        uint8_t module_addr; // 7-bit slave address
+    } i2c_module_ref_t;
+
+    // Decoded common register block of one module
+    typedef struct
+    {
+        ModuleType_t module_type;
+        uint16_t fw_version;
+        uint8_t status;
+    } i2c_common_block_t;
+
+    typedef struct
+    {
+        uint32_t hits;      // Field requests answered from the cache
+        uint32_t misses;    // Field requests that needed a bus read
+        uint32_t bus_reads; // Block reads issued (each is one transaction)
+        uint32_t evictions; // Entries replaced because the cache was full
+        uint32_t entries;   // Modules currently cached
+    } i2c_module_cache_stats_t;
+
+    typedef struct
+    {
+        uint32_t frames_checked; // CMD_SET_PARAM / CMD_SET_PARAM_BULK frames looked up
+        uint32_t frames_dropped; // Frames not sent because every parameter was already held (transactions saved)
+        uint32_t params_checked; // Parameters in the checked frames
+        uint32_t params_dropped; // Parameters removed from frames, including those of dropped frames
+        uint32_t bytes_saved;    // Frame bytes not sent
+        uint32_t invalidations;  // Modules or channels forgotten (reset, failed transaction, rediscovery)
+        uint32_t untracked;      // Acknowledged writes not recorded because the shadow was full
+        uint32_t entries;        // Parameters currently shadowed
+        uint32_t capacity;       // CONFIG_CENTRAL_I2C_PARAM_SHADOW_ENTRIES (0 if disabled)
+    } i2c_param_shadow_stats_t;
+
     // --- Initialization / Deinitialization ---
 
     /**
@@ -63,11 +210,15 @@ extern "C"
     // --- Asynchronous Write/Command Functions (Queue-based) ---
     // These functions queue a request and return quickly. The actual I2C operation
     // happens later in the dedicated task. They return ESP_OK if successfully queued.
+    // Each calling task gets its own lock-free single-producer ring on first use
+    // (up to CONFIG_CENTRAL_I2C_MAX_PRODUCERS tasks), so producers never contend with
+    // each other or with the bus task. Requests from one task are sent in order.
+    // Task context only; not callable from ISRs.
 
     /**
      * @brief Queue a request to set a parameter on a specific module.
      *
-     * @param mux_channel The mux channel (0-7) the module is on.
+     * @param mux_channel The flat mux channel the module is on.
      * @param module_addr The I2C slave address of the module.
      * @param param_id The parameter to set (ParamId_t).
      * @param value The value to set the parameter to (ParamValue_t).
@@ -78,7 +229,7 @@ extern "C"
     /**
      * @brief Queue a request to configure I2S slots for a specific module.
      *
-     * @param mux_channel The mux channel (0-7).
+     * @param mux_channel The flat mux channel.
      * @param module_addr The I2C slave address.
      * @param config The I2S configuration data.
      * @return ESP_OK if the request was successfully queued, ESP_FAIL or ESP_ERR_TIMEOUT if queue is full.
@@ -88,13 +239,193 @@ extern "C"
     /**
      * @brief Queue a request to send a simple command (no payload) to a module.
      *
-     * @param mux_channel The mux channel (0-7).
+     * @param mux_channel The flat mux channel.
      * @param module_addr The I2C slave address.
      * @param command The command byte (e.g., CMD_COMMON_RESET).
      * @return ESP_OK if the request was successfully queued, ESP_FAIL or ESP_ERR_TIMEOUT if queue is full.
      */
     esp_err_t i2c_manager_queue_send_command(uint8_t mux_channel, uint8_t module_addr, uint8_t command);
 
+    /**
+     * @brief Queue a broadcast frame (see i2c_manager_broadcast()). It is sent in order with
+     * the calling task's other queued requests.
+     *
+     * @return ESP_OK if queued, ESP_ERR_INVALID_ARG for an empty mask or oversized payload,
+     *         ESP_ERR_TIMEOUT if the ring is full.
+     */
+    esp_err_t i2c_manager_queue_broadcast(i2c_channel_mask_t channel_mask, uint8_t command_id, const void *data, size_t data_len);
+
+    /**
+     * @brief Queue a CMD_SET_PARAM_BULK frame (see i2c_manager_send_param_block()).
+     *
+     * @return ESP_OK if queued, ESP_ERR_INVALID_ARG if count is out of range, ESP_ERR_TIMEOUT if the ring is full.
+     */
+    esp_err_t i2c_manager_queue_param_block(uint8_t mux_channel, uint8_t module_addr,
+                                            const ParamId_t *param_ids, const ParamValue_t *values, size_t count);
+
+    /**
+     * @brief Hand-off statistics for every producer task that has queued a request.
+     *
+     * @param[out] stats Buffer for one entry per producer.
+     * @param capacity Entries in stats.
+     * @param[out] count Number of entries written.
+     */
+    esp_err_t i2c_manager_get_producer_stats(i2c_producer_stats_t *stats, size_t capacity, size_t *count);
+
+    /**
+     * @brief Reset the per-producer counters and maximum latency.
+     */
+    void i2c_manager_reset_producer_stats(void);
+
+    // --- Admission Control ---
+    // Every transaction's bus time is estimated from its byte count and the SCL
+    // frequency and accounted over a sliding window of CONFIG_CENTRAL_I2C_BUDGET_WINDOW_MS,
+    // for the bus as a whole, per module and per producer task. Before the bus task
+    // runs a queued request it checks the producer's and the target module's budgets
+    // (CONFIG_CENTRAL_I2C_SOURCE_BUDGET_PCT / CONFIG_CENTRAL_I2C_MODULE_BUDGET_PCT of
+    // the window); a request that would exceed either stays queued until the window
+    // moves on, as does the rest of that producer's ring, so its order is kept. While
+    // the bus is oversubscribed, low-priority producers are deferred as well. Their
+    // parameter writes older than CONFIG_CENTRAL_I2C_SHED_AGE_MS are dropped if newer
+    // writes queued behind them by the same task cover every parameter, to the same
+    // target; otherwise they wait like any other request. Blocking calls are never
+    // deferred but count towards bus and module load.
+
+    /**
+     * @brief Set the admission priority of the calling task's queued requests.
+     * Claims the task's producer ring if it has none yet.
+     *
+     * @return ESP_OK, ESP_ERR_INVALID_ARG for an unknown priority, ESP_ERR_INVALID_STATE
+     *         if the manager is not running, ESP_ERR_NO_MEM if every producer slot is taken.
+     */
+    esp_err_t i2c_manager_set_producer_priority(i2c_producer_priority_t priority);
+
+    /**
+     * @brief Choose whether the calling task's queued parameter writes are passed to the
+     * parameter observer (they are by default). A modulation source turns this off, so the
+     * observer keeps the values set by hand rather than following every modulated step.
+     * Claims the task's producer ring if it has none yet.
+     *
+     * @return ESP_OK, ESP_ERR_INVALID_STATE if the manager is not running, ESP_ERR_NO_MEM
+     *         if every producer slot is taken.
+     */
+    esp_err_t i2c_manager_set_producer_reported(bool reported);
+
+    /**
+     * @brief Current bus utilisation and admission counters, e.g. for a UI load meter
+     * that warns before queued requests start to lag.
+     */
+    esp_err_t i2c_manager_get_bus_load(i2c_bus_load_t *load);
+
+    // --- Direct Bus Access (Blocking) ---
+    // These perform the transaction in the caller's context under the internal mutex.
+
+    /**
+     * @brief Connect one flat mux channel, and the trunk channels leading to it (Blocking).
+     * Only muxes whose control register has to change are written: none when the channel
+     * is already selected, one when switching within a mux.
+     *
+     * @param channel The flat mux channel (below I2C_MUX_CHANNEL_COUNT).
+     * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a bad channel, or an I2C error code.
+     */
+    esp_err_t i2c_manager_select_mux_channel(uint8_t channel);
+
+    /**
+     * @brief Enable any combination of flat mux channels at once, across muxes (Blocking).
+     * As with i2c_manager_select_mux_channel(), only muxes that change are written.
+     *
+     * @param channel_mask Bit n enables flat channel n (0 disconnects all downstream buses).
+     * @return ESP_OK on success, ESP_ERR_INVALID_ARG for bits beyond I2C_MUX_CHANNEL_COUNT, or an I2C error code.
+     */
+    esp_err_t i2c_manager_select_mux_mask(i2c_channel_mask_t channel_mask);
+
+    /**
+     * @brief Send a command byte followed by an optional payload to a module (Blocking).
+     *
+     * @param mux_channel The flat mux channel.
+     * @param module_address The I2C slave address.
+     * @param command_id The command byte.
+     * @param data Optional payload appended after the command byte (may be NULL).
+     * @param data_len Length of the payload in bytes.
+     * @return ESP_OK on success, or an I2C error code.
+     */
+    esp_err_t i2c_manager_send_command(uint8_t mux_channel, uint8_t module_address, uint8_t command_id, const void *data, size_t data_len);
+
+    /**
+     * @brief Read raw data from a module, optionally writing a request/register byte first (Blocking).
+     *
+     * @param mux_channel The flat mux channel.
+     * @param module_address The I2C slave address.
+     * @param request_id Register or request byte written before the read phase.
+     * @param write_request_id If true, request_id is written before reading (repeated start).
+     * @param[out] buffer Buffer receiving the data.
+     * @param buffer_len Number of bytes to read.
+     * @param[out] bytes_read Number of bytes actually read.
+     * @return ESP_OK on success, or an I2C error code.
+     */
+    esp_err_t i2c_manager_read_data(uint8_t mux_channel, uint8_t module_address, uint8_t request_id,
+                                    bool write_request_id, void *buffer, size_t buffer_len, size_t *bytes_read);
+
+    /**
+     * @brief Probe for an ACK from an address on mux channel 0 (Blocking).
+     *
+     * @param device_address The 7-bit address to probe.
+     * @return ESP_OK if the device ACKed, ESP_ERR_NOT_FOUND otherwise.
+     */
+    esp_err_t i2c_manager_probe_device(uint8_t device_address);
+
+    /**
+     * @brief Probe for an ACK from an address on a specific mux channel (Blocking).
+     *
+     * @param mux_channel The flat mux channel.
+     * @param device_address The 7-bit address to probe.
+     * @return ESP_OK if the device ACKed, ESP_ERR_NOT_FOUND otherwise.
+     */
+    esp_err_t i2c_manager_probe_device_on_channel(uint8_t mux_channel, uint8_t device_address);
+
+    /**
+     * @brief Write several parameters to one module in a single I2C transaction (Blocking).
+     *
+     * Frame layout: CMD_SET_PARAM_BULK, count, then count x (ParamId_t, ParamValue_t).
+     * Used by batched producers (e.g. the modulation engine) so a module receiving
+     * several changed parameters in one control tick costs one bus transaction.
+     *
+     * @param mux_channel The flat mux channel.
+     * @param module_addr The I2C slave address.
+     * @param param_ids Array of parameter IDs.
+     * @param values Array of values, same length as param_ids.
+     * @param count Number of parameters (1..I2C_MANAGER_MAX_BULK_PARAMS).
+     * @return ESP_OK on success, ESP_ERR_INVALID_ARG if count is out of range, or an I2C error code.
+     */
+    esp_err_t i2c_manager_send_param_block(uint8_t mux_channel, uint8_t module_addr,
+                                           const ParamId_t *param_ids, const ParamValue_t *values, size_t count);
+
+    // --- Broadcast (Blocking) ---
+    // For global settings (sample rate, clock sync, CMD_COMMON_RESET): every channel in the
+    // mask is enabled at once, on every mux it spans, and a single frame goes to
+    // CONFIG_CENTRAL_I2C_BROADCAST_ADDRESS (the general call address by default), so a
+    // whole rack costs one transaction.
+    // The ACK is wired-AND: ESP_OK only proves that at least one module took the frame.
+    // To confirm each module, follow up from a low-priority task with
+    // i2c_manager_get_cached_modules() + i2c_manager_read_common_blocks(); the broadcast
+    // has already marked their cached status stale.
+
+    /**
+     * @brief Send one command frame to every module on the selected mux channels.
+     *
+     * @param channel_mask Mux channels to reach (e.g. I2C_MUX_ALL_CHANNELS).
+     * @param command_id The command byte.
+     * @param data Optional payload (up to I2C_MANAGER_MAX_QUEUED_PAYLOAD bytes).
+     * @param data_len Payload length.
+     * @return ESP_OK if the frame was ACKed, ESP_ERR_INVALID_ARG, or an I2C error code.
+     */
+    esp_err_t i2c_manager_broadcast(i2c_channel_mask_t channel_mask, uint8_t command_id, const void *data, size_t data_len);
+
+    /**
+     * @brief Broadcast a CMD_SET_PARAM frame (same payload as i2c_manager_queue_set_param()).
+     */
+    esp_err_t i2c_manager_broadcast_param(i2c_channel_mask_t channel_mask, ParamId_t param_id, ParamValue_t value);
+
     // --- Synchronous Read Functions (Blocking) ---
     // These functions perform the I2C read operation directly (within the caller's context,
     // but internally they might signal the I2C task or use a mutex for bus access).
@@ -104,7 +435,7 @@ extern "C"
      * @brief Read a common register from a specific module (Blocking).
      * Handles mux switching, write-read sequence, and uses internal mutex for bus access.
      *
-     * @param mux_channel The mux channel (0-7).
+     * @param mux_channel The flat mux channel.
      * @param module_addr The I2C slave address.
      * @param reg_addr The common register address to read (CommonReadRegAddr_t).
      * @param[out] buffer Pointer to store the read data.
@@ -114,10 +445,43 @@ extern "C"
      */
     esp_err_t i2c_manager_read_common_reg(uint8_t mux_channel, uint8_t module_addr, uint8_t reg_addr, uint8_t *buffer, size_t read_size, TickType_t timeout_ticks);
 
-    // --- Convenience Read Functions (Wrappers around i2c_manager_read_common_reg) ---
+    /**
+     * @brief Read the whole common register block of one module in a single write-read
+     * transaction (Blocking). The result also refreshes the module cache.
+     *
+     * @param mux_channel Mux channel.
+     * @param module_addr Slave address.
+     * @param[out] block Decoded register block.
+     * @param timeout_ticks Max time to wait for the bus mutex.
+     * @return ESP_OK on success, ESP_ERR_TIMEOUT if the bus is busy, or an I2C error code.
+     */
+    esp_err_t i2c_manager_read_common_block(uint8_t mux_channel, uint8_t module_addr, i2c_common_block_t *block, TickType_t timeout_ticks);
+
+    /**
+     * @brief Read the common register block of many modules back to back under one
+     * mutex hold (Blocking). Modules are visited grouped by mux channel, so each channel
+     * is selected at most once. Every result also refreshes the module cache.
+     *
+     * @param modules Modules to read.
+     * @param count Number of entries in modules.
+     * @param[out] blocks One decoded block per module (entries for failed reads are untouched).
+     * @param[out] results Optional per-module result (may be NULL).
+     * @param timeout_ticks Max time to wait for the bus mutex.
+     * @return ESP_OK if every read succeeded, ESP_ERR_TIMEOUT if the mutex was not acquired,
+     *         otherwise the first per-module error.
+     */
+    esp_err_t i2c_manager_read_common_blocks(const i2c_module_ref_t *modules, size_t count,
+                                             i2c_common_block_t *blocks, esp_err_t *results, TickType_t timeout_ticks);
+
+    // --- Cached Module Info ---
+    // Answers come from a per-module cache filled by common block reads. Each field has
+    // its own TTL: type and firmware version stay valid while the module keeps answering
+    // (CONFIG_CENTRAL_I2C_IDENTITY_TTL_MS, 0 = no expiry), the status byte for
+    // CONFIG_CENTRAL_I2C_STATUS_TTL_MS. A stale field costs one block read, which
+    // refreshes all fields; a failed read drops the entry.
 
     /**
-     * @brief Get the module type (Blocking).
+     * @brief Get the module type (Blocking on a cache miss).
      *
      * @param mux_channel Mux channel.
      * @param module_addr Slave address.
@@ -128,7 +492,7 @@ extern "C"
     esp_err_t i2c_manager_get_module_type(uint8_t mux_channel, uint8_t module_addr, ModuleType_t *module_type, TickType_t timeout_ticks);
 
     /**
-     * @brief Get the module status byte (Blocking).
+     * @brief Get the module status byte (Blocking on a cache miss).
      *
      * @param mux_channel Mux channel.
      * @param module_addr Slave address.
@@ -139,7 +503,7 @@ extern "C"
     esp_err_t i2c_manager_get_status(uint8_t mux_channel, uint8_t module_addr, uint8_t *status, TickType_t timeout_ticks);
 
     /**
-     * @brief Get the module firmware version (Blocking).
+     * @brief Get the module firmware version (Blocking on a cache miss).
      *
      * @param mux_channel Mux channel.
      * @param module_addr Slave address.
@@ -149,11 +513,92 @@ extern "C"
      */
     esp_err_t i2c_manager_get_fw_version(uint8_t mux_channel, uint8_t module_addr, uint16_t *version, TickType_t timeout_ticks);
 
+    /**
+     * @brief Get all common fields of a module, reading the bus only if any field is stale.
+     *
+     * @param[out] info Decoded block.
+     * @return ESP_OK on success, or the error of the refreshing read.
+     */
+    esp_err_t i2c_manager_get_module_info(uint8_t mux_channel, uint8_t module_addr, i2c_common_block_t *info, TickType_t timeout_ticks);
+
+    /**
+     * @brief Bring the cache up to date for a set of modules (e.g. one UI page) with one
+     * block read per module that has a stale field, issued back to back. Modules that are
+     * fully fresh cost nothing.
+     *
+     * @param[out] infos Optional: current info per module (entries for failed reads are untouched).
+     * @param[out] results Optional: per-module result.
+     * @return ESP_OK if every module is now cached, otherwise the first error.
+     */
+    esp_err_t i2c_manager_refresh_modules(const i2c_module_ref_t *modules, size_t count,
+                                          i2c_common_block_t *infos, esp_err_t *results, TickType_t timeout_ticks);
+
+    /**
+     * @brief List the cached (i.e. recently answering) modules on the given mux channels.
+     *
+     * @param channel_mask Mux channels to include.
+     * @param[out] modules Buffer for the module references.
+     * @param capacity Entries in modules.
+     * @param[out] count Number of entries written.
+     */
+    esp_err_t i2c_manager_get_cached_modules(i2c_channel_mask_t channel_mask, i2c_module_ref_t *modules, size_t capacity, size_t *count);
+
+    /**
+     * @brief Drop the cached entry and the shadowed parameter values of one module (e.g.
+     * after sending it CMD_COMMON_RESET, or when it was swapped).
+     */
+    void i2c_manager_invalidate_module(uint8_t mux_channel, uint8_t module_addr);
+
+    /**
+     * @brief Drop every cached entry and every shadowed parameter value.
+     */
+    void i2c_manager_invalidate_all_modules(void);
+
+    void i2c_manager_get_module_cache_stats(i2c_module_cache_stats_t *stats);
+
+    // --- Redundant Write Elimination ---
+    // The manager keeps the last value each module acknowledged for each parameter
+    // (CONFIG_CENTRAL_I2C_PARAM_SHADOW_ENABLE). Right before a CMD_SET_PARAM or
+    // CMD_SET_PARAM_BULK frame goes out, queued or direct, parameters the module already
+    // holds are removed; a frame with nothing left is not sent and still returns ESP_OK.
+    // The check runs under the bus mutex in the order frames reach the wire, so it never
+    // reorders writes. A module's values are forgotten when it is reset (CMD_COMMON_RESET,
+    // i2c_manager_invalidate_module()), when a transaction with it fails, and on
+    // discovery. Modules whose state changes by other means (front-panel controls,
+    // power cycling without a failed read) must be invalidated by the caller.
+
+    /**
+     * @brief Counters of the redundant write check (cumulative since boot).
+     */
+    void i2c_manager_get_param_shadow_stats(i2c_param_shadow_stats_t *stats);
+
+    // --- Acknowledged Parameter Values ---
+
+    /**
+     * @brief Receives every parameter value a module has taken: each parameter of an
+     * acknowledged unicast CMD_SET_PARAM / CMD_SET_PARAM_BULK frame (queued or direct, from
+     * any task, except those queued by a task that called i2c_manager_set_producer_reported(false)),
+     * and each parameter of a scene applied by i2c_stage_commit(). Parameters
+     * removed by the redundant write check were reported when the module first took them.
+     * Broadcast parameter writes are not reported, as they do not name a module.
+     * May be called with the bus mutex held: must be quick and must not call back into the manager.
+     */
+    typedef void (*i2c_param_observer_t)(uint8_t mux_channel, uint8_t module_addr, ParamId_t param_id,
+                                         ParamValue_t value);
+
+    /**
+     * @brief Install the observer (NULL removes it). Works whether or not the redundant write
+     * check is enabled.
+     */
+    void i2c_manager_set_param_observer(i2c_param_observer_t observer);
+
     // --- Discovery ---
 
     /**
-     * @brief Scans the I2C bus (all mux channels, specified addresses) for modules (Blocking).
-     * This operation takes time. It uses the internal mutex for bus access during scans.
+     * @brief Scans the I2C bus (all flat mux channels in tree order, specified addresses) for modules (Blocking).
+     * Each candidate costs one common block read, which doubles as the presence probe and
+     * fills the module cache. The internal mutex is released between mux channels.
+     * Shadowed parameter values are forgotten first: the rack may have changed.
      *
      * @param[out] found_modules_buffer Buffer to store details of found modules.
      * @param buffer_capacity Max number of modules the buffer can hold.
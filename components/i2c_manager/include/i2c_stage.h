@@ -0,0 +1,84 @@
+#pragma once
+
+#include "i2c_manager.h"
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // --- Staged Scene Changes ---
+    // Collect parameter changes for any number of modules, then make them audible all at
+    // once. i2c_stage_commit() first sends each module its changes as CMD_STAGE_PARAM_BULK
+    // frames, which the module holds as pending, then one CMD_COMMIT_STAGED broadcast makes
+    // every module apply its pending set at the same audio frame. Staging costs bus time in
+    // proportion to the number of changes but changes nothing audible; the commit is a
+    // single transaction whatever the size of the scene.
+
+    typedef struct
+    {
+        uint8_t mux_channel;
+        uint8_t module_addr;
+        ParamId_t param_id;
+        ParamValue_t value;
+    } i2c_staged_param_t;
+
+    // Caller-owned set of pending changes. Not thread-safe; fill it from one task.
+    typedef struct
+    {
+        i2c_staged_param_t *params;
+        size_t count;
+        size_t capacity;
+    } i2c_stage_t;
+
+    typedef struct
+    {
+        i2c_channel_mask_t channel_mask; // Mux channels the commit was broadcast to
+        uint8_t seq;                     // Sequence number the pending sets were staged under
+        uint16_t modules;                // Modules that received a pending set
+        uint16_t frames;                 // CMD_STAGE_PARAM_BULK frames sent
+        uint32_t stage_us;               // Time spent sending pending sets (inaudible)
+        uint32_t commit_us;              // Duration of the commit broadcast
+    } i2c_stage_result_t;
+
+    /**
+     * @brief Allocate storage for up to `capacity` staged parameters (PSRAM if available).
+     *
+     * @return ESP_OK, ESP_ERR_INVALID_ARG, or ESP_ERR_NO_MEM.
+     */
+    esp_err_t i2c_stage_init(i2c_stage_t *stage, size_t capacity);
+
+    void i2c_stage_free(i2c_stage_t *stage);
+
+    /**
+     * @brief Drop all staged parameters (nothing is sent).
+     */
+    void i2c_stage_clear(i2c_stage_t *stage);
+
+    /**
+     * @brief Add a change to the stage. Staging the same parameter of the same module again
+     * replaces the earlier value. Nothing is sent until i2c_stage_commit().
+     *
+     * @return ESP_OK, or ESP_ERR_NO_MEM if the stage is full.
+     */
+    esp_err_t i2c_stage_set_param(i2c_stage_t *stage, uint8_t mux_channel, uint8_t module_addr,
+                                  ParamId_t param_id, ParamValue_t value);
+
+    /**
+     * @brief Send every module its pending set, then broadcast the commit (Blocking).
+     * Commits from different tasks are serialized. If any pending set cannot be delivered,
+     * CMD_DISCARD_STAGED is broadcast instead and no module applies anything.
+     * On success the stage is cleared; on failure it is kept for a retry.
+     *
+     * @param[out] result Optional timing and size of the commit.
+     * @return ESP_OK, or the error of the failed stage frame or commit broadcast.
+     */
+    esp_err_t i2c_stage_commit(i2c_stage_t *stage, i2c_stage_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // --- Trace Format ---
+    // Every bus transaction issued by the I2C manager is appended to a ring of
+    // fixed 16-byte records in PSRAM. A dump is a header followed by records in
+    // recording order; tools/i2c_trace_decode.py turns it into a timeline and
+    // per-module statistics. All fields are little-endian.
+
+#define I2C_TRACE_MAGIC 0x54433249u // "I2CT"
+#define I2C_TRACE_VERSION 1
+
+    typedef enum
+    {
+        I2C_TRACE_OP_LOST = 0,       // Slot was being overwritten while dumping; ignore
+        I2C_TRACE_OP_MUX_SELECT = 1, // Write to a TCA9548A control register (address says which mux)
+        I2C_TRACE_OP_WRITE = 2,      // Command (+ payload) write to a module
+        I2C_TRACE_OP_READ = 3,       // Read without a write phase
+        I2C_TRACE_OP_WRITE_READ = 4, // Request byte write followed by a read
+        I2C_TRACE_OP_PROBE = 5,      // Zero-length address probe
+        I2C_TRACE_OP_BROADCAST = 6,  // Write to the broadcast address; mux_channel holds the channel mask (0xFF beyond channel 7)
+    } i2c_trace_op_t;
+
+#define I2C_TRACE_MUX_MULTI 0xFF // mux_channel of a MUX_SELECT enabling several (or no) channels
+
+    // Naturally aligned (no padding), so the recorder writes whole words
+    typedef struct
+    {
+        uint32_t timestamp_us; // Transaction start, low 32 bits of esp_timer_get_time()
+        uint16_t duration_us;  // Saturates at 0xFFFF
+        uint16_t seq;          // Low 16 bits of the record index (detects torn records)
+        uint8_t mux_channel;
+        uint8_t address; // 7-bit device address
+        uint8_t command; // Command or request byte, 0 if none
+        uint8_t op;      // i2c_trace_op_t
+        uint16_t length; // Bytes transferred (excluding the address byte)
+        int16_t result;  // esp_err_t, clamped to int16
+    } i2c_trace_record_t;
+
+    typedef struct
+    {
+        uint32_t magic;        // I2C_TRACE_MAGIC
+        uint8_t version;       // I2C_TRACE_VERSION
+        uint8_t record_size;   // sizeof(i2c_trace_record_t)
+        uint16_t reserved;
+        uint32_t first_index;  // Index of the first record in the dump
+        uint32_t record_count; // Records following the header
+        uint64_t dump_time_us; // esp_timer_get_time() when the dump started, to unwrap timestamps
+    } i2c_trace_header_t;
+
+    /**
+     * @brief Sink for i2c_trace_dump(). Called with consecutive chunks of the dump.
+     */
+    typedef esp_err_t (*i2c_trace_write_fn_t)(const void *data, size_t len, void *ctx);
+
+    typedef struct
+    {
+        uint32_t recorded; // Records written since init or the last clear
+        uint32_t capacity; // Ring size in records
+        bool enabled;
+        bool in_psram;
+    } i2c_trace_stats_t;
+
+    // --- Control ---
+
+    /**
+     * @brief Allocate the trace ring. Called by i2c_manager_init(); safe to call again.
+     *
+     * @return ESP_OK, or ESP_ERR_NO_MEM (tracing then stays off).
+     */
+    esp_err_t i2c_trace_init(void);
+
+    /**
+     * @brief Start or pause recording. Recording is on after init.
+     */
+    void i2c_trace_set_enabled(bool enabled);
+
+    /**
+     * @brief Discard all records.
+     */
+    void i2c_trace_clear(void);
+
+    void i2c_trace_get_stats(i2c_trace_stats_t *stats);
+
+    // --- Recording ---
+
+    /**
+     * @brief Append one transaction. Lock-free and safe from any task; costs one
+     * atomic increment, one timer read and a 16-byte store.
+     *
+     * @param start_us esp_timer_get_time() taken just before the transaction.
+     */
+    void i2c_trace_record(i2c_trace_op_t op, uint8_t mux_channel, uint8_t address, uint8_t command,
+                          size_t length, esp_err_t result, int64_t start_us);
+
+    // --- Export ---
+
+    /**
+     * @brief Stream the ring (header + records, oldest first) to a sink, e.g. a USB CDC
+     * or file writer. Recording is paused for the duration of the dump.
+     *
+     * @return ESP_OK, ESP_ERR_INVALID_STATE if not initialized, or the first error from write_fn.
+     */
+    esp_err_t i2c_trace_dump(i2c_trace_write_fn_t write_fn, void *ctx);
+
+    /**
+     * @brief Dump to the console as hex lines framed by "I2CT BEGIN" / "I2CT END",
+     * which tools/i2c_trace_decode.py can read straight from a captured serial log.
+     */
+    esp_err_t i2c_trace_dump_console(void);
+
+    /**
+     * @brief Measure the cost of i2c_trace_record() and log it.
+     *
+     * @param iterations Number of records to write (the ring is cleared afterwards).
+     * @param ns_per_record Optional output: average cost in nanoseconds.
+     */
+    esp_err_t i2c_trace_benchmark(uint32_t iterations, float *ns_per_record);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,89 @@
+#include "encoder_accel.h"
+#include <string.h>
+
+#define IDLE_RESET_US 250000 // A pause this long starts a new gesture at 1x
+
+void encoder_accel_init(encoder_accel_t *a, const encoder_accel_params_t *params)
+{
+    memset(a, 0, sizeof(*a));
+    a->p = *params;
+    if (a->p.counts_per_detent == 0)
+    {
+        a->p.counts_per_detent = 1;
+    }
+    if (a->p.accel_max_mult == 0)
+    {
+        a->p.accel_max_mult = 1;
+    }
+    a->last_detent_us = INT64_MIN / 2;
+    a->last_emit_us = INT64_MIN / 2;
+}
+
+// Multiplier for a speed, x ENCODER_ACCEL_ONE, linear between the two thresholds
+static uint32_t multiplier_for(const encoder_accel_params_t *p, uint32_t rate_dps)
+{
+    uint32_t max = (uint32_t)p->accel_max_mult * ENCODER_ACCEL_ONE;
+    if (rate_dps <= p->accel_min_dps || max <= ENCODER_ACCEL_ONE)
+    {
+        return ENCODER_ACCEL_ONE;
+    }
+    if (rate_dps >= p->accel_max_dps || p->accel_max_dps <= p->accel_min_dps)
+    {
+        return max;
+    }
+    return ENCODER_ACCEL_ONE + (max - ENCODER_ACCEL_ONE) * (rate_dps - p->accel_min_dps) /
+                                   (p->accel_max_dps - p->accel_min_dps);
+}
+
+void encoder_accel_feed(encoder_accel_t *a, int32_t counts, int64_t now_us)
+{
+    a->sub_detent += counts;
+    int32_t detents = a->sub_detent / a->p.counts_per_detent; // Truncates toward zero
+    if (detents == 0)
+    {
+        return;
+    }
+    a->sub_detent -= detents * a->p.counts_per_detent;
+
+    int8_t direction = detents > 0 ? 1 : -1;
+    uint32_t steps = (uint32_t)(detents > 0 ? detents : -detents);
+    int64_t dt = now_us - a->last_detent_us;
+
+    // Speed: several detents in one read give it directly; single detents are smoothed
+    if (direction != a->direction || dt >= IDLE_RESET_US)
+    {
+        a->rate_dps = 0; // Reversing or resuming wants fine control
+        a->fraction = 0;
+    }
+    else
+    {
+        uint32_t instant = dt > 0 ? (uint32_t)((int64_t)steps * 1000000 / dt) : a->p.accel_max_dps;
+        a->rate_dps = (a->rate_dps * 3 + instant) / 4;
+    }
+    a->direction = direction;
+    a->last_detent_us = now_us;
+
+    uint32_t mult = multiplier_for(&a->p, a->rate_dps);
+    int32_t scaled = (int32_t)(steps * mult) + a->fraction;
+    a->fraction = scaled % ENCODER_ACCEL_ONE;
+    a->pending_delta += direction * (scaled / ENCODER_ACCEL_ONE);
+    a->pending_detents += detents;
+    a->pending = true;
+}
+
+bool encoder_accel_poll(encoder_accel_t *a, int64_t now_us, encoder_delta_t *out)
+{
+    if (!a->pending || now_us - a->last_emit_us < a->p.batch_window_us)
+    {
+        return false;
+    }
+
+    out->delta = a->pending_delta;
+    out->detents = a->pending_detents;
+    out->multiplier = (uint16_t)multiplier_for(&a->p, a->rate_dps);
+    a->pending_delta = 0;
+    a->pending_detents = 0;
+    a->pending = false;
+    a->last_emit_us = now_us;
+    return out->delta != 0; // A back-and-forth that nets to zero is not worth an event
+}
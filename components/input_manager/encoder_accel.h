@@ -0,0 +1,58 @@
+#pragma once
+
+// Internal: encoder acceleration and event batching. Pure C with the time passed in,
+// so it builds and runs on the host as well as on the target.
+//
+// Raw quadrature counts go in through encoder_accel_feed(); whole detents are scaled
+// by a speed-dependent multiplier and accumulated. encoder_accel_poll() hands out the
+// accumulated delta at most once per batch window, so a slow click is reported at once
+// while a fast spin becomes one aggregated delta per window.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ENCODER_ACCEL_ONE 16 // Multipliers are fixed point with this many steps per 1x
+
+typedef struct
+{
+    uint16_t counts_per_detent; // Quadrature counts per mechanical detent (4 for x4 decoding)
+    uint32_t batch_window_us;   // Minimum time between two events
+    uint16_t accel_min_dps;     // Below this speed (detents/s) every detent counts once
+    uint16_t accel_max_dps;     // At and above this speed the full multiplier applies
+    uint16_t accel_max_mult;    // Multiplier at accel_max_dps (1 disables acceleration)
+} encoder_accel_params_t;
+
+typedef struct
+{
+    encoder_accel_params_t p;
+    int32_t sub_detent;      // Counts short of a full detent
+    int32_t pending_delta;   // Accelerated delta not yet handed out
+    int32_t pending_detents; // Detents behind pending_delta
+    bool pending;            // Detents arrived since the last event (they may net to zero)
+    int32_t fraction;        // Accelerated remainder, in 1/ENCODER_ACCEL_ONE steps
+    uint32_t rate_dps;       // Smoothed speed
+    int8_t direction;        // Sign of the last detent
+    int64_t last_detent_us;
+    int64_t last_emit_us;
+} encoder_accel_t;
+
+typedef struct
+{
+    int32_t delta;       // Accelerated change to apply
+    int32_t detents;     // Detents actually turned (signed)
+    uint16_t multiplier; // Multiplier of the last detent, x ENCODER_ACCEL_ONE
+} encoder_delta_t;
+
+void encoder_accel_init(encoder_accel_t *a, const encoder_accel_params_t *params);
+
+/**
+ * @brief Add counts read from the hardware counter since the previous call.
+ */
+void encoder_accel_feed(encoder_accel_t *a, int32_t counts, int64_t now_us);
+
+/**
+ * @brief Take the accumulated delta if there is one and the batch window has passed.
+ *
+ * @return true if `out` was filled.
+ */
+bool encoder_accel_poll(encoder_accel_t *a, int64_t now_us, encoder_delta_t *out);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h" // For TickType_t, UBaseType_t
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // --- Encoders and Buttons ---
+    // Each encoder is decoded in hardware by one PCNT unit (x4 quadrature, glitch filter
+    // on both inputs), so no step is lost however long the input task is delayed. The task
+    // reads the counters every poll period, applies speed-based acceleration and emits at
+    // most one delta event per encoder per batch window. Push switches use GPIO interrupts
+    // that wake the task, and are debounced there.
+
+#define INPUT_MAX_ENCODERS 4 // PCNT units on the ESP32-S3
+
+    typedef struct
+    {
+        int pin_a;
+        int pin_b;
+        int pin_switch; // Push switch to GND, or -1
+    } input_encoder_pins_t;
+
+    typedef struct
+    {
+        input_encoder_pins_t encoders[INPUT_MAX_ENCODERS];
+        uint8_t encoder_count;
+        uint16_t counts_per_detent; // 4 for the usual one-cycle-per-detent encoder
+        uint32_t poll_ms;           // Counter read period (input latency)
+        uint32_t batch_ms;          // Minimum time between two events of one encoder
+        uint32_t debounce_ms;       // Switch level must be stable this long
+        uint16_t accel_min_dps;     // Detents/s where acceleration starts
+        uint16_t accel_max_dps;     // Detents/s where accel_max_mult is reached
+        uint16_t accel_max_mult;    // 1 disables acceleration
+        size_t event_queue_len;
+        size_t task_stack_size;
+        UBaseType_t task_priority;
+        int task_core_id;
+    } input_manager_config_t;
+
+    typedef enum
+    {
+        INPUT_EVENT_ENCODER = 0, // delta/detents valid
+        INPUT_EVENT_SWITCH_DOWN,
+        INPUT_EVENT_SWITCH_UP,
+    } input_event_type_t;
+
+    typedef struct
+    {
+        input_event_type_t type;
+        uint8_t index;    // Encoder index
+        int32_t delta;    // Accelerated change, for parameters
+        int32_t detents;  // Detents actually turned, for menus and lists
+        uint32_t time_ms; // When the event was emitted
+    } input_event_t;
+
+    typedef struct
+    {
+        uint32_t detents; // Detents turned, all encoders
+        uint32_t events;  // Events queued
+        uint32_t dropped; // Events lost to a full queue
+    } input_stats_t;
+
+    /**
+     * @brief Set up PCNT units and switch interrupts and start the input task.
+     *
+     * @return ESP_OK, ESP_ERR_INVALID_ARG, ESP_ERR_INVALID_STATE if already running,
+     *         ESP_ERR_NO_MEM, or a driver error.
+     */
+    esp_err_t input_manager_init(const input_manager_config_t *config);
+
+    /**
+     * @brief Wait for the next input event.
+     *
+     * @return ESP_OK, or ESP_ERR_TIMEOUT if none arrived in time.
+     */
+    esp_err_t input_manager_get_event(input_event_t *event, TickType_t timeout_ticks);
+
+    /**
+     * @brief Get event counters (detents vs. events shows the batching ratio).
+     */
+    void input_manager_get_stats(input_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,295 @@
+#include "input_manager.h"
+#include "encoder_accel.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "driver/pulse_cnt.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "INPUT_MANAGER";
+
+#define PCNT_LIMIT 10000    // Counter range; overflow is accumulated by the driver
+#define PCNT_GLITCH_NS 1000 // Pulses shorter than this are ignored in hardware
+
+// --- State ---
+
+typedef struct
+{
+    pcnt_unit_handle_t unit;
+    pcnt_channel_handle_t chan_a;
+    pcnt_channel_handle_t chan_b;
+    int last_count;
+    encoder_accel_t accel;
+    int pin_switch;
+    int switch_level;     // Debounced level (1 = released, pulled up)
+    int switch_candidate; // Last raw level seen
+    int64_t switch_change_us;
+} encoder_state_t;
+
+static encoder_state_t encoders[INPUT_MAX_ENCODERS];
+static uint8_t encoder_count = 0;
+static QueueHandle_t event_queue = NULL;
+static TaskHandle_t input_task_handle = NULL;
+static TickType_t poll_ticks = 1;
+static int64_t debounce_us = 0;
+static input_stats_t stats = {0};
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// --- Hardware Setup ---
+
+// x4 quadrature: each channel counts both edges of its pin, direction from the other pin's level
+static esp_err_t setup_encoder(encoder_state_t *enc, const input_encoder_pins_t *pins)
+{
+    pcnt_unit_config_t unit_config = {
+        .high_limit = PCNT_LIMIT,
+        .low_limit = -PCNT_LIMIT,
+        .flags.accum_count = true,
+    };
+    esp_err_t ret = pcnt_new_unit(&unit_config, &enc->unit);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    pcnt_glitch_filter_config_t filter_config = {.max_glitch_ns = PCNT_GLITCH_NS};
+    ret = pcnt_unit_set_glitch_filter(enc->unit, &filter_config);
+
+    pcnt_chan_config_t chan_a_config = {.edge_gpio_num = pins->pin_a, .level_gpio_num = pins->pin_b};
+    pcnt_chan_config_t chan_b_config = {.edge_gpio_num = pins->pin_b, .level_gpio_num = pins->pin_a};
+    if (ret == ESP_OK)
+    {
+        ret = pcnt_new_channel(enc->unit, &chan_a_config, &enc->chan_a);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = pcnt_new_channel(enc->unit, &chan_b_config, &enc->chan_b);
+    }
+    if (ret == ESP_OK)
+    {
+        pcnt_channel_set_edge_action(enc->chan_a, PCNT_CHANNEL_EDGE_ACTION_DECREASE, PCNT_CHANNEL_EDGE_ACTION_INCREASE);
+        pcnt_channel_set_level_action(enc->chan_a, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE);
+        pcnt_channel_set_edge_action(enc->chan_b, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_DECREASE);
+        pcnt_channel_set_level_action(enc->chan_b, PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_INVERSE);
+
+        // Watch points at the limits let the driver fold overflows into the count
+        ret = pcnt_unit_add_watch_point(enc->unit, PCNT_LIMIT);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = pcnt_unit_add_watch_point(enc->unit, -PCNT_LIMIT);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = pcnt_unit_enable(enc->unit);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = pcnt_unit_clear_count(enc->unit);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = pcnt_unit_start(enc->unit);
+    }
+    enc->last_count = 0;
+    return ret;
+}
+
+static void IRAM_ATTR switch_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(input_task_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static esp_err_t setup_switch(encoder_state_t *enc, int pin)
+{
+    enc->pin_switch = pin;
+    enc->switch_level = 1;
+    enc->switch_candidate = 1;
+    if (pin < 0)
+    {
+        return ESP_OK;
+    }
+
+    gpio_config_t io_config = {
+        .pin_bit_mask = 1ULL << pin,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .intr_type = GPIO_INTR_ANYEDGE,
+    };
+    esp_err_t ret = gpio_config(&io_config);
+    if (ret == ESP_OK)
+    {
+        ret = gpio_isr_handler_add(pin, switch_isr, NULL);
+    }
+    return ret;
+}
+
+// --- Input Task ---
+
+static void queue_event(input_event_type_t type, uint8_t index, int32_t delta, int32_t detents, int64_t now_us)
+{
+    input_event_t event = {
+        .type = type,
+        .index = index,
+        .delta = delta,
+        .detents = detents,
+        .time_ms = (uint32_t)(now_us / 1000),
+    };
+    bool sent = xQueueSend(event_queue, &event, 0) == pdTRUE;
+
+    portENTER_CRITICAL(&stats_lock);
+    if (sent)
+    {
+        stats.events++;
+    }
+    else
+    {
+        stats.dropped++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+static void poll_switch(encoder_state_t *enc, uint8_t index, int64_t now_us)
+{
+    int level = gpio_get_level(enc->pin_switch);
+    if (level != enc->switch_candidate)
+    {
+        enc->switch_candidate = level; // Still bouncing: restart the stability timer
+        enc->switch_change_us = now_us;
+    }
+    else if (level != enc->switch_level && now_us - enc->switch_change_us >= debounce_us)
+    {
+        enc->switch_level = level;
+        queue_event(level ? INPUT_EVENT_SWITCH_UP : INPUT_EVENT_SWITCH_DOWN, index, 0, 0, now_us);
+    }
+}
+
+static void input_task(void *arg)
+{
+    while (1)
+    {
+        // Switch interrupts cut the wait short; encoder counts keep accumulating in hardware
+        ulTaskNotifyTake(pdTRUE, poll_ticks);
+        int64_t now = esp_timer_get_time();
+
+        uint8_t count_now = __atomic_load_n(&encoder_count, __ATOMIC_ACQUIRE);
+        for (uint8_t i = 0; i < count_now; ++i)
+        {
+            encoder_state_t *enc = &encoders[i];
+
+            int count = 0;
+            if (pcnt_unit_get_count(enc->unit, &count) == ESP_OK && count != enc->last_count)
+            {
+                encoder_accel_feed(&enc->accel, count - enc->last_count, now);
+                enc->last_count = count;
+            }
+
+            encoder_delta_t d;
+            if (encoder_accel_poll(&enc->accel, now, &d))
+            {
+                portENTER_CRITICAL(&stats_lock);
+                stats.detents += (uint32_t)(d.detents > 0 ? d.detents : -d.detents);
+                portEXIT_CRITICAL(&stats_lock);
+                queue_event(INPUT_EVENT_ENCODER, i, d.delta, d.detents, now);
+            }
+
+            if (enc->pin_switch >= 0)
+            {
+                poll_switch(enc, i, now);
+            }
+        }
+    }
+}
+
+// --- Public API ---
+
+esp_err_t input_manager_init(const input_manager_config_t *config)
+{
+    if (config == NULL || config->encoder_count > INPUT_MAX_ENCODERS || config->event_queue_len == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (input_task_handle != NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    event_queue = xQueueCreate(config->event_queue_len, sizeof(input_event_t));
+    if (event_queue == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    poll_ticks = pdMS_TO_TICKS(config->poll_ms) ? pdMS_TO_TICKS(config->poll_ms) : 1;
+    debounce_us = (int64_t)config->debounce_ms * 1000;
+    encoder_accel_params_t accel_params = {
+        .counts_per_detent = config->counts_per_detent,
+        .batch_window_us = config->batch_ms * 1000,
+        .accel_min_dps = config->accel_min_dps,
+        .accel_max_dps = config->accel_max_dps,
+        .accel_max_mult = config->accel_max_mult,
+    };
+
+    // The task handle must exist before a switch interrupt can fire
+    if (xTaskCreatePinnedToCore(input_task, "input", config->task_stack_size, NULL,
+                                config->task_priority, &input_task_handle, config->task_core_id) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create input task");
+        vQueueDelete(event_queue);
+        event_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ret = gpio_install_isr_service(0);
+    if (ret == ESP_ERR_INVALID_STATE)
+    {
+        ret = ESP_OK; // Already installed by another component
+    }
+
+    // The task only looks at encoders [0, encoder_count), so it is safe to publish the count last
+    for (uint8_t i = 0; ret == ESP_OK && i < config->encoder_count; ++i)
+    {
+        memset(&encoders[i], 0, sizeof(encoders[i]));
+        encoder_accel_init(&encoders[i].accel, &accel_params);
+        ret = setup_encoder(&encoders[i], &config->encoders[i]);
+        if (ret == ESP_OK)
+        {
+            ret = setup_switch(&encoders[i], config->encoders[i].pin_switch);
+        }
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to set up encoder %d (pins %d/%d): %s", i, config->encoders[i].pin_a,
+                     config->encoders[i].pin_b, esp_err_to_name(ret));
+            break;
+        }
+        __atomic_store_n(&encoder_count, i + 1, __ATOMIC_RELEASE);
+    }
+
+    ESP_LOGI(TAG, "Input initialized (%d encoders, poll %lu ms, batch %lu ms)", encoder_count,
+             (unsigned long)config->poll_ms, (unsigned long)config->batch_ms);
+    return ret;
+}
+
+esp_err_t input_manager_get_event(input_event_t *event, TickType_t timeout_ticks)
+{
+    if (event == NULL || event_queue == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return xQueueReceive(event_queue, event, timeout_ticks) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void input_manager_get_stats(input_stats_t *out)
+{
+    if (out == NULL)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
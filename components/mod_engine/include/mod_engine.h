@@ -0,0 +1,180 @@
+#pragma once
+
+#include "module_i2c_proto.h" // For ParamId_t, ParamValue_t
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h" // For UBaseType_t
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // --- Types ---
+
+    typedef int16_t mod_handle_t; // Stable handle for a modulator, valid until removed
+#define MOD_HANDLE_INVALID ((mod_handle_t)-1)
+
+    typedef enum
+    {
+        MOD_TYPE_LFO = 0,
+        MOD_TYPE_ENVELOPE,
+        MOD_TYPE_SAMPLE_HOLD,
+    } mod_type_t;
+
+    typedef enum
+    {
+        MOD_LFO_SINE = 0,
+        MOD_LFO_TRIANGLE,
+        MOD_LFO_SAW,
+        MOD_LFO_SQUARE,
+    } mod_lfo_shape_t;
+
+    // Destination of a modulator: one parameter on one module.
+    // The emitted value is clamp(base + depth * m, min, max) where m is the
+    // modulator output (-1..1 for LFO and S&H, 0..1 for envelopes).
+    typedef struct
+    {
+        uint8_t mux_channel; // Flat mux channel of the target module
+        uint8_t module_addr; // I2C slave address of the target module
+        ParamId_t param_id;  // Parameter being modulated
+        float base;          // Unmodulated parameter value
+        float depth;         // Modulation amount in parameter units
+        float min;           // Lower clamp of the emitted value
+        float max;           // Upper clamp of the emitted value
+        float threshold;     // Minimum change since the last emitted value before a write is sent
+    } mod_target_t;
+
+    typedef struct
+    {
+        uint32_t rate_hz;          // Control rate (CONFIG_CENTRAL_MOD_ENGINE_RATE_HZ if 0)
+        size_t task_stack_size;    // Stack size for the engine task
+        UBaseType_t task_priority; // Priority for the engine task
+        int task_core_id;          // Core to pin the task to (0, 1, or tskNO_AFFINITY)
+    } mod_engine_config_t;
+
+    typedef struct
+    {
+        uint32_t ticks;          // Control ticks evaluated since start
+        uint32_t overruns;       // Ticks that started late because the previous pass overran
+        uint32_t params_emitted; // Parameter values in queued bulk writes (modulators on one parameter count once)
+        uint32_t bus_writes;     // Bulk I2C transactions queued to the bus task
+        uint32_t dropped_writes; // Bulk writes not queued because the bus queue was full (retried next tick)
+        uint32_t last_pass_us;   // Duration of the most recent evaluation pass
+        uint32_t max_pass_us;    // Longest evaluation pass observed
+    } mod_engine_stats_t;
+
+    // --- Lifecycle ---
+
+    /**
+     * @brief Initialize the modulation engine and create its (idle) control-rate task.
+     *
+     * @param config Pointer to configuration struct.
+     * @return ESP_OK on success, or an error code.
+     */
+    esp_err_t mod_engine_init(const mod_engine_config_t *config);
+
+    /**
+     * @brief Start the periodic control-rate timer driving the engine task.
+     *
+     * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialized.
+     */
+    esp_err_t mod_engine_start(void);
+
+    /**
+     * @brief Stop the control-rate timer. Modulator state is retained.
+     *
+     * @return ESP_OK on success.
+     */
+    esp_err_t mod_engine_stop(void);
+
+    // --- Modulator Management ---
+
+    /**
+     * @brief Add a free-running LFO.
+     *
+     * @param target Destination parameter and scaling.
+     * @param shape Waveform shape.
+     * @param rate_hz LFO frequency in Hz (must be below half the control rate).
+     * @param[out] handle Handle of the new modulator.
+     * @return ESP_OK on success, ESP_ERR_NO_MEM if all slots are in use, ESP_ERR_INVALID_ARG on bad input.
+     */
+    esp_err_t mod_engine_add_lfo(const mod_target_t *target, mod_lfo_shape_t shape, float rate_hz, mod_handle_t *handle);
+
+    /**
+     * @brief Add a gated linear ADSR envelope. The envelope idles until mod_engine_gate() is called.
+     *
+     * @param target Destination parameter and scaling.
+     * @param attack_s Attack time in seconds.
+     * @param decay_s Decay time in seconds.
+     * @param sustain Sustain level (0..1).
+     * @param release_s Release time in seconds.
+     * @param[out] handle Handle of the new modulator.
+     * @return ESP_OK on success, ESP_ERR_NO_MEM if all slots are in use, ESP_ERR_INVALID_ARG on bad input.
+     */
+    esp_err_t mod_engine_add_envelope(const mod_target_t *target, float attack_s, float decay_s, float sustain, float release_s, mod_handle_t *handle);
+
+    /**
+     * @brief Add a sample-and-hold generator that picks a new random value at rate_hz.
+     *
+     * @param target Destination parameter and scaling.
+     * @param rate_hz Sampling rate in Hz.
+     * @param[out] handle Handle of the new modulator.
+     * @return ESP_OK on success, ESP_ERR_NO_MEM if all slots are in use, ESP_ERR_INVALID_ARG on bad input.
+     */
+    esp_err_t mod_engine_add_sample_hold(const mod_target_t *target, float rate_hz, mod_handle_t *handle);
+
+    /**
+     * @brief Open or close the gate of an envelope modulator.
+     *
+     * @param handle Envelope handle.
+     * @param gate_on true to (re)start the attack stage, false to enter release.
+     * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the handle is not an envelope.
+     */
+    esp_err_t mod_engine_gate(mod_handle_t handle, bool gate_on);
+
+    /**
+     * @brief Change the unmodulated base value of a modulator's target (e.g. when the user turns the knob).
+     *
+     * @param handle Modulator handle.
+     * @param base New base value.
+     * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown handle.
+     */
+    esp_err_t mod_engine_set_base(mod_handle_t handle, float base);
+
+    /**
+     * @brief Remove a modulator. The target keeps the last value that was sent.
+     *
+     * @param handle Modulator handle.
+     * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown handle.
+     */
+    esp_err_t mod_engine_remove(mod_handle_t handle);
+
+    // --- Diagnostics ---
+
+    /**
+     * @brief Copy the engine statistics.
+     *
+     * @param[out] stats Destination.
+     * @return ESP_OK on success.
+     */
+    esp_err_t mod_engine_get_stats(mod_engine_stats_t *stats);
+
+    /**
+     * @brief Measure evaluation throughput without touching the bus.
+     *
+     * Must be called while the engine is stopped. Temporarily fills the engine with
+     * num_modulators mixed modulators, runs num_ticks evaluation passes and removes them again.
+     *
+     * @param num_modulators Number of modulators to evaluate per pass.
+     * @param num_ticks Number of passes to time.
+     * @param[out] modulators_per_ms Modulator evaluations per millisecond of CPU time.
+     * @return ESP_OK on success, ESP_ERR_INVALID_STATE if running or not empty, ESP_ERR_INVALID_ARG on bad input.
+     */
+    esp_err_t mod_engine_benchmark(size_t num_modulators, uint32_t num_ticks, float *modulators_per_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,821 @@
+#include "mod_engine.h"
+#include "i2c_manager.h"     // For bulk parameter writes
+#include "synth_constants.h" // From common_definitions
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h" // For mutex
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "MOD_ENGINE";
+
+// Configuration values (read from sdkconfig)
+#define MOD_MAX_MODULATORS CONFIG_CENTRAL_MOD_ENGINE_MAX_MODULATORS
+#define MOD_DEFAULT_RATE_HZ CONFIG_CENTRAL_MOD_ENGINE_RATE_HZ
+
+#define SINE_TABLE_SIZE 256 // Power of two, one full cycle
+
+// Conversion from the engine's float domain to the wire type
+#define MOD_TO_PARAM_VALUE(v) ((ParamValue_t)(v))
+
+typedef enum
+{
+    ENV_IDLE = 0,
+    ENV_ATTACK,
+    ENV_DECAY,
+    ENV_SUSTAIN,
+    ENV_RELEASE,
+} env_stage_t;
+
+// --- State (struct-of-arrays) ---
+// Live modulators are packed into slots [0, active_count) so each pass is a
+// straight linear sweep over contiguous arrays. Removal swaps the last slot in,
+// and handles are kept stable through the handle_to_slot/slot_to_handle maps.
+
+// Generator state
+static uint8_t mod_type[MOD_MAX_MODULATORS];
+static uint8_t mod_shape[MOD_MAX_MODULATORS];
+static float mod_phase[MOD_MAX_MODULATORS];     // 0..1
+static float mod_phase_inc[MOD_MAX_MODULATORS]; // Phase advance per tick (0 for envelopes)
+static uint8_t mod_wrapped[MOD_MAX_MODULATORS]; // Set when the phase wrapped this tick
+static float mod_out[MOD_MAX_MODULATORS];       // Current output (also the envelope level)
+static float mod_held[MOD_MAX_MODULATORS];      // Held value for sample-and-hold
+
+// Envelope state
+static uint8_t env_stage[MOD_MAX_MODULATORS];
+static float env_attack_inc[MOD_MAX_MODULATORS];
+static float env_decay_inc[MOD_MAX_MODULATORS];
+static float env_sustain[MOD_MAX_MODULATORS];
+static float env_release_inc[MOD_MAX_MODULATORS];
+
+// Target state
+static uint8_t tgt_mux[MOD_MAX_MODULATORS];
+static uint8_t tgt_addr[MOD_MAX_MODULATORS];
+static ParamId_t tgt_param[MOD_MAX_MODULATORS];
+static float tgt_base[MOD_MAX_MODULATORS];
+static float tgt_depth[MOD_MAX_MODULATORS];
+static float tgt_min[MOD_MAX_MODULATORS];
+static float tgt_max[MOD_MAX_MODULATORS];
+static float tgt_threshold[MOD_MAX_MODULATORS];
+static float tgt_last[MOD_MAX_MODULATORS];  // Last value emitted to the module
+static float tgt_value[MOD_MAX_MODULATORS]; // Value computed this tick
+
+// Slot bookkeeping
+static mod_handle_t slot_to_handle[MOD_MAX_MODULATORS];
+static int16_t handle_to_slot[MOD_MAX_MODULATORS]; // -1 when the handle is free
+static size_t active_count = 0;
+
+// Per-tick scratch
+static uint16_t dirty_slots[MOD_MAX_MODULATORS];
+
+typedef struct
+{
+    uint8_t mux_channel;
+    uint8_t module_addr;
+    uint8_t count;
+    ParamId_t param_ids[I2C_MANAGER_MAX_BULK_PARAMS];
+    ParamValue_t values[I2C_MANAGER_MAX_BULK_PARAMS];
+} module_batch_t;
+
+static module_batch_t batches[MOD_MAX_MODULATORS]; // Worst case: one batch per dirty modulator
+static uint16_t dirty_batch[MOD_MAX_MODULATORS];   // Batch carrying each dirty slot's value
+static bool batch_queued[MOD_MAX_MODULATORS];
+
+static float sine_table[SINE_TABLE_SIZE + 1]; // +1 guard entry for interpolation
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t control_rate_hz = 0;
+static SemaphoreHandle_t mod_mutex = NULL;
+static TaskHandle_t mod_task_handle = NULL;
+static esp_timer_handle_t tick_timer = NULL;
+static bool running = false;
+static mod_engine_stats_t stats;
+
+// --- Helpers ---
+
+static inline uint32_t next_random(void)
+{
+    // xorshift32: cheap and deterministic, good enough for modulation
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static inline float random_bipolar(void)
+{
+    return (float)(next_random() >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+static inline float lookup_sine(float phase)
+{
+    float pos = phase * SINE_TABLE_SIZE;
+    int idx = (int)pos;
+    float frac = pos - (float)idx;
+    return sine_table[idx] + frac * (sine_table[idx + 1] - sine_table[idx]);
+}
+
+static inline float seconds_to_inc(float seconds)
+{
+    // Per-tick step for a 0->1 ramp lasting `seconds`; zero-length segments complete in one tick
+    float ticks = seconds * (float)control_rate_hz;
+    return (ticks < 1.0f) ? 1.0f : 1.0f / ticks;
+}
+
+static bool target_is_valid(const mod_target_t *target)
+{
+    return target != NULL && target->mux_channel < I2C_MUX_CHANNEL_COUNT &&
+           target->min <= target->max && target->threshold >= 0.0f;
+}
+
+// Caller must hold mod_mutex. Returns the new slot index, or -1 if full.
+static int alloc_slot_locked(const mod_target_t *target, mod_type_t type, mod_handle_t *handle)
+{
+    if (active_count >= MOD_MAX_MODULATORS)
+    {
+        return -1;
+    }
+
+    mod_handle_t h = MOD_HANDLE_INVALID;
+    for (int i = 0; i < MOD_MAX_MODULATORS; ++i)
+    {
+        if (handle_to_slot[i] < 0)
+        {
+            h = (mod_handle_t)i;
+            break;
+        }
+    }
+    if (h == MOD_HANDLE_INVALID)
+    {
+        return -1;
+    }
+
+    int slot = (int)active_count++;
+    handle_to_slot[h] = (int16_t)slot;
+    slot_to_handle[slot] = h;
+
+    mod_type[slot] = (uint8_t)type;
+    mod_shape[slot] = 0;
+    mod_phase[slot] = 0.0f;
+    mod_phase_inc[slot] = 0.0f;
+    mod_wrapped[slot] = 0;
+    mod_out[slot] = 0.0f;
+    mod_held[slot] = 0.0f;
+    env_stage[slot] = ENV_IDLE;
+
+    tgt_mux[slot] = target->mux_channel;
+    tgt_addr[slot] = target->module_addr;
+    tgt_param[slot] = target->param_id;
+    tgt_base[slot] = target->base;
+    tgt_depth[slot] = target->depth;
+    tgt_min[slot] = target->min;
+    tgt_max[slot] = target->max;
+    tgt_threshold[slot] = target->threshold;
+    tgt_last[slot] = -INFINITY; // Forces the first evaluated value out to the module
+
+    *handle = h;
+    return slot;
+}
+
+// Caller must hold mod_mutex. Moves the last live slot into `slot`.
+static void free_slot_locked(int slot)
+{
+    int last = (int)active_count - 1;
+    mod_handle_t freed = slot_to_handle[slot];
+
+    if (slot != last)
+    {
+#define MOVE(arr) arr[slot] = arr[last]
+        MOVE(mod_type);
+        MOVE(mod_shape);
+        MOVE(mod_phase);
+        MOVE(mod_phase_inc);
+        MOVE(mod_wrapped);
+        MOVE(mod_out);
+        MOVE(mod_held);
+        MOVE(env_stage);
+        MOVE(env_attack_inc);
+        MOVE(env_decay_inc);
+        MOVE(env_sustain);
+        MOVE(env_release_inc);
+        MOVE(tgt_mux);
+        MOVE(tgt_addr);
+        MOVE(tgt_param);
+        MOVE(tgt_base);
+        MOVE(tgt_depth);
+        MOVE(tgt_min);
+        MOVE(tgt_max);
+        MOVE(tgt_threshold);
+        MOVE(tgt_last);
+#undef MOVE
+        slot_to_handle[slot] = slot_to_handle[last];
+        handle_to_slot[slot_to_handle[slot]] = (int16_t)slot;
+    }
+
+    handle_to_slot[freed] = -1;
+    active_count--;
+}
+
+// Caller must hold mod_mutex.
+static int slot_for_handle_locked(mod_handle_t handle)
+{
+    if (handle < 0 || handle >= MOD_MAX_MODULATORS)
+    {
+        return -1;
+    }
+    return handle_to_slot[handle];
+}
+
+// --- Evaluation ---
+
+// One control tick over all live modulators. Caller must hold mod_mutex.
+// Returns the number of slots whose value moved beyond their threshold; their
+// indices are left in dirty_slots[] and their values in tgt_value[].
+static size_t evaluate_locked(void)
+{
+    const size_t n = active_count;
+
+    // Pass 1: phase accumulators (branch-free, same arithmetic for every slot)
+    for (size_t i = 0; i < n; ++i)
+    {
+        float p = mod_phase[i] + mod_phase_inc[i];
+        uint8_t wrapped = (p >= 1.0f);
+        mod_phase[i] = wrapped ? p - 1.0f : p;
+        mod_wrapped[i] = wrapped;
+    }
+
+    // Pass 2: generator outputs
+    for (size_t i = 0; i < n; ++i)
+    {
+        float p = mod_phase[i];
+        switch (mod_type[i])
+        {
+        case MOD_TYPE_LFO:
+            switch (mod_shape[i])
+            {
+            case MOD_LFO_SINE:
+                mod_out[i] = lookup_sine(p);
+                break;
+            case MOD_LFO_TRIANGLE:
+                mod_out[i] = (p < 0.5f) ? (4.0f * p - 1.0f) : (3.0f - 4.0f * p);
+                break;
+            case MOD_LFO_SAW:
+                mod_out[i] = 2.0f * p - 1.0f;
+                break;
+            default: // MOD_LFO_SQUARE
+                mod_out[i] = (p < 0.5f) ? 1.0f : -1.0f;
+                break;
+            }
+            break;
+
+        case MOD_TYPE_SAMPLE_HOLD:
+            if (mod_wrapped[i])
+            {
+                mod_held[i] = random_bipolar();
+            }
+            mod_out[i] = mod_held[i];
+            break;
+
+        case MOD_TYPE_ENVELOPE:
+        {
+            float level = mod_out[i];
+            switch (env_stage[i])
+            {
+            case ENV_ATTACK:
+                level += env_attack_inc[i];
+                if (level >= 1.0f)
+                {
+                    level = 1.0f;
+                    env_stage[i] = ENV_DECAY;
+                }
+                break;
+            case ENV_DECAY:
+                level -= env_decay_inc[i];
+                if (level <= env_sustain[i])
+                {
+                    level = env_sustain[i];
+                    env_stage[i] = ENV_SUSTAIN;
+                }
+                break;
+            case ENV_RELEASE:
+                level -= env_release_inc[i];
+                if (level <= 0.0f)
+                {
+                    level = 0.0f;
+                    env_stage[i] = ENV_IDLE;
+                }
+                break;
+            default: // ENV_IDLE, ENV_SUSTAIN hold their level
+                break;
+            }
+            mod_out[i] = level;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // Pass 3: scale, clamp and threshold against the last emitted value
+    size_t dirty_count = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        float v = tgt_base[i] + tgt_depth[i] * mod_out[i];
+        v = (v < tgt_min[i]) ? tgt_min[i] : ((v > tgt_max[i]) ? tgt_max[i] : v);
+        tgt_value[i] = v;
+        if (fabsf(v - tgt_last[i]) > tgt_threshold[i])
+        {
+            dirty_slots[dirty_count++] = (uint16_t)i;
+        }
+    }
+
+    return dirty_count;
+}
+
+// Groups dirty slots into per-module batches, one entry per parameter: when several
+// modulators drive the same parameter, the last slot's value wins, as it would on the
+// module. Caller must hold mod_mutex. Returns the number of batches; nothing counts as
+// emitted until mark_emitted_locked().
+static size_t build_batches_locked(size_t dirty_count)
+{
+    size_t batch_count = 0;
+
+    for (size_t d = 0; d < dirty_count; ++d)
+    {
+        uint16_t i = dirty_slots[d];
+        module_batch_t *batch = NULL;
+        int entry = -1;
+
+        // Racks hold a handful of modules, so a linear search of open batches is cheapest
+        for (size_t b = 0; b < batch_count && entry < 0; ++b)
+        {
+            if (batches[b].mux_channel != tgt_mux[i] || batches[b].module_addr != tgt_addr[i])
+            {
+                continue;
+            }
+            for (int k = 0; k < batches[b].count; ++k)
+            {
+                if (batches[b].param_ids[k] == tgt_param[i])
+                {
+                    batch = &batches[b];
+                    entry = k;
+                    break;
+                }
+            }
+            if (batch == NULL && batches[b].count < I2C_MANAGER_MAX_BULK_PARAMS)
+            {
+                batch = &batches[b]; // Keep looking: a later batch may already hold the parameter
+            }
+        }
+        if (batch == NULL)
+        {
+            batch = &batches[batch_count++];
+            batch->mux_channel = tgt_mux[i];
+            batch->module_addr = tgt_addr[i];
+            batch->count = 0;
+        }
+        if (entry < 0)
+        {
+            entry = batch->count++;
+            batch->param_ids[entry] = tgt_param[i];
+        }
+
+        batch->values[entry] = MOD_TO_PARAM_VALUE(tgt_value[i]);
+        dirty_batch[d] = (uint16_t)(batch - batches);
+    }
+
+    return batch_count;
+}
+
+// Queued batches' values become the threshold reference. A batch that did not reach
+// the bus queue stays dirty and is retried on the next tick, so a value that has
+// stopped moving (a held envelope, a static LFO) still gets through. Caller must hold
+// mod_mutex.
+static void mark_emitted_locked(size_t dirty_count)
+{
+    for (size_t d = 0; d < dirty_count; ++d)
+    {
+        if (batch_queued[dirty_batch[d]])
+        {
+            tgt_last[dirty_slots[d]] = tgt_value[dirty_slots[d]];
+        }
+    }
+}
+
+static void mod_engine_task(void *arg)
+{
+    ESP_LOGI(TAG, "Modulation engine task started (%lu Hz)", (unsigned long)control_rate_hz);
+
+    // Modulated values are transient: the parameter observer (and so the param store)
+    // keeps the value the parameter was set to, not wherever the modulation has taken it
+    if (i2c_manager_set_producer_reported(false) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Could not keep modulated writes from the parameter observer");
+    }
+
+    while (1)
+    {
+        // Each notification is one timer tick; a count above 1 means we fell behind
+        uint32_t pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (pending > 1)
+        {
+            stats.overruns += pending - 1;
+        }
+
+        int64_t start_us = esp_timer_get_time();
+
+        xSemaphoreTake(mod_mutex, portMAX_DELAY);
+        size_t dirty_count = evaluate_locked();
+        size_t batch_count = build_batches_locked(dirty_count);
+
+        // Hand batches to the bus task through this task's ring; the pass never
+        // waits on I2C. The bus task outranks this one on the same core, so each
+        // queue call wakes it and it sends the batch before this loop continues.
+        // Queueing is lock-free, so it is done under mod_mutex, while the dirty
+        // slots still refer to the same modulators.
+        uint32_t params_queued = 0;
+        for (size_t b = 0; b < batch_count; ++b)
+        {
+            esp_err_t ret = i2c_manager_queue_param_block(batches[b].mux_channel, batches[b].module_addr,
+                                                          batches[b].param_ids, batches[b].values, batches[b].count);
+            batch_queued[b] = ret == ESP_OK;
+            if (ret != ESP_OK)
+            {
+                stats.dropped_writes++;
+                continue;
+            }
+            stats.bus_writes++;
+            params_queued += batches[b].count;
+        }
+        mark_emitted_locked(dirty_count);
+        xSemaphoreGive(mod_mutex);
+
+        uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+        stats.ticks++;
+        stats.params_emitted += params_queued;
+        stats.last_pass_us = elapsed_us;
+        if (elapsed_us > stats.max_pass_us)
+        {
+            stats.max_pass_us = elapsed_us;
+        }
+    }
+}
+
+static void tick_timer_callback(void *arg)
+{
+    xTaskNotifyGive(mod_task_handle);
+}
+
+// --- Initialization ---
+
+esp_err_t mod_engine_init(const mod_engine_config_t *config)
+{
+    if (config == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (mod_mutex != NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    control_rate_hz = (config->rate_hz != 0) ? config->rate_hz : MOD_DEFAULT_RATE_HZ;
+    if (control_rate_hz > 1000000)
+    {
+        ESP_LOGE(TAG, "Control rate %lu Hz out of range", (unsigned long)control_rate_hz);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int i = 0; i <= SINE_TABLE_SIZE; ++i)
+    {
+        sine_table[i] = sinf(2.0f * (float)M_PI * (float)i / SINE_TABLE_SIZE);
+    }
+    for (int i = 0; i < MOD_MAX_MODULATORS; ++i)
+    {
+        handle_to_slot[i] = -1;
+    }
+    active_count = 0;
+    memset(&stats, 0, sizeof(stats));
+
+    mod_mutex = xSemaphoreCreateMutex();
+    if (mod_mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create modulation mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreatePinnedToCore(mod_engine_task, "mod_engine", config->task_stack_size, NULL,
+                                config->task_priority, &mod_task_handle, config->task_core_id) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create modulation task");
+        goto init_fail;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = tick_timer_callback,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "mod_tick",
+    };
+    if (esp_timer_create(&timer_args, &tick_timer) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to create control-rate timer");
+        goto init_fail;
+    }
+
+    ESP_LOGI(TAG, "Modulation engine initialized (%lu Hz, max %d modulators)",
+             (unsigned long)control_rate_hz, MOD_MAX_MODULATORS);
+    return ESP_OK;
+
+init_fail:
+    if (mod_task_handle)
+    {
+        vTaskDelete(mod_task_handle);
+        mod_task_handle = NULL;
+    }
+    vSemaphoreDelete(mod_mutex);
+    mod_mutex = NULL;
+    return ESP_FAIL;
+}
+
+esp_err_t mod_engine_start(void)
+{
+    if (tick_timer == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (running)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = esp_timer_start_periodic(tick_timer, 1000000ULL / control_rate_hz);
+    if (ret == ESP_OK)
+    {
+        running = true;
+    }
+    return ret;
+}
+
+esp_err_t mod_engine_stop(void)
+{
+    if (tick_timer == NULL || !running)
+    {
+        return ESP_OK;
+    }
+
+    running = false;
+    return esp_timer_stop(tick_timer);
+}
+
+// --- Modulator Management ---
+
+esp_err_t mod_engine_add_lfo(const mod_target_t *target, mod_lfo_shape_t shape, float rate_hz, mod_handle_t *handle)
+{
+    if (!target_is_valid(target) || handle == NULL || shape > MOD_LFO_SQUARE ||
+        rate_hz <= 0.0f || rate_hz >= (float)control_rate_hz / 2.0f)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (mod_mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(mod_mutex, portMAX_DELAY);
+    int slot = alloc_slot_locked(target, MOD_TYPE_LFO, handle);
+    if (slot >= 0)
+    {
+        mod_shape[slot] = (uint8_t)shape;
+        mod_phase_inc[slot] = rate_hz / (float)control_rate_hz;
+    }
+    xSemaphoreGive(mod_mutex);
+
+    return (slot >= 0) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t mod_engine_add_envelope(const mod_target_t *target, float attack_s, float decay_s, float sustain, float release_s, mod_handle_t *handle)
+{
+    if (!target_is_valid(target) || handle == NULL || attack_s < 0.0f || decay_s < 0.0f ||
+        release_s < 0.0f || sustain < 0.0f || sustain > 1.0f)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (mod_mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(mod_mutex, portMAX_DELAY);
+    int slot = alloc_slot_locked(target, MOD_TYPE_ENVELOPE, handle);
+    if (slot >= 0)
+    {
+        env_attack_inc[slot] = seconds_to_inc(attack_s);
+        env_decay_inc[slot] = seconds_to_inc(decay_s) * (1.0f - sustain);
+        env_release_inc[slot] = seconds_to_inc(release_s);
+        env_sustain[slot] = sustain;
+    }
+    xSemaphoreGive(mod_mutex);
+
+    return (slot >= 0) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t mod_engine_add_sample_hold(const mod_target_t *target, float rate_hz, mod_handle_t *handle)
+{
+    if (!target_is_valid(target) || handle == NULL || rate_hz <= 0.0f || rate_hz > (float)control_rate_hz)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (mod_mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(mod_mutex, portMAX_DELAY);
+    int slot = alloc_slot_locked(target, MOD_TYPE_SAMPLE_HOLD, handle);
+    if (slot >= 0)
+    {
+        mod_phase_inc[slot] = rate_hz / (float)control_rate_hz;
+        mod_held[slot] = random_bipolar();
+    }
+    xSemaphoreGive(mod_mutex);
+
+    return (slot >= 0) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t mod_engine_gate(mod_handle_t handle, bool gate_on)
+{
+    if (mod_mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(mod_mutex, portMAX_DELAY);
+    int slot = slot_for_handle_locked(handle);
+    if (slot < 0 || mod_type[slot] != MOD_TYPE_ENVELOPE)
+    {
+        ret = ESP_ERR_INVALID_ARG;
+    }
+    else if (gate_on)
+    {
+        env_stage[slot] = ENV_ATTACK; // Retrigger from the current level, no click back to zero
+    }
+    else if (env_stage[slot] != ENV_IDLE)
+    {
+        env_stage[slot] = ENV_RELEASE;
+    }
+    xSemaphoreGive(mod_mutex);
+
+    return ret;
+}
+
+esp_err_t mod_engine_set_base(mod_handle_t handle, float base)
+{
+    if (mod_mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(mod_mutex, portMAX_DELAY);
+    int slot = slot_for_handle_locked(handle);
+    if (slot < 0)
+    {
+        ret = ESP_ERR_INVALID_ARG;
+    }
+    else
+    {
+        tgt_base[slot] = base;
+    }
+    xSemaphoreGive(mod_mutex);
+
+    return ret;
+}
+
+esp_err_t mod_engine_remove(mod_handle_t handle)
+{
+    if (mod_mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(mod_mutex, portMAX_DELAY);
+    int slot = slot_for_handle_locked(handle);
+    if (slot < 0)
+    {
+        ret = ESP_ERR_INVALID_ARG;
+    }
+    else
+    {
+        free_slot_locked(slot);
+    }
+    xSemaphoreGive(mod_mutex);
+
+    return ret;
+}
+
+// --- Diagnostics ---
+
+esp_err_t mod_engine_get_stats(mod_engine_stats_t *out_stats)
+{
+    if (out_stats == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_stats = stats;
+    return ESP_OK;
+}
+
+esp_err_t mod_engine_benchmark(size_t num_modulators, uint32_t num_ticks, float *modulators_per_ms)
+{
+    if (modulators_per_ms == NULL || num_modulators == 0 || num_modulators > MOD_MAX_MODULATORS || num_ticks == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (mod_mutex == NULL || running)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(mod_mutex, portMAX_DELAY);
+    if (active_count != 0)
+    {
+        xSemaphoreGive(mod_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Realistic mix: mostly LFOs, some envelopes and S&H, spread over 8 modules
+    for (size_t i = 0; i < num_modulators; ++i)
+    {
+        mod_target_t target = {
+            .mux_channel = (uint8_t)(i % MAX_I2C_MUX_CHANNELS),
+            .module_addr = 0x20,
+            .param_id = (ParamId_t)(i / MAX_I2C_MUX_CHANNELS),
+            .base = 512.0f,
+            .depth = 500.0f,
+            .min = 0.0f,
+            .max = 1023.0f,
+            .threshold = 1.0f,
+        };
+        mod_handle_t h;
+        int slot;
+        switch (i % 4)
+        {
+        case 0:
+            slot = alloc_slot_locked(&target, MOD_TYPE_ENVELOPE, &h);
+            env_attack_inc[slot] = seconds_to_inc(0.05f);
+            env_decay_inc[slot] = seconds_to_inc(0.2f) * 0.5f;
+            env_release_inc[slot] = seconds_to_inc(0.5f);
+            env_sustain[slot] = 0.5f;
+            env_stage[slot] = ENV_ATTACK;
+            break;
+        case 1:
+            slot = alloc_slot_locked(&target, MOD_TYPE_SAMPLE_HOLD, &h);
+            mod_phase_inc[slot] = 8.0f / (float)control_rate_hz;
+            break;
+        default:
+            slot = alloc_slot_locked(&target, MOD_TYPE_LFO, &h);
+            mod_shape[slot] = (uint8_t)(i % 3);
+            mod_phase_inc[slot] = (0.1f + 0.37f * (float)(i % 11)) / (float)control_rate_hz;
+            break;
+        }
+    }
+
+    // Evaluation and batching are timed; the bus writes they would feed are not
+    size_t emitted = 0;
+    int64_t start_us = esp_timer_get_time();
+    for (uint32_t t = 0; t < num_ticks; ++t)
+    {
+        size_t dirty_count = evaluate_locked();
+        size_t batch_count = build_batches_locked(dirty_count);
+        for (size_t b = 0; b < batch_count; ++b)
+        {
+            batch_queued[b] = true; // As if every batch were queued
+            emitted += batches[b].count;
+        }
+        mark_emitted_locked(dirty_count);
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+    // Leave the engine empty again
+    for (int i = 0; i < MOD_MAX_MODULATORS; ++i)
+    {
+        handle_to_slot[i] = -1;
+    }
+    active_count = 0;
+    xSemaphoreGive(mod_mutex);
+
+    if (elapsed_us <= 0)
+    {
+        elapsed_us = 1;
+    }
+    *modulators_per_ms = (float)num_modulators * (float)num_ticks * 1000.0f / (float)elapsed_us;
+
+    ESP_LOGI(TAG, "Benchmark: %d modulators x %lu ticks in %lld us -> %.0f modulators/ms (%.1f%% of values emitted)",
+             num_modulators, (unsigned long)num_ticks, elapsed_us, *modulators_per_ms,
+             100.0f * (float)emitted / ((float)num_modulators * (float)num_ticks));
+    return ESP_OK;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "module_i2c_proto.h" // For ParamId_t, ParamValue_t
+#include "patch_manager.h"    // For module_id_t
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // --- Parameter Store ---
+    // The controller's copy of every module parameter value it has set, so remote editors
+    // can read the rack state without polling modules over I2C. Every write that changes
+    // a value stamps it with the next value of a global generation counter. A client keeps
+    // the generation it last saw and asks for the entries changed since then; entries are
+    // kept in generation order, so that costs time proportional to the changes, not to
+    // the store size. Rewriting an unchanged value does not advance the generation.
+    // Generations restart at every boot, so they are only meaningful together with the
+    // session: a random 32-bit ID drawn at init, which the client keeps alongside.
+    //
+    // Every value a module acknowledges is recorded, whoever sent it (UI, patch import,
+    // remote editor): main.c installs param_store_record_module_param() as the i2c_manager
+    // parameter observer, so the store follows what the rack holds. The modulation engine's
+    // writes are left out (see i2c_manager_set_producer_reported()): the store keeps the
+    // value a modulated parameter was set to, and SYNC settles while modulation runs.
+
+#define PARAM_STORE_MODULE_ID(mux_channel, address) ((module_id_t)(((mux_channel) << 8) | (address)))
+
+    typedef struct
+    {
+        module_id_t module_id;
+        ParamId_t param_id;
+        ParamValue_t value;
+        uint32_t generation; // Generation of the write that set this value
+    } param_store_entry_t;
+
+    typedef struct
+    {
+        uint32_t generation; // Latest generation handed out
+        uint32_t entries;    // Parameters stored
+        uint32_t capacity;   // CONFIG_CENTRAL_PARAM_STORE_ENTRIES
+        uint32_t writes;     // param_store_set() calls
+        uint32_t unchanged;  // Writes that matched the stored value
+        uint32_t rejected;   // Writes of new parameters dropped because the store was full
+        uint32_t queries;    // param_store_changes_since() calls
+        bool in_psram;       // Whether the entries were placed in PSRAM
+    } param_store_stats_t;
+
+    /**
+     * @brief Allocate the store (entries in PSRAM when available).
+     *
+     * @return ESP_OK, ESP_ERR_INVALID_STATE if already initialized, or ESP_ERR_NO_MEM.
+     */
+    esp_err_t param_store_init(void);
+
+    /**
+     * @brief Record the current value of a module parameter.
+     *
+     * @param[out] generation Optional: generation of the value now stored.
+     * @return ESP_OK, ESP_ERR_NO_MEM if the store is full, or ESP_ERR_INVALID_STATE.
+     */
+    esp_err_t param_store_set(module_id_t module_id, ParamId_t param_id, ParamValue_t value, uint32_t *generation);
+
+    /**
+     * @brief param_store_set() for the module at (mux_channel, address), keyed by
+     * PARAM_STORE_MODULE_ID. Matches i2c_param_observer_t; a full store is logged by
+     * param_store_set().
+     */
+    void param_store_record_module_param(uint8_t mux_channel, uint8_t module_addr, ParamId_t param_id,
+                                         ParamValue_t value);
+
+    /**
+     * @brief Look up a stored value.
+     *
+     * @return ESP_OK, ESP_ERR_NOT_FOUND, or ESP_ERR_INVALID_STATE.
+     */
+    esp_err_t param_store_get(module_id_t module_id, ParamId_t param_id, ParamValue_t *value);
+
+    /**
+     * @brief Entries changed after generation `since`, in ascending generation order.
+     *
+     * Page through a large delta by passing the generation of the last entry returned.
+     * Entries rewritten while paging move to the end and are returned again with their
+     * new value. Generation 0 asks for everything.
+     *
+     * @param session param_store_session() at the time the client got `since`.
+     * @param since Generation the client is up to date with.
+     * @param[out] entries Buffer for the changed entries.
+     * @param capacity Entries in the buffer.
+     * @param[out] count Entries written.
+     * @param[out] full Optional: set if `since` is 0, or `session` is not the current one
+     *             (the controller rebooted), or the store was cleared after `since`. The
+     *             client must then drop its copy; the result starts from the beginning.
+     * @return ESP_OK, ESP_ERR_INVALID_ARG, or ESP_ERR_INVALID_STATE.
+     */
+    esp_err_t param_store_changes_since(uint32_t session, uint32_t since, param_store_entry_t *entries,
+                                        size_t capacity, size_t *count, bool *full);
+
+    /**
+     * @brief The `full` result of param_store_changes_since() without fetching anything:
+     * whether a client up to date with `since` in `session` must start over.
+     */
+    bool param_store_full_sync_needed(uint32_t session, uint32_t since);
+
+    /**
+     * @brief Latest generation handed out (0 before the first write).
+     */
+    uint32_t param_store_generation(void);
+
+    /**
+     * @brief Random non-zero ID of this boot's generation sequence (0 before init).
+     */
+    uint32_t param_store_session(void);
+
+    /**
+     * @brief Drop every entry (e.g. before loading a different rack). Clients behind the
+     * clear are told to resync in full.
+     */
+    void param_store_clear(void);
+
+    void param_store_get_stats(param_store_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
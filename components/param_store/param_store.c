@@ -0,0 +1,378 @@
+#include "param_store.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h" // For esp_ptr_external_ram
+#include "esp_random.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+static const char *TAG = "PARAM_STORE";
+
+#define STORE_CAPACITY CONFIG_CENTRAL_PARAM_STORE_ENTRIES
+#define INDEX_EMPTY 0    // Index slots hold row + 1
+#define ROW_NONE 0xFFFF  // End of the generation list
+
+_Static_assert(STORE_CAPACITY < ROW_NONE, "Rows must fit the 16-bit index");
+
+// Entries prefer PSRAM and fall back to internal RAM
+#define ENTRY_CAPS_PREFERRED (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define ENTRY_CAPS_FALLBACK MALLOC_CAP_DEFAULT
+
+typedef struct
+{
+    uint32_t generation;
+    ParamValue_t value;
+    module_id_t module_id;
+    ParamId_t param_id;
+    uint16_t prev; // Neighbours in generation order
+    uint16_t next;
+} store_row_t;
+
+// --- State ---
+
+// Rows are never deleted individually, so they stay dense in [0, row_count)
+static store_row_t *rows = NULL;
+static size_t row_count = 0;
+
+// Hot index (internal RAM): power-of-two table, load factor <= 1/2
+static uint16_t *index_table = NULL;
+static size_t index_size = 0;
+
+// Generation order: oldest at head, most recently changed at tail
+static uint16_t head = ROW_NONE;
+static uint16_t tail = ROW_NONE;
+
+static uint32_t generation = 0;
+static uint32_t cleared_at = 0; // Generation stamped by the last clear
+static uint32_t session = 0;    // Drawn at init; clients from another boot must resync
+static param_store_stats_t stats = {0};
+static SemaphoreHandle_t store_mutex = NULL;
+
+// --- Helpers (store_mutex held) ---
+
+static inline size_t key_home(module_id_t module_id, ParamId_t param_id)
+{
+    uint32_t h = ((uint32_t)module_id << 16 | (uint32_t)param_id) * 0x9E3779B1u;
+    return (h ^ (h >> 15)) & (index_size - 1);
+}
+
+// Index slot holding the key, or the empty slot where it would go
+static size_t find_slot(module_id_t module_id, ParamId_t param_id)
+{
+    size_t h = key_home(module_id, param_id);
+    while (index_table[h] != INDEX_EMPTY)
+    {
+        const store_row_t *r = &rows[index_table[h] - 1];
+        if (r->module_id == module_id && r->param_id == param_id)
+        {
+            break;
+        }
+        h = (h + 1) & (index_size - 1);
+    }
+    return h;
+}
+
+static void unlink_row(uint16_t row)
+{
+    store_row_t *r = &rows[row];
+    if (r->prev != ROW_NONE)
+    {
+        rows[r->prev].next = r->next;
+    }
+    else
+    {
+        head = r->next;
+    }
+    if (r->next != ROW_NONE)
+    {
+        rows[r->next].prev = r->prev;
+    }
+    else
+    {
+        tail = r->prev;
+    }
+}
+
+static void append_row(uint16_t row)
+{
+    rows[row].prev = tail;
+    rows[row].next = ROW_NONE;
+    if (tail != ROW_NONE)
+    {
+        rows[tail].next = row;
+    }
+    else
+    {
+        head = row;
+    }
+    tail = row;
+}
+
+// First row with a generation above `since`, walking in from whichever end is closer
+static uint16_t first_after(uint32_t since)
+{
+    if (tail == ROW_NONE || rows[tail].generation <= since)
+    {
+        return ROW_NONE;
+    }
+    if (rows[head].generation > since)
+    {
+        return head;
+    }
+
+    uint16_t row;
+    if (since - rows[head].generation < rows[tail].generation - since)
+    {
+        for (row = head; rows[row].generation <= since; row = rows[row].next)
+        {
+        }
+    }
+    else
+    {
+        for (row = tail; rows[row].prev != ROW_NONE && rows[rows[row].prev].generation > since; row = rows[row].prev)
+        {
+        }
+    }
+    return row;
+}
+
+static void reset_locked(void)
+{
+    row_count = 0;
+    head = ROW_NONE;
+    tail = ROW_NONE;
+    memset(index_table, 0, index_size * sizeof(uint16_t));
+}
+
+// --- Public API ---
+
+esp_err_t param_store_init(void)
+{
+    if (store_mutex != NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    rows = heap_caps_malloc(STORE_CAPACITY * sizeof(store_row_t), ENTRY_CAPS_PREFERRED);
+    if (rows == NULL)
+    {
+        rows = heap_caps_malloc(STORE_CAPACITY * sizeof(store_row_t), ENTRY_CAPS_FALLBACK);
+    }
+    index_size = 2;
+    while (index_size < 2 * STORE_CAPACITY)
+    {
+        index_size <<= 1;
+    }
+    index_table = heap_caps_malloc(index_size * sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    store_mutex = xSemaphoreCreateMutex();
+    if (rows == NULL || index_table == NULL || store_mutex == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to allocate parameter store (%d entries)", STORE_CAPACITY);
+        goto init_fail;
+    }
+
+    reset_locked();
+    do
+    {
+        session = esp_random();
+    } while (session == 0); // 0 is what a client without a session sends
+    stats.capacity = STORE_CAPACITY;
+    stats.in_psram = esp_ptr_external_ram(rows);
+    ESP_LOGI(TAG, "Parameter store ready: %d entries (%d bytes in %s, %d bytes index)", STORE_CAPACITY,
+             STORE_CAPACITY * sizeof(store_row_t), stats.in_psram ? "PSRAM" : "internal RAM",
+             index_size * sizeof(uint16_t));
+    return ESP_OK;
+
+init_fail:
+    heap_caps_free(rows);
+    heap_caps_free(index_table);
+    rows = NULL;
+    index_table = NULL;
+    if (store_mutex)
+    {
+        vSemaphoreDelete(store_mutex);
+        store_mutex = NULL;
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t param_store_set(module_id_t module_id, ParamId_t param_id, ParamValue_t value, uint32_t *gen_out)
+{
+    if (store_mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+
+    esp_err_t ret = ESP_OK;
+    stats.writes++;
+    size_t slot = find_slot(module_id, param_id);
+    uint16_t row = ROW_NONE;
+    if (index_table[slot] != INDEX_EMPTY)
+    {
+        row = index_table[slot] - 1;
+        if (rows[row].value == value)
+        {
+            stats.unchanged++;
+            goto set_done;
+        }
+        unlink_row(row);
+    }
+    else if (row_count >= STORE_CAPACITY)
+    {
+        // Every acknowledged write lands here, so only the first miss is logged
+        if (stats.rejected++ == 0)
+        {
+            ESP_LOGW(TAG, "Store full, not recording module %d param %d (and any further new parameters)",
+                     module_id, param_id);
+        }
+        ret = ESP_ERR_NO_MEM;
+        goto set_done;
+    }
+    else
+    {
+        row = (uint16_t)row_count++;
+        rows[row].module_id = module_id;
+        rows[row].param_id = param_id;
+        index_table[slot] = row + 1;
+    }
+    rows[row].value = value;
+    rows[row].generation = ++generation;
+    append_row(row);
+
+set_done:
+    if (gen_out && ret == ESP_OK)
+    {
+        *gen_out = rows[row].generation;
+    }
+    xSemaphoreGive(store_mutex);
+    return ret;
+}
+
+void param_store_record_module_param(uint8_t mux_channel, uint8_t module_addr, ParamId_t param_id,
+                                     ParamValue_t value)
+{
+    param_store_set(PARAM_STORE_MODULE_ID(mux_channel, module_addr), param_id, value, NULL);
+}
+
+esp_err_t param_store_get(module_id_t module_id, ParamId_t param_id, ParamValue_t *value)
+{
+    if (value == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (store_mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    size_t slot = find_slot(module_id, param_id);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (index_table[slot] != INDEX_EMPTY)
+    {
+        *value = rows[index_table[slot] - 1].value;
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(store_mutex);
+    return ret;
+}
+
+// A client from another boot (generations restart at 0, so its `since` may well look
+// valid) or from before the last clear cannot patch its copy; it starts over. Caller
+// must hold store_mutex.
+static bool restart_needed_locked(uint32_t client_session, uint32_t since)
+{
+    return client_session != session || since < cleared_at || since > generation;
+}
+
+esp_err_t param_store_changes_since(uint32_t client_session, uint32_t since, param_store_entry_t *entries,
+                                    size_t capacity, size_t *count, bool *full)
+{
+    if (count == NULL || (entries == NULL && capacity > 0))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (store_mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+
+    bool restart = restart_needed_locked(client_session, since);
+    if (restart)
+    {
+        since = 0;
+    }
+    if (full)
+    {
+        *full = restart || since == 0;
+    }
+
+    size_t n = 0;
+    for (uint16_t row = first_after(since); row != ROW_NONE && n < capacity; row = rows[row].next)
+    {
+        entries[n++] = (param_store_entry_t){
+            .module_id = rows[row].module_id,
+            .param_id = rows[row].param_id,
+            .value = rows[row].value,
+            .generation = rows[row].generation,
+        };
+    }
+    stats.queries++;
+
+    xSemaphoreGive(store_mutex);
+    *count = n;
+    return ESP_OK;
+}
+
+bool param_store_full_sync_needed(uint32_t client_session, uint32_t since)
+{
+    if (store_mutex == NULL)
+    {
+        return true;
+    }
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    bool full = since == 0 || restart_needed_locked(client_session, since);
+    xSemaphoreGive(store_mutex);
+    return full;
+}
+
+uint32_t param_store_generation(void)
+{
+    return __atomic_load_n(&generation, __ATOMIC_RELAXED);
+}
+
+uint32_t param_store_session(void)
+{
+    return session;
+}
+
+void param_store_clear(void)
+{
+    if (store_mutex == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    reset_locked();
+    cleared_at = ++generation;
+    xSemaphoreGive(store_mutex);
+}
+
+void param_store_get_stats(param_store_stats_t *out)
+{
+    if (out == NULL)
+    {
+        return;
+    }
+    if (store_mutex == NULL)
+    {
+        *out = stats;
+        return;
+    }
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    *out = stats;
+    out->generation = generation;
+    out->entries = row_count;
+    xSemaphoreGive(store_mutex);
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // --- Bank Format ---
+    // A bank is a 6-byte header followed by records:
+    //
+    //   header:  magic "PBNK" (u32 LE), version (u8), flags (u8, 0)
+    //   record:  type (u8), body length (varint), body
+    //
+    // A patch is PATCH_BEGIN, any number of MODULE / CONNECTION / PARAM records, then
+    // PATCH_END carrying the CRC-32 of the patch's bytes from its PATCH_BEGIN up to the
+    // PATCH_END record. The bank ends with BANK_END: the patch count and the CRC-32 of
+    // every byte before it. Integers in bodies are unsigned LEB128 varints (signed values
+    // zigzag-encoded) except CRCs, which are u32 LE. CRC-32 is the IEEE/zlib polynomial.
+    //
+    // Readers skip record types they do not know and ignore trailing bytes in a known
+    // body, so later versions can add records and append fields. Neither side ever holds
+    // more than one record, so banks of any size stream through a fixed amount of RAM.
+    // tools/patch_bank.py is a host-side reference implementation of the same format.
+
+#define PATCH_FORMAT_MAGIC 0x4B4E4250u // "PBNK"
+#define PATCH_FORMAT_VERSION 1
+#define PATCH_FORMAT_HEADER_SIZE 6
+#define PATCH_FORMAT_MAX_NAME 32       // Patch name bytes (not NUL-terminated in the stream)
+#define PATCH_FORMAT_MAX_BODY 64       // Largest body of a known record type
+#define PATCH_FORMAT_WRITE_CHUNK 512   // Writer output is batched into chunks of this size
+
+    typedef enum
+    {
+        PATCH_REC_PATCH_BEGIN = 0x01, // index, name length, name bytes
+        PATCH_REC_MODULE = 0x02,      // module_id, mux_channel, address, module_type, fw_version
+        PATCH_REC_CONNECTION = 0x03,  // src_module, src_port, dst_module, dst_port, flags
+        PATCH_REC_PARAM = 0x04,       // module_id, param_id, value (zigzag)
+        PATCH_REC_PATCH_END = 0x05,   // crc32 (u32 LE)
+        PATCH_REC_BANK_END = 0x7F,    // patch_count, crc32 (u32 LE)
+    } patch_record_type_t;
+
+#define PATCH_CONN_FLAG_ACTIVE 0x01
+
+    // --- Record Contents ---
+
+    typedef struct
+    {
+        uint32_t index;                       // Slot of the patch in the bank
+        char name[PATCH_FORMAT_MAX_NAME + 1]; // NUL-terminated
+    } patch_format_patch_t;
+
+    typedef struct
+    {
+        uint16_t module_id;   // ID used by this patch's connections and params
+        uint8_t mux_channel;  // Where the module was when the patch was saved
+        uint8_t address;
+        uint32_t module_type; // Identity, checked against the rack on import
+        uint16_t fw_version;
+    } patch_format_module_t;
+
+    typedef struct
+    {
+        uint16_t src_module;
+        uint8_t src_port;
+        uint16_t dst_module;
+        uint8_t dst_port;
+        uint8_t flags; // PATCH_CONN_FLAG_*
+    } patch_format_connection_t;
+
+    typedef struct
+    {
+        uint16_t module_id;
+        uint16_t param_id;
+        int32_t value;
+    } patch_format_param_t;
+
+    // --- CRC ---
+
+    /**
+     * @brief Update an IEEE CRC-32. Start with crc = 0; the result equals zlib's crc32().
+     */
+    uint32_t patch_format_crc32(uint32_t crc, const void *data, size_t len);
+
+    // --- Streaming Writer ---
+
+    /**
+     * @brief Sink for writer output, called with chunks of up to PATCH_FORMAT_WRITE_CHUNK bytes.
+     */
+    typedef esp_err_t (*patch_format_write_fn_t)(const void *data, size_t len, void *ctx);
+
+    typedef struct
+    {
+        patch_format_write_fn_t write_fn;
+        void *ctx;
+        uint8_t buf[PATCH_FORMAT_WRITE_CHUNK];
+        size_t buf_len;
+        uint32_t bank_crc;
+        uint32_t patch_crc;
+        uint32_t patch_count;
+        bool in_patch;
+        esp_err_t error; // First error; every later call returns it
+    } patch_writer_t;
+
+    /**
+     * @brief Start a bank: writes the header.
+     */
+    esp_err_t patch_writer_begin(patch_writer_t *w, patch_format_write_fn_t write_fn, void *ctx);
+
+    esp_err_t patch_writer_begin_patch(patch_writer_t *w, const patch_format_patch_t *patch);
+    esp_err_t patch_writer_module(patch_writer_t *w, const patch_format_module_t *module);
+    esp_err_t patch_writer_connection(patch_writer_t *w, const patch_format_connection_t *conn);
+    esp_err_t patch_writer_param(patch_writer_t *w, const patch_format_param_t *param);
+    esp_err_t patch_writer_end_patch(patch_writer_t *w);
+
+    /**
+     * @brief Write BANK_END and flush everything to the sink.
+     *
+     * @return ESP_OK, ESP_ERR_INVALID_STATE if a patch is still open, or the first sink error.
+     */
+    esp_err_t patch_writer_finish(patch_writer_t *w);
+
+    // --- Streaming Reader ---
+    // A push parser: feed it bytes in chunks of any size as they arrive. Record callbacks
+    // run as soon as each record is complete; on_patch_end only runs once the patch CRC has
+    // matched, so consumers should collect a patch and apply it there. A callback returning
+    // an error stops the reader with that error.
+
+    typedef struct
+    {
+        esp_err_t (*on_patch_begin)(const patch_format_patch_t *patch, void *ctx);
+        esp_err_t (*on_module)(const patch_format_module_t *module, void *ctx);
+        esp_err_t (*on_connection)(const patch_format_connection_t *conn, void *ctx);
+        esp_err_t (*on_param)(const patch_format_param_t *param, void *ctx);
+        esp_err_t (*on_patch_end)(uint32_t index, void *ctx);
+        void *ctx;
+    } patch_reader_callbacks_t;
+
+    typedef struct
+    {
+        const patch_reader_callbacks_t *cbs;
+        uint8_t state;
+        uint8_t type;
+        uint8_t len_shift;
+        uint32_t len;
+        uint32_t body_pos;
+        uint8_t body[PATCH_FORMAT_MAX_BODY];
+        uint8_t header[PATCH_FORMAT_HEADER_SIZE];
+        uint32_t bank_crc;
+        uint32_t patch_crc;
+        uint32_t record_bank_crc;  // bank_crc before the current record
+        uint32_t record_patch_crc; // patch_crc before the current record
+        uint32_t patch_index;
+        uint32_t patch_count;
+        bool in_patch;
+        bool patch_crc_active;
+        esp_err_t error;
+    } patch_reader_t;
+
+    void patch_reader_init(patch_reader_t *r, const patch_reader_callbacks_t *cbs);
+
+    /**
+     * @brief Parse the next chunk of a bank.
+     *
+     * @param[out] consumed Optional: bytes used. Less than len only once the bank has ended
+     *                      (the rest belongs to whatever follows) or on error.
+     * @return ESP_OK (more input needed or bank complete), ESP_ERR_INVALID_RESPONSE (bad magic),
+     *         ESP_ERR_INVALID_VERSION, ESP_ERR_INVALID_CRC, ESP_ERR_INVALID_SIZE (malformed record),
+     *         ESP_ERR_INVALID_STATE (records out of order), or a callback's error.
+     */
+    esp_err_t patch_reader_feed(patch_reader_t *r, const void *data, size_t len, size_t *consumed);
+
+    /**
+     * @brief Whether BANK_END has been read and verified.
+     */
+    bool patch_reader_done(const patch_reader_t *r);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,547 @@
+#include "patch_format.h"
+#include <string.h>
+
+// Reader states
+enum
+{
+    READ_HEADER = 0,
+    READ_TYPE,
+    READ_LEN,
+    READ_BODY,
+    READ_DONE,
+};
+
+#define VARINT_MAX_BYTES 5 // 32-bit values
+
+// --- CRC-32 ---
+// Nibble table: 64 bytes of flash, two lookups per byte
+
+static const uint32_t crc_nibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+static inline uint32_t crc_byte(uint32_t c, uint8_t b)
+{
+    c ^= b;
+    c = (c >> 4) ^ crc_nibble[c & 0x0F];
+    c = (c >> 4) ^ crc_nibble[c & 0x0F];
+    return c;
+}
+
+uint32_t patch_format_crc32(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint32_t c = ~crc;
+    for (size_t i = 0; i < len; ++i)
+    {
+        c = crc_byte(c, p[i]);
+    }
+    return ~c;
+}
+
+// --- Varints ---
+
+static size_t put_varint(uint8_t *out, uint32_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static inline uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static void put_u32le(uint8_t *out, uint32_t v)
+{
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+    out[2] = (uint8_t)(v >> 16);
+    out[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32le(const uint8_t *in)
+{
+    return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+// Bounds-checked cursor over a record body
+typedef struct
+{
+    const uint8_t *p;
+    size_t len;
+    size_t pos;
+    bool ok;
+} body_cursor_t;
+
+static uint32_t take_varint(body_cursor_t *c)
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 7 * VARINT_MAX_BYTES; shift += 7)
+    {
+        if (c->pos >= c->len)
+        {
+            break;
+        }
+        uint8_t b = c->p[c->pos++];
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+        {
+            return v;
+        }
+    }
+    c->ok = false;
+    return 0;
+}
+
+static uint32_t take_u32le(body_cursor_t *c)
+{
+    if (c->len - c->pos < 4)
+    {
+        c->ok = false;
+        return 0;
+    }
+    uint32_t v = get_u32le(&c->p[c->pos]);
+    c->pos += 4;
+    return v;
+}
+
+// --- Writer ---
+
+static esp_err_t writer_flush(patch_writer_t *w)
+{
+    if (w->error == ESP_OK && w->buf_len > 0)
+    {
+        w->error = w->write_fn(w->buf, w->buf_len, w->ctx);
+        w->buf_len = 0;
+    }
+    return w->error;
+}
+
+static void writer_put(patch_writer_t *w, const uint8_t *data, size_t len)
+{
+    w->bank_crc = patch_format_crc32(w->bank_crc, data, len);
+    if (w->in_patch)
+    {
+        w->patch_crc = patch_format_crc32(w->patch_crc, data, len);
+    }
+    while (len > 0 && w->error == ESP_OK)
+    {
+        size_t n = sizeof(w->buf) - w->buf_len;
+        n = n < len ? n : len;
+        memcpy(&w->buf[w->buf_len], data, n);
+        w->buf_len += n;
+        data += n;
+        len -= n;
+        if (w->buf_len == sizeof(w->buf))
+        {
+            writer_flush(w);
+        }
+    }
+}
+
+static esp_err_t writer_record(patch_writer_t *w, uint8_t type, const uint8_t *body, size_t body_len)
+{
+    uint8_t head[1 + VARINT_MAX_BYTES];
+    if (w->error != ESP_OK)
+    {
+        return w->error;
+    }
+    head[0] = type;
+    size_t head_len = 1 + put_varint(&head[1], (uint32_t)body_len);
+    writer_put(w, head, head_len);
+    writer_put(w, body, body_len);
+    return w->error;
+}
+
+esp_err_t patch_writer_begin(patch_writer_t *w, patch_format_write_fn_t write_fn, void *ctx)
+{
+    if (w == NULL || write_fn == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(w, 0, sizeof(*w));
+    w->write_fn = write_fn;
+    w->ctx = ctx;
+
+    uint8_t header[PATCH_FORMAT_HEADER_SIZE];
+    put_u32le(header, PATCH_FORMAT_MAGIC);
+    header[4] = PATCH_FORMAT_VERSION;
+    header[5] = 0; // Flags
+    writer_put(w, header, sizeof(header));
+    return w->error;
+}
+
+esp_err_t patch_writer_begin_patch(patch_writer_t *w, const patch_format_patch_t *patch)
+{
+    uint8_t body[2 * VARINT_MAX_BYTES + PATCH_FORMAT_MAX_NAME];
+    if (w->error != ESP_OK)
+    {
+        return w->error;
+    }
+    if (w->in_patch)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    size_t name_len = strnlen(patch->name, PATCH_FORMAT_MAX_NAME);
+    size_t n = put_varint(body, patch->index);
+    n += put_varint(&body[n], (uint32_t)name_len);
+    memcpy(&body[n], patch->name, name_len);
+    n += name_len;
+
+    w->in_patch = true;
+    w->patch_crc = 0;
+    return writer_record(w, PATCH_REC_PATCH_BEGIN, body, n);
+}
+
+esp_err_t patch_writer_module(patch_writer_t *w, const patch_format_module_t *module)
+{
+    uint8_t body[5 * VARINT_MAX_BYTES];
+    if (!w->in_patch)
+    {
+        return w->error != ESP_OK ? w->error : ESP_ERR_INVALID_STATE;
+    }
+    size_t n = put_varint(body, module->module_id);
+    n += put_varint(&body[n], module->mux_channel);
+    n += put_varint(&body[n], module->address);
+    n += put_varint(&body[n], module->module_type);
+    n += put_varint(&body[n], module->fw_version);
+    return writer_record(w, PATCH_REC_MODULE, body, n);
+}
+
+esp_err_t patch_writer_connection(patch_writer_t *w, const patch_format_connection_t *conn)
+{
+    uint8_t body[5 * VARINT_MAX_BYTES];
+    if (!w->in_patch)
+    {
+        return w->error != ESP_OK ? w->error : ESP_ERR_INVALID_STATE;
+    }
+    size_t n = put_varint(body, conn->src_module);
+    n += put_varint(&body[n], conn->src_port);
+    n += put_varint(&body[n], conn->dst_module);
+    n += put_varint(&body[n], conn->dst_port);
+    n += put_varint(&body[n], conn->flags);
+    return writer_record(w, PATCH_REC_CONNECTION, body, n);
+}
+
+esp_err_t patch_writer_param(patch_writer_t *w, const patch_format_param_t *param)
+{
+    uint8_t body[3 * VARINT_MAX_BYTES];
+    if (!w->in_patch)
+    {
+        return w->error != ESP_OK ? w->error : ESP_ERR_INVALID_STATE;
+    }
+    size_t n = put_varint(body, param->module_id);
+    n += put_varint(&body[n], param->param_id);
+    n += put_varint(&body[n], zigzag(param->value));
+    return writer_record(w, PATCH_REC_PARAM, body, n);
+}
+
+esp_err_t patch_writer_end_patch(patch_writer_t *w)
+{
+    uint8_t body[4];
+    if (!w->in_patch)
+    {
+        return w->error != ESP_OK ? w->error : ESP_ERR_INVALID_STATE;
+    }
+    put_u32le(body, w->patch_crc); // Covers PATCH_BEGIN up to here
+    w->in_patch = false;
+    w->patch_count++;
+    return writer_record(w, PATCH_REC_PATCH_END, body, sizeof(body));
+}
+
+esp_err_t patch_writer_finish(patch_writer_t *w)
+{
+    uint8_t body[VARINT_MAX_BYTES + 4];
+    if (w->error != ESP_OK)
+    {
+        return w->error;
+    }
+    if (w->in_patch)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    size_t n = put_varint(body, w->patch_count);
+    put_u32le(&body[n], w->bank_crc); // Covers every byte before this record
+    writer_record(w, PATCH_REC_BANK_END, body, n + 4);
+    return writer_flush(w);
+}
+
+// --- Reader ---
+
+void patch_reader_init(patch_reader_t *r, const patch_reader_callbacks_t *cbs)
+{
+    memset(r, 0, sizeof(*r));
+    r->cbs = cbs;
+    r->state = READ_HEADER;
+}
+
+bool patch_reader_done(const patch_reader_t *r)
+{
+    return r->state == READ_DONE;
+}
+
+static bool known_type(uint8_t type)
+{
+    return (type >= PATCH_REC_PATCH_BEGIN && type <= PATCH_REC_PATCH_END) || type == PATCH_REC_BANK_END;
+}
+
+// Decode and dispatch a complete record held in r->body
+static esp_err_t reader_dispatch(patch_reader_t *r)
+{
+    const patch_reader_callbacks_t *cbs = r->cbs;
+    body_cursor_t c = {.p = r->body, .len = r->len, .pos = 0, .ok = true};
+    esp_err_t ret = ESP_OK;
+
+    // Only the patch structure records are order-checked; data records need an open patch
+    if (r->type != PATCH_REC_PATCH_BEGIN && r->type != PATCH_REC_BANK_END && known_type(r->type) && !r->in_patch)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    switch (r->type)
+    {
+    case PATCH_REC_PATCH_BEGIN:
+    {
+        if (r->in_patch)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+        patch_format_patch_t patch = {0};
+        patch.index = take_varint(&c);
+        uint32_t name_len = take_varint(&c);
+        if (!c.ok || name_len > PATCH_FORMAT_MAX_NAME || name_len > c.len - c.pos)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(patch.name, &c.p[c.pos], name_len);
+        r->in_patch = true;
+        r->patch_index = patch.index;
+        if (cbs->on_patch_begin)
+        {
+            ret = cbs->on_patch_begin(&patch, cbs->ctx);
+        }
+        break;
+    }
+    case PATCH_REC_MODULE:
+    {
+        patch_format_module_t m;
+        m.module_id = (uint16_t)take_varint(&c);
+        m.mux_channel = (uint8_t)take_varint(&c);
+        m.address = (uint8_t)take_varint(&c);
+        m.module_type = take_varint(&c);
+        m.fw_version = (uint16_t)take_varint(&c);
+        if (!c.ok)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (cbs->on_module)
+        {
+            ret = cbs->on_module(&m, cbs->ctx);
+        }
+        break;
+    }
+    case PATCH_REC_CONNECTION:
+    {
+        patch_format_connection_t conn;
+        conn.src_module = (uint16_t)take_varint(&c);
+        conn.src_port = (uint8_t)take_varint(&c);
+        conn.dst_module = (uint16_t)take_varint(&c);
+        conn.dst_port = (uint8_t)take_varint(&c);
+        conn.flags = (uint8_t)take_varint(&c);
+        if (!c.ok)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (cbs->on_connection)
+        {
+            ret = cbs->on_connection(&conn, cbs->ctx);
+        }
+        break;
+    }
+    case PATCH_REC_PARAM:
+    {
+        patch_format_param_t param;
+        param.module_id = (uint16_t)take_varint(&c);
+        param.param_id = (uint16_t)take_varint(&c);
+        param.value = unzigzag(take_varint(&c));
+        if (!c.ok)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (cbs->on_param)
+        {
+            ret = cbs->on_param(&param, cbs->ctx);
+        }
+        break;
+    }
+    case PATCH_REC_PATCH_END:
+    {
+        uint32_t crc = take_u32le(&c);
+        if (!c.ok)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (crc != r->record_patch_crc)
+        {
+            return ESP_ERR_INVALID_CRC;
+        }
+        r->in_patch = false;
+        r->patch_crc_active = false;
+        r->patch_count++;
+        if (cbs->on_patch_end)
+        {
+            ret = cbs->on_patch_end(r->patch_index, cbs->ctx);
+        }
+        break;
+    }
+    case PATCH_REC_BANK_END:
+    {
+        if (r->in_patch)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+        uint32_t count = take_varint(&c);
+        uint32_t crc = take_u32le(&c);
+        if (!c.ok)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (crc != r->record_bank_crc)
+        {
+            return ESP_ERR_INVALID_CRC;
+        }
+        if (count != r->patch_count)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        r->state = READ_DONE;
+        break;
+    }
+    default:
+        break; // Unknown record from a newer writer: skipped
+    }
+    return ret;
+}
+
+esp_err_t patch_reader_feed(patch_reader_t *r, const void *data, size_t len, size_t *consumed)
+{
+    const uint8_t *p = data;
+    size_t i = 0;
+
+    while (i < len && r->error == ESP_OK && r->state != READ_DONE)
+    {
+        uint8_t b = p[i++];
+
+        if (r->state == READ_TYPE)
+        {
+            // CRCs stored in END records cover everything before the record
+            r->record_bank_crc = r->bank_crc;
+            r->record_patch_crc = r->patch_crc;
+            if (b == PATCH_REC_PATCH_BEGIN && !r->in_patch)
+            {
+                r->patch_crc = 0;
+                r->patch_crc_active = true; // The patch CRC starts at its PATCH_BEGIN
+            }
+        }
+        r->bank_crc = patch_format_crc32(r->bank_crc, &b, 1);
+        if (r->patch_crc_active)
+        {
+            r->patch_crc = patch_format_crc32(r->patch_crc, &b, 1);
+        }
+
+        switch (r->state)
+        {
+        case READ_HEADER:
+            r->header[r->body_pos++] = b;
+            if (r->body_pos == PATCH_FORMAT_HEADER_SIZE)
+            {
+                if (get_u32le(r->header) != PATCH_FORMAT_MAGIC)
+                {
+                    r->error = ESP_ERR_INVALID_RESPONSE;
+                }
+                else if (r->header[4] != PATCH_FORMAT_VERSION)
+                {
+                    r->error = ESP_ERR_INVALID_VERSION;
+                }
+                r->body_pos = 0;
+                r->state = READ_TYPE;
+            }
+            break;
+
+        case READ_TYPE:
+            r->type = b;
+            r->len = 0;
+            r->len_shift = 0;
+            r->state = READ_LEN;
+            break;
+
+        case READ_LEN:
+            r->len |= (uint32_t)(b & 0x7F) << r->len_shift;
+            r->len_shift += 7;
+            if (b & 0x80)
+            {
+                if (r->len_shift >= 7 * VARINT_MAX_BYTES)
+                {
+                    r->error = ESP_ERR_INVALID_SIZE;
+                }
+                break;
+            }
+            if (known_type(r->type) && r->len > PATCH_FORMAT_MAX_BODY)
+            {
+                r->error = ESP_ERR_INVALID_SIZE;
+                break;
+            }
+            r->body_pos = 0;
+            r->state = READ_BODY;
+            if (r->len > 0)
+            {
+                break;
+            }
+            // Empty body: complete now
+            r->error = reader_dispatch(r);
+            if (r->state != READ_DONE)
+            {
+                r->state = READ_TYPE;
+            }
+            break;
+
+        case READ_BODY:
+            if (r->body_pos < PATCH_FORMAT_MAX_BODY)
+            {
+                r->body[r->body_pos] = b; // Unknown records longer than this are skipped, not stored
+            }
+            if (++r->body_pos == r->len)
+            {
+                r->error = reader_dispatch(r);
+                if (r->state != READ_DONE)
+                {
+                    r->state = READ_TYPE;
+                }
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (consumed)
+    {
+        *consumed = i;
+    }
+    return r->error;
+}
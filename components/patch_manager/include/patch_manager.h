@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h> // For bool type
 #include <stddef.h>  // For size_t
+#include "freertos/FreeRTOS.h" // For UBaseType_t
 
 // Define basic types for identifying modules and their ports (inputs/outputs)
 // These might become more complex later.
@@ -19,8 +20,42 @@ typedef struct
     port_id_t dest_port;
     // Add other potential attributes like connection type (audio, cv), status etc.
     bool is_active;
+    bool is_feedback; // Connection closes a loop; excluded from ordering and latency
+
 } patch_connection_t;
 
+// Connection store capacity and memory usage
+typedef struct
+{
+    size_t connection_count; // Connections currently stored
+    size_t capacity;         // Rows allocated (grows on demand)
+    size_t max_connections;  // Hard limit (CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS)
+    size_t column_bytes;     // Connection data, in PSRAM when available
+    size_t index_bytes;      // Lookup index, always in internal RAM
+    bool columns_in_psram;   // Whether the connection data was placed in PSRAM
+} patch_storage_info_t;
+
+// Persistence: a snapshot plus an append-only journal of edits in the "patch_nvs" partition
+typedef struct
+{
+    size_t task_stack_size;    // Stack size for the background compaction task
+    UBaseType_t task_priority; // Low; compaction is a long run of flash writes
+    int task_core_id;          // Core to pin the task to (0, 1, or tskNO_AFFINITY)
+} patch_journal_config_t;
+
+typedef struct
+{
+    uint32_t snapshot_connections; // Connections in the current snapshot
+    uint32_t journal_entries;      // Edits journaled since that snapshot
+    uint32_t replayed;             // Journal entries replayed at boot
+    uint32_t appends;              // Edits journaled since boot
+    uint32_t append_failures;      // Appends that failed (each schedules a snapshot)
+    uint32_t last_append_us;
+    uint32_t max_append_us;
+    uint32_t compactions;
+    uint32_t last_compaction_us;
+} patch_journal_stats_t;
+
 /**
  * @brief Initialize the Patch Manager.
  *
@@ -44,7 +79,8 @@ esp_err_t patch_manager_init(void);
  * @param source_port_id ID of the source port on the source module.
  * @param dest_module_id ID of the destination module.
  * @param dest_port_id ID of the destination port on the destination module.
- * @return ESP_OK on success, ESP_FAIL or other error code on failure.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the connection already exists,
+ *         ESP_ERR_NO_MEM if the store or module graph is full, or another error code on failure.
  */
 esp_err_t patch_manager_add_connection(module_id_t source_module_id, port_id_t source_port_id, module_id_t dest_module_id, port_id_t dest_port_id);
 
@@ -65,6 +101,22 @@ esp_err_t patch_manager_add_connection(module_id_t source_module_id, port_id_t s
  */
 esp_err_t patch_manager_remove_connection(module_id_t source_module_id, port_id_t source_port_id, module_id_t dest_module_id, port_id_t dest_port_id);
 
+/**
+ * @brief Replace the whole patch with a new set of connections, all or nothing.
+ *
+ * Either every connection is added and the previous patch is gone, or (on any failure)
+ * the previous patch is put back and the error returned. Once restored, the new patch is
+ * saved as one snapshot before the call returns, rather than journaling a remove per old
+ * and an add per new connection; if that write fails the change is rolled back too.
+ *
+ * @param connections New connections (only the module and port fields are used).
+ * @param count Number of connections; 0 clears the patch.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on NULL with a non-zero count,
+ *         ESP_ERR_INVALID_STATE on a duplicate connection, ESP_ERR_NO_MEM if the set does not
+ *         fit the store or module graph, or the NVS error that prevented saving it.
+ */
+esp_err_t patch_manager_replace_connections(const patch_connection_t *connections, size_t count);
+
 /**
  * @brief Get the current list of active patch connections.
  *
@@ -75,4 +127,96 @@ esp_err_t patch_manager_remove_connection(module_id_t source_module_id, port_id_
  * @param[out] count Pointer to store the actual number of active connections written to the buffer.
  * @return ESP_OK on success, or an error code.
  */
-esp_err_t patch_manager_get_connections(patch_connection_t *connections_buffer, size_t buffer_size, size_t *count);
\ No newline at end of file
+esp_err_t patch_manager_get_connections(patch_connection_t *connections_buffer, size_t buffer_size, size_t *count);
+
+/**
+ * @brief Get a page of connections, starting at position `first` of the current list.
+ *
+ * Lets callers walk a large patch with a small buffer (e.g. streaming export). Positions
+ * are only stable while the patch is not modified.
+ *
+ * @param first Position of the first connection to copy.
+ * @param[out] connections_buffer Pointer to an array to store the connections.
+ * @param buffer_size The maximum number of connections the buffer can hold.
+ * @param[out] count Number of connections written (0 once `first` is past the end).
+ * @return ESP_OK on success, or an error code.
+ */
+esp_err_t patch_manager_get_connections_from(size_t first, patch_connection_t *connections_buffer, size_t buffer_size, size_t *count);
+
+// --- Graph Queries ---
+// The patch is also maintained as a module graph, updated incrementally on every
+// add/remove, so these queries never walk the connection list.
+
+/**
+ * @brief Get the worst-case accumulated I2S TDM hop latency from one module to another.
+ *
+ * Constant time: a table lookup in the incrementally maintained graph.
+ * Feedback connections are not counted.
+ *
+ * @param from_module Upstream module (e.g. an oscillator).
+ * @param to_module Downstream module (e.g. the output).
+ * @param[out] latency_samples Longest path latency in samples (hops x CONFIG_CENTRAL_PATCH_HOP_LATENCY_SAMPLES).
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no signal path exists, ESP_ERR_INVALID_ARG on NULL output.
+ */
+esp_err_t patch_manager_get_path_latency(module_id_t from_module, module_id_t to_module, uint32_t *latency_samples);
+
+/**
+ * @brief Get the number of feedback loops (module pairs joined by a loop-closing connection).
+ *
+ * @param[out] count Number of feedback connections by module pair.
+ * @return ESP_OK on success.
+ */
+esp_err_t patch_manager_get_feedback_count(size_t *count);
+
+/**
+ * @brief Get the modules in topological (signal-flow) order, sources first.
+ *
+ * @param[out] modules_buffer Buffer to receive module IDs.
+ * @param buffer_size Capacity of the buffer.
+ * @param[out] count Number of module IDs written.
+ * @return ESP_OK on success.
+ */
+esp_err_t patch_manager_get_module_order(module_id_t *modules_buffer, size_t buffer_size, size_t *count);
+
+/**
+ * @brief Get connection store capacity and memory usage.
+ *
+ * @param[out] info Destination.
+ * @return ESP_OK on success.
+ */
+esp_err_t patch_manager_get_storage_info(patch_storage_info_t *info);
+
+// --- Persistence ---
+// Each successful add/remove is appended to the journal as one 8-byte NVS entry before
+// the call returns; the whole matrix is only rewritten when a background task folds the
+// journal into a new snapshot (every CONFIG_CENTRAL_PATCH_JOURNAL_COMPACT_ENTRIES edits),
+// or directly by patch_manager_replace_connections().
+// Every flash write is atomic, so a power cut at any moment restores the patch as of the
+// last completed edit.
+
+/**
+ * @brief Restore the saved patch (snapshot, then journal) and start persisting edits.
+ *
+ * Call once, after patch_manager_init() and on the still-empty patch. Edits made before
+ * this call are not saved.
+ *
+ * @param config Compaction task settings.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the patch is not empty or already
+ *         restored, or the NVS error that prevented mounting the journal partition.
+ */
+esp_err_t patch_manager_restore(const patch_journal_config_t *config);
+
+/**
+ * @brief Ask the compaction task to write a snapshot now (e.g. before a planned power-off).
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE before patch_manager_restore().
+ */
+esp_err_t patch_manager_compact_journal(void);
+
+/**
+ * @brief Get journal and snapshot counters.
+ *
+ * @param[out] stats Destination.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on NULL.
+ */
+esp_err_t patch_manager_get_journal_stats(patch_journal_stats_t *stats);
@@ -0,0 +1,456 @@
+#include "patch_graph.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "PATCH_GRAPH";
+
+#define MAX_NODES PATCH_GRAPH_MAX_NODES
+#define NODE_HASH_SIZE 256 // Power of two, at least 2x MAX_NODES
+#define NO_PATH 0xFF       // Marker in the hop matrix: target not reachable
+#define NO_NODE 0xFF
+
+_Static_assert(CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS < UINT16_MAX, "Pair multiplicities are 16-bit");
+
+// --- State ---
+// Matrices are indexed by node slot. hops[x][y] is the longest hop count on
+// any path x -> y through normal (non-feedback) edges, kept up to date on every
+// edge change so queries are a single lookup.
+
+static module_id_t node_module[MAX_NODES];
+static bool node_used[MAX_NODES];
+static uint32_t node_degree[MAX_NODES]; // Total edge multiplicity touching the node (a self-loop counts twice)
+static uint8_t node_ord[MAX_NODES];     // Position in the topological order
+static uint8_t ord_node[MAX_NODES];     // Node at each position [0, node_count)
+static size_t node_count = 0;
+
+static uint8_t node_hash[NODE_HASH_SIZE]; // Open addressing: node slot + 1, 0 = empty
+
+static uint16_t edge_mult[MAX_NODES][MAX_NODES];     // Normal connections per module pair
+static uint16_t feedback_mult[MAX_NODES][MAX_NODES]; // Loop-closing connections per module pair
+static uint8_t hops[MAX_NODES][MAX_NODES];
+static size_t feedback_pairs = 0;
+
+// Scratch for Pearce-Kelly reordering and incremental removal
+static bool visited[MAX_NODES];
+static uint8_t fwd_set[MAX_NODES];
+static uint8_t back_set[MAX_NODES];
+static uint8_t scratch_pos[MAX_NODES];
+
+// --- Node Lookup ---
+
+static inline size_t hash_slot(module_id_t id)
+{
+    return ((uint32_t)id * 2654435761u) >> 24 & (NODE_HASH_SIZE - 1);
+}
+
+static uint8_t find_node(module_id_t id)
+{
+    for (size_t h = hash_slot(id);; h = (h + 1) & (NODE_HASH_SIZE - 1))
+    {
+        uint8_t entry = node_hash[h];
+        if (entry == 0)
+        {
+            return NO_NODE;
+        }
+        if (node_module[entry - 1] == id)
+        {
+            return entry - 1;
+        }
+    }
+}
+
+static uint8_t get_or_create_node(module_id_t id)
+{
+    uint8_t n = find_node(id);
+    if (n != NO_NODE)
+    {
+        return n;
+    }
+    if (node_count >= MAX_NODES)
+    {
+        return NO_NODE;
+    }
+
+    for (n = 0; n < MAX_NODES && node_used[n]; ++n)
+    {
+    }
+
+    node_used[n] = true;
+    node_module[n] = id;
+    node_degree[n] = 0;
+    for (int i = 0; i < MAX_NODES; ++i)
+    {
+        hops[n][i] = NO_PATH;
+        hops[i][n] = NO_PATH;
+    }
+    hops[n][n] = 0;
+
+    // A new node has no edges, so the end of the order is always valid
+    node_ord[n] = (uint8_t)node_count;
+    ord_node[node_count++] = n;
+
+    size_t h = hash_slot(id);
+    while (node_hash[h] != 0)
+    {
+        h = (h + 1) & (NODE_HASH_SIZE - 1);
+    }
+    node_hash[h] = n + 1;
+    return n;
+}
+
+// Drop a node whose last edge was removed. Its matrix rows are already empty.
+static void release_node(uint8_t n)
+{
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    size_t h = hash_slot(node_module[n]);
+    while (node_hash[h] != n + 1)
+    {
+        h = (h + 1) & (NODE_HASH_SIZE - 1);
+    }
+    size_t hole = h;
+    for (size_t j = (hole + 1) & (NODE_HASH_SIZE - 1); node_hash[j] != 0; j = (j + 1) & (NODE_HASH_SIZE - 1))
+    {
+        size_t home = hash_slot(node_module[node_hash[j] - 1]);
+        // Move the entry back if its home position is not between the hole and its slot (cyclically)
+        if (((j - home) & (NODE_HASH_SIZE - 1)) >= ((j - hole) & (NODE_HASH_SIZE - 1)))
+        {
+            node_hash[hole] = node_hash[j];
+            hole = j;
+        }
+    }
+    node_hash[hole] = 0;
+
+    // Close the gap in the order; relative order of the rest is unchanged
+    for (size_t p = node_ord[n]; p + 1 < node_count; ++p)
+    {
+        ord_node[p] = ord_node[p + 1];
+        node_ord[ord_node[p]] = (uint8_t)p;
+    }
+    node_count--;
+    node_used[n] = false;
+}
+
+// --- Topological Order (Pearce-Kelly) ---
+
+static void dfs_forward(uint8_t n, uint8_t upper, size_t *count)
+{
+    visited[n] = true;
+    fwd_set[(*count)++] = n;
+    for (uint8_t s = 0; s < MAX_NODES; ++s)
+    {
+        if (edge_mult[n][s] && !visited[s] && node_ord[s] <= upper)
+        {
+            dfs_forward(s, upper, count);
+        }
+    }
+}
+
+static void dfs_backward(uint8_t n, uint8_t lower, size_t *count)
+{
+    visited[n] = true;
+    back_set[(*count)++] = n;
+    for (uint8_t p = 0; p < MAX_NODES; ++p)
+    {
+        if (edge_mult[p][n] && !visited[p] && node_ord[p] >= lower)
+        {
+            dfs_backward(p, lower, count);
+        }
+    }
+}
+
+static void sort_by_ord(uint8_t *nodes, size_t count)
+{
+    // Affected regions are small; insertion sort avoids qsort's callback overhead
+    for (size_t i = 1; i < count; ++i)
+    {
+        uint8_t n = nodes[i];
+        size_t j = i;
+        while (j > 0 && node_ord[nodes[j - 1]] > node_ord[n])
+        {
+            nodes[j] = nodes[j - 1];
+            j--;
+        }
+        nodes[j] = n;
+    }
+}
+
+// Restore a valid order after adding u -> v where v currently precedes u.
+// Only nodes between the two positions are touched.
+static void reorder_after_insert(uint8_t u, uint8_t v)
+{
+    uint8_t lower = node_ord[v];
+    uint8_t upper = node_ord[u];
+    size_t fwd_count = 0;
+    size_t back_count = 0;
+
+    memset(visited, 0, sizeof(visited));
+    dfs_forward(v, upper, &fwd_count);
+    dfs_backward(u, lower, &back_count);
+
+    sort_by_ord(fwd_set, fwd_count);
+    sort_by_ord(back_set, back_count);
+
+    // Pool the positions both sets occupied, then hand them out: everything
+    // that reaches u first, everything reachable from v after.
+    size_t total = 0;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < back_count || j < fwd_count)
+    {
+        if (j >= fwd_count || (i < back_count && node_ord[back_set[i]] < node_ord[fwd_set[j]]))
+        {
+            scratch_pos[total++] = node_ord[back_set[i++]];
+        }
+        else
+        {
+            scratch_pos[total++] = node_ord[fwd_set[j++]];
+        }
+    }
+
+    size_t p = 0;
+    for (i = 0; i < back_count; ++i, ++p)
+    {
+        node_ord[back_set[i]] = scratch_pos[p];
+        ord_node[scratch_pos[p]] = back_set[i];
+    }
+    for (j = 0; j < fwd_count; ++j, ++p)
+    {
+        node_ord[fwd_set[j]] = scratch_pos[p];
+        ord_node[scratch_pos[p]] = fwd_set[j];
+    }
+}
+
+// --- Longest-Path Maintenance ---
+
+// New edge u -> v: any path x -> u can now continue to anything v reaches
+static void hops_after_insert(uint8_t u, uint8_t v)
+{
+    for (uint8_t x = 0; x < MAX_NODES; ++x)
+    {
+        if (hops[x][u] == NO_PATH)
+        {
+            continue;
+        }
+        for (uint8_t y = 0; y < MAX_NODES; ++y)
+        {
+            if (hops[v][y] == NO_PATH)
+            {
+                continue;
+            }
+            uint8_t candidate = hops[x][u] + 1 + hops[v][y];
+            if (hops[x][y] == NO_PATH || candidate > hops[x][y])
+            {
+                hops[x][y] = candidate;
+            }
+        }
+    }
+}
+
+// Edge u -> v was the last connection between the pair. Only pairs (x, y) with
+// x reaching u and v reaching y can change; recompute just that block from each
+// x's successors, walking x in reverse topological order so successors are final.
+static void hops_after_remove(uint8_t u, uint8_t v, const uint8_t *sources, size_t source_count,
+                              const uint8_t *targets, size_t target_count)
+{
+    for (size_t i = source_count; i-- > 0;)
+    {
+        uint8_t x = sources[i];
+        for (size_t t = 0; t < target_count; ++t)
+        {
+            uint8_t y = targets[t];
+            if (x == y)
+            {
+                continue;
+            }
+            uint8_t best = NO_PATH;
+            for (uint8_t s = 0; s < MAX_NODES; ++s)
+            {
+                if (edge_mult[x][s] && hops[s][y] != NO_PATH &&
+                    (best == NO_PATH || hops[s][y] + 1 > best))
+                {
+                    best = hops[s][y] + 1;
+                }
+            }
+            hops[x][y] = best;
+        }
+    }
+}
+
+static void insert_normal_edge(uint8_t u, uint8_t v)
+{
+    if (edge_mult[u][v]++ != 0)
+    {
+        return; // Parallel connection: same hop, nothing derived changes
+    }
+    if (node_ord[v] < node_ord[u])
+    {
+        reorder_after_insert(u, v);
+    }
+    hops_after_insert(u, v);
+}
+
+// Promote feedback edges whose loop has been broken. Loops are rare and small,
+// so a scan of the pair table after a removal is cheap.
+static void promote_feedback_edges(void)
+{
+    for (uint8_t a = 0; a < MAX_NODES && feedback_pairs > 0; ++a)
+    {
+        for (uint8_t b = 0; b < MAX_NODES; ++b)
+        {
+            if (feedback_mult[a][b] == 0 || a == b || hops[b][a] != NO_PATH)
+            {
+                continue;
+            }
+            uint16_t mult = feedback_mult[a][b];
+            feedback_mult[a][b] = 0;
+            feedback_pairs--;
+            insert_normal_edge(a, b);
+            edge_mult[a][b] += mult - 1;
+            ESP_LOGD(TAG, "Loop broken, %d -> %d is no longer feedback", node_module[a], node_module[b]);
+        }
+    }
+}
+
+// --- Public (component-internal) API ---
+
+void patch_graph_init(void)
+{
+    memset(node_used, 0, sizeof(node_used));
+    memset(node_hash, 0, sizeof(node_hash));
+    memset(edge_mult, 0, sizeof(edge_mult));
+    memset(feedback_mult, 0, sizeof(feedback_mult));
+    memset(hops, NO_PATH, sizeof(hops));
+    node_count = 0;
+    feedback_pairs = 0;
+}
+
+esp_err_t patch_graph_add_edge(module_id_t src, module_id_t dst, bool *is_feedback)
+{
+    uint8_t u = get_or_create_node(src);
+    uint8_t v = get_or_create_node(dst);
+    if (u == NO_NODE || v == NO_NODE)
+    {
+        ESP_LOGE(TAG, "Module table full (%d modules)", MAX_NODES);
+        // Undo a node created for the side that did fit
+        if (u != NO_NODE && node_degree[u] == 0)
+        {
+            release_node(u);
+        }
+        if (v != NO_NODE && node_degree[v] == 0)
+        {
+            release_node(v);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
+    node_degree[u]++;
+    node_degree[v]++;
+
+    // Reachability is known for every pair, so loop detection is one lookup
+    bool closes_loop = (u == v) || (hops[v][u] != NO_PATH);
+    if (closes_loop)
+    {
+        if (feedback_mult[u][v]++ == 0)
+        {
+            feedback_pairs++;
+        }
+        ESP_LOGW(TAG, "Connection %d -> %d closes a feedback loop", src, dst);
+    }
+    else
+    {
+        insert_normal_edge(u, v);
+    }
+
+    if (is_feedback)
+    {
+        *is_feedback = closes_loop;
+    }
+    return ESP_OK;
+}
+
+esp_err_t patch_graph_remove_edge(module_id_t src, module_id_t dst)
+{
+    uint8_t u = find_node(src);
+    uint8_t v = find_node(dst);
+    if (u == NO_NODE || v == NO_NODE || (edge_mult[u][v] == 0 && feedback_mult[u][v] == 0))
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (feedback_mult[u][v] > 0)
+    {
+        // Feedback edges never entered the order or hop matrix
+        if (--feedback_mult[u][v] == 0)
+        {
+            feedback_pairs--;
+        }
+    }
+    else if (--edge_mult[u][v] == 0)
+    {
+        // Capture the affected block while the old reachability is still intact.
+        // Sources are gathered in topological order for the recompute pass.
+        size_t source_count = 0;
+        size_t target_count = 0;
+        for (size_t p = 0; p < node_count; ++p)
+        {
+            uint8_t n = ord_node[p];
+            if (hops[n][u] != NO_PATH)
+            {
+                back_set[source_count++] = n;
+            }
+            if (hops[v][n] != NO_PATH)
+            {
+                fwd_set[target_count++] = n;
+            }
+        }
+        hops_after_remove(u, v, back_set, source_count, fwd_set, target_count);
+        // Removing an edge never invalidates a topological order
+        promote_feedback_edges();
+    }
+
+    node_degree[u]--;
+    node_degree[v]--;
+    if (node_degree[u] == 0)
+    {
+        release_node(u);
+    }
+    if (v != u && node_degree[v] == 0)
+    {
+        release_node(v);
+    }
+    return ESP_OK;
+}
+
+bool patch_graph_is_feedback(module_id_t src, module_id_t dst)
+{
+    uint8_t u = find_node(src);
+    uint8_t v = find_node(dst);
+    return u != NO_NODE && v != NO_NODE && feedback_mult[u][v] > 0;
+}
+
+esp_err_t patch_graph_path_hops(module_id_t from, module_id_t to, uint32_t *out_hops)
+{
+    uint8_t x = find_node(from);
+    uint8_t y = find_node(to);
+    if (x == NO_NODE || y == NO_NODE || hops[x][y] == NO_PATH)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *out_hops = hops[x][y];
+    return ESP_OK;
+}
+
+size_t patch_graph_feedback_count(void)
+{
+    return feedback_pairs;
+}
+
+size_t patch_graph_topo_order(module_id_t *buffer, size_t buffer_size)
+{
+    size_t n = (node_count < buffer_size) ? node_count : buffer_size;
+    for (size_t p = 0; p < n; ++p)
+    {
+        buffer[p] = node_module[ord_node[p]];
+    }
+    return n;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+// Internal: incrementally maintained graph view of the patch matrix.
+// Nodes are modules, edges are connections (parallel connections between the
+// same two modules collapse into one edge with a multiplicity). All functions
+// must be called with patch_mutex held.
+
+#include "patch_manager.h"
+
+#define PATCH_GRAPH_MAX_NODES CONFIG_CENTRAL_PATCH_GRAPH_MAX_MODULES
+
+/**
+ * @brief Reset the graph to empty.
+ */
+void patch_graph_init(void);
+
+/**
+ * @brief Add one connection src -> dst.
+ * A connection that would close a loop is kept as a feedback edge: it is
+ * excluded from the topological order and latency accounting.
+ *
+ * @param[out] is_feedback Set to true if the edge closes a loop.
+ * @return ESP_OK, or ESP_ERR_NO_MEM if the module table is full.
+ */
+esp_err_t patch_graph_add_edge(module_id_t src, module_id_t dst, bool *is_feedback);
+
+/**
+ * @brief Remove one connection src -> dst previously added.
+ * Feedback edges that no longer close a loop are promoted to normal edges.
+ *
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND if no such edge exists.
+ */
+esp_err_t patch_graph_remove_edge(module_id_t src, module_id_t dst);
+
+/**
+ * @brief Whether the src -> dst edge is currently a feedback edge.
+ */
+bool patch_graph_is_feedback(module_id_t src, module_id_t dst);
+
+/**
+ * @brief Longest accumulated hop count from -> to (constant time).
+ *
+ * @param[out] hops Number of I2S TDM hops on the longest path.
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND if there is no path.
+ */
+esp_err_t patch_graph_path_hops(module_id_t from, module_id_t to, uint32_t *hops);
+
+/**
+ * @brief Number of feedback edges (distinct module pairs) in the patch.
+ */
+size_t patch_graph_feedback_count(void);
+
+/**
+ * @brief Copy the current topological order of modules (sources first).
+ *
+ * @return Number of modules written.
+ */
+size_t patch_graph_topo_order(module_id_t *buffer, size_t buffer_size);
@@ -0,0 +1,614 @@
+#include "patch_journal.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h" // For mutex
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "PATCH_JOURNAL";
+
+#define JOURNAL_PARTITION "patch_nvs" // See partitions.csv
+#define JOURNAL_NAMESPACE "patch"
+#define KEY_SNAPSHOT_SLOT "snap_slot" // u8: which of "snap0"/"snap1" is current
+#define KEY_MAX 16                    // NVS keys are at most 15 characters
+#define ERASE_BATCH 32                // Stale journal keys collected per iterator pass
+
+#define SNAPSHOT_MAGIC 0x50414E53u // "SNAP"
+#define SNAPSHOT_VERSION 1
+
+// NVS stores everything in 32-byte entries, 126 to a 4 KB page, and keeps one page
+// free for garbage collection. A blob is split into per-page chunks, each with a header
+// entry, plus one index entry.
+#define NVS_PAGE_SIZE 4096
+#define NVS_ENTRY_SIZE 32
+#define NVS_PAGE_ENTRIES 126
+
+#define JOURNAL_CAPS_PREFERRED (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define JOURNAL_CAPS_FALLBACK (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+// --- On-Flash Layout ---
+// Every write below is a single NVS entry write, which NVS makes atomic, so a power cut
+// leaves either the old or the new value of each key:
+//
+//   "j%08lx"   u64   one edit, keyed by sequence number (see pack_entry)
+//   "snap0/1"  blob  snapshot_header_t + connections, covering edits up to header.seq
+//   snap_slot  u8    current snapshot; switched only after the new blob is complete
+//
+// Boot loads the current snapshot and replays "j" entries from header.seq + 1 until the
+// first missing key. Compaction writes the other snapshot slot, switches snap_slot, then
+// erases the entries the snapshot covers; entries left over by a cut during the erase are
+// below the replay start, so they are ignored and swept by the next compaction. A bulk
+// replace writes a snapshot the same way, with patch_mutex held so no edit slips between
+// the copy and the switch.
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t seq;   // Last journal entry included
+    uint32_t count; // Connections that follow
+} snapshot_header_t;
+
+// --- State ---
+
+static nvs_handle_t journal_nvs = 0;
+static bool journal_open = false;
+static uint32_t last_seq = 0;     // Last appended entry (patch_mutex)
+static uint32_t snapshot_seq = 0; // Last entry covered by the current snapshot
+static uint8_t snapshot_slot = 0;
+static SemaphoreHandle_t snapshot_mutex = NULL; // One snapshot write at a time; taken after patch_mutex
+static uint32_t bulk_saves = 0;                 // Snapshots saved by bulk replaces (snapshot_mutex)
+static volatile bool compaction_requested = false;
+static volatile bool compaction_running = false; // Threshold requests wait for it to finish
+static TaskHandle_t compaction_task_handle = NULL;
+static patch_journal_stats_t stats = {0};
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// --- Encoding ---
+
+static uint64_t pack_entry(patch_journal_op_t op, module_id_t src_module, port_id_t src_port,
+                           module_id_t dst_module, port_id_t dst_port)
+{
+    return (uint64_t)op | ((uint64_t)src_module << 8) | ((uint64_t)src_port << 24) |
+           ((uint64_t)dst_module << 32) | ((uint64_t)dst_port << 48);
+}
+
+static void entry_key(char *key, uint32_t seq)
+{
+    snprintf(key, KEY_MAX, "j%08lx", (unsigned long)seq);
+}
+
+static void snapshot_key(char *key, uint8_t slot)
+{
+    snprintf(key, KEY_MAX, "snap%d", slot);
+}
+
+static void request_compaction(void)
+{
+    compaction_requested = true;
+    if (compaction_task_handle)
+    {
+        xTaskNotifyGive(compaction_task_handle);
+    }
+}
+
+// --- Partition Sizing ---
+
+static size_t blob_entries(size_t bytes)
+{
+    size_t data = (bytes + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE;
+    size_t chunks = (data + NVS_PAGE_ENTRIES - 2) / (NVS_PAGE_ENTRIES - 1);
+    return data + chunks + 1;
+}
+
+// Worst case the journal has to hold: both snapshot slots at full size (they coexist
+// during compaction) and the journal at twice the compaction threshold, since edits
+// keep being appended while a snapshot is written
+static esp_err_t check_partition_fits(void)
+{
+    const esp_partition_t *part =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS, JOURNAL_PARTITION);
+    if (part == NULL)
+    {
+        ESP_LOGE(TAG, "No '%s' partition, see partitions.csv", JOURNAL_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    size_t snapshot = sizeof(snapshot_header_t) + CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS * sizeof(patch_journal_conn_t);
+    size_t needed = 2 * blob_entries(snapshot) + 2 * CONFIG_CENTRAL_PATCH_JOURNAL_COMPACT_ENTRIES + 1;
+    size_t available = (part->size / NVS_PAGE_SIZE - 1) * NVS_PAGE_ENTRIES;
+    if (needed > available)
+    {
+        ESP_LOGE(TAG, "'%s' (%lu KB) cannot hold two %d-connection snapshots and %d journal entries: "
+                      "needs %d NVS entries, has %d. Lower CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS or "
+                      "CONFIG_CENTRAL_PATCH_JOURNAL_COMPACT_ENTRIES, or grow the partition.",
+                 JOURNAL_PARTITION, (unsigned long)(part->size / 1024), CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS,
+                 2 * CONFIG_CENTRAL_PATCH_JOURNAL_COMPACT_ENTRIES, needed, available);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+// --- Restore ---
+
+static esp_err_t load_snapshot(patch_journal_apply_fn_t apply)
+{
+    esp_err_t ret = nvs_get_u8(journal_nvs, KEY_SNAPSHOT_SLOT, &snapshot_slot);
+    if (ret == ESP_ERR_NVS_NOT_FOUND)
+    {
+        snapshot_slot = 0;
+        snapshot_seq = 0;
+        return ESP_OK; // Nothing saved yet: the journal alone is the patch
+    }
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    char key[KEY_MAX];
+    snapshot_key(key, snapshot_slot);
+    size_t len = 0;
+    ret = nvs_get_blob(journal_nvs, key, NULL, &len);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    uint8_t *blob = heap_caps_malloc(len, JOURNAL_CAPS_PREFERRED);
+    if (blob == NULL)
+    {
+        blob = heap_caps_malloc(len, JOURNAL_CAPS_FALLBACK);
+    }
+    if (blob == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ret = nvs_get_blob(journal_nvs, key, blob, &len);
+    const snapshot_header_t *hdr = (const snapshot_header_t *)blob;
+    if (ret == ESP_OK &&
+        (len < sizeof(*hdr) || hdr->magic != SNAPSHOT_MAGIC || hdr->version != SNAPSHOT_VERSION ||
+         len != sizeof(*hdr) + hdr->count * sizeof(patch_journal_conn_t)))
+    {
+        ret = ESP_ERR_INVALID_VERSION;
+    }
+    if (ret == ESP_OK)
+    {
+        const patch_journal_conn_t *conns = (const patch_journal_conn_t *)(blob + sizeof(*hdr));
+        for (uint32_t i = 0; i < hdr->count; ++i)
+        {
+            esp_err_t apply_ret = apply(PATCH_JOURNAL_OP_ADD, conns[i].src_module, conns[i].src_port,
+                                        conns[i].dst_module, conns[i].dst_port);
+            if (apply_ret != ESP_OK)
+            {
+                ESP_LOGW(TAG, "Snapshot connection %d:%d -> %d:%d not restored: %s", conns[i].src_module,
+                         conns[i].src_port, conns[i].dst_module, conns[i].dst_port, esp_err_to_name(apply_ret));
+            }
+        }
+        snapshot_seq = hdr->seq;
+        stats.snapshot_connections = hdr->count;
+    }
+
+    heap_caps_free(blob);
+    return ret;
+}
+
+static esp_err_t replay_journal(patch_journal_apply_fn_t apply)
+{
+    char key[KEY_MAX];
+    uint32_t seq = snapshot_seq;
+    for (;;)
+    {
+        uint64_t entry;
+        entry_key(key, seq + 1);
+        esp_err_t ret = nvs_get_u64(journal_nvs, key, &entry);
+        if (ret == ESP_ERR_NVS_NOT_FOUND)
+        {
+            break;
+        }
+        if (ret != ESP_OK)
+        {
+            return ret;
+        }
+        seq++;
+
+        // Ops are re-applied exactly as they were, so they succeed again; a failure only
+        // means the edit was already part of the snapshot
+        apply((patch_journal_op_t)(entry & 0xFF), (module_id_t)(entry >> 8), (port_id_t)(entry >> 24),
+              (module_id_t)(entry >> 32), (port_id_t)(entry >> 48));
+    }
+    last_seq = seq;
+    stats.replayed = seq - snapshot_seq;
+    stats.journal_entries = stats.replayed;
+    return ESP_OK;
+}
+
+esp_err_t patch_journal_open(patch_journal_apply_fn_t apply)
+{
+    if (journal_open)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Refuse up front rather than have every compaction fail once the patch grows
+    esp_err_t ret = check_partition_fits();
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    ret = nvs_flash_init_partition(JOURNAL_PARTITION);
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_LOGW(TAG, "Journal partition needs formatting, saved patch is lost");
+        ESP_ERROR_CHECK(nvs_flash_erase_partition(JOURNAL_PARTITION));
+        ret = nvs_flash_init_partition(JOURNAL_PARTITION);
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to mount '%s' partition: %s", JOURNAL_PARTITION, esp_err_to_name(ret));
+        return ret;
+    }
+    ret = nvs_open_from_partition(JOURNAL_PARTITION, JOURNAL_NAMESPACE, NVS_READWRITE, &journal_nvs);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to open journal namespace: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    if (snapshot_mutex == NULL)
+    {
+        snapshot_mutex = xSemaphoreCreateMutex();
+    }
+    if (snapshot_mutex == NULL)
+    {
+        nvs_close(journal_nvs);
+        return ESP_ERR_NO_MEM;
+    }
+
+    int64_t start = esp_timer_get_time();
+    ret = load_snapshot(apply);
+    if (ret == ESP_ERR_INVALID_VERSION)
+    {
+        // Written by an incompatible firmware: the journal cannot be replayed without it
+        ESP_LOGE(TAG, "Unreadable snapshot, starting with an empty patch");
+        nvs_erase_all(journal_nvs);
+        nvs_commit(journal_nvs);
+        snapshot_slot = 0;
+        snapshot_seq = 0;
+        ret = ESP_OK;
+    }
+    if (ret == ESP_OK)
+    {
+        ret = replay_journal(apply);
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to restore patch: %s", esp_err_to_name(ret));
+        nvs_close(journal_nvs);
+        return ret;
+    }
+
+    journal_open = true;
+    ESP_LOGI(TAG, "Restored %lu snapshot connections + %lu journal entries in %lu ms",
+             (unsigned long)stats.snapshot_connections, (unsigned long)stats.replayed,
+             (unsigned long)((esp_timer_get_time() - start) / 1000));
+    return ESP_OK;
+}
+
+// --- Append ---
+
+void patch_journal_append(patch_journal_op_t op, module_id_t src_module, port_id_t src_port,
+                          module_id_t dst_module, port_id_t dst_port)
+{
+    if (!journal_open)
+    {
+        return;
+    }
+
+    char key[KEY_MAX];
+    entry_key(key, last_seq + 1);
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = nvs_set_u64(journal_nvs, key, pack_entry(op, src_module, src_port, dst_module, dst_port));
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(journal_nvs);
+    }
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+
+    if (ret != ESP_OK)
+    {
+        // The sequence number is reused by the next edit; this one reaches flash with the snapshot
+        ESP_LOGE(TAG, "Journal append failed: %s, scheduling a snapshot", esp_err_to_name(ret));
+        portENTER_CRITICAL(&stats_lock);
+        stats.append_failures++;
+        portEXIT_CRITICAL(&stats_lock);
+        request_compaction();
+        return;
+    }
+
+    last_seq++;
+    uint32_t pending = last_seq - snapshot_seq;
+    portENTER_CRITICAL(&stats_lock);
+    stats.appends++;
+    stats.journal_entries = pending;
+    stats.last_append_us = us;
+    if (us > stats.max_append_us)
+    {
+        stats.max_append_us = us;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (pending >= CONFIG_CENTRAL_PATCH_JOURNAL_COMPACT_ENTRIES && !compaction_requested && !compaction_running)
+    {
+        request_compaction();
+    }
+}
+
+uint32_t patch_journal_last_seq(void)
+{
+    return last_seq;
+}
+
+// --- Compaction ---
+
+// Erase every journal entry the current snapshot covers, including leftovers from an
+// interrupted compaction. Entries are collected first, since erasing invalidates iterators.
+// Appends write the same namespace, so each batch (walk and erase) runs under patch_mutex;
+// `locked` says the caller already holds it.
+static void erase_covered_entries(uint32_t covered_seq, bool locked)
+{
+    char stale[ERASE_BATCH][KEY_MAX];
+    size_t n;
+    do
+    {
+        if (!locked)
+        {
+            patch_state_lock();
+        }
+        n = 0;
+        nvs_iterator_t it = NULL;
+        esp_err_t ret = nvs_entry_find(JOURNAL_PARTITION, JOURNAL_NAMESPACE, NVS_TYPE_U64, &it);
+        while (ret == ESP_OK && n < ERASE_BATCH)
+        {
+            nvs_entry_info_t info;
+            nvs_entry_info(it, &info);
+            if (info.key[0] == 'j')
+            {
+                uint32_t seq = (uint32_t)strtoul(&info.key[1], NULL, 16);
+                if ((int32_t)(seq - covered_seq) <= 0)
+                {
+                    memcpy(stale[n++], info.key, KEY_MAX);
+                }
+            }
+            ret = nvs_entry_next(&it);
+        }
+        nvs_release_iterator(it);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            nvs_erase_key(journal_nvs, stale[i]);
+        }
+        nvs_commit(journal_nvs);
+        if (!locked)
+        {
+            patch_state_unlock(); // Let edits through between batches
+        }
+    } while (n == ERASE_BATCH);
+}
+
+static uint8_t *alloc_snapshot(size_t *size)
+{
+    *size = sizeof(snapshot_header_t) + CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS * sizeof(patch_journal_conn_t);
+    uint8_t *blob = heap_caps_malloc(*size, JOURNAL_CAPS_PREFERRED);
+    if (blob == NULL)
+    {
+        blob = heap_caps_malloc(*size, JOURNAL_CAPS_FALLBACK);
+    }
+    if (blob == NULL)
+    {
+        ESP_LOGE(TAG, "No memory for a %d byte snapshot", *size);
+    }
+    return blob;
+}
+
+// Write a filled-in snapshot to the inactive slot, switch to it, and reclaim the old slot
+// (snapshot_mutex held). The caller then erases the journal entries it covers.
+static esp_err_t write_snapshot(const uint8_t *blob)
+{
+    const snapshot_header_t *hdr = (const snapshot_header_t *)blob;
+    size_t size = sizeof(*hdr) + hdr->count * sizeof(patch_journal_conn_t);
+
+    // 1. Write the inactive slot, 2. switch to it
+    char key[KEY_MAX];
+    uint8_t new_slot = snapshot_slot ^ 1;
+    snapshot_key(key, new_slot);
+    esp_err_t ret = nvs_set_blob(journal_nvs, key, blob, size);
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(journal_nvs);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = nvs_set_u8(journal_nvs, KEY_SNAPSHOT_SLOT, new_slot);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(journal_nvs);
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Snapshot write failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    snapshot_slot = new_slot;
+    snapshot_seq = hdr->seq;
+
+    // 3. Reclaim the old snapshot
+    snapshot_key(key, new_slot ^ 1);
+    nvs_erase_key(journal_nvs, key);
+    nvs_commit(journal_nvs);
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.snapshot_connections = hdr->count;
+    stats.journal_entries = __atomic_load_n(&last_seq, __ATOMIC_RELAXED) - hdr->seq;
+    portEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
+
+static esp_err_t compact(void)
+{
+    int64_t start = esp_timer_get_time();
+    size_t size;
+    uint8_t *blob = alloc_snapshot(&size);
+    if (blob == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Copy the patch; edits continue meanwhile and are journaled after `seq`
+    uint32_t saves = __atomic_load_n(&bulk_saves, __ATOMIC_RELAXED);
+    snapshot_header_t *hdr = (snapshot_header_t *)blob;
+    *hdr = (snapshot_header_t){.magic = SNAPSHOT_MAGIC, .version = SNAPSHOT_VERSION};
+    hdr->count = patch_state_capture((patch_journal_conn_t *)(blob + sizeof(*hdr)), CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS,
+                                     &hdr->seq);
+
+    xSemaphoreTake(snapshot_mutex, portMAX_DELAY);
+    esp_err_t ret = ESP_OK;
+    bool stale = bulk_saves != saves; // A bulk replace saved the patch since the copy began
+    if (!stale)
+    {
+        ret = write_snapshot(blob);
+    }
+    xSemaphoreGive(snapshot_mutex);
+    uint32_t count = hdr->count;
+    uint32_t seq = hdr->seq;
+    heap_caps_free(blob);
+    if (ret != ESP_OK || stale)
+    {
+        return ret;
+    }
+    // 4. Reclaim the journal, outside snapshot_mutex since it takes patch_mutex per batch
+    erase_covered_entries(seq, false);
+
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+    portENTER_CRITICAL(&stats_lock);
+    stats.compactions++;
+    stats.last_compaction_us = us;
+    portEXIT_CRITICAL(&stats_lock);
+
+    ESP_LOGI(TAG, "Compacted journal up to entry %lu into a %lu connection snapshot in %lu ms",
+             (unsigned long)seq, (unsigned long)count, (unsigned long)(us / 1000));
+    return ESP_OK;
+}
+
+esp_err_t patch_journal_save_snapshot(void)
+{
+    if (!journal_open)
+    {
+        return ESP_OK;
+    }
+
+    int64_t start = esp_timer_get_time();
+    size_t size;
+    uint8_t *blob = alloc_snapshot(&size);
+    if (blob == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    snapshot_header_t *hdr = (snapshot_header_t *)blob;
+    *hdr = (snapshot_header_t){.magic = SNAPSHOT_MAGIC, .version = SNAPSHOT_VERSION, .seq = last_seq};
+    hdr->count = patch_state_capture_locked((patch_journal_conn_t *)(blob + sizeof(*hdr)),
+                                            CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS);
+
+    xSemaphoreTake(snapshot_mutex, portMAX_DELAY);
+    esp_err_t ret = write_snapshot(blob);
+    if (ret == ESP_OK)
+    {
+        bulk_saves++;
+    }
+    xSemaphoreGive(snapshot_mutex);
+    uint32_t count = hdr->count;
+    uint32_t seq = hdr->seq;
+    heap_caps_free(blob);
+    if (ret == ESP_OK)
+    {
+        erase_covered_entries(seq, true);
+        ESP_LOGI(TAG, "Saved a %lu connection snapshot in %lu ms", (unsigned long)count,
+                 (unsigned long)((esp_timer_get_time() - start) / 1000));
+    }
+    return ret;
+}
+
+static void compaction_task(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!compaction_requested)
+        {
+            continue;
+        }
+        compaction_running = true;
+        compaction_requested = false;
+        compact();
+        compaction_running = false;
+    }
+}
+
+esp_err_t patch_journal_start(const patch_journal_config_t *config)
+{
+    if (!journal_open)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (compaction_task_handle != NULL)
+    {
+        return ESP_OK;
+    }
+
+    if (xTaskCreatePinnedToCore(compaction_task, "patch_journal", config->task_stack_size, NULL,
+                                config->task_priority, &compaction_task_handle, config->task_core_id) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create compaction task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Catch up on a journal that was already long, or an append that failed during replay
+    if (compaction_requested || last_seq - snapshot_seq >= CONFIG_CENTRAL_PATCH_JOURNAL_COMPACT_ENTRIES)
+    {
+        request_compaction();
+    }
+    return ESP_OK;
+}
+
+// --- Public API ---
+
+esp_err_t patch_manager_compact_journal(void)
+{
+    if (compaction_task_handle == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    request_compaction();
+    return ESP_OK;
+}
+
+esp_err_t patch_manager_get_journal_stats(patch_journal_stats_t *out)
+{
+    if (out == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
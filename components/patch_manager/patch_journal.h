@@ -0,0 +1,81 @@
+#pragma once
+
+// Internal: persistence of the patch as a snapshot plus an append-only journal of
+// edits, both in a dedicated NVS partition. patch_state.c appends one entry per
+// successful add/remove (with patch_mutex held); a background task folds the
+// journal into a new snapshot once it passes CONFIG_CENTRAL_PATCH_JOURNAL_COMPACT_ENTRIES.
+// A bulk replace writes its snapshot directly instead.
+
+#include "patch_manager.h"
+
+typedef enum
+{
+    PATCH_JOURNAL_OP_ADD = 1,
+    PATCH_JOURNAL_OP_REMOVE = 2,
+} patch_journal_op_t;
+
+// One connection in a snapshot blob
+typedef struct __attribute__((packed))
+{
+    uint16_t src_module;
+    uint8_t src_port;
+    uint16_t dst_module;
+    uint8_t dst_port;
+} patch_journal_conn_t;
+
+/**
+ * @brief Applies one restored edit to the patch (snapshot connections arrive as adds).
+ */
+typedef esp_err_t (*patch_journal_apply_fn_t)(patch_journal_op_t op, module_id_t src_module, port_id_t src_port,
+                                              module_id_t dst_module, port_id_t dst_port);
+
+/**
+ * @brief Mount the journal partition, replay snapshot and journal through `apply`, and
+ * enable appends. Called with patch_mutex held.
+ */
+esp_err_t patch_journal_open(patch_journal_apply_fn_t apply);
+
+/**
+ * @brief Start the compaction task.
+ */
+esp_err_t patch_journal_start(const patch_journal_config_t *config);
+
+/**
+ * @brief Record one edit (patch_mutex held). No-op until patch_journal_open() has run, so
+ * edits made before the restore (e.g. by the boot perf suite) are not persisted. A failed
+ * write schedules a snapshot, which captures the edit instead.
+ */
+void patch_journal_append(patch_journal_op_t op, module_id_t src_module, port_id_t src_port,
+                          module_id_t dst_module, port_id_t dst_port);
+
+/**
+ * @brief Sequence number of the last appended edit (patch_mutex held).
+ */
+uint32_t patch_journal_last_seq(void);
+
+/**
+ * @brief Save the live patch as the current snapshot now, instead of journaling the edits
+ * that produced it (patch_mutex held). ESP_OK without writing until patch_journal_open()
+ * has run. On failure the previous snapshot and journal are untouched.
+ */
+esp_err_t patch_journal_save_snapshot(void);
+
+/**
+ * @brief Copy the live patch for a snapshot. Implemented in patch_state.c; takes patch_mutex.
+ *
+ * @param[out] seq Last journal entry the copy includes.
+ * @return Connections copied.
+ */
+size_t patch_state_capture(patch_journal_conn_t *out, size_t capacity, uint32_t *seq);
+
+/**
+ * @brief patch_state_capture() for callers already holding patch_mutex.
+ */
+size_t patch_state_capture_locked(patch_journal_conn_t *out, size_t capacity);
+
+/**
+ * @brief Take and release patch_mutex, for journal maintenance that must not interleave
+ * with appends. Implemented in patch_state.c.
+ */
+void patch_state_lock(void);
+void patch_state_unlock(void);
@@ -1,16 +1,24 @@
 #include "patch_manager.h"
 #include "esp_log.h"
+#include "esp_heap_caps.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h" // For mutex
 #include "string.h"          // For memset
 #include "synth_constants.h" // From common_definitions
 #include "i2c_manager.h"     // To send routing commands
+#include "patch_graph.h"
+#include "patch_store.h"
+#include "patch_journal.h"
 
 static const char *TAG = "PATCH_MANAGER";
 
+// Rollback copy of the patch during a bulk replace
+#define STATE_CAPS_PREFERRED (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define STATE_CAPS_FALLBACK (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
 // --- State ---
-static patch_connection_t patch_connections[MAX_PATCH_CONNECTIONS];
-static size_t active_connection_count = 0;
+// Connections live in patch_store (struct-of-arrays, PSRAM-backed, hash-indexed);
+// MAX_PATCH_CONNECTIONS is now only the initial capacity.
 static SemaphoreHandle_t patch_mutex = NULL;
 
 // --- Initialization ---
@@ -25,60 +33,47 @@ esp_err_t patch_manager_init(void)
     }
 
     // Clear the patch state
-    memset(patch_connections, 0, sizeof(patch_connections));
-    for (int i = 0; i < MAX_PATCH_CONNECTIONS; ++i)
+    esp_err_t ret = patch_store_init(MAX_PATCH_CONNECTIONS);
+    if (ret != ESP_OK)
     {
-        patch_connections[i].is_active = false;
+        vSemaphoreDelete(patch_mutex);
+        patch_mutex = NULL;
+        return ret;
     }
-    active_connection_count = 0;
+    patch_graph_init();
 
-    ESP_LOGI(TAG, "Patch Manager Initialized (Max Connections: %d)", MAX_PATCH_CONNECTIONS);
+    ESP_LOGI(TAG, "Patch Manager Initialized (Max Connections: %d)", CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS);
     return ESP_OK;
 }
 
 // --- Connection Management Stubs ---
 
-esp_err_t patch_manager_add_connection(module_id_t source_module_id, port_id_t source_port_id, module_id_t dest_module_id, port_id_t dest_port_id)
+// Add/remove bodies, shared by the public API and journal replay (patch_mutex held)
+static esp_err_t add_connection_locked(module_id_t source_module_id, port_id_t source_port_id, module_id_t dest_module_id, port_id_t dest_port_id)
 {
     esp_err_t ret = ESP_FAIL;
 
-    if (xSemaphoreTake(patch_mutex, portMAX_DELAY) != pdTRUE)
-    {
-        ESP_LOGE(TAG, "Failed to acquire patch mutex for add");
-        return ESP_ERR_TIMEOUT;
-    }
-
     // --- STUB ---
-    ESP_LOGW(TAG, "STUB: %s called: %d:%d -> %d:%d", __func__,
+    ESP_LOGD(TAG, "STUB: %s called: %d:%d -> %d:%d", __func__,
              source_module_id, source_port_id, dest_module_id, dest_port_id);
 
-    // 1. Find an empty slot
-    int empty_slot = -1;
-    for (int i = 0; i < MAX_PATCH_CONNECTIONS; ++i)
+    // 1. Reject duplicates (O(1) through the store's hash index)
+    if (patch_store_find(source_module_id, source_port_id, dest_module_id, dest_port_id) >= 0)
     {
-        if (!patch_connections[i].is_active)
-        {
-            empty_slot = i;
-            break;
-        }
-    }
-
-    if (empty_slot == -1)
-    {
-        ESP_LOGE(TAG, "Cannot add connection: Patch matrix full (%d connections)", MAX_PATCH_CONNECTIONS);
-        ret = ESP_ERR_NO_MEM;
+        ESP_LOGW(TAG, "Connection already exists.");
+        ret = ESP_ERR_INVALID_STATE;
     }
     else
     {
         // 2. Validate connection (Placeholder - needs module discovery info)
-        ESP_LOGI(TAG, "Connection validation (placeholder)... OK");
+        ESP_LOGD(TAG, "Connection validation (placeholder)... OK");
 
         // 3. Determine TDM slots (Placeholder - needs complex logic)
-        uint8_t tdm_slot = (uint8_t)active_connection_count; // Extremely basic placeholder
-        ESP_LOGI(TAG, "Assigning TDM slot (placeholder): %d", tdm_slot);
+        uint8_t tdm_slot = (uint8_t)patch_store_count(); // Extremely basic placeholder
+        ESP_LOGD(TAG, "Assigning TDM slot (placeholder): %d", tdm_slot);
 
         // 4. Send I2C commands (Placeholder - needs protocol definition & module info)
-        ESP_LOGI(TAG, "Sending I2C routing commands (placeholder)...");
+        ESP_LOGD(TAG, "Sending I2C routing commands (placeholder)...");
         // Example (pseudo-code):
         // module_info_t* src_info = get_module_info(source_module_id);
         // module_info_t* dst_info = get_module_info(dest_module_id);
@@ -94,57 +89,50 @@ esp_err_t patch_manager_add_connection(module_id_t source_module_id, port_id_t s
         // Assuming I2C commands were successful (in this stub)
         ret = ESP_OK; // Placeholder success
 
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to configure routing for new connection via I2C.");
+            // Rollback any partial configuration if necessary
+        }
+
+        // 5. Update the graph view (ordering, loops, latency)
+        bool is_feedback = false;
         if (ret == ESP_OK)
         {
-            // 5. Store the connection state
-            patch_connections[empty_slot].source_module = source_module_id;
-            patch_connections[empty_slot].source_port = source_port_id;
-            patch_connections[empty_slot].dest_module = dest_module_id;
-            patch_connections[empty_slot].dest_port = dest_port_id;
-            patch_connections[empty_slot].is_active = true;
-            active_connection_count++;
-            ESP_LOGI(TAG, "Connection added successfully. Total active: %d", active_connection_count);
+            ret = patch_graph_add_edge(source_module_id, dest_module_id, &is_feedback);
         }
-        else
+
+        if (ret == ESP_OK)
         {
-            ESP_LOGE(TAG, "Failed to configure routing for new connection via I2C.");
-            // Rollback any partial configuration if necessary
+            // 6. Store the connection state
+            ret = patch_store_insert(source_module_id, source_port_id, dest_module_id, dest_port_id);
+            if (ret != ESP_OK)
+            {
+                ESP_LOGE(TAG, "Cannot add connection: connection store full (%d connections)", patch_store_count());
+                patch_graph_remove_edge(source_module_id, dest_module_id);
+            }
+            else
+            {
+                ESP_LOGD(TAG, "Connection added successfully%s. Total active: %d",
+                         is_feedback ? " (feedback loop)" : "", patch_store_count());
+            }
         }
     }
     // --- END STUB ---
 
-    xSemaphoreGive(patch_mutex);
     return ret;
 }
 
-esp_err_t patch_manager_remove_connection(module_id_t source_module_id, port_id_t source_port_id, module_id_t dest_module_id, port_id_t dest_port_id)
+static esp_err_t remove_connection_locked(module_id_t source_module_id, port_id_t source_port_id, module_id_t dest_module_id, port_id_t dest_port_id)
 {
     esp_err_t ret = ESP_FAIL;
 
-    if (xSemaphoreTake(patch_mutex, portMAX_DELAY) != pdTRUE)
-    {
-        ESP_LOGE(TAG, "Failed to acquire patch mutex for remove");
-        return ESP_ERR_TIMEOUT;
-    }
-
     // --- STUB ---
-    ESP_LOGW(TAG, "STUB: %s called: %d:%d -> %d:%d", __func__,
+    ESP_LOGD(TAG, "STUB: %s called: %d:%d -> %d:%d", __func__,
              source_module_id, source_port_id, dest_module_id, dest_port_id);
 
     // 1. Find the connection
-    int found_slot = -1;
-    for (int i = 0; i < MAX_PATCH_CONNECTIONS; ++i)
-    {
-        if (patch_connections[i].is_active &&
-            patch_connections[i].source_module == source_module_id &&
-            patch_connections[i].source_port == source_port_id &&
-            patch_connections[i].dest_module == dest_module_id &&
-            patch_connections[i].dest_port == dest_port_id)
-        {
-            found_slot = i;
-            break;
-        }
-    }
+    int32_t found_slot = patch_store_find(source_module_id, source_port_id, dest_module_id, dest_port_id);
 
     if (found_slot == -1)
     {
@@ -154,7 +142,7 @@ esp_err_t patch_manager_remove_connection(module_id_t source_module_id, port_id_
     else
     {
         // 2. Send I2C commands to deconfigure routing (Placeholder)
-        ESP_LOGI(TAG, "Sending I2C de-routing commands (placeholder)...");
+        ESP_LOGD(TAG, "Sending I2C de-routing commands (placeholder)...");
         // Example (pseudo-code):
         // module_info_t* src_info = get_module_info(source_module_id);
         // module_info_t* dst_info = get_module_info(dest_module_id);
@@ -168,9 +156,9 @@ esp_err_t patch_manager_remove_connection(module_id_t source_module_id, port_id_
         if (ret == ESP_OK)
         {
             // 3. Update state
-            patch_connections[found_slot].is_active = false;
-            active_connection_count--;
-            ESP_LOGI(TAG, "Connection removed successfully. Total active: %d", active_connection_count);
+            patch_store_remove_at(found_slot);
+            patch_graph_remove_edge(source_module_id, dest_module_id);
+            ESP_LOGD(TAG, "Connection removed successfully. Total active: %d", patch_store_count());
         }
         else
         {
@@ -180,38 +168,322 @@ esp_err_t patch_manager_remove_connection(module_id_t source_module_id, port_id_
     }
     // --- END STUB ---
 
+    return ret;
+}
+
+esp_err_t patch_manager_add_connection(module_id_t source_module_id, port_id_t source_port_id, module_id_t dest_module_id, port_id_t dest_port_id)
+{
+    if (xSemaphoreTake(patch_mutex, portMAX_DELAY) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Failed to acquire patch mutex for add");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    esp_err_t ret = add_connection_locked(source_module_id, source_port_id, dest_module_id, dest_port_id);
+    if (ret == ESP_OK)
+    {
+        // Still under the mutex, so journal order is the order edits were applied in
+        patch_journal_append(PATCH_JOURNAL_OP_ADD, source_module_id, source_port_id, dest_module_id, dest_port_id);
+    }
+
     xSemaphoreGive(patch_mutex);
     return ret;
 }
 
-esp_err_t patch_manager_get_connections(patch_connection_t *connections_buffer, size_t buffer_size, size_t *count)
+esp_err_t patch_manager_remove_connection(module_id_t source_module_id, port_id_t source_port_id, module_id_t dest_module_id, port_id_t dest_port_id)
 {
-    if (connections_buffer == NULL || count == NULL)
+    if (xSemaphoreTake(patch_mutex, portMAX_DELAY) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Failed to acquire patch mutex for remove");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    esp_err_t ret = remove_connection_locked(source_module_id, source_port_id, dest_module_id, dest_port_id);
+    if (ret == ESP_OK)
+    {
+        patch_journal_append(PATCH_JOURNAL_OP_REMOVE, source_module_id, source_port_id, dest_module_id, dest_port_id);
+    }
+
+    xSemaphoreGive(patch_mutex);
+    return ret;
+}
+
+// Remove every connection (patch_mutex held). Removing the last row never moves another.
+static void clear_locked(void)
+{
+    for (size_t n = patch_store_count(); n > 0; --n)
+    {
+        patch_connection_t conn;
+        patch_store_get(n - 1, &conn);
+        remove_connection_locked(conn.source_module, conn.source_port, conn.dest_module, conn.dest_port);
+    }
+}
+
+esp_err_t patch_manager_replace_connections(const patch_connection_t *connections, size_t count)
+{
+    if (connections == NULL && count > 0)
     {
         return ESP_ERR_INVALID_ARG;
     }
 
     if (xSemaphoreTake(patch_mutex, portMAX_DELAY) != pdTRUE)
     {
-        ESP_LOGE(TAG, "Failed to acquire patch mutex for get");
+        ESP_LOGE(TAG, "Failed to acquire patch mutex for replace");
         return ESP_ERR_TIMEOUT;
     }
 
-    // --- STUB ---
-    ESP_LOGD(TAG, "STUB: %s called", __func__);
+    // Keep the current patch so any failure below can put it back
+    size_t old_count = patch_store_count();
+    size_t old_size = (old_count > 0 ? old_count : 1) * sizeof(patch_journal_conn_t);
+    patch_journal_conn_t *old = heap_caps_malloc(old_size, STATE_CAPS_PREFERRED);
+    if (old == NULL)
+    {
+        old = heap_caps_malloc(old_size, STATE_CAPS_FALLBACK);
+    }
+    if (old == NULL)
+    {
+        xSemaphoreGive(patch_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+    patch_state_capture_locked(old, old_count);
+
+    clear_locked();
+    esp_err_t ret = ESP_OK;
+    for (size_t i = 0; ret == ESP_OK && i < count; ++i)
+    {
+        const patch_connection_t *c = &connections[i];
+        ret = add_connection_locked(c->source_module, c->source_port, c->dest_module, c->dest_port);
+    }
+    if (ret == ESP_OK)
+    {
+        // One snapshot instead of a journal entry per removed and added connection
+        ret = patch_journal_save_snapshot();
+    }
 
-    size_t num_to_copy = 0;
-    for (int i = 0; i < MAX_PATCH_CONNECTIONS && num_to_copy < buffer_size; ++i)
+    if (ret != ESP_OK)
     {
-        if (patch_connections[i].is_active)
+        ESP_LOGE(TAG, "Replacing the patch with %d connections failed (%s), restoring the previous %d",
+                 count, esp_err_to_name(ret), old_count);
+        clear_locked();
+        for (size_t i = 0; i < old_count; ++i)
         {
-            memcpy(&connections_buffer[num_to_copy], &patch_connections[i], sizeof(patch_connection_t));
-            num_to_copy++;
+            // These all fitted a moment ago, in this order
+            add_connection_locked(old[i].src_module, old[i].src_port, old[i].dst_module, old[i].dst_port);
         }
     }
+    else
+    {
+        ESP_LOGD(TAG, "Replaced %d connections with %d", old_count, count);
+    }
+
+    xSemaphoreGive(patch_mutex);
+    heap_caps_free(old);
+    return ret;
+}
+
+esp_err_t patch_manager_get_connections(patch_connection_t *connections_buffer, size_t buffer_size, size_t *count)
+{
+    return patch_manager_get_connections_from(0, connections_buffer, buffer_size, count);
+}
+
+esp_err_t patch_manager_get_connections_from(size_t first, patch_connection_t *connections_buffer, size_t buffer_size, size_t *count)
+{
+    if (connections_buffer == NULL || count == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (xSemaphoreTake(patch_mutex, portMAX_DELAY) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Failed to acquire patch mutex for get");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    size_t total = patch_store_count();
+    size_t num_to_copy = first < total ? total - first : 0;
+    if (num_to_copy > buffer_size)
+    {
+        num_to_copy = buffer_size;
+    }
+    for (size_t i = 0; i < num_to_copy; ++i)
+    {
+        patch_connection_t *conn = &connections_buffer[i];
+        patch_store_get(first + i, conn);
+        // Loop status can change when other connections are removed, so report it live
+        conn->is_feedback = patch_graph_is_feedback(conn->source_module, conn->dest_module);
+    }
     *count = num_to_copy;
-    // --- END STUB ---
 
     xSemaphoreGive(patch_mutex);
     return ESP_OK;
 }
+
+// --- Graph Queries ---
+
+esp_err_t patch_manager_get_path_latency(module_id_t from_module, module_id_t to_module, uint32_t *latency_samples)
+{
+    if (latency_samples == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (xSemaphoreTake(patch_mutex, portMAX_DELAY) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Failed to acquire patch mutex for latency query");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    uint32_t hops = 0;
+    esp_err_t ret = patch_graph_path_hops(from_module, to_module, &hops);
+    if (ret == ESP_OK)
+    {
+        *latency_samples = hops * CONFIG_CENTRAL_PATCH_HOP_LATENCY_SAMPLES;
+    }
+
+    xSemaphoreGive(patch_mutex);
+    return ret;
+}
+
+esp_err_t patch_manager_get_feedback_count(size_t *count)
+{
+    if (count == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (xSemaphoreTake(patch_mutex, portMAX_DELAY) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Failed to acquire patch mutex for feedback query");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    *count = patch_graph_feedback_count();
+
+    xSemaphoreGive(patch_mutex);
+    return ESP_OK;
+}
+
+esp_err_t patch_manager_get_module_order(module_id_t *modules_buffer, size_t buffer_size, size_t *count)
+{
+    if (modules_buffer == NULL || count == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (xSemaphoreTake(patch_mutex, portMAX_DELAY) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Failed to acquire patch mutex for order query");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    *count = patch_graph_topo_order(modules_buffer, buffer_size);
+
+    xSemaphoreGive(patch_mutex);
+    return ESP_OK;
+}
+
+esp_err_t patch_manager_get_storage_info(patch_storage_info_t *info)
+{
+    if (info == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (xSemaphoreTake(patch_mutex, portMAX_DELAY) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Failed to acquire patch mutex for storage info");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    patch_store_get_info(info);
+
+    xSemaphoreGive(patch_mutex);
+    return ESP_OK;
+}
+
+// --- Persistence ---
+
+static esp_err_t replay_op(patch_journal_op_t op, module_id_t src_module, port_id_t src_port,
+                           module_id_t dst_module, port_id_t dst_port)
+{
+    if (op == PATCH_JOURNAL_OP_ADD)
+    {
+        return add_connection_locked(src_module, src_port, dst_module, dst_port);
+    }
+    return remove_connection_locked(src_module, src_port, dst_module, dst_port);
+}
+
+esp_err_t patch_manager_restore(const patch_journal_config_t *config)
+{
+    if (config == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (xSemaphoreTake(patch_mutex, portMAX_DELAY) != pdTRUE)
+    {
+        ESP_LOGE(TAG, "Failed to acquire patch mutex for restore");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (patch_store_count() != 0)
+    {
+        ESP_LOGE(TAG, "Restore needs an empty patch");
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        ret = patch_journal_open(replay_op);
+    }
+
+    xSemaphoreGive(patch_mutex);
+
+    if (ret == ESP_OK)
+    {
+        ret = patch_journal_start(config);
+    }
+    return ret;
+}
+
+void patch_state_lock(void)
+{
+    xSemaphoreTake(patch_mutex, portMAX_DELAY);
+}
+
+void patch_state_unlock(void)
+{
+    xSemaphoreGive(patch_mutex);
+}
+
+size_t patch_state_capture_locked(patch_journal_conn_t *out, size_t capacity)
+{
+    size_t count = patch_store_count();
+    if (count > capacity)
+    {
+        count = capacity;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        patch_connection_t conn;
+        patch_store_get(i, &conn);
+        out[i] = (patch_journal_conn_t){
+            .src_module = conn.source_module,
+            .src_port = conn.source_port,
+            .dst_module = conn.dest_module,
+            .dst_port = conn.dest_port,
+        };
+    }
+    return count;
+}
+
+size_t patch_state_capture(patch_journal_conn_t *out, size_t capacity, uint32_t *seq)
+{
+    xSemaphoreTake(patch_mutex, portMAX_DELAY);
+
+    size_t count = patch_state_capture_locked(out, capacity);
+    *seq = patch_journal_last_seq(); // Appends happen under the same mutex
+
+    xSemaphoreGive(patch_mutex);
+    return count;
+}
@@ -0,0 +1,274 @@
+#include "patch_store.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h" // For esp_ptr_external_ram
+#include <string.h>
+
+static const char *TAG = "PATCH_STORE";
+
+#define STORE_MAX_CONNECTIONS CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS
+#define INDEX_EMPTY 0 // Index slots hold row + 1
+
+// Column storage prefers PSRAM and falls back to internal RAM
+#define COLUMN_CAPS_PREFERRED (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define COLUMN_CAPS_FALLBACK MALLOC_CAP_DEFAULT
+
+// --- State ---
+
+// Cold columns (PSRAM)
+static module_id_t *col_src_module = NULL;
+static port_id_t *col_src_port = NULL;
+static module_id_t *col_dst_module = NULL;
+static port_id_t *col_dst_port = NULL;
+static size_t row_count = 0;
+static size_t row_capacity = 0;
+
+// Hot index (internal RAM): power-of-two table, load factor <= 1/2
+static uint16_t *index_table = NULL;
+static size_t index_size = 0;
+
+// --- Helpers ---
+
+static inline uint32_t key_hash(module_id_t src_module, port_id_t src_port, module_id_t dst_module, port_id_t dst_port)
+{
+    uint32_t h = ((uint32_t)src_module << 16 | dst_module) * 0x9E3779B1u;
+    h ^= ((uint32_t)src_port << 8 | dst_port) * 0x85EBCA77u;
+    return h ^ (h >> 15);
+}
+
+static inline size_t row_home(size_t row)
+{
+    return key_hash(col_src_module[row], col_src_port[row], col_dst_module[row], col_dst_port[row]) & (index_size - 1);
+}
+
+static inline bool row_matches(size_t row, module_id_t src_module, port_id_t src_port, module_id_t dst_module, port_id_t dst_port)
+{
+    return col_src_module[row] == src_module && col_dst_module[row] == dst_module &&
+           col_src_port[row] == src_port && col_dst_port[row] == dst_port;
+}
+
+// Slot in index_table holding `row`
+static size_t index_slot_of_row(size_t row)
+{
+    size_t h = row_home(row);
+    while (index_table[h] != row + 1)
+    {
+        h = (h + 1) & (index_size - 1);
+    }
+    return h;
+}
+
+static void index_insert_row(size_t row)
+{
+    size_t h = row_home(row);
+    while (index_table[h] != INDEX_EMPTY)
+    {
+        h = (h + 1) & (index_size - 1);
+    }
+    index_table[h] = (uint16_t)(row + 1);
+}
+
+// Backward-shift deletion keeps probe chains intact without tombstones
+static void index_delete_slot(size_t hole)
+{
+    for (size_t j = (hole + 1) & (index_size - 1); index_table[j] != INDEX_EMPTY; j = (j + 1) & (index_size - 1))
+    {
+        size_t home = row_home(index_table[j] - 1);
+        if (((j - home) & (index_size - 1)) >= ((j - hole) & (index_size - 1)))
+        {
+            index_table[hole] = index_table[j];
+            hole = j;
+        }
+    }
+    index_table[hole] = INDEX_EMPTY;
+}
+
+static esp_err_t rebuild_index(size_t new_size)
+{
+    uint16_t *table = heap_caps_calloc(new_size, sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (table == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    heap_caps_free(index_table);
+    index_table = table;
+    index_size = new_size;
+    for (size_t row = 0; row < row_count; ++row)
+    {
+        index_insert_row(row);
+    }
+    return ESP_OK;
+}
+
+static void *realloc_column(void *column, size_t size)
+{
+    void *p = heap_caps_realloc(column, size, COLUMN_CAPS_PREFERRED);
+    if (p == NULL)
+    {
+        p = heap_caps_realloc(column, size, COLUMN_CAPS_FALLBACK);
+    }
+    return p;
+}
+
+// Grow columns (and index) to new_capacity. On failure the store is unchanged
+// apart from columns that already grew, which is harmless.
+static esp_err_t grow(size_t new_capacity)
+{
+    void *p;
+
+    if ((p = realloc_column(col_src_module, new_capacity * sizeof(module_id_t))) == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    col_src_module = p;
+    if ((p = realloc_column(col_src_port, new_capacity * sizeof(port_id_t))) == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    col_src_port = p;
+    if ((p = realloc_column(col_dst_module, new_capacity * sizeof(module_id_t))) == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    col_dst_module = p;
+    if ((p = realloc_column(col_dst_port, new_capacity * sizeof(port_id_t))) == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    col_dst_port = p;
+
+    size_t needed_index = index_size ? index_size : 16;
+    while (needed_index < new_capacity * 2)
+    {
+        needed_index *= 2;
+    }
+    if (needed_index != index_size && rebuild_index(needed_index) != ESP_OK)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    row_capacity = new_capacity;
+    return ESP_OK;
+}
+
+// --- Component-internal API ---
+
+esp_err_t patch_store_init(size_t initial_capacity)
+{
+    row_count = 0;
+    if (initial_capacity > STORE_MAX_CONNECTIONS)
+    {
+        initial_capacity = STORE_MAX_CONNECTIONS;
+    }
+    if (row_capacity >= initial_capacity)
+    {
+        // Re-init keeps the existing allocation
+        memset(index_table, 0, index_size * sizeof(uint16_t));
+        return ESP_OK;
+    }
+
+    esp_err_t ret = grow(initial_capacity);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to allocate connection store for %d connections", initial_capacity);
+    }
+    return ret;
+}
+
+int32_t patch_store_find(module_id_t src_module, port_id_t src_port, module_id_t dst_module, port_id_t dst_port)
+{
+    if (index_size == 0)
+    {
+        return -1;
+    }
+    for (size_t h = key_hash(src_module, src_port, dst_module, dst_port) & (index_size - 1);
+         index_table[h] != INDEX_EMPTY; h = (h + 1) & (index_size - 1))
+    {
+        size_t row = index_table[h] - 1;
+        if (row_matches(row, src_module, src_port, dst_module, dst_port))
+        {
+            return (int32_t)row;
+        }
+    }
+    return -1;
+}
+
+esp_err_t patch_store_insert(module_id_t src_module, port_id_t src_port, module_id_t dst_module, port_id_t dst_port)
+{
+    if (patch_store_find(src_module, src_port, dst_module, dst_port) >= 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (row_count == row_capacity)
+    {
+        if (row_capacity >= STORE_MAX_CONNECTIONS)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+        size_t new_capacity = row_capacity ? row_capacity * 2 : 16;
+        if (new_capacity > STORE_MAX_CONNECTIONS)
+        {
+            new_capacity = STORE_MAX_CONNECTIONS;
+        }
+        esp_err_t ret = grow(new_capacity);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to grow connection store to %d", new_capacity);
+            return ret;
+        }
+        ESP_LOGD(TAG, "Connection store grown to %d", new_capacity);
+    }
+
+    size_t row = row_count++;
+    col_src_module[row] = src_module;
+    col_src_port[row] = src_port;
+    col_dst_module[row] = dst_module;
+    col_dst_port[row] = dst_port;
+    index_insert_row(row);
+    return ESP_OK;
+}
+
+void patch_store_remove_at(int32_t row)
+{
+    size_t last = row_count - 1;
+
+    index_delete_slot(index_slot_of_row((size_t)row));
+
+    if ((size_t)row != last)
+    {
+        // Repoint the last row's index slot before moving its data down
+        size_t slot = index_slot_of_row(last);
+        index_table[slot] = (uint16_t)(row + 1);
+        col_src_module[row] = col_src_module[last];
+        col_src_port[row] = col_src_port[last];
+        col_dst_module[row] = col_dst_module[last];
+        col_dst_port[row] = col_dst_port[last];
+    }
+    row_count--;
+}
+
+size_t patch_store_count(void)
+{
+    return row_count;
+}
+
+void patch_store_get(size_t row, patch_connection_t *out)
+{
+    out->source_module = col_src_module[row];
+    out->source_port = col_src_port[row];
+    out->dest_module = col_dst_module[row];
+    out->dest_port = col_dst_port[row];
+    out->is_active = true; // Dense storage: every stored row is active
+    out->is_feedback = false;
+}
+
+void patch_store_get_info(patch_storage_info_t *info)
+{
+    info->connection_count = row_count;
+    info->capacity = row_capacity;
+    info->max_connections = STORE_MAX_CONNECTIONS;
+    info->column_bytes = row_capacity * (2 * sizeof(module_id_t) + 2 * sizeof(port_id_t));
+    info->index_bytes = index_size * sizeof(uint16_t);
+    info->columns_in_psram = col_src_module != NULL && esp_ptr_external_ram(col_src_module);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// Internal: growable struct-of-arrays connection store.
+// Connection columns live in PSRAM (when available) and are kept dense, so
+// there is no per-entry active flag. A compact open-addressed hash index in
+// internal RAM maps a connection to its row. All functions except init must
+// be called with patch_mutex held.
+
+#include "patch_manager.h"
+
+/**
+ * @brief Allocate the store with room for initial_capacity connections.
+ *
+ * @return ESP_OK, or ESP_ERR_NO_MEM.
+ */
+esp_err_t patch_store_init(size_t initial_capacity);
+
+/**
+ * @brief Row of a connection, or -1 if it is not stored.
+ */
+int32_t patch_store_find(module_id_t src_module, port_id_t src_port, module_id_t dst_module, port_id_t dst_port);
+
+/**
+ * @brief Append a connection, growing the columns and index if needed.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if already stored, ESP_ERR_NO_MEM at the configured limit or on allocation failure.
+ */
+esp_err_t patch_store_insert(module_id_t src_module, port_id_t src_port, module_id_t dst_module, port_id_t dst_port);
+
+/**
+ * @brief Remove the connection at a row. The last row is moved into its place.
+ */
+void patch_store_remove_at(int32_t row);
+
+/**
+ * @brief Number of stored connections (rows [0, count) are valid).
+ */
+size_t patch_store_count(void);
+
+/**
+ * @brief Copy one row out as a patch_connection_t.
+ */
+void patch_store_get(size_t row, patch_connection_t *out);
+
+/**
+ * @brief Fill in capacity and memory usage.
+ */
+void patch_store_get_info(patch_storage_info_t *info);
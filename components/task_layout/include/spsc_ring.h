@@ -0,0 +1,110 @@
+#pragma once
+
+// Lock-free single-producer/single-consumer ring of fixed-size elements.
+// Exactly one task may write and exactly one task may read a given ring; no
+// locks are taken, so a high-priority consumer never waits on a preempted
+// producer. Producers write in place (acquire/commit) and consumers read in
+// place (peek/release), so an element is never copied twice.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct
+    {
+        uint8_t *buffer;
+        uint32_t elem_size;
+        uint32_t mask; // Capacity - 1 (capacity is a power of two)
+        uint32_t head; // Written only by the producer
+        uint32_t tail; // Written only by the consumer
+    } spsc_ring_t;
+
+    /**
+     * @brief Set up a ring over caller-provided storage of capacity * elem_size bytes.
+     * Capacity must be a power of two.
+     */
+    static inline void spsc_ring_init(spsc_ring_t *r, void *buffer, uint32_t elem_size, uint32_t capacity)
+    {
+        r->buffer = (uint8_t *)buffer;
+        r->elem_size = elem_size;
+        r->mask = capacity - 1;
+        r->head = 0;
+        r->tail = 0;
+    }
+
+    // --- Producer Side ---
+
+    /**
+     * @brief Slot for the next element, or NULL if the ring is full.
+     * Nothing is visible to the consumer until spsc_ring_commit().
+     */
+    static inline void *spsc_ring_acquire(spsc_ring_t *r)
+    {
+        uint32_t head = r->head;
+        uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        if (head - tail > r->mask)
+        {
+            return NULL;
+        }
+        return r->buffer + (size_t)(head & r->mask) * r->elem_size;
+    }
+
+    static inline void spsc_ring_commit(spsc_ring_t *r)
+    {
+        __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELEASE);
+    }
+
+    // --- Consumer Side ---
+
+    /**
+     * @brief Oldest element, or NULL if the ring is empty. Valid until spsc_ring_release().
+     */
+    static inline void *spsc_ring_peek(spsc_ring_t *r)
+    {
+        uint32_t tail = r->tail;
+        uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        if (head == tail)
+        {
+            return NULL;
+        }
+        return r->buffer + (size_t)(tail & r->mask) * r->elem_size;
+    }
+
+    /**
+     * @brief Element `index` places behind the oldest, or NULL if fewer are queued.
+     * Valid until it is released.
+     */
+    static inline void *spsc_ring_peek_at(spsc_ring_t *r, uint32_t index)
+    {
+        uint32_t tail = r->tail;
+        uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        if (head - tail <= index)
+        {
+            return NULL;
+        }
+        return r->buffer + (size_t)((tail + index) & r->mask) * r->elem_size;
+    }
+
+    static inline void spsc_ring_release(spsc_ring_t *r)
+    {
+        __atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+    }
+
+    // --- Either Side ---
+
+    /**
+     * @brief Elements currently queued (a snapshot; may be stale by the time it is used).
+     */
+    static inline uint32_t spsc_ring_count(const spsc_ring_t *r)
+    {
+        return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    }
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+
+// Where every long-running task lives. Keep all core/priority choices here so
+// the layout can be reviewed in one place.
+//
+// Core 0 (control): UI, encoders, MIDI/OSC/USB input, display, settings and
+//                   the ESP-IDF system tasks (Wi-Fi, USB stack, esp_timer).
+// Core 1 (bus):     the I2C bus engine and the modulation engine that feeds it.
+//
+// Producers on either core hand bus writes to the bus engine through
+// per-producer SPSC rings (see spsc_ring.h), never through a shared mutex.
+// On core 1 the bus engine outranks the modulation engine, so queueing a batch
+// wakes it and preempts the producer: each batch goes out as soon as it is queued.
+
+#include "freertos/FreeRTOS.h"
+
+#define TASK_CORE_CONTROL 0
+#define TASK_CORE_BUS 1
+
+// --- Core 1 ---
+#define TASK_BUS_ENGINE_PRIORITY 12
+#define TASK_BUS_ENGINE_STACK 4096
+
+#define TASK_MOD_ENGINE_PRIORITY 10
+#define TASK_MOD_ENGINE_STACK 4096
+
+// --- Core 0 ---
+#define TASK_INPUT_PRIORITY 8 // Encoders, MIDI, OSC: short bursts, latency-sensitive
+#define TASK_INPUT_STACK 4096
+
+#define TASK_DISPLAY_PRIORITY 3 // The UI can wait, the bus cannot
+#define TASK_DISPLAY_STACK 4096
+
+#define TASK_LIBRARIAN_PRIORITY 4 // Bulk bank transfers; USB flow control absorbs any delay
+#define TASK_LIBRARIAN_STACK 4096
+
+#define TASK_SETTINGS_PRIORITY 2 // Flash writes are slow and can wait for everything else
+#define TASK_SETTINGS_STACK 3072
+
+#define TASK_PATCH_JOURNAL_PRIORITY 2 // Snapshot writes, same reasoning as settings
+#define TASK_PATCH_JOURNAL_STACK 3072
+
+#define TASK_MONITOR_PRIORITY 1
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    typedef struct
+    {
+        const char *name;          // Task name (points into the TCB; valid while the task exists)
+        BaseType_t core_id;        // Pinned core, or tskNO_AFFINITY
+        UBaseType_t priority;      // Current priority
+        uint32_t load_permille;    // Share of one core's time since the previous sample (0-1000)
+        uint32_t stack_free_bytes; // Stack high-water mark
+    } task_load_t;
+
+    /**
+     * @brief Per-task CPU load since the previous call (or since boot on the first call).
+     * Needs CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS.
+     *
+     * @param[out] loads Buffer for one entry per task.
+     * @param capacity Entries in loads.
+     * @param[out] count Number of entries written.
+     * @return ESP_OK, ESP_ERR_INVALID_SIZE if loads is too small, ESP_ERR_NOT_SUPPORTED without run-time stats.
+     */
+    esp_err_t task_monitor_sample(task_load_t *loads, size_t capacity, size_t *count);
+
+    /**
+     * @brief Sample and log one line per task, busiest first.
+     */
+    esp_err_t task_monitor_log(void);
+
+#ifdef __cplusplus
+}
+#endif
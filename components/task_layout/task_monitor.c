@@ -0,0 +1,112 @@
+#include "task_monitor.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+
+static const char *TAG = "TASK_MONITOR";
+
+#define MONITOR_MAX_TASKS 32
+
+// --- State ---
+// Run-time counters from the previous sample, matched by task handle.
+// Not thread-safe: sample from one task only.
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+static TaskStatus_t status_buf[MONITOR_MAX_TASKS];
+static TaskHandle_t prev_handle[MONITOR_MAX_TASKS];
+static uint32_t prev_counter[MONITOR_MAX_TASKS];
+static size_t prev_count = 0;
+static uint32_t prev_total = 0;
+#endif
+
+// --- Sampling ---
+
+esp_err_t task_monitor_sample(task_load_t *loads, size_t capacity, size_t *count)
+{
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    if (loads == NULL || count == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t total = 0;
+    UBaseType_t n = uxTaskGetSystemState(status_buf, MONITOR_MAX_TASKS, &total);
+    if (n == 0 || n > capacity)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // The total counts wall time; each core adds its own task time, so 1000
+    // permille is one fully busy core
+    uint32_t elapsed = total - prev_total;
+
+    for (UBaseType_t i = 0; i < n; ++i)
+    {
+        const TaskStatus_t *t = &status_buf[i];
+        uint32_t before = 0;
+        for (size_t j = 0; j < prev_count; ++j)
+        {
+            if (prev_handle[j] == t->xHandle)
+            {
+                before = prev_counter[j];
+                break;
+            }
+        }
+
+        loads[i].name = t->pcTaskName;
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        loads[i].core_id = t->xCoreID;
+#else
+        loads[i].core_id = tskNO_AFFINITY;
+#endif
+        loads[i].priority = t->uxCurrentPriority;
+        loads[i].load_permille = elapsed ? (uint32_t)((uint64_t)(t->ulRunTimeCounter - before) * 1000 / elapsed) : 0;
+        loads[i].stack_free_bytes = t->usStackHighWaterMark;
+
+        prev_handle[i] = t->xHandle;
+        prev_counter[i] = t->ulRunTimeCounter;
+    }
+    prev_count = n;
+    prev_total = total;
+    *count = n;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+static int compare_load_desc(const void *a, const void *b)
+{
+    const task_load_t *la = a;
+    const task_load_t *lb = b;
+    return (lb->load_permille > la->load_permille) - (lb->load_permille < la->load_permille);
+}
+
+esp_err_t task_monitor_log(void)
+{
+    task_load_t loads[MONITOR_MAX_TASKS];
+    size_t count = 0;
+
+    esp_err_t ret = task_monitor_sample(loads, MONITOR_MAX_TASKS, &count);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Task load unavailable: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    qsort(loads, count, sizeof(loads[0]), compare_load_desc);
+    ESP_LOGI(TAG, "%-16s %4s %4s %7s %7s", "task", "core", "prio", "load", "stack");
+    for (size_t i = 0; i < count; ++i)
+    {
+        char core[4] = "-";
+        if (loads[i].core_id >= 0 && loads[i].core_id < portNUM_PROCESSORS)
+        {
+            core[0] = (char)('0' + loads[i].core_id);
+        }
+        ESP_LOGI(TAG, "%-16s %4s %4u %5lu.%lu%% %7lu", loads[i].name, core, (unsigned)loads[i].priority,
+                 (unsigned long)(loads[i].load_permille / 10), (unsigned long)(loads[i].load_permille % 10),
+                 (unsigned long)loads[i].stack_free_bytes);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h" // For UBaseType_t
+#include "param_store.h"       // For PARAM_STORE_MODULE_ID
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // --- USB Librarian ---
+    // Transfers patch banks (see patch_format.h) over the native USB port, enumerated as
+    // a CDC-ACM serial device. Commands are text lines; banks travel as raw bytes and are
+    // self-delimiting, so no length prefix or escaping is needed:
+    //
+    //   PING\n          -> PONG PBNK <version>\n
+    //   EXPORT\n        -> BANK\n, then the live patch as a one-patch bank
+    //   IMPORT [slot]\n -> READY\n; host sends a bank; -> OK <patches>\n or ERR <reason>\n
+    //   SYNC [session gen]\n -> DELTA <session> <gen> <full>\n, then the changed parameters as a one-patch bank
+    //
+    // IMPORT streams the bank through a fixed-size parser, applies the patch whose index
+    // is `slot` (default 0) once its CRC has matched, and skips the others. A corrupt or
+    // truncated bank leaves the live patch untouched. tools/patch_bank.py implements the
+    // host side.
+    //
+    // SYNC lets an editor mirror the parameter store (see param_store.h) without reading the
+    // whole rack each time: it sends the session and generation from its last DELTA reply
+    // (nothing the first time) and receives PARAM records for just the values changed since.
+    // When <full> is 1 the editor's copy is stale (controller rebooted, so the session
+    // differs, or the store was cleared) and the bank holds every stored value instead.
+    //
+    // Module IDs in exported banks are LIBRARIAN_MODULE_ID(mux_channel, address), the same
+    // IDs the live patch uses for its connections and the parameter store uses for values.
+
+#define LIBRARIAN_MODULE_ID(mux_channel, address) PARAM_STORE_MODULE_ID(mux_channel, address)
+#define LIBRARIAN_MODULE_MUX(module_id) ((uint8_t)((module_id) >> 8))
+#define LIBRARIAN_MODULE_ADDR(module_id) ((uint8_t)((module_id) & 0xFF))
+
+    typedef struct
+    {
+        size_t task_stack_size;    // Stack size for the librarian task
+        UBaseType_t task_priority; // Below the bus engine; transfers are bulk work
+        int task_core_id;          // Core to pin the task to (0, 1, or tskNO_AFFINITY)
+    } usb_librarian_config_t;
+
+    typedef struct
+    {
+        uint32_t exports;
+        uint32_t imports;         // Banks imported with the selected patch applied
+        uint32_t syncs;           // Parameter deltas sent
+        uint32_t failures;        // Imports rejected (bad bank, timeout, patch not found)
+        uint32_t last_bytes;      // Size of the most recent transfer
+        uint32_t last_us;         // Duration of the most recent transfer
+    } usb_librarian_stats_t;
+
+    /**
+     * @brief Install the TinyUSB CDC-ACM driver and start the librarian task.
+     *
+     * @return ESP_OK, ESP_ERR_INVALID_ARG, ESP_ERR_INVALID_STATE if already running,
+     *         ESP_ERR_NO_MEM, or the TinyUSB driver's error.
+     */
+    esp_err_t usb_librarian_init(const usb_librarian_config_t *config);
+
+    /**
+     * @brief Get transfer counters.
+     */
+    void usb_librarian_get_stats(usb_librarian_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
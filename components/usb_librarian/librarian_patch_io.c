@@ -0,0 +1,458 @@
+#include "librarian_patch_io.h"
+#include "usb_librarian.h"
+#include "patch_manager.h"
+#include "param_store.h"
+#include "i2c_manager.h"
+#include "i2c_stage.h"
+#include "synth_constants.h" // For I2C_TIMEOUT_MS
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <string.h>
+
+static const char *TAG = "LIBRARIAN_IO";
+
+#define IO_CAPS_PREFERRED (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define IO_CAPS_FALLBACK (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+
+static void *io_alloc(size_t size)
+{
+    void *p = heap_caps_malloc(size, IO_CAPS_PREFERRED);
+    if (p == NULL)
+    {
+        p = heap_caps_malloc(size, IO_CAPS_FALLBACK);
+    }
+    return p;
+}
+
+// --- Export ---
+
+// PARAM records for every stored value changed after `since`, up to generation `upto`.
+// Values rewritten meanwhile get a newer generation and are left for the next sync.
+static esp_err_t write_params(patch_writer_t *w, uint32_t since, uint32_t upto, size_t *written)
+{
+    param_store_entry_t page[LIBRARIAN_PARAM_PAGE];
+    size_t total = 0;
+    esp_err_t ret = ESP_OK;
+    for (uint32_t cursor = since; cursor < upto;)
+    {
+        size_t count = 0;
+        ret = param_store_changes_since(param_store_session(), cursor, page, LIBRARIAN_PARAM_PAGE, &count, NULL);
+        if (ret != ESP_OK || count == 0)
+        {
+            break;
+        }
+        for (size_t i = 0; i < count && page[i].generation <= upto; ++i)
+        {
+            patch_format_param_t param = {
+                .module_id = page[i].module_id,
+                .param_id = page[i].param_id,
+                .value = page[i].value,
+            };
+            patch_writer_param(w, &param);
+            total++;
+        }
+        cursor = page[count - 1].generation;
+    }
+    *written = total;
+    return ret;
+}
+
+esp_err_t librarian_export_live(patch_format_write_fn_t write_fn, void *ctx)
+{
+    patch_writer_t *w = io_alloc(sizeof(patch_writer_t));
+    i2c_module_ref_t *refs = io_alloc(CONFIG_CENTRAL_I2C_MODULE_CACHE_ENTRIES * sizeof(i2c_module_ref_t));
+    patch_connection_t page[LIBRARIAN_EXPORT_PAGE];
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    if (w == NULL || refs == NULL)
+    {
+        goto export_done;
+    }
+
+    patch_format_patch_t patch = {.index = 0};
+    strcpy(patch.name, "live");
+    patch_writer_begin(w, write_fn, ctx);
+    patch_writer_begin_patch(w, &patch);
+
+    // Modules: whatever discovery and traffic have put in the module cache
+    size_t n_modules = 0;
+    i2c_manager_get_cached_modules(I2C_MUX_ALL_CHANNELS, refs, CONFIG_CENTRAL_I2C_MODULE_CACHE_ENTRIES, &n_modules);
+    for (size_t i = 0; i < n_modules; ++i)
+    {
+        i2c_common_block_t info;
+        if (i2c_manager_get_module_info(refs[i].mux_channel, refs[i].module_addr, &info,
+                                        pdMS_TO_TICKS(I2C_TIMEOUT_MS)) != ESP_OK)
+        {
+            continue; // Gone since it was cached
+        }
+        patch_format_module_t m = {
+            .module_id = LIBRARIAN_MODULE_ID(refs[i].mux_channel, refs[i].module_addr),
+            .mux_channel = refs[i].mux_channel,
+            .address = refs[i].module_addr,
+            .module_type = info.module_type,
+            .fw_version = info.fw_version,
+        };
+        patch_writer_module(w, &m);
+    }
+
+    // Connections, a page at a time so the whole patch never has to be copied
+    size_t first = 0;
+    for (;;)
+    {
+        size_t count = 0;
+        ret = patch_manager_get_connections_from(first, page, LIBRARIAN_EXPORT_PAGE, &count);
+        if (ret != ESP_OK || count == 0)
+        {
+            break;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            patch_format_connection_t c = {
+                .src_module = page[i].source_module,
+                .src_port = page[i].source_port,
+                .dst_module = page[i].dest_module,
+                .dst_port = page[i].dest_port,
+                .flags = page[i].is_active ? PATCH_CONN_FLAG_ACTIVE : 0,
+            };
+            patch_writer_connection(w, &c);
+        }
+        first += count;
+    }
+
+    // Parameters: every value the controller has set, from the parameter store
+    size_t n_params = 0;
+    if (ret == ESP_OK)
+    {
+        ret = write_params(w, 0, param_store_generation(), &n_params);
+    }
+
+    if (ret == ESP_OK)
+    {
+        patch_writer_end_patch(w);
+        ret = patch_writer_finish(w); // Returns the writer's first error, if any
+    }
+    if (ret == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Exported %d modules, %d connections, %d parameters", n_modules, first, n_params);
+    }
+
+export_done:
+    heap_caps_free(refs);
+    heap_caps_free(w);
+    return ret;
+}
+
+esp_err_t librarian_export_changes(uint32_t since, uint32_t upto, patch_format_write_fn_t write_fn, void *ctx)
+{
+    patch_writer_t *w = io_alloc(sizeof(patch_writer_t));
+    if (w == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    patch_format_patch_t patch = {.index = 0};
+    strcpy(patch.name, "changes");
+    patch_writer_begin(w, write_fn, ctx);
+    patch_writer_begin_patch(w, &patch);
+    size_t n_params = 0;
+    esp_err_t ret = write_params(w, since, upto, &n_params);
+    if (ret == ESP_OK)
+    {
+        patch_writer_end_patch(w);
+        ret = patch_writer_finish(w);
+    }
+    if (ret == ESP_OK)
+    {
+        ESP_LOGD(TAG, "Sent %d parameters changed in generations %lu-%lu", n_params, (unsigned long)since + 1,
+                 (unsigned long)upto);
+    }
+    heap_caps_free(w);
+    return ret;
+}
+
+// --- Import ---
+// Records of the selected patch are collected (connections in a buffer, parameters in a
+// staged scene) and only acted on from on_patch_end, after the patch CRC has matched:
+// nothing touches the bus or the live patch before that.
+
+typedef struct
+{
+    uint16_t module_id;
+    uint8_t mux_channel;
+    uint8_t address;
+    uint32_t module_type;
+} import_module_t;
+
+struct librarian_import
+{
+    patch_reader_t reader;
+    patch_reader_callbacks_t cbs;
+    uint32_t slot;
+    bool selected; // Inside the patch being imported
+    bool applied;
+    esp_err_t apply_error;
+    import_module_t modules[LIBRARIAN_MAX_MODULES];
+    size_t module_count;
+    patch_connection_t *connections; // The new patch, swapped in whole by on_patch_end
+    size_t connection_count;
+    size_t skipped_params;
+    i2c_stage_t stage;
+};
+
+static const import_module_t *find_module(const librarian_import_t *imp, uint16_t module_id)
+{
+    for (size_t i = 0; i < imp->module_count; ++i)
+    {
+        if (imp->modules[i].module_id == module_id)
+        {
+            return &imp->modules[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t on_patch_begin(const patch_format_patch_t *patch, void *ctx)
+{
+    librarian_import_t *imp = ctx;
+    imp->selected = !imp->applied && patch->index == imp->slot;
+    if (imp->selected)
+    {
+        imp->module_count = 0;
+        imp->connection_count = 0;
+        imp->skipped_params = 0;
+        i2c_stage_clear(&imp->stage);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t on_module(const patch_format_module_t *module, void *ctx)
+{
+    librarian_import_t *imp = ctx;
+    if (!imp->selected)
+    {
+        return ESP_OK;
+    }
+    if (imp->module_count >= LIBRARIAN_MAX_MODULES)
+    {
+        ESP_LOGW(TAG, "More than %d modules in patch, ignoring module %d", LIBRARIAN_MAX_MODULES, module->module_id);
+        return ESP_OK;
+    }
+
+    import_module_t *m = &imp->modules[imp->module_count++];
+    m->module_id = module->module_id;
+    m->mux_channel = module->mux_channel;
+    m->address = module->address;
+    m->module_type = module->module_type;
+    return ESP_OK;
+}
+
+static esp_err_t on_connection(const patch_format_connection_t *conn, void *ctx)
+{
+    librarian_import_t *imp = ctx;
+    if (!imp->selected)
+    {
+        return ESP_OK;
+    }
+    if (imp->connection_count >= CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    imp->connections[imp->connection_count++] = (patch_connection_t){
+        .source_module = conn->src_module,
+        .source_port = conn->src_port,
+        .dest_module = conn->dst_module,
+        .dest_port = conn->dst_port,
+        .is_active = true,
+    };
+    return ESP_OK;
+}
+
+static esp_err_t on_param(const patch_format_param_t *param, void *ctx)
+{
+    librarian_import_t *imp = ctx;
+    if (!imp->selected)
+    {
+        return ESP_OK;
+    }
+    const import_module_t *m = find_module(imp, param->module_id);
+    if (m == NULL || m->mux_channel >= I2C_MUX_CHANNEL_COUNT)
+    {
+        imp->skipped_params++;
+        return ESP_OK;
+    }
+    return i2c_stage_set_param(&imp->stage, m->mux_channel, m->address,
+                               (ParamId_t)param->param_id, (ParamValue_t)param->value);
+}
+
+// Parameters only make sense on the same kind of module: drop the staged parameters of
+// modules that are missing from the rack or of another type
+static void drop_absent_params(librarian_import_t *imp)
+{
+    bool present[LIBRARIAN_MAX_MODULES];
+    for (size_t i = 0; i < imp->module_count; ++i)
+    {
+        const import_module_t *m = &imp->modules[i];
+        i2c_common_block_t info;
+        present[i] = m->mux_channel < I2C_MUX_CHANNEL_COUNT &&
+                     i2c_manager_get_module_info(m->mux_channel, m->address, &info, pdMS_TO_TICKS(I2C_TIMEOUT_MS)) ==
+                         ESP_OK &&
+                     info.module_type == m->module_type;
+        if (!present[i])
+        {
+            ESP_LOGW(TAG, "Module %d (type %lu at 0x%02X on MUX %d) not in rack, skipping its parameters",
+                     m->module_id, (unsigned long)m->module_type, m->address, m->mux_channel);
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t p = 0; p < imp->stage.count; ++p)
+    {
+        const i2c_staged_param_t *param = &imp->stage.params[p];
+        bool keep = false;
+        for (size_t i = 0; i < imp->module_count && !keep; ++i)
+        {
+            keep = present[i] && imp->modules[i].mux_channel == param->mux_channel &&
+                   imp->modules[i].address == param->module_addr;
+        }
+        if (keep)
+        {
+            imp->stage.params[kept++] = *param;
+        }
+        else
+        {
+            imp->skipped_params++;
+        }
+    }
+    imp->stage.count = kept;
+}
+
+static esp_err_t on_patch_end(uint32_t index, void *ctx)
+{
+    librarian_import_t *imp = ctx;
+    if (!imp->selected)
+    {
+        return ESP_OK;
+    }
+    imp->selected = false;
+    imp->applied = true;
+    // From here on the bank itself is fine: errors go to apply_error and reading carries on,
+    // so the reply reports the real outcome
+
+    // All or nothing across connections and parameters: keep the current connections so
+    // they can be put back if the parameters cannot be applied
+    patch_connection_t *previous = io_alloc(CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS * sizeof(patch_connection_t));
+    size_t previous_count = 0;
+    esp_err_t ret = previous != NULL ? patch_manager_get_connections(previous, CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS,
+                                                                     &previous_count)
+                                     : ESP_ERR_NO_MEM;
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Cannot keep the live patch for rollback, patch %lu not applied: %s", (unsigned long)index,
+                 esp_err_to_name(ret));
+        imp->apply_error = ret;
+        heap_caps_free(previous);
+        return ESP_OK;
+    }
+
+    // On failure the previous patch is still in place (and in flash)
+    ret = patch_manager_replace_connections(imp->connections, imp->connection_count);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Applying connections of patch %lu failed, live patch unchanged: %s", (unsigned long)index,
+                 esp_err_to_name(ret));
+        imp->apply_error = ret;
+        heap_caps_free(previous);
+        return ESP_OK;
+    }
+
+    // All parameters in one synchronized scene change. If a pending set cannot be
+    // delivered the modules discard everything, so putting the connections back leaves
+    // the previous patch whole (a failed commit broadcast may still have reached some).
+    drop_absent_params(imp);
+    size_t params = imp->stage.count;
+    i2c_stage_result_t result;
+    ret = i2c_stage_commit(&imp->stage, &result);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Applying parameters of patch %lu failed, restoring the previous connections: %s",
+                 (unsigned long)index, esp_err_to_name(ret));
+        imp->apply_error = ret;
+        esp_err_t restore_ret = patch_manager_replace_connections(previous, previous_count);
+        if (restore_ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Restoring the previous connections failed, patch %lu connections stay live: %s",
+                     (unsigned long)index, esp_err_to_name(restore_ret));
+        }
+        heap_caps_free(previous);
+        return ESP_OK;
+    }
+    heap_caps_free(previous);
+
+    ESP_LOGI(TAG, "Applied patch %lu: %d connections, %d parameters (%d skipped)", (unsigned long)index,
+             imp->connection_count, params, imp->skipped_params);
+    return ESP_OK;
+}
+
+librarian_import_t *librarian_import_begin(uint32_t slot)
+{
+    librarian_import_t *imp = io_alloc(sizeof(librarian_import_t));
+    if (imp == NULL)
+    {
+        return NULL;
+    }
+    memset(imp, 0, sizeof(*imp));
+    imp->slot = slot;
+    imp->connections = io_alloc(CONFIG_CENTRAL_PATCH_MAX_CONNECTIONS * sizeof(patch_connection_t));
+    if (imp->connections == NULL || i2c_stage_init(&imp->stage, CONFIG_CENTRAL_USB_LIBRARIAN_MAX_PARAMS) != ESP_OK)
+    {
+        heap_caps_free(imp->connections);
+        heap_caps_free(imp);
+        return NULL;
+    }
+
+    imp->cbs = (patch_reader_callbacks_t){
+        .on_patch_begin = on_patch_begin,
+        .on_module = on_module,
+        .on_connection = on_connection,
+        .on_param = on_param,
+        .on_patch_end = on_patch_end,
+        .ctx = imp,
+    };
+    patch_reader_init(&imp->reader, &imp->cbs);
+    return imp;
+}
+
+esp_err_t librarian_import_feed(librarian_import_t *imp, const void *data, size_t len, size_t *consumed)
+{
+    return patch_reader_feed(&imp->reader, data, len, consumed);
+}
+
+bool librarian_import_done(const librarian_import_t *imp)
+{
+    return patch_reader_done(&imp->reader);
+}
+
+esp_err_t librarian_import_end(librarian_import_t *imp, uint32_t *patches)
+{
+    esp_err_t ret;
+    if (!patch_reader_done(&imp->reader))
+    {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    else if (!imp->applied)
+    {
+        ret = ESP_ERR_NOT_FOUND;
+    }
+    else
+    {
+        ret = imp->apply_error;
+    }
+    if (patches)
+    {
+        *patches = imp->reader.patch_count;
+    }
+
+    i2c_stage_free(&imp->stage);
+    heap_caps_free(imp->connections);
+    heap_caps_free(imp);
+    return ret;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// Live patch <-> bank records. Transport-independent, so the USB task only moves bytes.
+
+#include "patch_format.h"
+#include "esp_err.h"
+#include <stdint.h>
+
+#define LIBRARIAN_MAX_MODULES 64   // MODULE records remembered per imported patch
+#define LIBRARIAN_EXPORT_PAGE 32   // Connections copied out of the patch manager at a time
+#define LIBRARIAN_PARAM_PAGE 32    // Parameter store entries copied out at a time
+
+/**
+ * @brief Write the live patch (modules known to the module cache, all connections, every
+ * parameter in the parameter store) as a one-patch bank.
+ */
+esp_err_t librarian_export_live(patch_format_write_fn_t write_fn, void *ctx);
+
+/**
+ * @brief Write the parameter store entries changed in generations (since, upto] as a
+ * one-patch bank of PARAM records only.
+ */
+esp_err_t librarian_export_changes(uint32_t since, uint32_t upto, patch_format_write_fn_t write_fn, void *ctx);
+
+typedef struct librarian_import librarian_import_t;
+
+/**
+ * @brief Start an import that will apply the patch with index `slot`.
+ *
+ * @return NULL if the connection and parameter buffers cannot be allocated.
+ */
+librarian_import_t *librarian_import_begin(uint32_t slot);
+
+/**
+ * @brief Feed the next chunk of the bank. Same contract as patch_reader_feed(); the
+ * selected patch is applied from inside this call once its PATCH_END has been verified.
+ */
+esp_err_t librarian_import_feed(librarian_import_t *imp, const void *data, size_t len, size_t *consumed);
+
+/**
+ * @brief Whether the bank has ended.
+ */
+bool librarian_import_done(const librarian_import_t *imp);
+
+/**
+ * @brief Free the import.
+ *
+ * @param[out] patches Optional: patches in the bank (valid once done).
+ * @return ESP_OK if the selected patch was applied, ESP_ERR_NOT_FOUND if the bank did not
+ *         contain it, ESP_ERR_INVALID_STATE if the bank never ended, or the error that kept
+ *         the patch from being applied (the previous connections are then back in place).
+ */
+esp_err_t librarian_import_end(librarian_import_t *imp, uint32_t *patches);
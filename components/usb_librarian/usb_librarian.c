@@ -0,0 +1,404 @@
+#include "usb_librarian.h"
+#include "librarian_patch_io.h"
+#include "param_store.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "tinyusb.h"
+#include "tusb_cdc_acm.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "USB_LIBRARIAN";
+
+#define LIBRARIAN_ITF TINYUSB_CDC_ACM_0
+#define RX_CHUNK 512             // One full-speed bulk packet batch per read
+#define LINE_MAX 32              // Longest command line
+#define RX_POLL_MS 20            // Upper bound on a missed RX notification
+#define TX_FLUSH_TIMEOUT_MS 1000 // Host stopped reading
+#define DRAIN_IDLE_MS 100        // Quiet time that marks the end of a rejected bank
+
+#define IMPORT_TIMEOUT_US ((int64_t)CONFIG_CENTRAL_USB_LIBRARIAN_IMPORT_TIMEOUT_MS * 1000)
+
+// --- State ---
+
+static TaskHandle_t librarian_task_handle = NULL;
+static usb_librarian_stats_t stats = {0};
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// --- Transport ---
+// The RX callback runs in the TinyUSB task and only wakes the librarian task, which reads
+// the CDC FIFO itself. Data it has not read stays in the FIFO and the host is NAKed, so a
+// slow patch apply throttles the sender instead of dropping bytes.
+
+static void cdc_rx_callback(int itf, cdcacm_event_t *event)
+{
+    if (librarian_task_handle)
+    {
+        xTaskNotifyGive(librarian_task_handle);
+    }
+}
+
+// Read whatever is waiting, blocking up to wait_ticks for something to arrive
+static size_t cdc_read(uint8_t *buf, size_t cap, TickType_t wait_ticks)
+{
+    size_t n = 0;
+    if (tinyusb_cdcacm_read(LIBRARIAN_ITF, buf, cap, &n) == ESP_OK && n > 0)
+    {
+        return n;
+    }
+    ulTaskNotifyTake(pdTRUE, wait_ticks);
+    if (tinyusb_cdcacm_read(LIBRARIAN_ITF, buf, cap, &n) != ESP_OK)
+    {
+        return 0;
+    }
+    return n;
+}
+
+// patch_format_write_fn_t: queue everything, flushing whenever the TX FIFO is full
+static esp_err_t cdc_write(const void *data, size_t len, void *ctx)
+{
+    const uint8_t *p = data;
+    while (len > 0)
+    {
+        size_t queued = tinyusb_cdcacm_write_queue(LIBRARIAN_ITF, p, len);
+        p += queued;
+        len -= queued;
+        if (len > 0 && tinyusb_cdcacm_write_flush(LIBRARIAN_ITF, pdMS_TO_TICKS(TX_FLUSH_TIMEOUT_MS)) != ESP_OK)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+    return ESP_OK;
+}
+
+static void cdc_reply(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void cdc_reply(const char *fmt, ...)
+{
+    char line[64];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (len > 0)
+    {
+        cdc_write(line, len < (int)sizeof(line) ? (size_t)len : sizeof(line) - 1, NULL);
+        tinyusb_cdcacm_write_flush(LIBRARIAN_ITF, pdMS_TO_TICKS(TX_FLUSH_TIMEOUT_MS));
+    }
+}
+
+typedef enum
+{
+    TRANSFER_EXPORT,
+    TRANSFER_IMPORT,
+    TRANSFER_SYNC,
+} transfer_kind_t;
+
+static void record_transfer(transfer_kind_t kind, esp_err_t ret, uint32_t bytes, int64_t start_us)
+{
+    static const char *const verbs[] = {"Exported", "Imported", "Synced"};
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start_us);
+    portENTER_CRITICAL(&stats_lock);
+    if (ret != ESP_OK)
+    {
+        stats.failures++;
+    }
+    else if (kind == TRANSFER_EXPORT)
+    {
+        stats.exports++;
+    }
+    else if (kind == TRANSFER_IMPORT)
+    {
+        stats.imports++;
+    }
+    else
+    {
+        stats.syncs++;
+    }
+    stats.last_bytes = bytes;
+    stats.last_us = us;
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (ret == ESP_OK)
+    {
+        ESP_LOGI(TAG, "%s %lu bytes in %lu us (%lu KB/s)", verbs[kind], (unsigned long)bytes, (unsigned long)us,
+                 (unsigned long)(us ? (uint64_t)bytes * 1000000 / 1024 / us : 0));
+    }
+}
+
+// --- Commands ---
+
+typedef struct
+{
+    uint8_t buf[RX_CHUNK];
+    size_t len;
+    size_t pos;
+} rx_buffer_t;
+
+static esp_err_t count_bytes(const void *data, size_t len, void *ctx)
+{
+    esp_err_t ret = cdc_write(data, len, NULL);
+    *(uint32_t *)ctx += len;
+    return ret;
+}
+
+static void handle_export(void)
+{
+    int64_t start = esp_timer_get_time();
+    uint32_t bytes = 0;
+    cdc_reply("BANK\n");
+    esp_err_t ret = librarian_export_live(count_bytes, &bytes);
+    tinyusb_cdcacm_write_flush(LIBRARIAN_ITF, pdMS_TO_TICKS(TX_FLUSH_TIMEOUT_MS));
+    if (ret != ESP_OK)
+    {
+        // The host sees a bank without BANK_END and times out
+        ESP_LOGE(TAG, "Export failed: %s", esp_err_to_name(ret));
+    }
+    record_transfer(TRANSFER_EXPORT, ret, bytes, start);
+}
+
+// Parameter values changed since the host's session and generation. The reply names the
+// session and generation the host is now up to date with; changes made while the bank is
+// sent carry a later generation and are left for the next SYNC.
+static void handle_sync(uint32_t host_session, uint32_t since)
+{
+    int64_t start = esp_timer_get_time();
+    uint32_t bytes = 0;
+    uint32_t upto = param_store_generation();
+    bool full = param_store_full_sync_needed(host_session, since);
+    if (full)
+    {
+        since = 0; // Host is from another boot, behind a clear, or has nothing: send every stored value
+    }
+
+    cdc_reply("DELTA %lu %lu %d\n", (unsigned long)param_store_session(), (unsigned long)upto, full);
+    esp_err_t ret = librarian_export_changes(since, upto, count_bytes, &bytes);
+    tinyusb_cdcacm_write_flush(LIBRARIAN_ITF, pdMS_TO_TICKS(TX_FLUSH_TIMEOUT_MS));
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Sync failed: %s", esp_err_to_name(ret));
+    }
+    record_transfer(TRANSFER_SYNC, ret, bytes, start);
+}
+
+// Discard input until the host has been quiet for DRAIN_IDLE_MS
+static void drain_input(rx_buffer_t *rx)
+{
+    rx->len = 0;
+    rx->pos = 0;
+    while (cdc_read(rx->buf, sizeof(rx->buf), pdMS_TO_TICKS(DRAIN_IDLE_MS)) > 0)
+    {
+    }
+}
+
+static void handle_import(rx_buffer_t *rx, uint32_t slot)
+{
+    librarian_import_t *imp = librarian_import_begin(slot);
+    if (imp == NULL)
+    {
+        cdc_reply("ERR %s\n", esp_err_to_name(ESP_ERR_NO_MEM));
+        return;
+    }
+    cdc_reply("READY\n");
+
+    int64_t start = esp_timer_get_time();
+    int64_t last_rx = start;
+    uint32_t bytes = 0;
+    esp_err_t ret = ESP_OK;
+    while (!librarian_import_done(imp))
+    {
+        if (rx->pos == rx->len)
+        {
+            rx->pos = 0;
+            rx->len = cdc_read(rx->buf, sizeof(rx->buf), pdMS_TO_TICKS(RX_POLL_MS));
+            int64_t now = esp_timer_get_time();
+            if (rx->len == 0)
+            {
+                if (now - last_rx > IMPORT_TIMEOUT_US)
+                {
+                    ret = ESP_ERR_TIMEOUT;
+                    break;
+                }
+                continue;
+            }
+            last_rx = now;
+        }
+
+        size_t used = 0;
+        ret = librarian_import_feed(imp, &rx->buf[rx->pos], rx->len - rx->pos, &used);
+        rx->pos += used;
+        bytes += used;
+        if (ret != ESP_OK)
+        {
+            break;
+        }
+    }
+
+    uint32_t patches = 0;
+    esp_err_t end_ret = librarian_import_end(imp, &patches);
+    if (ret == ESP_OK)
+    {
+        ret = end_ret;
+    }
+    else
+    {
+        drain_input(rx); // The rest of a rejected bank must not be parsed as commands
+    }
+
+    if (ret == ESP_OK)
+    {
+        cdc_reply("OK %lu\n", (unsigned long)patches);
+    }
+    else
+    {
+        ESP_LOGW(TAG, "Import of slot %lu failed after %lu bytes: %s", (unsigned long)slot, (unsigned long)bytes,
+                 esp_err_to_name(ret));
+        cdc_reply("ERR %s\n", esp_err_to_name(ret));
+    }
+    record_transfer(TRANSFER_IMPORT, ret, bytes, start);
+}
+
+static void handle_line(rx_buffer_t *rx, char *line)
+{
+    char *arg = strchr(line, ' ');
+    if (arg)
+    {
+        *arg++ = '\0';
+    }
+
+    if (strcmp(line, "PING") == 0)
+    {
+        cdc_reply("PONG PBNK %d\n", PATCH_FORMAT_VERSION);
+    }
+    else if (strcmp(line, "EXPORT") == 0)
+    {
+        handle_export();
+    }
+    else if (strcmp(line, "SYNC") == 0)
+    {
+        // "SYNC <session> <gen>"; anything less is a host without a copy
+        char *gen = NULL;
+        uint32_t host_session = arg ? (uint32_t)strtoul(arg, &gen, 10) : 0;
+        handle_sync(host_session, gen && *gen != '\0' ? (uint32_t)strtoul(gen, NULL, 10) : 0);
+    }
+    else if (strcmp(line, "IMPORT") == 0)
+    {
+        handle_import(rx, arg ? (uint32_t)strtoul(arg, NULL, 10) : 0);
+    }
+    else if (line[0] != '\0')
+    {
+        cdc_reply("ERR unknown command\n");
+    }
+}
+
+static void librarian_task(void *arg)
+{
+    rx_buffer_t rx = {0};
+    char line[LINE_MAX + 1];
+    size_t line_len = 0;
+    bool overlong = false;
+
+    while (1)
+    {
+        if (rx.pos == rx.len)
+        {
+            rx.pos = 0;
+            rx.len = cdc_read(rx.buf, sizeof(rx.buf), portMAX_DELAY);
+            continue;
+        }
+
+        char ch = (char)rx.buf[rx.pos++];
+        if (ch == '\r')
+        {
+            continue;
+        }
+        if (ch != '\n')
+        {
+            if (line_len < LINE_MAX)
+            {
+                line[line_len++] = ch;
+            }
+            else
+            {
+                overlong = true;
+            }
+            continue;
+        }
+
+        line[line_len] = '\0';
+        if (overlong)
+        {
+            cdc_reply("ERR line too long\n");
+        }
+        else
+        {
+            handle_line(&rx, line); // May consume bytes following the line (an IMPORT bank)
+        }
+        line_len = 0;
+        overlong = false;
+    }
+}
+
+// --- Public API ---
+
+esp_err_t usb_librarian_init(const usb_librarian_config_t *config)
+{
+    if (config == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (librarian_task_handle != NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const tinyusb_config_t tusb_cfg = {0}; // Default descriptors for a CDC device
+    esp_err_t ret = tinyusb_driver_install(&tusb_cfg);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to install TinyUSB driver: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    const tinyusb_config_cdcacm_t acm_cfg = {
+        .usb_dev = TINYUSB_USBDEV_0,
+        .cdc_port = LIBRARIAN_ITF,
+        .rx_unread_buf_sz = RX_CHUNK,
+        .callback_rx = cdc_rx_callback,
+    };
+    ret = tusb_cdc_acm_init(&acm_cfg);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to initialize CDC-ACM: %s", esp_err_to_name(ret));
+        goto init_fail;
+    }
+
+    if (xTaskCreatePinnedToCore(librarian_task, "usb_librarian", config->task_stack_size, NULL,
+                                config->task_priority, &librarian_task_handle, config->task_core_id) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create librarian task");
+        ret = ESP_ERR_NO_MEM;
+        goto init_fail;
+    }
+
+    ESP_LOGI(TAG, "USB librarian ready (bank format v%d)", PATCH_FORMAT_VERSION);
+    return ESP_OK;
+
+init_fail:
+    tinyusb_driver_uninstall();
+    librarian_task_handle = NULL;
+    return ret;
+}
+
+void usb_librarian_get_stats(usb_librarian_stats_t *out)
+{
+    if (out == NULL)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
@@ -5,7 +5,16 @@
 #include "esp_system.h"
 #include "nvs_flash.h"
 #include "i2c_manager.h"
+#include "i2c_trace.h"
 #include "patch_manager.h"
+#include "param_store.h"
+#include "mod_engine.h"
+#include "display.h"
+#include "input_manager.h"
+#include "global_settings.h"
+#include "usb_librarian.h"
+#include "task_layout.h"
+#include "task_monitor.h"
 #include "synth_constants.h" // From common_definitions
 
 static const char *TAG = "MAIN";
@@ -23,14 +32,58 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
+    // Load persistent settings into RAM; later reads never touch flash
+    global_settings_config_t settings_config = {
+        .quiet_period_ms = CONFIG_CENTRAL_SETTINGS_QUIET_PERIOD_MS,
+        .max_delay_ms = CONFIG_CENTRAL_SETTINGS_MAX_DELAY_MS,
+        .task_stack_size = TASK_SETTINGS_STACK,
+        .task_priority = TASK_SETTINGS_PRIORITY,
+        .task_core_id = TASK_CORE_CONTROL,
+    };
+    ret = global_settings_init(&settings_config);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to initialize Global Settings!");
+        return;
+    }
+
     // Initialize Core Components
     ESP_LOGI(TAG, "Initializing I2C Manager...");
 
     // Create and configure the I2C manager configuration
     i2c_manager_config_t i2c_config = {
-        .scl_pin = 22,        // Example: SCL on GPIO22
-        .sda_pin = 21,        // Example: SDA on GPIO21
-        .clock_speed = 400000 // Example: 400 KHz
+        .i2c_port = CONFIG_CENTRAL_I2C_MASTER_PORT_NUM,
+        .sda_io_num = CONFIG_CENTRAL_I2C_MASTER_SDA_IO,
+        .scl_io_num = CONFIG_CENTRAL_I2C_MASTER_SCL_IO,
+        .clk_speed = CONFIG_CENTRAL_I2C_MASTER_FREQ_HZ,
+        .muxes = {
+            {CONFIG_CENTRAL_I2C_MUX_ADDRESS, I2C_MUX_ROOT},
+#if CONFIG_CENTRAL_I2C_MUX_COUNT >= 2
+            {CONFIG_CENTRAL_I2C_MUX_ADDRESS + 1, CONFIG_CENTRAL_I2C_MUX1_PARENT},
+#endif
+#if CONFIG_CENTRAL_I2C_MUX_COUNT >= 3
+            {CONFIG_CENTRAL_I2C_MUX_ADDRESS + 2, CONFIG_CENTRAL_I2C_MUX2_PARENT},
+#endif
+#if CONFIG_CENTRAL_I2C_MUX_COUNT >= 4
+            {CONFIG_CENTRAL_I2C_MUX_ADDRESS + 3, CONFIG_CENTRAL_I2C_MUX3_PARENT},
+#endif
+#if CONFIG_CENTRAL_I2C_MUX_COUNT >= 5
+            {CONFIG_CENTRAL_I2C_MUX_ADDRESS + 4, CONFIG_CENTRAL_I2C_MUX4_PARENT},
+#endif
+#if CONFIG_CENTRAL_I2C_MUX_COUNT >= 6
+            {CONFIG_CENTRAL_I2C_MUX_ADDRESS + 5, CONFIG_CENTRAL_I2C_MUX5_PARENT},
+#endif
+#if CONFIG_CENTRAL_I2C_MUX_COUNT >= 7
+            {CONFIG_CENTRAL_I2C_MUX_ADDRESS + 6, CONFIG_CENTRAL_I2C_MUX6_PARENT},
+#endif
+#if CONFIG_CENTRAL_I2C_MUX_COUNT >= 8
+            {CONFIG_CENTRAL_I2C_MUX_ADDRESS + 7, CONFIG_CENTRAL_I2C_MUX7_PARENT},
+#endif
+        },
+        .task_stack_size = TASK_BUS_ENGINE_STACK,
+        .task_priority = TASK_BUS_ENGINE_PRIORITY,
+        .task_core_id = TASK_CORE_BUS,
+        .command_queue_size = CONFIG_CENTRAL_I2C_QUEUE_DEPTH,
     };
 
     ret = i2c_manager_init(&i2c_config);
@@ -45,6 +98,11 @@ void app_main(void)
         ESP_LOGI(TAG, "I2C Manager Initialized.");
     }
 
+#if CONFIG_CENTRAL_I2C_TRACE_BENCHMARK_AT_BOOT
+    float trace_ns = 0.0f;
+    i2c_trace_benchmark(10000, &trace_ns);
+#endif
+
     ESP_LOGI(TAG, "Initializing Patch Manager...");
     ret = patch_manager_init();
     if (ret != ESP_OK)
@@ -58,43 +116,184 @@ void app_main(void)
         ESP_LOGI(TAG, "Patch Manager Initialized.");
     }
 
+    ret = param_store_init();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to initialize Parameter Store!");
+        return;
+    }
+
+    i2c_manager_set_param_observer(param_store_record_module_param);
+
+#if CONFIG_CENTRAL_PATCH_JOURNAL_ENABLE
+    patch_journal_config_t journal_config = {
+        .task_stack_size = TASK_PATCH_JOURNAL_STACK,
+        .task_priority = TASK_PATCH_JOURNAL_PRIORITY,
+        .task_core_id = TASK_CORE_CONTROL,
+    };
+    ret = patch_manager_restore(&journal_config);
+    if (ret != ESP_OK)
+    {
+        // Keep running with an empty patch; edits just won't survive a reboot
+        ESP_LOGE(TAG, "Failed to restore saved patch!");
+    }
+#endif
+
+#if CONFIG_CENTRAL_USB_LIBRARIAN_ENABLE
+    ESP_LOGI(TAG, "Initializing USB Librarian...");
+    usb_librarian_config_t librarian_config = {
+        .task_stack_size = TASK_LIBRARIAN_STACK,
+        .task_priority = TASK_LIBRARIAN_PRIORITY,
+        .task_core_id = TASK_CORE_CONTROL, // With the USB stack
+    };
+    ret = usb_librarian_init(&librarian_config);
+    if (ret != ESP_OK)
+    {
+        // Patches can still be edited on the device
+        ESP_LOGE(TAG, "Failed to initialize USB Librarian!");
+    }
+#endif
+
+    ESP_LOGI(TAG, "Initializing Modulation Engine...");
+    mod_engine_config_t mod_config = {
+        .rate_hz = CONFIG_CENTRAL_MOD_ENGINE_RATE_HZ,
+        .task_stack_size = TASK_MOD_ENGINE_STACK,
+        .task_priority = TASK_MOD_ENGINE_PRIORITY,
+        .task_core_id = TASK_CORE_BUS, // Next to its consumer, off the core running Wi-Fi/USB
+    };
+    ret = mod_engine_init(&mod_config);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to initialize Modulation Engine!");
+        return;
+    }
+
+#if CONFIG_CENTRAL_MOD_ENGINE_BENCHMARK_AT_BOOT
+    float mods_per_ms = 0.0f;
+    mod_engine_benchmark(CONFIG_CENTRAL_MOD_ENGINE_MAX_MODULATORS, 1000, &mods_per_ms);
+#endif
+
+    ret = mod_engine_start();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start Modulation Engine!");
+        return;
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Modulation Engine Running.");
+    }
+
+#if CONFIG_CENTRAL_INPUT_ENCODER_COUNT > 0
+    ESP_LOGI(TAG, "Initializing Input...");
+    input_manager_config_t input_config = {
+        .encoders = {
+            {CONFIG_CENTRAL_INPUT_ENC1_A_IO, CONFIG_CENTRAL_INPUT_ENC1_B_IO, CONFIG_CENTRAL_INPUT_ENC1_SW_IO},
+#if CONFIG_CENTRAL_INPUT_ENCODER_COUNT >= 2
+            {CONFIG_CENTRAL_INPUT_ENC2_A_IO, CONFIG_CENTRAL_INPUT_ENC2_B_IO, CONFIG_CENTRAL_INPUT_ENC2_SW_IO},
+#endif
+#if CONFIG_CENTRAL_INPUT_ENCODER_COUNT >= 3
+            {CONFIG_CENTRAL_INPUT_ENC3_A_IO, CONFIG_CENTRAL_INPUT_ENC3_B_IO, CONFIG_CENTRAL_INPUT_ENC3_SW_IO},
+#endif
+#if CONFIG_CENTRAL_INPUT_ENCODER_COUNT >= 4
+            {CONFIG_CENTRAL_INPUT_ENC4_A_IO, CONFIG_CENTRAL_INPUT_ENC4_B_IO, CONFIG_CENTRAL_INPUT_ENC4_SW_IO},
+#endif
+        },
+        .encoder_count = CONFIG_CENTRAL_INPUT_ENCODER_COUNT,
+        .counts_per_detent = CONFIG_CENTRAL_INPUT_COUNTS_PER_DETENT,
+        .poll_ms = CONFIG_CENTRAL_INPUT_POLL_MS,
+        .batch_ms = CONFIG_CENTRAL_INPUT_BATCH_MS,
+        .debounce_ms = CONFIG_CENTRAL_INPUT_DEBOUNCE_MS,
+        .accel_min_dps = CONFIG_CENTRAL_INPUT_ACCEL_MIN_DPS,
+        .accel_max_dps = CONFIG_CENTRAL_INPUT_ACCEL_MAX_DPS,
+        .accel_max_mult = CONFIG_CENTRAL_INPUT_ACCEL_MAX_MULT,
+        .event_queue_len = 32,
+        .task_stack_size = TASK_INPUT_STACK,
+        .task_priority = TASK_INPUT_PRIORITY,
+        .task_core_id = TASK_CORE_CONTROL,
+    };
+    ret = input_manager_init(&input_config);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to initialize Input!");
+    }
+#endif
+
+    ESP_LOGI(TAG, "Initializing Display...");
+    display_config_t display_config = {
+        .task_stack_size = TASK_DISPLAY_STACK,
+        .task_priority = TASK_DISPLAY_PRIORITY,
+        .task_core_id = TASK_CORE_CONTROL,
+        .max_fps = CONFIG_CENTRAL_DISPLAY_MAX_FPS,
+    };
+    ret = display_init(&display_config);
+    if (ret != ESP_OK)
+    {
+        // The synth still runs headless, so this is not fatal
+        ESP_LOGE(TAG, "Failed to initialize Display!");
+    }
+    else
+    {
+#if CONFIG_CENTRAL_DISPLAY_BENCHMARK_AT_BOOT
+        display_stats_t display_bench;
+        display_benchmark(200, &display_bench);
+#endif
+        display_present();
+        ESP_LOGI(TAG, "Display Initialized.");
+    }
+
     // --- Initialization Complete ---
     ESP_LOGI(TAG, "System Initialization Complete.");
 
-    // --- Placeholder Task/Loop ---
-    // In a real application, you would start tasks here for UI, networking, etc.
-    // For now, just print a message periodically.
-    int module_count = 0; // Placeholder
+    // --- Monitoring ---
+    // All work happens in the tasks laid out in task_layout.h; the main task only
+    // reports per-task CPU load and bus hand-off latency.
+    vTaskPrioritySet(NULL, TASK_MONITOR_PRIORITY);
+#if CONFIG_CENTRAL_TASK_MONITOR_PERIOD_S > 0
     while (1)
     {
-        ESP_LOGI(TAG, "Main loop running... Discovered Modules (Placeholder): %d", module_count);
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_CENTRAL_TASK_MONITOR_PERIOD_S * 1000));
 
-        // Example: Periodically select different mux channels and probe an address
-        for (uint8_t i = 0; i < MAX_I2C_MUX_CHANNELS; i++)
+        task_monitor_log();
+
+#if CONFIG_CENTRAL_INPUT_ENCODER_COUNT > 0
+        input_stats_t input_stats;
+        input_manager_get_stats(&input_stats);
+        ESP_LOGI(TAG, "Input: %lu detents in %lu events, %lu dropped", (unsigned long)input_stats.detents,
+                 (unsigned long)input_stats.events, (unsigned long)input_stats.dropped);
+#endif
+
+        i2c_producer_stats_t producer_stats[CONFIG_CENTRAL_I2C_MAX_PRODUCERS];
+        size_t producer_count = 0;
+        i2c_manager_get_producer_stats(producer_stats, CONFIG_CENTRAL_I2C_MAX_PRODUCERS, &producer_count);
+        for (size_t i = 0; i < producer_count; ++i)
         {
-            ESP_LOGD(TAG, "Selecting MUX channel %d", i);
-            ret = i2c_manager_select_mux_channel(i);
-            if (ret != ESP_OK)
-            {
-                ESP_LOGW(TAG, "Failed to select MUX channel %d", i);
-            }
-            else
-            {
-                // Placeholder: Try to probe a device on the selected channel
-                uint8_t dummy_addr = 0x50; // Example address
-                ret = i2c_manager_probe_device(dummy_addr);
-                if (ret == ESP_OK)
-                {
-                    ESP_LOGI(TAG, "Device ACKed at 0x%02X on channel %d", dummy_addr, i);
-                }
-                else
-                {
-                    ESP_LOGD(TAG, "No ACK from 0x%02X on channel %d", dummy_addr, i);
-                }
-            }
-            vTaskDelay(pdMS_TO_TICKS(50)); // Small delay between probes
+            ESP_LOGI(TAG, "Bus producer %-16s sent %lu, dropped %lu, failed %lu, deferred %lu, shed %lu, "
+                          "max hand-off %lu us, load %d.%d%%",
+                     producer_stats[i].task_name, (unsigned long)producer_stats[i].sent,
+                     (unsigned long)producer_stats[i].dropped, (unsigned long)producer_stats[i].failed,
+                     (unsigned long)producer_stats[i].deferred, (unsigned long)producer_stats[i].shed,
+                     (unsigned long)producer_stats[i].max_latency_us, producer_stats[i].load_permille / 10,
+                     producer_stats[i].load_permille % 10);
         }
 
-        vTaskDelay(pdMS_TO_TICKS(5000)); // Delay for 5 seconds
+        i2c_bus_load_t bus_load;
+        i2c_manager_get_bus_load(&bus_load);
+        ESP_LOGI(TAG, "Bus load %d.%d%%%s over %lu ms, busiest module 0x%02X on MUX %d at %d.%d%%",
+                 bus_load.bus_permille / 10, bus_load.bus_permille % 10,
+                 bus_load.oversubscribed ? " (oversubscribed)" : "", (unsigned long)bus_load.window_ms,
+                 bus_load.busiest_module_addr, bus_load.busiest_mux_channel, bus_load.busiest_permille / 10,
+                 bus_load.busiest_permille % 10);
+        i2c_manager_reset_producer_stats();
+
+#if CONFIG_CENTRAL_I2C_PARAM_SHADOW_ENABLE
+        i2c_param_shadow_stats_t shadow;
+        i2c_manager_get_param_shadow_stats(&shadow);
+        ESP_LOGI(TAG, "Redundant writes: %lu of %lu frames and %lu of %lu params dropped, %lu bytes saved",
+                 (unsigned long)shadow.frames_dropped, (unsigned long)shadow.frames_checked,
+                 (unsigned long)shadow.params_dropped, (unsigned long)shadow.params_checked,
+                 (unsigned long)shadow.bytes_saved);
+#endif
     }
-}
\ No newline at end of file
+#endif
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+// Shared by the host tests: a non-fatal CHECK that reports and counts failures, and the
+// runner pieces around it. Each test program includes this once.
+
+#include <stdio.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond, ...)                                \
+    do                                                  \
+    {                                                   \
+        if (!(cond))                                    \
+        {                                               \
+            test_failures++;                            \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+        }                                               \
+    } while (0)
+
+// Run one test function call and report it by name
+#define RUN_TEST(call)                                                           \
+    do                                                                           \
+    {                                                                            \
+        int failures_before = test_failures;                                     \
+        call;                                                                    \
+        printf("  %-40s %s\n", #call, test_failures == failures_before ? "ok" : "FAILED"); \
+    } while (0)
+
+/**
+ * @brief Print the suite result; returns the process exit status.
+ */
+static inline int test_summary(const char *suite)
+{
+    printf("%s: %s\n", suite, test_failures == 0 ? "all tests passed" : "FAILED");
+    return test_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+// Host test for components/input_manager/encoder_accel: simulated turns fed at the
+// input task's poll rate, checked for slow, fast, reversing and bouncing input.
+//
+// Settings come from sdkconfig.defaults (the Makefile turns it into sdkconfig.h), the
+// same values main.c passes to input_manager_init().
+
+#include "encoder_accel.h"
+#include "sdkconfig.h"
+#include "test_common.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define POLL_US (CONFIG_CENTRAL_INPUT_POLL_MS * 1000) // Input task poll period
+#define COUNTS CONFIG_CENTRAL_INPUT_COUNTS_PER_DETENT
+#define WINDOW_US (CONFIG_CENTRAL_INPUT_BATCH_MS * 1000)
+#define MAX_MULT CONFIG_CENTRAL_INPUT_ACCEL_MAX_MULT
+
+static const encoder_accel_params_t params = {
+    .counts_per_detent = COUNTS,
+    .batch_window_us = WINDOW_US,
+    .accel_min_dps = CONFIG_CENTRAL_INPUT_ACCEL_MIN_DPS,
+    .accel_max_dps = CONFIG_CENTRAL_INPUT_ACCEL_MAX_DPS,
+    .accel_max_mult = MAX_MULT,
+};
+
+typedef struct
+{
+    int32_t delta;
+    int32_t detents;
+    int events;
+    uint16_t first_mult;
+    uint16_t max_mult;
+    int64_t min_gap_us; // Shortest time between two events
+    int64_t last_event_us;
+} totals_t;
+
+static void reset_totals(totals_t *t)
+{
+    memset(t, 0, sizeof(*t));
+    t->min_gap_us = INT64_MAX;
+    t->last_event_us = -1;
+}
+
+static void poll(encoder_accel_t *a, int64_t now, totals_t *t)
+{
+    encoder_delta_t d;
+    if (!encoder_accel_poll(a, now, &d))
+    {
+        return;
+    }
+    if (t->events == 0)
+    {
+        t->first_mult = d.multiplier;
+    }
+    if (t->last_event_us >= 0 && now - t->last_event_us < t->min_gap_us)
+    {
+        t->min_gap_us = now - t->last_event_us;
+    }
+    t->last_event_us = now;
+    t->delta += d.delta;
+    t->detents += d.detents;
+    t->events++;
+    if (d.multiplier > t->max_mult)
+    {
+        t->max_mult = d.multiplier;
+    }
+}
+
+// Turn `detents` detents (negative turns back), one every `interval_us`, as the poll
+// loop would see them, then keep polling until everything has been handed out
+static int64_t turn(encoder_accel_t *a, int64_t now, int32_t detents, int64_t interval_us, totals_t *t)
+{
+    int32_t step = detents > 0 ? COUNTS : -COUNTS;
+    int32_t left = detents > 0 ? detents : -detents;
+    int64_t next_detent = now;
+    while (left > 0)
+    {
+        int32_t counts = 0;
+        while (left > 0 && next_detent <= now)
+        {
+            counts += step;
+            left--;
+            next_detent += interval_us;
+        }
+        if (counts != 0)
+        {
+            encoder_accel_feed(a, counts, now);
+        }
+        poll(a, now, t);
+        now += POLL_US;
+    }
+    for (int64_t end = now + 2 * WINDOW_US; now < end; now += POLL_US)
+    {
+        poll(a, now, t);
+    }
+    return now;
+}
+
+// --- Tests ---
+
+static void test_slow(void)
+{
+    // 5 detents/s, under accel_min_dps: every click is reported at once, at 1x
+    encoder_accel_t a;
+    encoder_accel_init(&a, &params);
+    totals_t t;
+    reset_totals(&t);
+    turn(&a, 0, 10, 200000, &t);
+    CHECK(t.delta == 10 && t.detents == 10, "slow: delta %d, detents %d", t.delta, t.detents);
+    CHECK(t.events == 10, "slow: %d events for 10 clicks", t.events);
+    CHECK(t.max_mult == ENCODER_ACCEL_ONE, "slow: multiplier %d", t.max_mult);
+
+    reset_totals(&t);
+    turn(&a, 10000000, -10, 200000, &t);
+    CHECK(t.delta == -10 && t.detents == -10, "slow back: delta %d, detents %d", t.delta, t.detents);
+}
+
+static void test_fast(void)
+{
+    // 500 detents/s, over accel_max_dps: full multiplier, batched to one event per window
+    encoder_accel_t a;
+    encoder_accel_init(&a, &params);
+    totals_t t;
+    reset_totals(&t);
+    turn(&a, 0, 200, 2000, &t);
+    CHECK(t.detents == 200, "fast: %d detents reported of 200", t.detents);
+    CHECK(t.max_mult == MAX_MULT * ENCODER_ACCEL_ONE, "fast: peak multiplier %d", t.max_mult);
+    CHECK(t.first_mult == ENCODER_ACCEL_ONE, "fast: gesture started at multiplier %d", t.first_mult);
+    CHECK(t.delta > 200 * MAX_MULT * 3 / 4 && t.delta <= 200 * MAX_MULT, "fast: delta %d for 200 detents", t.delta);
+    CHECK(t.min_gap_us >= WINDOW_US, "fast: events %lld us apart", (long long)t.min_gap_us);
+    CHECK(t.events <= 400000 / WINDOW_US + 2, "fast: %d events in 400 ms", t.events);
+
+    // Medium speed lands between the thresholds
+    encoder_accel_init(&a, &params);
+    reset_totals(&t);
+    turn(&a, 0, 100, 15000, &t); // ~67 detents/s
+    CHECK(t.max_mult > ENCODER_ACCEL_ONE && t.max_mult < MAX_MULT * ENCODER_ACCEL_ONE, "medium: multiplier %d",
+          t.max_mult);
+    CHECK(t.detents == 100 && t.delta > 100 && t.delta < 100 * MAX_MULT, "medium: delta %d, detents %d", t.delta,
+          t.detents);
+}
+
+static void test_reversal(void)
+{
+    // A reversal mid-spin drops straight back to 1x for fine adjustment
+    encoder_accel_t a;
+    encoder_accel_init(&a, &params);
+    totals_t t;
+    reset_totals(&t);
+    int64_t now = turn(&a, 0, 100, 2000, &t);
+    CHECK(t.max_mult == MAX_MULT * ENCODER_ACCEL_ONE, "reversal: forward spin peaked at %d", t.max_mult);
+
+    reset_totals(&t);
+    now = turn(&a, now, -1, 2000, &t);
+    CHECK(t.delta == -1 && t.detents == -1, "reversal: first click back gave delta %d", t.delta);
+    CHECK(t.first_mult == ENCODER_ACCEL_ONE, "reversal: multiplier %d", t.first_mult);
+
+    // A pause also ends the gesture, even in the same direction
+    reset_totals(&t);
+    turn(&a, now, 100, 2000, &t);
+    turn(&a, now + 1000000, 1, 2000, &t);
+    reset_totals(&t);
+    turn(&a, now + 2000000, 1, 2000, &t);
+    CHECK(t.delta == 1, "pause: click after a pause gave delta %d", t.delta);
+}
+
+static void test_bounce(void)
+{
+    encoder_accel_t a;
+    encoder_accel_init(&a, &params);
+    totals_t t;
+    reset_totals(&t);
+
+    // Contact bounce around a detent position never adds up to a detent
+    int64_t now = 0;
+    for (int i = 0; i < 200; ++i, now += POLL_US)
+    {
+        encoder_accel_feed(&a, (i & 1) ? -1 : 1, now);
+        poll(&a, now, &t);
+    }
+    CHECK(t.events == 0, "bounce: %d events from jitter", t.events);
+
+    // Three quarters of a detent and back again is nothing either
+    encoder_accel_feed(&a, 3, now);
+    encoder_accel_feed(&a, -3, now + POLL_US);
+    for (int64_t end = now + 3 * WINDOW_US; now < end; now += POLL_US)
+    {
+        poll(&a, now, &t);
+    }
+    CHECK(t.events == 0, "bounce: %d events from a partial detent", t.events);
+
+    // A click forward and back within one window nets to zero: no event, nothing left over
+    encoder_accel_feed(&a, COUNTS, now);
+    encoder_accel_feed(&a, -COUNTS, now + POLL_US);
+    for (int64_t end = now + 3 * WINDOW_US; now < end; now += POLL_US)
+    {
+        poll(&a, now, &t);
+    }
+    CHECK(t.events == 0, "bounce: %d events for a click that netted to zero", t.events);
+
+    // Split reads still add up to whole detents
+    encoder_accel_feed(&a, 2, now);
+    encoder_accel_feed(&a, 2, now + POLL_US);
+    for (int64_t end = now + 3 * WINDOW_US; now < end; now += POLL_US)
+    {
+        poll(&a, now, &t);
+    }
+    CHECK(t.events == 1 && t.delta == 1, "split: %d events, delta %d", t.events, t.delta);
+}
+
+int main(void)
+{
+    RUN_TEST(test_slow());
+    RUN_TEST(test_fast());
+    RUN_TEST(test_reversal());
+    RUN_TEST(test_bounce());
+    return test_summary("encoder_accel");
+}
@@ -0,0 +1,297 @@
+// Host test for components/patch_format, run on banks written by tools/patch_bank.py:
+//
+//  - round trip: re-encoding whatever the reader decodes gives back the Python bytes
+//  - chunking: the result does not depend on how the input is split across feeds
+//  - corruption: with any single bit flipped, the bank is never accepted and no patch
+//    whose CRC covers the flip reaches on_patch_end
+//
+// Usage: test_patch_format BANK...
+
+#include "patch_format.h"
+#include "test_common.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_PATCHES 64
+#define LARGE_BANK_FLIPS 2000 // Positions tried in banks too big to corrupt byte by byte
+#define EXHAUSTIVE_LIMIT 4096 // Banks up to this size get every bit of every byte flipped
+#define PATCH_END_RECORD 6    // Type, body length (4), CRC
+
+// --- Helpers ---
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void)
+{
+    // xorshift32: deterministic, so a failure reproduces
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+typedef struct
+{
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} buffer_t;
+
+static esp_err_t buffer_write(const void *data, size_t len, void *ctx)
+{
+    buffer_t *b = ctx;
+    if (b->len + len > b->cap)
+    {
+        b->cap = (b->len + len) * 2;
+        b->data = realloc(b->data, b->cap);
+        if (b->data == NULL)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    return ESP_OK;
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(*len + 1);
+    if (data != NULL && fread(data, 1, *len, f) != *len)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+// --- Decode and Re-encode ---
+// Every callback forwards its record straight to a writer, so the output is byte for
+// byte what the reader understood.
+
+typedef struct
+{
+    patch_writer_t writer;
+    buffer_t out;
+    size_t fed;                       // Input bytes fed so far (feeds of one byte give exact offsets)
+    size_t patch_ends;                // on_patch_end calls
+    size_t patch_end_at[MAX_PATCHES]; // Value of `fed` at each on_patch_end
+} recoder_t;
+
+static esp_err_t on_patch_begin(const patch_format_patch_t *patch, void *ctx)
+{
+    recoder_t *rc = ctx;
+    return patch_writer_begin_patch(&rc->writer, patch);
+}
+
+static esp_err_t on_module(const patch_format_module_t *module, void *ctx)
+{
+    recoder_t *rc = ctx;
+    return patch_writer_module(&rc->writer, module);
+}
+
+static esp_err_t on_connection(const patch_format_connection_t *conn, void *ctx)
+{
+    recoder_t *rc = ctx;
+    return patch_writer_connection(&rc->writer, conn);
+}
+
+static esp_err_t on_param(const patch_format_param_t *param, void *ctx)
+{
+    recoder_t *rc = ctx;
+    return patch_writer_param(&rc->writer, param);
+}
+
+static esp_err_t on_patch_end(uint32_t index, void *ctx)
+{
+    (void)index;
+    recoder_t *rc = ctx;
+    if (rc->patch_ends < MAX_PATCHES)
+    {
+        rc->patch_end_at[rc->patch_ends] = rc->fed;
+    }
+    rc->patch_ends++;
+    return patch_writer_end_patch(&rc->writer);
+}
+
+// Feed `data` in chunks: `chunk` bytes at a time, or random sizes up to 1 KB if 0.
+// Returns the reader's result; `done` and `consumed` report how far it got.
+static esp_err_t decode(recoder_t *rc, const uint8_t *data, size_t len, size_t chunk, bool *done,
+                        size_t *consumed)
+{
+    memset(rc, 0, sizeof(*rc));
+    patch_reader_callbacks_t cbs = {
+        .on_patch_begin = on_patch_begin,
+        .on_module = on_module,
+        .on_connection = on_connection,
+        .on_param = on_param,
+        .on_patch_end = on_patch_end,
+        .ctx = rc,
+    };
+    patch_reader_t reader;
+    patch_reader_init(&reader, &cbs);
+    patch_writer_begin(&rc->writer, buffer_write, &rc->out);
+
+    esp_err_t ret = ESP_OK;
+    size_t pos = 0;
+    while (pos < len && ret == ESP_OK && !patch_reader_done(&reader))
+    {
+        size_t n = chunk > 0 ? chunk : 1 + rng() % 1024;
+        if (n > len - pos)
+        {
+            n = len - pos;
+        }
+        size_t used = 0;
+        rc->fed = pos + n;
+        ret = patch_reader_feed(&reader, data + pos, n, &used);
+        pos += used;
+    }
+    *done = patch_reader_done(&reader);
+    *consumed = pos;
+    if (ret == ESP_OK && *done)
+    {
+        ret = patch_writer_finish(&rc->writer);
+    }
+    return ret;
+}
+
+// --- Tests ---
+
+static void test_crc(void)
+{
+    // The standard CRC-32 check value, as zlib.crc32(b"123456789") gives it
+    CHECK(patch_format_crc32(0, "123456789", 9) == 0xCBF43926u, "CRC-32 check value");
+    uint32_t split = patch_format_crc32(patch_format_crc32(0, "1234", 4), "56789", 5);
+    CHECK(split == 0xCBF43926u, "CRC-32 in two updates");
+}
+
+static void test_round_trip(const char *name, const uint8_t *bank, size_t len)
+{
+    static const size_t chunks[] = {1, 2, 3, 7, 64, 511, 512, 513, 0, 0, 0, 0};
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); ++i)
+    {
+        recoder_t rc;
+        bool done;
+        size_t consumed;
+        esp_err_t ret = decode(&rc, bank, len, chunks[i], &done, &consumed);
+        CHECK(ret == ESP_OK && done, "%s, chunk %zu: decode failed (0x%x)", name, chunks[i], ret);
+        CHECK(consumed == len, "%s, chunk %zu: consumed %zu of %zu", name, chunks[i], consumed, len);
+        CHECK(rc.out.len == len && memcmp(rc.out.data, bank, len) == 0,
+              "%s, chunk %zu: re-encoded bank differs (%zu vs %zu bytes)", name, chunks[i], rc.out.len, len);
+        free(rc.out.data);
+    }
+
+    // Bytes after BANK_END belong to whatever follows and are left unconsumed
+    uint8_t *padded = malloc(len + 3);
+    memcpy(padded, bank, len);
+    memcpy(padded + len, "XYZ", 3);
+    recoder_t rc;
+    bool done;
+    size_t consumed;
+    esp_err_t ret = decode(&rc, padded, len + 3, len + 3, &done, &consumed);
+    CHECK(ret == ESP_OK && done && consumed == len, "%s: trailing bytes consumed (%zu of %zu)", name, consumed,
+          len);
+    free(rc.out.data);
+    free(padded);
+}
+
+static void flip_and_check(const char *name, uint8_t *bank, size_t len, const size_t *patch_end_at,
+                           size_t patches, size_t pos, uint8_t bit)
+{
+    bank[pos] ^= bit;
+    recoder_t rc;
+    bool done;
+    size_t consumed;
+    esp_err_t ret = decode(&rc, bank, len, 1, &done, &consumed);
+    bank[pos] ^= bit;
+
+    // A patch's CRC covers its records from PATCH_BEGIN up to its PATCH_END record. Flips
+    // elsewhere (bank header, END records, BANK_END) may still let it through, since the
+    // patch itself is intact, but the bank as a whole must be rejected.
+    CHECK(!(ret == ESP_OK && done), "%s: bank accepted with bit 0x%02x of byte %zu flipped", name, bit, pos);
+    for (size_t k = 0; k < rc.patch_ends && k < patches; ++k)
+    {
+        size_t begin = k == 0 ? PATCH_FORMAT_HEADER_SIZE : patch_end_at[k - 1];
+        size_t end = patch_end_at[k] - PATCH_END_RECORD;
+        CHECK(pos < begin || pos >= end, "%s: patch %zu applied with bit 0x%02x of its byte %zu flipped", name, k,
+              bit, pos);
+    }
+    free(rc.out.data);
+}
+
+static void test_corruption(const char *name, uint8_t *bank, size_t len)
+{
+    // Offsets where each patch ends, from a clean one-byte-at-a-time decode
+    recoder_t clean;
+    bool done;
+    size_t consumed;
+    decode(&clean, bank, len, 1, &done, &consumed);
+    free(clean.out.data);
+    size_t patches = clean.patch_ends < MAX_PATCHES ? clean.patch_ends : MAX_PATCHES;
+
+    if (len <= EXHAUSTIVE_LIMIT)
+    {
+        for (size_t pos = 0; pos < len; ++pos)
+        {
+            for (int b = 0; b < 8; ++b)
+            {
+                flip_and_check(name, bank, len, clean.patch_end_at, patches, pos, (uint8_t)(1u << b));
+            }
+        }
+        return;
+    }
+    for (int i = 0; i < LARGE_BANK_FLIPS; ++i)
+    {
+        flip_and_check(name, bank, len, clean.patch_end_at, patches, rng() % len, (uint8_t)(1u << (rng() % 8)));
+    }
+}
+
+static void test_truncation(const char *name, const uint8_t *bank, size_t len)
+{
+    // A bank cut short is never done, however far it got
+    for (size_t cut = 0; cut < len; cut += 1 + len / 97)
+    {
+        recoder_t rc;
+        bool done;
+        size_t consumed;
+        decode(&rc, bank, cut, 0, &done, &consumed);
+        CHECK(!done, "%s: bank done after %zu of %zu bytes", name, cut, len);
+        free(rc.out.data);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s BANK...\n", argv[0]);
+        return 2;
+    }
+
+    RUN_TEST(test_crc());
+    for (int i = 1; i < argc; ++i)
+    {
+        size_t len = 0;
+        uint8_t *bank = read_file(argv[i], &len);
+        if (bank == NULL)
+        {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 2;
+        }
+        printf("%s (%zu bytes):\n", argv[i], len);
+        RUN_TEST(test_round_trip(argv[i], bank, len));
+        RUN_TEST(test_corruption(argv[i], bank, len));
+        RUN_TEST(test_truncation(argv[i], bank, len));
+        free(bank);
+    }
+    return test_summary("patch_format");
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+// Stored performance budgets, in CPU cycles per operation on the ESP32-S3 at
+// 240 MHz (median of PERF_SAMPLES runs). Each test case logs the measured value
+// next to its budget; when a change makes a path intentionally slower or faster,
+// update the number here in the same commit. All budgets are multiplied by
+// CONFIG_CENTRAL_PERF_BUDGET_SCALE_PCT / 100 at run time. A case without an entry
+// here fails.
+
+typedef struct
+{
+    const char *name;
+    uint32_t cycles;
+} perf_budget_t;
+
+static const perf_budget_t perf_budgets[] = {
+    // patch_manager: mutex + hash index + incremental graph update
+    {"patch_add/empty", 12000},
+    {"patch_add/half", 12000},
+    {"patch_add/full", 12000},
+    {"patch_remove/empty", 40000},
+    {"patch_remove/half", 40000},
+    {"patch_remove/full", 40000},
+    // get_connections is reported per returned connection (per call when empty)
+    {"patch_get/empty", 2000},
+    {"patch_get/half", 400},
+    {"patch_get/full", 400},
+
+    // i2c_manager against the mock bus: locking, framing and tracing only
+    {"i2c_send/mock", 12000},
+    {"i2c_send_mux_switch/mock", 16000},
+    {"i2c_param_block/mock", 14000},
+    {"i2c_param_redundant/mock", 6000}, // Shadow lookup only, no bus transaction
+    {"i2c_read/mock", 8000},
+    {"i2c_broadcast/mock", 16000},
+};
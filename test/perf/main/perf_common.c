@@ -0,0 +1,64 @@
+#include "perf_common.h"
+#include "perf_budgets.h"
+#include "unity.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <string.h>
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_cpu.h" // For esp_cpu_get_cycle_count
+#endif
+
+static const char *TAG = "PERF";
+
+#define PERF_REFERENCE_MHZ 240 // Clock the budgets were measured at
+
+uint32_t perf_cycles_now(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ns = (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+    return (uint32_t)(ns * PERF_REFERENCE_MHZ / 1000);
+#else
+    return (uint32_t)esp_cpu_get_cycle_count();
+#endif
+}
+
+uint32_t perf_median(uint32_t *samples, size_t n)
+{
+    // Insertion sort: n is small and this runs outside the measured region
+    for (size_t i = 1; i < n; ++i)
+    {
+        uint32_t v = samples[i];
+        size_t j = i;
+        while (j > 0 && samples[j - 1] > v)
+        {
+            samples[j] = samples[j - 1];
+            --j;
+        }
+        samples[j] = v;
+    }
+    return samples[n / 2];
+}
+
+static uint32_t budget_for(const char *name)
+{
+    for (size_t i = 0; i < sizeof(perf_budgets) / sizeof(perf_budgets[0]); ++i)
+    {
+        if (strcmp(perf_budgets[i].name, name) == 0)
+        {
+            return (uint32_t)((uint64_t)perf_budgets[i].cycles * CONFIG_CENTRAL_PERF_BUDGET_SCALE_PCT / 100);
+        }
+    }
+    return 0;
+}
+
+void perf_check(const char *name, uint32_t cycles)
+{
+    uint32_t budget = budget_for(name);
+    TEST_ASSERT_NOT_EQUAL_MESSAGE(0, budget, "No budget in perf_budgets.h");
+    ESP_LOGI(TAG, "%-26s %8lu cycles  (budget %lu)", name, (unsigned long)cycles, (unsigned long)budget);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(budget, cycles, name);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// Timing helpers shared by the performance test cases.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PERF_SAMPLES 64 // Samples per case; the median rejects interrupt/preemption spikes
+
+/**
+ * @brief Current time in CPU cycles. On linux, host time converted to cycles of the
+ * ESP32-S3 at 240 MHz, so the same budgets apply (with room to spare on any recent host).
+ */
+uint32_t perf_cycles_now(void);
+
+/**
+ * @brief Median of `n` samples (sorts them in place).
+ */
+uint32_t perf_median(uint32_t *samples, size_t n);
+
+/**
+ * @brief Log the median of a case next to its stored budget and fail the test if it is
+ * over budget, or if perf_budgets.h has no budget for `name`.
+ */
+void perf_check(const char *name, uint32_t cycles);
@@ -0,0 +1,137 @@
+// i2c_manager send, read and broadcast paths against the mock bus backend, so they time
+// the manager's locking, framing, shadow and tracing rather than the wire.
+
+#include "perf_common.h"
+#include "unity.h"
+#include "i2c_manager.h"
+#include "sdkconfig.h"
+
+#if !CONFIG_CENTRAL_I2C_BUS_BACKEND_MOCK
+#error "The I2C performance cases need CONFIG_CENTRAL_I2C_BUS_BACKEND_MOCK (see sdkconfig.defaults)"
+#endif
+
+#define PERF_MUX 0
+#define PERF_ADDR 0x40
+#define PERF_BLOCK 8 // Parameters per bulk write
+
+static ParamId_t ids[PERF_BLOCK];
+static ParamValue_t values[PERF_BLOCK];
+
+// Fresh parameter IDs, and no shadowed values left from an earlier case
+static void reset_module(void)
+{
+    for (int i = 0; i < PERF_BLOCK; ++i)
+    {
+        ids[i] = (ParamId_t)i;
+        values[i] = (ParamValue_t)(i * 100);
+    }
+    i2c_manager_invalidate_module(PERF_MUX, PERF_ADDR);
+}
+
+// --- Tests ---
+
+TEST_CASE("i2c_manager send", "[perf][i2c]")
+{
+    uint32_t samples[PERF_SAMPLES];
+    uint8_t payload[8] = {0};
+    reset_module();
+
+    // The payload changes every sample so nothing could be taken for a repeat
+    for (int s = 0; s < PERF_SAMPLES; ++s)
+    {
+        payload[sizeof(payload) - 1] = (uint8_t)s;
+        uint32_t t0 = perf_cycles_now();
+        esp_err_t ret = i2c_manager_send_command(PERF_MUX, PERF_ADDR, 0x10, payload, sizeof(payload));
+        samples[s] = perf_cycles_now() - t0;
+        TEST_ASSERT_EQUAL(ESP_OK, ret);
+    }
+    perf_check("i2c_send/mock", perf_median(samples, PERF_SAMPLES));
+}
+
+TEST_CASE("i2c_manager send with a mux switch", "[perf][i2c]")
+{
+    uint32_t samples[PERF_SAMPLES];
+    uint8_t payload[8] = {0};
+    reset_module();
+
+    for (int s = 0; s < PERF_SAMPLES; ++s)
+    {
+        payload[sizeof(payload) - 1] = (uint8_t)~s;
+        uint32_t t0 = perf_cycles_now();
+        esp_err_t ret = i2c_manager_send_command(s & 1, PERF_ADDR, 0x10, payload, sizeof(payload)); // Alternate channels
+        samples[s] = perf_cycles_now() - t0;
+        TEST_ASSERT_EQUAL(ESP_OK, ret);
+    }
+    i2c_manager_invalidate_module(1, PERF_ADDR);
+    perf_check("i2c_send_mux_switch/mock", perf_median(samples, PERF_SAMPLES));
+}
+
+TEST_CASE("i2c_manager param block", "[perf][i2c]")
+{
+    uint32_t samples[PERF_SAMPLES];
+    reset_module();
+
+    // New values every sample, so the redundant write check never drops them
+    for (int s = 0; s < PERF_SAMPLES; ++s)
+    {
+        for (int i = 0; i < PERF_BLOCK; ++i)
+        {
+            values[i] = (ParamValue_t)(s * PERF_BLOCK + i);
+        }
+        uint32_t t0 = perf_cycles_now();
+        esp_err_t ret = i2c_manager_send_param_block(PERF_MUX, PERF_ADDR, ids, values, PERF_BLOCK);
+        samples[s] = perf_cycles_now() - t0;
+        TEST_ASSERT_EQUAL(ESP_OK, ret);
+    }
+    perf_check("i2c_param_block/mock", perf_median(samples, PERF_SAMPLES));
+}
+
+TEST_CASE("i2c_manager redundant param block", "[perf][i2c]")
+{
+    uint32_t samples[PERF_SAMPLES];
+    reset_module();
+
+    // The module already holds every value, so nothing is sent
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_manager_send_param_block(PERF_MUX, PERF_ADDR, ids, values, PERF_BLOCK));
+    for (int s = 0; s < PERF_SAMPLES; ++s)
+    {
+        uint32_t t0 = perf_cycles_now();
+        esp_err_t ret = i2c_manager_send_param_block(PERF_MUX, PERF_ADDR, ids, values, PERF_BLOCK);
+        samples[s] = perf_cycles_now() - t0;
+        TEST_ASSERT_EQUAL(ESP_OK, ret);
+    }
+    perf_check("i2c_param_redundant/mock", perf_median(samples, PERF_SAMPLES));
+}
+
+TEST_CASE("i2c_manager read", "[perf][i2c]")
+{
+    uint32_t samples[PERF_SAMPLES];
+    uint8_t rx[4];
+    size_t rx_len = 0;
+    reset_module();
+
+    for (int s = 0; s < PERF_SAMPLES; ++s)
+    {
+        uint32_t t0 = perf_cycles_now();
+        esp_err_t ret = i2c_manager_read_data(PERF_MUX, PERF_ADDR, 0x01, true, rx, sizeof(rx), &rx_len);
+        samples[s] = perf_cycles_now() - t0;
+        TEST_ASSERT_EQUAL(ESP_OK, ret);
+    }
+    perf_check("i2c_read/mock", perf_median(samples, PERF_SAMPLES));
+}
+
+TEST_CASE("i2c_manager broadcast", "[perf][i2c]")
+{
+    uint32_t samples[PERF_SAMPLES];
+    reset_module();
+
+    for (int s = 0; s < PERF_SAMPLES; ++s)
+    {
+        uint32_t t0 = perf_cycles_now();
+        esp_err_t ret = i2c_manager_broadcast_param(I2C_MUX_ALL_CHANNELS, ids[0], values[0]); // Includes the mux mask write
+        samples[s] = perf_cycles_now() - t0;
+        TEST_ASSERT_EQUAL(ESP_OK, ret);
+        i2c_manager_select_mux_channel(PERF_MUX);
+    }
+    perf_check("i2c_broadcast/mock", perf_median(samples, PERF_SAMPLES));
+}
@@ -0,0 +1,126 @@
+// patch_manager add/remove/get at an empty, half-full and full (MAX_PATCH_CONNECTIONS)
+// patch. Each case clears the patch first, so a case that failed half way does not
+// affect the next; the journal is disabled, so nothing reaches flash.
+
+#include "perf_common.h"
+#include "unity.h"
+#include "patch_manager.h"
+#include "synth_constants.h" // For MAX_PATCH_CONNECTIONS
+#include <stdio.h>
+#include <stdlib.h>
+
+// Connections present before each measured add; "full" means the add takes the last slot
+static const uint32_t levels[] = {0, MAX_PATCH_CONNECTIONS / 2, MAX_PATCH_CONNECTIONS - 1};
+static const char *const level_names[] = {"empty", "half", "full"};
+
+// --- Helpers ---
+
+// Unique connection for index i; sources and destinations are disjoint module sets so
+// the patch is a DAG and timing does not depend on loop handling
+static void perf_connection(uint32_t i, module_id_t *src_module, port_id_t *src_port, module_id_t *dst_module,
+                            port_id_t *dst_port)
+{
+    *src_module = 1 + (i % 8);
+    *dst_module = 9 + (i / 8) % 8;
+    *src_port = (port_id_t)(i / 64);
+    *dst_port = (port_id_t)(i / (64 * 256));
+}
+
+static esp_err_t perf_add(uint32_t i)
+{
+    module_id_t sm, dm;
+    port_id_t sp, dp;
+    perf_connection(i, &sm, &sp, &dm, &dp);
+    return patch_manager_add_connection(sm, sp, dm, dp);
+}
+
+static esp_err_t perf_remove(uint32_t i)
+{
+    module_id_t sm, dm;
+    port_id_t sp, dp;
+    perf_connection(i, &sm, &sp, &dm, &dp);
+    return patch_manager_remove_connection(sm, sp, dm, dp);
+}
+
+// Bring the patch to exactly `target` connections (indices [0, target))
+static void perf_fill_to(uint32_t *filled, uint32_t target)
+{
+    while (*filled < target)
+    {
+        TEST_ASSERT_EQUAL(ESP_OK, perf_add(*filled));
+        (*filled)++;
+    }
+    while (*filled > target)
+    {
+        (*filled)--;
+        TEST_ASSERT_EQUAL(ESP_OK, perf_remove(*filled));
+    }
+}
+
+// --- Tests ---
+
+TEST_CASE("patch_manager add and remove", "[perf][patch]")
+{
+    TEST_ASSERT_EQUAL(ESP_OK, patch_manager_replace_connections(NULL, 0));
+
+    uint32_t add_samples[PERF_SAMPLES];
+    uint32_t remove_samples[PERF_SAMPLES];
+    uint32_t filled = 0;
+    char name[32];
+
+    for (int l = 0; l < 3; ++l)
+    {
+        perf_fill_to(&filled, levels[l]);
+
+        // Add one extra connection and remove it again, timing both halves
+        for (int s = 0; s < PERF_SAMPLES; ++s)
+        {
+            uint32_t idx = levels[l] + (uint32_t)s; // Fresh key each time
+            uint32_t t0 = perf_cycles_now();
+            esp_err_t add_ret = perf_add(idx);
+            uint32_t t1 = perf_cycles_now();
+            esp_err_t remove_ret = perf_remove(idx);
+            uint32_t t2 = perf_cycles_now();
+            TEST_ASSERT_EQUAL(ESP_OK, add_ret);
+            TEST_ASSERT_EQUAL(ESP_OK, remove_ret);
+            add_samples[s] = t1 - t0;
+            remove_samples[s] = t2 - t1;
+        }
+        snprintf(name, sizeof(name), "patch_add/%s", level_names[l]);
+        perf_check(name, perf_median(add_samples, PERF_SAMPLES));
+        snprintf(name, sizeof(name), "patch_remove/%s", level_names[l]);
+        perf_check(name, perf_median(remove_samples, PERF_SAMPLES));
+    }
+
+    perf_fill_to(&filled, 0);
+}
+
+TEST_CASE("patch_manager get_connections", "[perf][patch]")
+{
+    patch_connection_t *buf = malloc(MAX_PATCH_CONNECTIONS * sizeof(patch_connection_t));
+    TEST_ASSERT_NOT_NULL(buf);
+    TEST_ASSERT_EQUAL(ESP_OK, patch_manager_replace_connections(NULL, 0));
+
+    uint32_t samples[PERF_SAMPLES];
+    uint32_t filled = 0;
+    char name[32];
+
+    for (int l = 0; l < 3; ++l)
+    {
+        // Reported per returned connection (per call when empty); "full" reads all of them
+        perf_fill_to(&filled, l == 2 ? MAX_PATCH_CONNECTIONS : levels[l]);
+        for (int s = 0; s < PERF_SAMPLES; ++s)
+        {
+            size_t n = 0;
+            uint32_t t0 = perf_cycles_now();
+            patch_manager_get_connections(buf, MAX_PATCH_CONNECTIONS, &n);
+            samples[s] = (perf_cycles_now() - t0) / (n ? n : 1);
+            TEST_ASSERT_EQUAL(filled, n);
+        }
+        snprintf(name, sizeof(name), "patch_get/%s", level_names[l]);
+        perf_check(name, perf_median(samples, PERF_SAMPLES));
+    }
+
+    perf_fill_to(&filled, 0);
+    free(buf);
+}
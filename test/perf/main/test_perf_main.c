@@ -0,0 +1,39 @@
+#include "unity.h"
+#include "esp_log.h"
+#include "i2c_manager.h"
+#include "patch_manager.h"
+#include "task_layout.h"
+#include "sdkconfig.h"
+#include <stdlib.h> // For exit
+
+static const char *TAG = "PERF_TEST";
+
+void app_main(void)
+{
+    // Brought up once, as at boot; every case leaves them as it found them
+    i2c_manager_config_t i2c_config = {
+        .clk_speed = CONFIG_CENTRAL_I2C_MASTER_FREQ_HZ,
+        .muxes = {
+            {CONFIG_CENTRAL_I2C_MUX_ADDRESS, I2C_MUX_ROOT},
+        },
+        .task_stack_size = TASK_BUS_ENGINE_STACK,
+        .task_priority = TASK_BUS_ENGINE_PRIORITY,
+        .task_core_id = TASK_CORE_BUS,
+        .command_queue_size = CONFIG_CENTRAL_I2C_QUEUE_DEPTH,
+    };
+    ESP_ERROR_CHECK(i2c_manager_init(&i2c_config));
+    ESP_ERROR_CHECK(patch_manager_init());
+
+    ESP_LOGI(TAG, "Budgets at %d%%", CONFIG_CENTRAL_PERF_BUDGET_SCALE_PCT);
+    UNITY_BEGIN();
+    unity_run_all_tests();
+    int failures = UNITY_END();
+
+#if CONFIG_IDF_TARGET_LINUX
+    exit(failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+#else
+    // On the board, stay up so single cases can be run again from the menu
+    (void)failures;
+    unity_run_menu();
+#endif
+}
@@ -0,0 +1,223 @@
+#!/usr/bin/env python3
+"""Decode an I2C transaction trace dumped by the central controller.
+
+Accepts either the raw binary dump (i2c_trace_dump()) or a serial log that
+contains an "I2CT BEGIN" ... "I2CT END" block (i2c_trace_dump_console()).
+Prints per-module statistics and, optionally, the full timeline.
+
+    tools/i2c_trace_decode.py monitor.log
+    tools/i2c_trace_decode.py --timeline trace.bin
+    tools/i2c_trace_decode.py --csv timeline.csv monitor.log
+"""
+
+import argparse
+import csv
+import struct
+import sys
+from collections import defaultdict
+
+MAGIC = 0x54433249  # "I2CT"
+HEADER = struct.Struct("<IBBHIIQ")
+RECORD = struct.Struct("<IHHBBBBHh")
+
+OPS = {
+    0: "lost",
+    1: "mux",
+    2: "write",
+    3: "read",
+    4: "wr_rd",
+    5: "probe",
+    6: "bcast",
+}
+
+MUX_MULTI = 0xFF
+
+ERRORS = {
+    0: "OK",
+    -1: "FAIL",
+    0x101: "NO_MEM",
+    0x102: "INVALID_ARG",
+    0x103: "INVALID_STATE",
+    0x104: "INVALID_SIZE",
+    0x105: "NOT_FOUND",
+    0x106: "NOT_SUPPORTED",
+    0x107: "TIMEOUT",
+}
+
+
+def error_name(code):
+    return ERRORS.get(code, "0x%x" % (code & 0xFFFF))
+
+
+def extract_dump(data):
+    """Return the binary dump from either a raw file or a console log."""
+    if len(data) >= 4 and struct.unpack_from("<I", data)[0] == MAGIC:
+        return data
+
+    blocks = []
+    current = None
+    for line in data.decode("utf-8", errors="replace").splitlines():
+        pos = line.find("I2CT ")
+        if pos < 0:
+            continue
+        token = line[pos + 5:].strip()
+        if token == "BEGIN":
+            current = bytearray()
+        elif token == "END":
+            if current is not None:
+                blocks.append(bytes(current))
+            current = None
+        elif current is not None:
+            current.extend(bytes.fromhex(token.split()[0]))
+    if not blocks:
+        sys.exit("no trace dump found (expected raw dump or I2CT BEGIN/END block)")
+    return blocks[-1]  # Most recent dump in the log
+
+
+def parse(dump):
+    if len(dump) < HEADER.size:
+        sys.exit("dump too short for header")
+    magic, version, record_size, _, first_index, count, dump_time_us = HEADER.unpack_from(dump)
+    if magic != MAGIC:
+        sys.exit("bad magic 0x%08x" % magic)
+    if version != 1 or record_size != RECORD.size:
+        sys.exit("unsupported trace version %d / record size %d" % (version, record_size))
+
+    available = (len(dump) - HEADER.size) // RECORD.size
+    if available < count:
+        print("warning: dump truncated, %d of %d records" % (available, count), file=sys.stderr)
+        count = available
+
+    raw = [RECORD.unpack_from(dump, HEADER.size + i * RECORD.size) for i in range(count)]
+
+    # Timestamps are the low 32 bits of the microsecond clock. Unwrap them
+    # backwards from the dump time, allowing small reorderings between records.
+    records = []
+    next_abs = dump_time_us
+    next_low = dump_time_us & 0xFFFFFFFF
+    for i in range(count - 1, -1, -1):
+        ts, dur, seq, mux, addr, cmd, op, length, result = raw[i]
+        if op == 0:
+            continue
+        delta = (next_low - ts) & 0xFFFFFFFF
+        if delta >= 1 << 31:
+            delta -= 1 << 32
+        next_abs -= delta
+        next_low = ts
+        records.append({
+            "index": first_index + i,
+            "time_us": next_abs,
+            "duration_us": dur,
+            "op": OPS.get(op, "op%d" % op),
+            "mux": mux,
+            "addr": addr,
+            "cmd": cmd,
+            "length": length,
+            "result": result,
+        })
+    records.reverse()
+    lost = count - len(records)
+    return records, lost, dump_time_us
+
+
+def print_stats(records, lost):
+    if not records:
+        print("no records (%d lost)" % lost)
+        return
+
+    start = records[0]["time_us"]
+    end = max(r["time_us"] + r["duration_us"] for r in records)
+    span = max(end - start, 1)
+    busy = sum(r["duration_us"] for r in records)
+
+    print("records: %d  lost: %d  span: %.3f s  bus busy: %.1f%%" %
+          (len(records), lost, span / 1e6, 100.0 * busy / span))
+
+    modules = defaultdict(lambda: {"n": 0, "err": 0, "bytes": 0, "busy": 0, "max": 0,
+                                   "errors": defaultdict(int), "cmds": defaultdict(int)})
+    for r in records:
+        if r["op"] == "mux":
+            key = ("mux", r["mux"] if r["mux"] != MUX_MULTI else "mask")
+        elif r["op"] == "bcast":
+            key = ("bcast", r["mux"])
+        else:
+            key = (r["mux"], r["addr"])
+        m = modules[key]
+        m["n"] += 1
+        m["bytes"] += r["length"]
+        m["busy"] += r["duration_us"]
+        m["max"] = max(m["max"], r["duration_us"])
+        if r["op"] in ("write", "wr_rd", "bcast"):
+            m["cmds"][r["cmd"]] += 1
+        if r["result"] != 0:
+            m["err"] += 1
+            m["errors"][error_name(r["result"])] += 1
+
+    print()
+    print("%-12s %8s %6s %9s %9s %8s %8s %6s  %s" %
+          ("module", "txns", "errors", "bytes", "busy ms", "avg us", "max us", "bus%", "top commands / errors"))
+
+    def sort_key(item):
+        return -item[1]["busy"]
+
+    for key, m in sorted(modules.items(), key=sort_key):
+        if key[0] == "mux":
+            name = "mux sel mask" if key[1] == "mask" else "mux sel ch%d" % key[1]
+        elif key[0] == "bcast":
+            name = "bcast 0x%02x" % key[1]
+        else:
+            name = "ch%d 0x%02x" % key
+        top = sorted(m["cmds"].items(), key=lambda kv: -kv[1])[:3]
+        notes = " ".join("0x%02x:%d" % kv for kv in top)
+        if m["errors"]:
+            notes += "  " + " ".join("%s:%d" % kv for kv in sorted(m["errors"].items()))
+        print("%-12s %8d %6d %9d %9.1f %8.1f %8d %5.1f%%  %s" %
+              (name, m["n"], m["err"], m["bytes"], m["busy"] / 1000.0, m["busy"] / m["n"],
+               m["max"], 100.0 * m["busy"] / span, notes))
+
+
+def print_timeline(records, out):
+    start = records[0]["time_us"] if records else 0
+    for r in records:
+        if r["op"] == "bcast" or r["mux"] == MUX_MULTI:
+            where = "m%02x" % (r["mux"] if r["op"] == "bcast" else r["cmd"])  # Channel mask
+        else:
+            where = "ch%d" % r["mux"]
+        out.write("%12.3f ms  +%5d us  %-5s %s 0x%02x cmd 0x%02x len %4d  %s\n" %
+                  ((r["time_us"] - start) / 1000.0, r["duration_us"], r["op"], where, r["addr"],
+                   r["cmd"], r["length"], error_name(r["result"])))
+
+
+def write_csv(records, path):
+    with open(path, "w", newline="") as f:
+        writer = csv.writer(f)
+        writer.writerow(["index", "time_us", "duration_us", "op", "mux", "addr", "cmd", "length", "result"])
+        for r in records:
+            writer.writerow([r["index"], r["time_us"], r["duration_us"], r["op"], r["mux"],
+                             "0x%02x" % r["addr"], "0x%02x" % r["cmd"], r["length"], error_name(r["result"])])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", help="raw dump or serial log ('-' for stdin)")
+    parser.add_argument("--timeline", action="store_true", help="print every transaction")
+    parser.add_argument("--csv", metavar="PATH", help="write the timeline as CSV")
+    args = parser.parse_args()
+
+    if args.input == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.input, "rb") as f:
+            data = f.read()
+
+    records, lost, _ = parse(extract_dump(data))
+    if args.timeline:
+        print_timeline(records, sys.stdout)
+        print()
+    if args.csv:
+        write_csv(records, args.csv)
+    print_stats(records, lost)
+
+
+if __name__ == "__main__":
+    main()
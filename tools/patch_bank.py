@@ -0,0 +1,414 @@
+#!/usr/bin/env python3
+"""Read, write and transfer patch banks (components/patch_format).
+
+Host-side reference implementation of the bank format, plus a client for the
+USB CDC librarian endpoint (components/usb_librarian).
+
+    tools/patch_bank.py dump bank.pbnk
+    tools/patch_bank.py roundtrip bank.pbnk
+    tools/patch_bank.py example --connections 4096 bank.pbnk
+    tools/patch_bank.py pull /dev/ttyACM0 bank.pbnk
+    tools/patch_bank.py push /dev/ttyACM0 bank.pbnk [--slot N]
+    tools/patch_bank.py sync /dev/ttyACM0 [--since SESSION:GEN] [--json]
+
+`sync` prints the parameter values changed since SESSION:GEN and the
+SESSION:GEN to pass next time. Without --since, or when the controller has
+rebooted since (a new session), every stored value is fetched.
+
+JSON is the editable form: `dump --json` writes it, `build` turns it back into
+a bank.
+"""
+
+import argparse
+import json
+import struct
+import sys
+import time
+import zlib
+
+MAGIC = 0x4B4E4250  # "PBNK"
+VERSION = 1
+MAX_NAME = 32
+MAX_BODY = 64
+
+PATCH_BEGIN = 0x01
+MODULE = 0x02
+CONNECTION = 0x03
+PARAM = 0x04
+PATCH_END = 0x05
+BANK_END = 0x7F
+
+CONN_FLAG_ACTIVE = 0x01
+
+
+class FormatError(Exception):
+    pass
+
+
+# --- Primitives ---
+
+def put_varint(v):
+    out = bytearray()
+    while v >= 0x80:
+        out.append((v & 0x7F) | 0x80)
+        v >>= 7
+    out.append(v)
+    return bytes(out)
+
+
+def zigzag(v):
+    return ((v << 1) ^ (v >> 31)) & 0xFFFFFFFF
+
+
+def unzigzag(v):
+    return (v >> 1) ^ -(v & 1)
+
+
+class Cursor:
+    def __init__(self, body):
+        self.body = body
+        self.pos = 0
+
+    def varint(self):
+        v = 0
+        for shift in range(0, 35, 7):
+            if self.pos >= len(self.body):
+                break
+            b = self.body[self.pos]
+            self.pos += 1
+            v |= (b & 0x7F) << shift
+            if not b & 0x80:
+                return v & 0xFFFFFFFF
+        raise FormatError("truncated varint")
+
+    def u32(self):
+        if len(self.body) - self.pos < 4:
+            raise FormatError("truncated u32")
+        v = struct.unpack_from("<I", self.body, self.pos)[0]
+        self.pos += 4
+        return v
+
+    def raw(self, n):
+        if len(self.body) - self.pos < n:
+            raise FormatError("truncated field")
+        v = self.body[self.pos:self.pos + n]
+        self.pos += n
+        return v
+
+
+# --- Encoding ---
+
+def record(rtype, body):
+    return bytes([rtype]) + put_varint(len(body)) + body
+
+
+def encode(bank):
+    """bank: {"patches": [{"index", "name", "modules", "connections", "params"}]}"""
+    out = bytearray(struct.pack("<IBB", MAGIC, VERSION, 0))
+    for patch in bank["patches"]:
+        start = len(out)
+        name = patch.get("name", "").encode("utf-8")[:MAX_NAME]
+        out += record(PATCH_BEGIN, put_varint(patch["index"]) + put_varint(len(name)) + name)
+        for m in patch.get("modules", []):
+            out += record(MODULE, b"".join(put_varint(m[k]) for k in
+                                           ("module_id", "mux_channel", "address", "module_type", "fw_version")))
+        for c in patch.get("connections", []):
+            flags = CONN_FLAG_ACTIVE if c.get("active", True) else 0
+            out += record(CONNECTION, b"".join(put_varint(v) for v in
+                                               (c["src_module"], c["src_port"], c["dst_module"], c["dst_port"], flags)))
+        for p in patch.get("params", []):
+            out += record(PARAM, put_varint(p["module_id"]) + put_varint(p["param_id"]) + put_varint(zigzag(p["value"])))
+        out += record(PATCH_END, struct.pack("<I", zlib.crc32(out[start:])))
+    body = put_varint(len(bank["patches"]))
+    out += record(BANK_END, body + struct.pack("<I", zlib.crc32(out)))
+    return bytes(out)
+
+
+# --- Decoding ---
+
+def decode(data):
+    """Return (bank, bytes used). Raises FormatError on any corruption."""
+    if len(data) < 6:
+        raise FormatError("too short for header")
+    magic, version, _ = struct.unpack_from("<IBB", data)
+    if magic != MAGIC:
+        raise FormatError("bad magic 0x%08x" % magic)
+    if version != VERSION:
+        raise FormatError("unsupported version %d" % version)
+
+    pos = 6
+    patches = []
+    patch = None
+    patch_start = 0
+    while True:
+        record_start = pos
+        if pos >= len(data):
+            raise FormatError("missing BANK_END")
+        rtype = data[pos]
+        c = Cursor(data)
+        c.pos = pos + 1
+        length = c.varint()
+        body_start = c.pos
+        if body_start + length > len(data):
+            raise FormatError("truncated record 0x%02x" % rtype)
+        known = rtype in (PATCH_BEGIN, MODULE, CONNECTION, PARAM, PATCH_END, BANK_END)
+        if known and length > MAX_BODY:
+            raise FormatError("record 0x%02x too long (%d)" % (rtype, length))
+        body = Cursor(data[body_start:body_start + length])
+        pos = body_start + length
+
+        if known and rtype not in (PATCH_BEGIN, BANK_END) and patch is None:
+            raise FormatError("record 0x%02x outside a patch" % rtype)
+
+        if rtype == PATCH_BEGIN:
+            if patch is not None:
+                raise FormatError("nested PATCH_BEGIN")
+            index = body.varint()
+            name_len = body.varint()
+            if name_len > MAX_NAME:
+                raise FormatError("name too long")
+            name = body.raw(name_len).decode("utf-8", errors="replace")
+            patch = {"index": index, "name": name, "modules": [], "connections": [], "params": []}
+            patch_start = record_start
+        elif rtype == MODULE:
+            keys = ("module_id", "mux_channel", "address", "module_type", "fw_version")
+            patch["modules"].append({k: body.varint() for k in keys})
+        elif rtype == CONNECTION:
+            v = [body.varint() for _ in range(5)]
+            patch["connections"].append({"src_module": v[0], "src_port": v[1], "dst_module": v[2],
+                                         "dst_port": v[3], "active": bool(v[4] & CONN_FLAG_ACTIVE)})
+        elif rtype == PARAM:
+            module_id, param_id, value = body.varint(), body.varint(), unzigzag(body.varint())
+            patch["params"].append({"module_id": module_id, "param_id": param_id, "value": value})
+        elif rtype == PATCH_END:
+            crc = body.u32()
+            if crc != zlib.crc32(data[patch_start:record_start]):
+                raise FormatError("patch %d CRC mismatch" % patch["index"])
+            patches.append(patch)
+            patch = None
+        elif rtype == BANK_END:
+            if patch is not None:
+                raise FormatError("BANK_END inside a patch")
+            count, crc = body.varint(), body.u32()
+            if crc != zlib.crc32(data[:record_start]):
+                raise FormatError("bank CRC mismatch")
+            if count != len(patches):
+                raise FormatError("bank says %d patches, found %d" % (count, len(patches)))
+            return {"patches": patches}, pos
+        # Unknown record types are skipped
+
+
+# --- Commands ---
+
+def cmd_dump(args):
+    bank, used = decode(read_file(args.bank))
+    if args.json:
+        json.dump(bank, sys.stdout, indent=1)
+        print()
+        return
+    print("%d bytes, %d patches" % (used, len(bank["patches"])))
+    for p in bank["patches"]:
+        print("patch %d '%s': %d modules, %d connections, %d params" %
+              (p["index"], p["name"], len(p["modules"]), len(p["connections"]), len(p["params"])))
+        for m in p["modules"]:
+            print("  module %d: ch%d 0x%02x type %d fw 0x%04x" %
+                  (m["module_id"], m["mux_channel"], m["address"], m["module_type"], m["fw_version"]))
+
+
+def cmd_build(args):
+    with open(args.json) as f:
+        bank = json.load(f)
+    write_file(args.bank, encode(bank))
+
+
+def cmd_roundtrip(args):
+    data = read_file(args.bank)
+    bank, used = decode(data)
+    again = encode(bank)
+    if again != data[:used]:
+        sys.exit("round trip differs (%d vs %d bytes)" % (len(again), used))
+    print("round trip OK: %d bytes, %d patches" % (used, len(bank["patches"])))
+
+
+def cmd_example(args):
+    modules = [{"module_id": (ch << 8) | addr, "mux_channel": ch, "address": addr, "module_type": 1 + (addr & 3),
+                "fw_version": 0x0102} for ch in range(8) for addr in (0x20, 0x21)]
+    ids = [m["module_id"] for m in modules]
+    conns = [{"src_module": ids[i % len(ids)], "src_port": (i // len(ids)) & 0xFF,
+              "dst_module": ids[(i * 7 + 3) % len(ids)], "dst_port": (i // 256) & 0xFF, "active": True}
+             for i in range(args.connections)]
+    params = [{"module_id": ids[i % len(ids)], "param_id": i // len(ids), "value": (i * 977) - 20000}
+              for i in range(args.params)]
+    bank = {"patches": [{"index": i, "name": "example %d" % i, "modules": modules, "connections": conns,
+                         "params": params} for i in range(args.patches)]}
+    data = encode(bank)
+    write_file(args.bank, data)
+    print("wrote %d bytes" % len(data))
+
+
+# --- Librarian Client ---
+
+def open_port(path):
+    try:
+        import serial
+    except ImportError:
+        sys.exit("pull/push/sync need pyserial (pip install pyserial)")
+    return serial.Serial(path, timeout=5)
+
+
+def read_line(port):
+    line = port.readline().decode("ascii", errors="replace").strip()
+    if not line:
+        sys.exit("no reply from librarian")
+    return line
+
+
+def read_bank(port):
+    """Read until a complete bank has arrived; returns (bank, bank bytes)."""
+    data = bytearray()
+    while True:
+        chunk = port.read(max(1, port.in_waiting))
+        if not chunk:
+            sys.exit("timeout after %d bytes" % len(data))
+        data += chunk
+        try:
+            bank, used = decode(bytes(data))
+            return bank, bytes(data[:used])
+        except FormatError as e:
+            if "missing" not in str(e) and "truncated" not in str(e):
+                raise
+
+
+def cmd_pull(args):
+    port = open_port(args.port)
+    port.reset_input_buffer()
+    port.write(b"EXPORT\n")
+    reply = read_line(port)
+    if reply != "BANK":
+        sys.exit("librarian: %s" % reply)
+    t0 = time.monotonic()
+    bank, data = read_bank(port)
+    used = len(data)
+    dt = time.monotonic() - t0
+    write_file(args.bank, data)
+    print("pulled %d patches, %d bytes in %.2f s (%.0f KB/s)" %
+          (len(bank["patches"]), used, dt, used / 1024.0 / max(dt, 1e-6)))
+
+
+def cmd_push(args):
+    data = read_file(args.bank)
+    decode(data)  # Refuse to send a corrupt bank
+    port = open_port(args.port)
+    port.reset_input_buffer()
+    port.write(b"IMPORT %d\n" % args.slot)
+    reply = read_line(port)
+    if reply != "READY":
+        sys.exit("librarian: %s" % reply)
+    t0 = time.monotonic()
+    port.write(data)
+    port.flush()
+    reply = read_line(port)
+    dt = time.monotonic() - t0
+    print("librarian: %s (%d bytes in %.2f s, %.0f KB/s)" % (reply, len(data), dt, len(data) / 1024.0 / max(dt, 1e-6)))
+    if not reply.startswith("OK"):
+        sys.exit(1)
+
+
+def parse_sync_point(text):
+    """'SESSION:GEN' as printed by sync -> (session, generation)."""
+    try:
+        session, generation = text.split(":")
+        return int(session), int(generation)
+    except ValueError:
+        raise argparse.ArgumentTypeError("expected SESSION:GEN, got %r" % text)
+
+
+def cmd_sync(args):
+    session, since = args.since or (0, 0)
+    port = open_port(args.port)
+    port.reset_input_buffer()
+    port.write(b"SYNC %d %d\n" % (session, since))
+    reply = read_line(port).split()
+    if len(reply) != 4 or reply[0] != "DELTA":
+        sys.exit("librarian: %s" % " ".join(reply))
+    new_session, generation, full = int(reply[1]), int(reply[2]), reply[3] == "1"
+    bank, data = read_bank(port)
+    params = bank["patches"][0]["params"]
+    if args.json:
+        json.dump({"session": new_session, "generation": generation, "full": full, "params": params},
+                  sys.stdout, indent=1)
+        print()
+        return
+    print("%d:%d (%s): %d parameters, %d bytes" %
+          (new_session, generation, "full" if full else "changes since %d:%d" % (session, since), len(params),
+           len(data)))
+    for p in params:
+        print("  module 0x%04X param %3d = %d" % (p["module_id"], p["param_id"], p["value"]))
+
+
+def read_file(path):
+    if path == "-":
+        return sys.stdin.buffer.read()
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def write_file(path, data):
+    if path == "-":
+        sys.stdout.buffer.write(data)
+        return
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("dump", help="summarize a bank")
+    p.add_argument("bank")
+    p.add_argument("--json", action="store_true", help="print the whole bank as JSON")
+    p.set_defaults(func=cmd_dump)
+
+    p = sub.add_parser("build", help="encode a JSON bank")
+    p.add_argument("json")
+    p.add_argument("bank")
+    p.set_defaults(func=cmd_build)
+
+    p = sub.add_parser("roundtrip", help="decode and re-encode, checking the bytes are identical")
+    p.add_argument("bank")
+    p.set_defaults(func=cmd_roundtrip)
+
+    p = sub.add_parser("example", help="generate a synthetic bank")
+    p.add_argument("bank")
+    p.add_argument("--patches", type=int, default=4)
+    p.add_argument("--connections", type=int, default=256)
+    p.add_argument("--params", type=int, default=512)
+    p.set_defaults(func=cmd_example)
+
+    p = sub.add_parser("pull", help="export the live patch over the USB librarian")
+    p.add_argument("port")
+    p.add_argument("bank")
+    p.set_defaults(func=cmd_pull)
+
+    p = sub.add_parser("push", help="send a bank over the USB librarian and apply one patch")
+    p.add_argument("port")
+    p.add_argument("bank")
+    p.add_argument("--slot", type=int, default=0, help="index of the patch to apply")
+    p.set_defaults(func=cmd_push)
+
+    p = sub.add_parser("sync", help="fetch the parameter values changed since a previous sync")
+    p.add_argument("port")
+    p.add_argument("--since", type=parse_sync_point, help="SESSION:GEN printed by the previous sync")
+    p.add_argument("--json", action="store_true", help="print session, generation and parameters as JSON")
+    p.set_defaults(func=cmd_sync)
+
+    args = parser.parse_args()
+    try:
+        args.func(args)
+    except FormatError as e:
+        sys.exit("bad bank: %s" % e)
+
+
+if __name__ == "__main__":
+    main()